@@ -0,0 +1,77 @@
+#ifndef ADMIN_MODULE_H
+#define ADMIN_MODULE_H
+
+#include <Arduino.h>
+#include "proto/meshtastic_protocol.h"
+#include "ConfigStore.h"
+#include "FromRadioQueue.h"
+
+#define ADMIN_MAX_CHANNELS    8
+
+// An edit left open this long is discarded, so RAM and flash do not drift
+// apart if the client goes away mid-batch. Saving a half-sent batch could
+// keep a LoRa preset without the channels that go with it; the client sees
+// the old settings on its next read and can send the batch again.
+#define ADMIN_EDIT_TIMEOUT_MS 120000
+
+// Local AdminMessage handling: get/set of config, module config, channels
+// and owner, kept in a ConfigStore. Sets are visible at once. Outside an
+// edit each set is persisted immediately; between begin_edit_settings and
+// commit_edit_settings they are batched into a single commit.
+class AdminModule {
+public:
+    AdminModule();
+
+    // Use `store` for settings, writing defaults if it is empty
+    bool begin(uint32_t nodeNum, ConfigStore* store);
+
+    void onSend(FromRadioSendCallback callback);
+
+    // Called with the channel index after set_channel, or with -1 after the
+    // LoRa config is set (the preset names every unnamed channel)
+    void onChannelChanged(std::function<void(int index)> callback);
+
+    // A packet from a client's ToRadio. Returns true if it was an admin
+    // packet for this node (it is then applied, not sent to the mesh).
+    bool handlePacket(const meshtastic_MeshPacket& packet);
+
+    // Discard an edit left open too long. Call from loop().
+    void update();
+
+    bool getChannel(uint8_t index, meshtastic_Channel* out);
+    bool getOwner(meshtastic_User* out);
+
+    void printStats();
+
+private:
+    ConfigStore* store;
+    FromRadioSendCallback sendCallback;
+    std::function<void(int index)> channelChanged;
+    uint32_t nodeNum;
+
+    bool editing;
+    unsigned long editStartedAt;
+    uint16_t pendingSets;       // Sets staged since the last commit
+
+    // Statistics
+    uint32_t messagesHandled;
+    uint32_t messagesMalformed;
+    uint32_t unsupported;
+    uint32_t editsDiscarded;
+    uint32_t lastBatchBytes;
+    uint16_t lastBatchSets;
+
+    void writeDefaults();
+    void commit();
+
+    void handleAdmin(uint32_t requestId, const meshtastic_AdminMessage& admin);
+    void afterSet();
+    bool getConfigSection(meshtastic_AdminMessage_ConfigType type, meshtastic_Config* out);
+    bool setConfigSection(const meshtastic_Config& in);
+    bool getModuleSection(meshtastic_AdminMessage_ModuleConfigType type, meshtastic_ModuleConfig* out);
+    bool setModuleSection(const meshtastic_ModuleConfig& in);
+    bool setOwner(const meshtastic_User& user);
+    void sendResponse(uint32_t requestId, const meshtastic_AdminMessage& response);
+};
+
+#endif // ADMIN_MODULE_H
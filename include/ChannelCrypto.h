@@ -0,0 +1,79 @@
+#ifndef CHANNEL_CRYPTO_H
+#define CHANNEL_CRYPTO_H
+
+#include <Arduino.h>
+#include "proto/meshtastic_protocol.h"
+
+// ESP32 builds use mbedtls, which drives the hardware AES block; the
+// portable table-based AES is for host builds
+#ifdef ESP_PLATFORM
+#include <mbedtls/aes.h>
+#else
+#define CHANNEL_CRYPTO_SOFTWARE 1
+#endif
+
+#define CRYPTO_MAX_CHANNELS  8    // One bit per slot in the hash table
+#define CRYPTO_BLOCK_SIZE    16
+#define CRYPTO_MAX_KEY       32
+
+// Expanded key for one channel slot
+struct ChannelKey {
+    volatile bool valid;       // Cleared while the slot is being rewritten
+    uint8_t hash;              // Channel hash carried in encrypted packets
+    uint8_t keyLength;         // 16 or 32, 0 = channel is not encrypted
+#ifdef CHANNEL_CRYPTO_SOFTWARE
+    uint8_t rounds;
+    uint8_t roundKeys[4 * 4 * 15];
+#else
+    mbedtls_aes_context aes;
+#endif
+};
+
+// AES-CTR for channel PSKs, as used by Meshtastic: the initial counter
+// block is the packet id (64-bit LE) followed by the sender (32-bit LE).
+// Key schedules are expanded once per channel, and packets are decrypted
+// in place in their receive buffer. A 256-entry table maps each channel
+// hash to the slots that produce it, so only those are tried.
+class ChannelCrypto {
+public:
+    ChannelCrypto();
+
+    // (Re)load the key for a channel slot. Unnamed channels hash as
+    // `defaultName` (the modem preset name, e.g. "LongFast").
+    void setChannel(uint8_t index, const meshtastic_Channel& channel, const char* defaultName);
+
+    // Decrypt an encrypted packet in place and replace it with its decoded
+    // Data. Returns false if no channel key produced a valid payload.
+    bool decrypt(meshtastic_MeshPacket& packet);
+
+    // Encrypt or decrypt (CTR is symmetric) with a channel's key
+    bool crypt(uint8_t index, uint32_t packetId, uint32_t from, uint8_t* data, size_t length);
+
+    void printStats();
+
+    static uint8_t channelHash(const char* name, const uint8_t* key, size_t keyLength);
+    static const char* presetName(meshtastic_Config_LoRaConfig_ModemPreset preset);
+
+    // AES primitives, shared with PkiCrypto
+    static void setKey(ChannelKey& slot, const uint8_t* key, uint8_t keyLength);
+    static void encryptBlock(ChannelKey& slot, const uint8_t* in, uint8_t* out);
+    // CTR from an explicit initial counter block
+    static void ctr(ChannelKey& slot, const uint8_t* nonce, uint8_t* data, size_t length);
+
+private:
+    ChannelKey keys[CRYPTO_MAX_CHANNELS];
+    volatile uint8_t hashSlots[256];   // Bitmask of slots per channel hash
+
+    // Statistics
+    uint32_t packetsDecrypted;
+    uint32_t packetsFailed;
+    uint32_t bytesDecrypted;
+    uint32_t decryptMicrosTotal;
+    uint32_t trialDecrypts;
+    uint32_t noCandidate;       // Dropped without any AES work
+
+    static bool expandPsk(const meshtastic_ChannelSettings_psk_t& psk, uint8_t* key, uint8_t* keyLength);
+    static void makeNonce(uint32_t packetId, uint32_t from, uint8_t* nonce);
+};
+
+#endif // CHANNEL_CRYPTO_H
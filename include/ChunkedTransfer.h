@@ -0,0 +1,121 @@
+#ifndef CHUNKED_TRANSFER_H
+#define CHUNKED_TRANSFER_H
+
+#include <Arduino.h>
+#include <functional>
+#include "proto/meshtastic_protocol.h"
+
+// Chunks and responses travel as Data payloads on private-range ports
+#define CHUNKED_PAYLOAD_PORT      ((meshtastic_PortNum)300)
+#define CHUNKED_RESPONSE_PORT     ((meshtastic_PortNum)301)
+
+// Chunk data per packet; an encoded ChunkedPayload must fit in Data.payload (233)
+#define CHUNK_DATA_SIZE           200
+#define CHUNK_MAX_CHUNKS          32    // One bitmap word per transfer
+#define CHUNK_MAX_PAYLOAD         (CHUNK_DATA_SIZE * 20)
+
+// Receive side memory budget: CHUNK_REASSEMBLY_SLOTS * CHUNK_MAX_PAYLOAD bytes
+#define CHUNK_REASSEMBLY_SLOTS    2
+#define CHUNK_RECENT_COMPLETED    4
+
+#define CHUNK_SEND_INTERVAL_MS    500   // Pacing between outgoing chunks
+#define CHUNK_RESEND_TIMEOUT_MS   3000  // Silence before asking for missing chunks
+#define CHUNK_MAX_RESEND_REQUESTS 5
+#define CHUNK_TRANSFER_TIMEOUT_MS 60000
+
+// Sends a Data payload to a node (wired to MessageHandler + BLE by the app)
+typedef std::function<void(uint32_t to, const meshtastic_Data& data)> ChunkSendCallback;
+
+// Called with a fully reassembled payload
+typedef std::function<void(uint32_t from, uint32_t payloadId, const uint8_t* data, size_t length)> PayloadCallback;
+
+// Reassembly state for one incoming payload
+struct ChunkReassembly {
+    bool active;
+    uint32_t from;
+    uint32_t payloadId;
+    uint16_t chunkCount;
+    uint16_t lastChunkLength;
+    uint32_t received;               // Bitmap of received chunk indexes
+    uint8_t resendRequests;
+    unsigned long startedAt;
+    unsigned long lastActivity;
+    uint8_t data[CHUNK_MAX_PAYLOAD];
+};
+
+// Splits payloads larger than one packet into meshtastic_ChunkedPayload
+// packets and reassembles them on the other side. The receiver keeps a
+// bitmap per transfer and asks only for missing indexes
+// (ChunkedPayloadResponse.resend_chunks) after a quiet period.
+class ChunkedTransfer {
+public:
+    ChunkedTransfer();
+
+    void onSend(ChunkSendCallback callback);
+    void onPayloadComplete(PayloadCallback callback);
+
+    // Start sending a payload. The data is not copied and must stay valid
+    // until the transfer finishes. Returns the payload id, 0 on failure.
+    uint32_t send(uint32_t to, const uint8_t* data, size_t length);
+    bool isSending();
+
+    // Packets received on CHUNKED_PAYLOAD_PORT / CHUNKED_RESPONSE_PORT
+    bool handleChunkPacket(const meshtastic_MeshPacket& packet);
+    bool handleResponsePacket(const meshtastic_MeshPacket& packet);
+
+    // Pace outgoing chunks, request missing ones, expire stale transfers.
+    // Call from loop().
+    void update();
+
+    void printStats();
+
+private:
+    // Outgoing transfer (one at a time)
+    bool sending;
+    uint32_t sendTo;
+    uint32_t sendPayloadId;
+    const uint8_t* sendData;
+    size_t sendLength;
+    uint16_t sendChunkCount;
+    uint32_t sendPending;            // Bitmap of chunks still to (re)send
+    uint32_t sendSent;               // Bitmap of chunks sent at least once
+    unsigned long lastChunkSentAt;
+    unsigned long lastResponseAt;
+    uint8_t sendProbes;              // Last chunk resent to draw out a lost reply
+
+    ChunkReassembly slots[CHUNK_REASSEMBLY_SLOTS];
+
+    // Recently completed transfers, so late duplicates get a fresh accept
+    struct CompletedTransfer {
+        uint32_t from;
+        uint32_t payloadId;
+    };
+    CompletedTransfer completed[CHUNK_RECENT_COMPLETED];
+    uint8_t completedNext;
+
+    ChunkSendCallback sendCallback;
+    PayloadCallback payloadCallback;
+
+    // Statistics
+    uint32_t chunksSent;
+    uint32_t chunksResent;
+    uint32_t chunkBytesSent;
+    uint32_t chunksReceived;
+    uint32_t duplicateChunks;
+    uint32_t resendRequestsSent;
+    uint32_t transfersSent;
+    uint32_t transfersReceived;
+    uint32_t transfersFailed;
+    uint32_t payloadBytesSent;       // Payload bytes of acknowledged sends
+    uint32_t payloadBytesDelivered;
+
+    bool sendChunk(uint16_t index);
+    void sendResponse(uint32_t to, uint32_t payloadId, bool accept, uint32_t missing);
+    ChunkReassembly* findSlot(uint32_t from, uint32_t payloadId);
+    ChunkReassembly* allocateSlot();
+    bool wasCompleted(uint32_t from, uint32_t payloadId);
+    void completeSlot(ChunkReassembly& slot);
+    uint32_t missingChunks(const ChunkReassembly& slot);
+};
+
+#endif // CHUNKED_TRANSFER_H
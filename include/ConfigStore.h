@@ -0,0 +1,104 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <vector>
+#include <pb.h>
+#include "proto/meshtastic_protocol.h"
+#include "meshtastic/localonly.pb.h"
+#include "meshtastic/deviceonly.pb.h"
+
+#define CONFIG_NVS_NAMESPACE  "config"
+#define CONFIG_IMAGE_MAGIC    0x31474643  // "CFG1"
+#define CONFIG_IMAGE_VERSION  1           // Bump on incompatible layout changes
+#define CONFIG_IMAGE_MAX      3072
+#define CONFIG_SECTION_MAX    256         // Largest encoded section (MQTTConfig, 224)
+
+// The message a section belongs to. Each section is one top-level field
+// of that message (e.g. LocalConfig.lora), or one element of a repeated
+// field (ChannelFile.channels[i]).
+enum ConfigMessage : uint8_t {
+    CONFIG_LOCAL    = 0,   // meshtastic_LocalConfig
+    CONFIG_MODULES  = 1,   // meshtastic_LocalModuleConfig
+    CONFIG_CHANNELS = 2,   // meshtastic_ChannelFile
+    CONFIG_OWNER    = 3    // meshtastic_User (stored whole, field 0)
+};
+
+// Image layout: header, section table, then the nanopb-encoded sections.
+// Offsets in the table are relative to the start of the section data.
+struct ConfigImageHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t sectionCount;
+    uint32_t sequence;         // Newer image wins at load
+    uint32_t crc32;            // Over the whole image with this field zeroed
+    uint32_t length;
+};
+
+struct ConfigSectionEntry {
+    uint8_t message;           // ConfigMessage
+    uint8_t field;             // Field number within the message
+    uint8_t index;             // Element of a repeated field
+    uint8_t reserved;
+    uint16_t offset;
+    uint16_t length;
+};
+
+// Settings kept as one encoded image instead of decoded structs. Reads
+// decode a single section on demand. Writes patch a copy of the image
+// (copy-on-write); commit() saves it to the other of two NVS slots, so a
+// power loss mid-write leaves the previous image intact.
+class ConfigStore {
+public:
+    ConfigStore();
+
+    // Load the newest valid image. Returns false if there is none.
+    bool begin();
+
+    bool hasImage();
+
+    // Decode one section into `out`. A missing section decodes to defaults.
+    bool read(ConfigMessage message, uint8_t field, uint8_t index, const pb_msgdesc_t* fields, void* out);
+
+    // Encode `in` as a section of the working copy (visible to reads at once)
+    bool write(ConfigMessage message, uint8_t field, uint8_t index, const pb_msgdesc_t* fields, const void* in);
+
+    // Uncommitted writes pending
+    bool isDirty();
+
+    // Persist the working copy. Returns bytes written to flash (0 on failure).
+    size_t commit();
+
+    // Drop uncommitted writes
+    void discard();
+
+    // Heap held by the committed image and the working copy
+    size_t residentBytes();
+
+    void printStats();
+
+private:
+    Preferences preferences;
+    std::vector<uint8_t> active;   // Last committed image
+    std::vector<uint8_t> pending;  // Working copy, empty until the first write
+    uint8_t activeSlot;
+
+    // Statistics
+    uint32_t loadMicros;
+    uint32_t reads;
+    uint32_t readMicrosTotal;
+    uint32_t commits;
+    uint32_t commitMicrosTotal;
+    uint32_t commitMicrosMax;
+    uint32_t flashBytesTotal;
+
+    std::vector<uint8_t>& current();
+    bool loadSlot(uint8_t slot, std::vector<uint8_t>& image);
+    static bool validate(const std::vector<uint8_t>& image);
+    static uint32_t imageCrc(const std::vector<uint8_t>& image);
+    static ConfigSectionEntry* findSection(std::vector<uint8_t>& image, ConfigMessage message, uint8_t field, uint8_t index);
+    static size_t dataStart(const std::vector<uint8_t>& image);
+};
+
+#endif // CONFIG_STORE_H
@@ -3,7 +3,51 @@
 
 #include <Arduino.h>
 #include <U8g2lib.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include "MessageHandler.h"
+#include "PositionStore.h"
+#include "TelemetryStore.h"
+#include "TextLayout.h"
+
+#define MESSAGE_FONT_HEIGHT  8     // 5x7 font plus one pixel of leading
+#define MESSAGE_AREA_TOP     16    // Below the status line, so rows line up with OLED pages
+#define MESSAGE_LIST_LINES   3     // Lines per message in the list; the detail view shows all
+#define DISPLAY_PAGES        8     // 8-pixel rows of the SSD1306
+#define DISPLAY_FRAME_SIZE   (DISPLAY_PAGES * 128)
+#define DISPLAY_FRAME_SLOTS  3     // Being drawn, ready, being flushed
+#define I2C_PAGE_OVERHEAD    12    // Address, control and position bytes per page (approx.)
+#define TELEMETRY_COLUMN_WIDTH 27  // Right-aligned min/avg/max columns, 5 glyphs each
+#define NEARBY_ROWS          6     // Nodes listed on the nearby screen
+
+// Idle policy: dim, then power save, until a new message or button press
+#define DISPLAY_DIM_TIMEOUT    30000    // ms idle before dimming
+#define DISPLAY_OFF_TIMEOUT    120000   // ms idle before power save
+#define DISPLAY_CONTRAST_FULL  0xCF     // SSD1306 power-on default
+#define DISPLAY_CONTRAST_DIM   0x08
+
+// Rough panel current with a screen of text, for the savings estimate (uA)
+#define OLED_FULL_UA           10000
+#define OLED_DIM_UA            4000
+#define OLED_OFF_UA            10
+
+// Layouts are cached by slab slot; size the cache for every stored message
+#if LAYOUT_CACHE_SIZE < MAX_MESSAGES
+#error "LAYOUT_CACHE_SIZE must hold every stored message"
+#endif
+
+// Frames are drawn on loop() and flushed to the OLED by a background task,
+// which owns all panel I/O. A finished frame is copied out of the U8g2
+// buffer into a slot and swapped in as the ready frame with one atomic
+// exchange; if the task has not taken the previous one yet, that frame is
+// dropped. The task sends only the pages that differ from the panel.
+enum DisplayPower {
+    POWER_FULL,
+    POWER_DIM,
+    POWER_OFF,
+    POWER_LEVELS
+};
 
 class DisplayController {
 public:
@@ -25,11 +69,34 @@ public:
     void showMessage(const Message& msg);
     void showLatestMessage(const Message& msg);
     
+    // A node's metrics over the last windowSeconds: min, avg and max of each
+    // metric with data, as many as fit below the column titles
+    void showTelemetry(TelemetryStore& telemetry, uint32_t node, uint32_t windowSeconds);
+    
+    // The nodes closest to `node`, nearest first, with their distance and
+    // how long ago their position was heard
+    void showNearby(PositionStore& positions, uint32_t node);
+    
+    // PRG button navigation: step the list back one message (wrapping to
+    // the newest after the oldest) or page through the open message
+    void scrollMessages(MessageHandler& messageHandler);
+    // Open the message at the bottom of the list, or return to the list
+    void toggleDetail(MessageHandler& messageHandler);
+    // Switch to the next conversation (channel or direct message peer)
+    void nextConversation(MessageHandler& messageHandler);
+    
     // Status line (top of screen)
     void updateStatus(const String& status);
     void updateBatteryLevel(uint8_t level);
     void updateChargingStatus(bool charging);
     
+    // Idle dimming and power save
+    void update();
+    // Note user activity; returns true if it turned the display back on
+    bool activity();
+    // Something on screen changed (battery, status, wake) since the last frame
+    bool needsRedraw();
+    
     // Sleep mode
     void sleep();
     void wake();
@@ -37,6 +104,8 @@ public:
     
     // Clear display
     void clear();
+    
+    void printStats();
 
 private:
     U8G2_SSD1306_128X64_NONAME_F_HW_I2C u8g2;
@@ -45,10 +114,70 @@ private:
     bool sleeping;
     uint8_t batteryLevel;
     bool isCharging;
+    TextLayout layout;
+    
+    // Frame build statistics
+    uint32_t framesBuilt;
+    uint32_t frameMicrosTotal;
+    uint32_t frameMicrosMax;
+    
+    // Scroll state
+    int conversation;          // Conversation shown, -1 = follow the most recent
+    uint32_t conversationId;   // Its id, to notice the entry being reused
+    uint32_t anchorSeq;    // Message at the bottom of the list, 0 = follow the newest
+    uint32_t detailSeq;    // Message open in the detail view, 0 = list
+    uint8_t detailLine;    // First line shown in the detail view
+    int listTop;           // Index of the top message in the last list frame
+    
+    // Frame handoff to the flush task
+    uint8_t frames[DISPLAY_FRAME_SLOTS][DISPLAY_FRAME_SIZE];
+    std::atomic<uint8_t> readySlot;   // Slot index, | FRAME_FRESH when not taken yet
+    uint8_t backSlot;                 // Owned by loop()
+    uint8_t frontSlot;                // Owned by the flush task
+    std::atomic<int8_t> powerRequest; // -1 none, else the power save level to set
+    std::atomic<int16_t> contrastRequest;   // -1 none
+    TaskHandle_t flushTaskHandle;
+    
+    // Panel contents, owned by the flush task
+    uint8_t panelFrame[DISPLAY_FRAME_SIZE];
+    bool panelValid;
+    
+    // Activity policy
+    DisplayPower power;
+    bool redrawPending;
+    unsigned long lastActivity;
+    unsigned long lastPowerUpdate;
+    uint32_t powerMillis[POWER_LEVELS];   // Time spent at each level
+    
+    // Frame transfer statistics
+    uint32_t framesQueued;
+    uint32_t framesDropped;        // Replaced before the task took them
+    uint32_t framesFlushed;
+    uint32_t stallMicrosTotal;     // Time loop() spends handing off frames
+    uint32_t stallMicrosMax;
+    uint32_t flushMicrosTotal;     // Time the task spends on the bus
+    uint32_t pagesSent;
+    uint32_t pagesSkipped;
+    uint32_t i2cBytes;
     
-    void drawHeader();
-    void drawMessage(int y, const String& sender, const String& text, bool isOwn);
-    int wrapText(const String& text, int maxWidth, String* lines, int maxLines);
+    void drawText(int x, int y, const char* text, bool rightAlign = false);
+    void drawHeader(const char* title = nullptr);
+    void drawConversationHeader(MessageHandler& messageHandler, int conv);
+    void drawScrollbar(int first, int visible, int total);
+    const LayoutLines& layoutMessage(const Message& msg);
+    void drawMessage(int y, const Message& msg, const LayoutLines& lines, uint8_t firstLine, uint8_t endLine);
+    void drawReactions(int y, const Message& msg);
+    uint8_t listRows(const Message& msg, const LayoutLines& lines);
+    uint8_t detailRows(const Message& msg, const LayoutLines& lines);
+    int currentConversation(MessageHandler& messageHandler);
+    int messageIndex(MessageHandler& messageHandler, int conv, uint32_t seq);
+    void buildMessages(MessageHandler& messageHandler, int conv);
+    void buildDetail(MessageHandler& messageHandler, int conv, int index);
+    void sendFrame();
+    void setPowerSave(uint8_t level);
+    void setContrast(uint8_t level);
+    void flushFrame(const uint8_t* frame);
+    static void flushTask(void* param);
 };
 
 #endif // DISPLAY_CONTROLLER_H
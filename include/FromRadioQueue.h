@@ -0,0 +1,75 @@
+#ifndef FROMRADIO_QUEUE_H
+#define FROMRADIO_QUEUE_H
+
+#include <Arduino.h>
+#include <functional>
+
+// Number of encoded FromRadio frames kept for replay after a reconnect
+#define FROMRADIO_QUEUE_DEPTH 16
+
+// Large enough for any encoded meshtastic_FromRadio (510 bytes)
+#define FROMRADIO_MAX_FRAME   512
+
+// Frames every session has consumed, or that were queued with no session
+// at all, stay replayable this long: a client back within the BLE resume
+// window still gets what was sent while it was away
+#define FROMRADIO_KEEP_MS     30000
+
+// Hands an encoded FromRadio frame to the BLE server (wired by the app)
+typedef std::function<void(uint8_t* data, size_t length)> FromRadioSendCallback;
+
+struct FromRadioFrame {
+    uint32_t id;      // Monotonic frame id (same value reported on FromNum)
+    uint16_t length;
+    uint8_t refs;     // Client sessions that have not consumed this frame yet
+    unsigned long queuedAt;
+    uint8_t data[FROMRADIO_MAX_FRAME];
+};
+
+// Fixed-size ring of outgoing FromRadio frames shared by all client sessions.
+// Each session only keeps a cursor ("last seen id"); frame ids are contiguous,
+// so a cursor resolves to its next frame in O(1) without per-client copies.
+// Frames are reference counted and reclaimed FROMRADIO_KEEP_MS after every
+// session moved past them.
+class FromRadioQueue {
+public:
+    FromRadioQueue();
+
+    // Copy a frame into the ring with one reference per interested session,
+    // evicting the oldest frame when full. Returns the assigned id, or 0 if
+    // the frame is too large. A frame without references is still kept.
+    uint32_t push(const uint8_t* data, size_t length, uint8_t refs);
+
+    // Oldest frame with id > afterId, or nullptr if the client is caught up
+    const FromRadioFrame* next(uint32_t afterId) const;
+
+    // Add/drop one reference on every held frame with id in (afterId, upToId]
+    void retain(uint32_t afterId, uint32_t upToId);
+    void release(uint32_t afterId, uint32_t upToId);
+
+    // Reclaim unreferenced frames older than FROMRADIO_KEEP_MS. Call from loop().
+    void expire();
+
+    // Id of the newest frame ever pushed (0 if none)
+    uint32_t lastId() const;
+
+    // Id of the oldest frame still held (lastId() + 1 when empty)
+    uint32_t oldestId() const;
+
+    size_t size() const;
+
+    // Frames evicted while some session still referenced them
+    uint32_t getOverruns() const;
+
+private:
+    FromRadioFrame frames[FROMRADIO_QUEUE_DEPTH];
+    uint8_t head;    // Slot of the oldest frame
+    uint8_t count;
+    uint32_t nextId;
+    uint32_t overruns;
+
+    FromRadioFrame& frameAt(uint32_t id);
+    void trim();
+};
+
+#endif // FROMRADIO_QUEUE_H
@@ -4,6 +4,8 @@
 #include <Arduino.h>
 #include <Preferences.h>
 
+#define KEY_SIZE 32  // Curve25519 keys
+
 class KeyManager {
 public:
     KeyManager();
@@ -31,7 +33,7 @@ public:
     // Clear stored keys
     void clearKeys();
     
-    // Get raw key data (for encryption operations)
+    // Get the 32 raw key bytes (for encryption operations)
     bool getPrivateKeyRaw(uint8_t* buffer, size_t maxLen);
     bool getPublicKeyRaw(uint8_t* buffer, size_t maxLen);
 
@@ -42,6 +44,8 @@ private:
     static const char* NAMESPACE;
     static const char* PRIVATE_KEY;
     static const char* PUBLIC_KEY;
+    
+    static size_t decodeKey(const String& key, uint8_t* buffer, size_t maxLen);
 };
 
 #endif // KEY_MANAGER_H
@@ -5,7 +5,9 @@
 #include <BLEDevice.h>
 #include <BLEServer.h>
 #include <BLEUtils.h>
+#include <esp_gatts_api.h>
 #include <functional>
+#include "FromRadioQueue.h"
 
 // Meshtastic BLE Service and Characteristic UUIDs
 #define MESHTASTIC_SERVICE_UUID      "6ba1b218-15a8-461f-9fa8-5dcae273eafd"
@@ -18,6 +20,57 @@
 #define BATTERY_SERVICE_UUID         "0000180F-0000-1000-8000-00805f9b34fb"
 #define BATTERY_LEVEL_UUID           "00002A19-0000-1000-8000-00805f9b34fb"
 
+// Session resumption: a client that reconnects within this window keeps
+// its FromRadio queue and can resume from the last FromRadio id it saw
+#define SESSION_RESUME_WINDOW_MS     FROMRADIO_KEEP_MS
+#define ADVERTISING_RESTART_DELAY_MS 500
+
+// Concurrent clients (e.g. phone + laptop). One extra session slot lets a
+// disconnected client keep its cursor while another one is attached.
+#define MAX_BLE_CLIENTS              3
+#define BLE_SESSION_SLOTS            (MAX_BLE_CLIENTS + 1)
+
+// Deficit round robin: bytes of FromRadio credit each client earns per round
+#define FROMRADIO_DRR_QUANTUM        FROMRADIO_MAX_FRAME
+
+#define BLE_EVENT_QUEUE_DEPTH        8
+
+// Per-client view of the shared FromRadio ring
+struct BLEClientSession {
+    bool inUse;
+    bool connected;
+    uint16_t connId;
+    uint8_t address[6];
+    bool publicAddress;              // Fixed address, so it identifies the peer on reconnect
+    uint32_t resumeToken;            // Client-chosen session id written to FromNum, 0 if none
+    bool resumed;                    // This connection continues an earlier one
+    uint32_t cursor;                 // Last FromRadio id delivered to this client
+    uint32_t deficit;                // DRR credit in bytes
+    unsigned long connectedAt;
+    unsigned long disconnectedAt;
+    bool awaitingFirstFrame;
+    unsigned long firstFrameLatency; // Connect -> first FromRadio notify (ms)
+    uint32_t framesSent;
+    uint32_t framesSkipped;          // Lost to ring overruns while lagging
+    uint32_t congestedRounds;        // Rounds cut short by a failed notify
+};
+
+// Connection events are posted from the BLE task and applied in update()
+enum BLEEventType {
+    BLE_EVENT_CONNECT,
+    BLE_EVENT_DISCONNECT,
+    BLE_EVENT_RESUME
+};
+
+struct BLEEvent {
+    BLEEventType type;
+    uint16_t connId;
+    uint8_t address[6];
+    bool publicAddress;              // Connect: not a rotating private address
+    uint32_t id;                     // Resume: last FromRadio id seen
+    uint32_t token;                  // Resume: client-chosen session id, 0 if not sent
+};
+
 class MeshtasticBLE {
 public:
     MeshtasticBLE();
@@ -32,8 +85,13 @@ public:
     
     // Check connection status
     bool isConnected();
+    uint8_t getConnectedCount();
+    
+    // Run deferred BLE work (advertising restart, queued notifications).
+    // Call from loop() - never blocks.
+    void update();
     
-    // Send data from radio (notify clients)
+    // Send data from radio (queued, then notified to every client)
     bool sendFromRadio(uint8_t* data, size_t length);
     
     // Register callback for received data (ToRadio writes)
@@ -42,11 +100,17 @@ public:
     // Register callback for key control commands
     void onKeyCommand(std::function<void(const String&)> callback);
     
+    // Result of the last query command, readable on the KeyControl characteristic
+    void setKeyCommandResponse(const String& response);
+    
     // Update battery level (0-100%)
     void updateBatteryLevel(uint8_t level);
     
     // Get device name
     String getDeviceName();
+    
+    // Print session/reconnect statistics to Serial
+    void printStats();
 
 private:
     BLEServer* pServer;
@@ -60,18 +124,53 @@ private:
     BLECharacteristic* pBatteryLevelChar;
     
     String deviceName;
-    bool connected;
-    uint32_t fromNum;
+    uint8_t connectedCount;
+    bool advertisingConfigured;
+    
+    // Outgoing frames are shared by all sessions and survive short disconnects
+    FromRadioQueue fromRadioQueue;
+    BLEClientSession sessions[BLE_SESSION_SLOTS];
+    uint8_t rrNext;                  // Session slot that starts the next DRR round
+    
+    // Single-producer (BLE task) / single-consumer (loop) event ring
+    BLEEvent events[BLE_EVENT_QUEUE_DEPTH];
+    volatile uint8_t eventHead;
+    volatile uint8_t eventTail;
+    uint32_t droppedEvents;
+    
+    bool advertisingRestartPending;
+    unsigned long advertisingRestartAt;
+    
+    // Reconnect statistics
+    uint32_t reconnectCount;
+    uint32_t resumedSessions;
+    // Connect -> first FromRadio, fresh [0] and resumed [1] sessions apart
+    uint32_t firstFrameMillisTotal[2];
+    uint32_t firstFrameCount[2];
+    
+    void postEvent(const BLEEvent& event);
+    void processEvents();
+    void openSession(uint16_t connId, const uint8_t* address, bool publicAddress);
+    void closeSession(uint16_t connId);
+    void resumeSession(uint16_t connId, uint32_t id, uint32_t token);
+    void expireSessions();
+    void scheduleAdvertising(unsigned long delayMs);
+    uint8_t liveSessionCount();
+    BLEClientSession* findSession(uint16_t connId);
+    void scheduleNotifications();
+    bool notifyClient(BLEClientSession& session, const FromRadioFrame& frame);
     
     std::function<void(uint8_t*, size_t)> dataCallback;
     std::function<void(const String&)> keyCallback;
     
     class ServerCallbacks;
     class ToRadioCallbacks;
+    class FromNumCallbacks;
     class KeyControlCallbacks;
     
     friend class ServerCallbacks;
     friend class ToRadioCallbacks;
+    friend class FromNumCallbacks;
     friend class KeyControlCallbacks;
 };
 
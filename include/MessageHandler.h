@@ -3,17 +3,81 @@
 
 #include <Arduino.h>
 #include <vector>
+#include <functional>
 #include <pb_encode.h>
 #include <pb_decode.h>
 #include "proto/meshtastic_protocol.h"
+#include "TextCompressor.h"
 
-#define MAX_MESSAGES 20
+#define MAX_MESSAGES 32          // Message slots shared by all conversations
+#define MAX_CONVERSATIONS 8      // Channels and direct message peers
+#define CONVERSATION_QUOTA 16    // Most slots one conversation may hold
+
+// Packet id -> slot hash, a power of two over twice MAX_MESSAGES
+#define MESSAGE_INDEX_SIZE 64
+
+// Distinct reactions kept per message, and the UTF-8 bytes of each
+#define MAX_REACTIONS 3
+#define REACTION_SIZE 8
+
+// Longest text accepted when expanding a compressed payload
+#define MAX_TEXT_LENGTH 512
+
+// Text packed with TextCompressor travels on a private-range port.
+// TEXT_MESSAGE_COMPRESSED_APP (7) is the firmware's Unishox2 port and
+// stock nodes would misread our codec there.
+#define TEXT_COMPRESSED_PORT ((meshtastic_PortNum)302)
+
+// Stock nodes drop port 302, so text goes out as TEXT_MESSAGE_APP unless
+// compression is switched on: build with -D TEXT_COMPRESSION_ENABLED=1 for
+// a mesh that runs this codec, or call setTextCompression(). Compressed
+// text is always accepted on receive.
+#ifndef TEXT_COMPRESSION_ENABLED
+#define TEXT_COMPRESSION_ENABLED 0
+#endif
+
+// Modules that handle non-text ports (chunked transfer, telemetry, ...)
+#define MAX_PORT_HANDLERS 12
+
+#define BROADCAST_ADDR 0xFFFFFFFF
+
+typedef std::function<bool(const meshtastic_MeshPacket&)> PacketHandler;
+
+// Transforms a packet in place: decrypts on receive, encrypts on send
+typedef std::function<bool(meshtastic_MeshPacket&)> CryptHandler;
+
+// Emoji reactions to a message are counted on it, not stored as messages
+struct Reaction {
+    char emoji[REACTION_SIZE];   // NUL-terminated
+    uint8_t count;
+};
 
 struct Message {
+    uint32_t id;     // Increasing, never 0 - identifies the message to caches
+    uint32_t seq;    // Position in its conversation: consecutive, from 1
+    uint8_t slot;    // Slab slot, so per-message caches can be indexed by it
+    uint8_t conversation;
+    uint32_t packetId;   // Mesh packet id, 0 if unknown
+    uint32_t replyId;    // Packet id of the message this replies to, 0 if none
     String sender;
     String text;
     uint32_t timestamp;
     bool isOwn;  // Message sent by us vs received
+    uint8_t reactionCount;
+    Reaction reactions[MAX_REACTIONS];
+};
+
+// A channel or a direct message peer. Its messages are slab slots kept in
+// a ring, oldest first, so the n-th message is one lookup away.
+struct Conversation {
+    uint32_t id;          // Increasing, never 0 - entries are reused
+    uint32_t peer;        // Channel index, or the peer's node number
+    bool direct;
+    uint8_t count;
+    uint8_t head;         // Ring position of the oldest message
+    uint8_t unread;
+    uint32_t nextSeq;
+    uint8_t slots[CONVERSATION_QUOTA];
 };
 
 class MessageHandler {
@@ -26,24 +90,108 @@ public:
     // Process received Meshtastic data
     bool processReceivedData(uint8_t* data, size_t length);
     
-    // Create and encode a text message to send
-    bool createTextMessage(const String& text, uint8_t* buffer, size_t* length, size_t maxLen);
+    // Create and encode a text message to send. A full 233-byte payload
+    // encodes to more than 256 bytes; size buffer for FROMRADIO_MAX_FRAME.
+    bool createTextMessage(const char* text, size_t textLength, uint8_t* buffer, size_t* length, size_t maxLen);
+    
+    // Send text on TEXT_COMPRESSED_PORT when that is smaller. Only peers
+    // running this codec can read it.
+    void setTextCompression(bool enabled);
+    bool getTextCompression();
     
-    // Get messages
+    // Wrap a Data payload into a MeshPacket for `to` and encode it
+    bool createDataPacket(const meshtastic_Data& data, uint32_t to, uint8_t* buffer, size_t* length, size_t maxLen);
+    
+    // Register a handler for decoded packets on a given port
+    bool onPort(meshtastic_PortNum port, PacketHandler handler);
+    
+    // Observe every decoded packet before it is routed (text included)
+    void onPacket(PacketHandler observer);
+    
+    // Decrypt packets that arrive in their encrypted variant
+    void onEncrypted(CryptHandler decrypter);
+    
+    // Encrypt outgoing packets before they are encoded (e.g. PKI direct messages)
+    void onOutgoing(CryptHandler encrypter);
+    
+    // Messages in all conversations
     int getMessageCount();
-    Message getMessage(int index);
-    Message getLatestMessage();
+    
+    // Conversations in use, most recently active first
+    int getConversationCount();
+    int conversationAt(int rank);    // Conversation index by recency
+    const Conversation& getConversation(int conversation);
+    
+    // Messages of one conversation, oldest first. No copy; index must be valid.
+    const Message& conversationMessage(int conversation, int index);
+    void markRead(int conversation);
+    
+    // Short name: "C<channel>" or "D<node hex>"
+    void conversationLabel(int conversation, char* out, size_t outSize);
+    // Conversation for a label, -1 if none
+    int findConversation(const char* label);
+    
+    // The message with a mesh packet id (e.g. a reply's parent), nullptr if not stored
+    const Message* findPacket(uint32_t packetId);
     
     // Clear message history
     void clearMessages();
     
-    // Add a sent message to history
-    void addSentMessage(const String& text);
+    // Add a sent message to history (channel 0), under the packet id of
+    // the last createTextMessage so replies and reactions to it can find it
+    void addSentMessage(const char* text, size_t length);
+    
+    // This device's node number (derived from the MAC like Meshtastic firmware)
+    uint32_t getNodeNum();
+    
+    // Print message/compression statistics to Serial
+    void printStats();
 
 private:
-    std::vector<Message> messages;
+    // Slab of message slots, handed out to conversations
+    Message messages[MAX_MESSAGES];
+    uint8_t freeSlots[MAX_MESSAGES];
+    uint8_t freeCount;
+    Conversation conversations[MAX_CONVERSATIONS];
+    uint8_t recent[MAX_CONVERSATIONS];   // Conversations in use, most recent first
+    uint8_t conversationCount;
+    uint32_t nextConversationId;
+    uint8_t packetIndex[MESSAGE_INDEX_SIZE];   // Slot + 1 by packet id, 0 = empty
+    TextCompressor compressor;
+    bool textCompression;
+    
+    struct PortHandler {
+        meshtastic_PortNum port;
+        PacketHandler handler;
+    };
+    PortHandler portHandlers[MAX_PORT_HANDLERS];
+    int portHandlerCount;
+    uint32_t nextMessageId;
+    PacketHandler packetObserver;
+    CryptHandler packetDecrypter;
+    CryptHandler packetEncrypter;
+    uint32_t nodeNum;
+    uint32_t lastPacketId;
+    
+    uint32_t duplicates;
+    uint32_t evictedByQuota;       // Conversation was at its quota
+    uint32_t evictedByLru;         // Slab was full: oldest of the least recent conversation
+    uint32_t reactionsReceived;
+    uint32_t reactionsDropped;     // Parent no longer stored, or no room
+    uint32_t compressedSent;
+    uint32_t rawSent;
+    uint32_t compressedReceived;
+    uint32_t unishoxIgnored;       // Port 7 text from stock firmware
     
-    void addMessage(const String& sender, const String& text, bool isOwn = false);
+    void addMessage(const String& sender, const String& text, bool isOwn,
+                    uint32_t peer, bool direct, uint32_t packetId = 0, uint32_t replyId = 0);
+    int conversationFor(uint32_t peer, bool direct);
+    void touchConversation(int conversation);
+    void evictOldest(int conversation);
+    bool addReaction(uint32_t parentId, const char* emoji);
+    bool handleText(const meshtastic_MeshPacket& packet, const String& text);
+    int indexSlot(uint32_t packetId);
+    void indexRemove(uint32_t packetId);
     bool decodeFromRadio(const uint8_t* data, size_t length);
 };
 
@@ -0,0 +1,92 @@
+#ifndef OUTBOUND_QUEUE_H
+#define OUTBOUND_QUEUE_H
+
+#include <Arduino.h>
+#include <functional>
+#include "proto/meshtastic_protocol.h"
+#include "MessageHandler.h"
+
+#define OUTBOUND_QUEUE_DEPTH     8
+#define OUTBOUND_PACKET_TEXT     233                 // Data payload bytes; coalesced lines must fit
+#define OUTBOUND_COALESCE_MS     200                 // Lines closer than this may share a packet
+#define OUTBOUND_MAX_WAIT_MS     (5 * 60 * 1000UL)   // Queued text older than this is dropped
+#define OUTBOUND_BURST_PACKETS   3                   // Bucket depth, in full-size packets
+
+// Like the firmware, use only half of what the region allows
+#define OUTBOUND_POLITE_PERCENT  50
+
+// LoRa packet bytes around the text: radio header and Data framing
+#define OUTBOUND_PACKET_OVERHEAD 21
+#define OUTBOUND_MAX_PACKET      255
+#define OUTBOUND_PREAMBLE        16                  // Symbols, as the firmware sends
+
+// Sends one text packet; returns the encoded packet bytes, 0 on failure
+typedef std::function<size_t(const char* text, size_t length)> OutboundSendCallback;
+
+// Paces text typed on the serial console. Lines wait in a small ring and
+// are released against a token bucket of airtime, refilled at the region's
+// duty cycle (see configure). Lines pasted or typed in quick succession
+// are joined into one packet while they wait; the newest line is held for
+// OUTBOUND_COALESCE_MS so the rest of a paste can catch up.
+class OutboundQueue {
+public:
+    OutboundQueue();
+
+    // Airtime per byte from the modem settings, refill rate from the region
+    void configure(const meshtastic_Config_LoRaConfig& lora);
+
+    void onSend(OutboundSendCallback callback);
+
+    // Queue a line of UTF-8 text. Returns false if the queue is full.
+    bool push(const char* text, size_t length);
+
+    // Send the oldest line once the bucket covers its airtime. Call from loop().
+    void update();
+
+    size_t size() const;
+
+    // Estimated time on air of a LoRa packet of `bytes`, in microseconds
+    uint32_t airtimeMicros(size_t bytes) const;
+
+    void printStats();
+
+private:
+    struct Entry {
+        char text[MAX_TEXT_LENGTH + 1];
+        uint16_t length;
+        unsigned long queuedAt;     // First line
+        unsigned long appendedAt;   // Last line joined in
+    };
+
+    Entry entries[OUTBOUND_QUEUE_DEPTH];
+    uint8_t head;
+    uint8_t count;
+    OutboundSendCallback sendCallback;
+
+    // Modem and region
+    uint8_t spreadFactor;
+    uint32_t bandwidthHz;
+    uint8_t codingRate;            // 5..8 for 4/5..4/8
+    uint16_t dutyPermille;         // Share of airtime the bucket refills at
+
+    // Token bucket, in microseconds of airtime
+    int32_t tokens;
+    uint32_t capacity;
+    unsigned long lastRefill;
+
+    // Statistics
+    uint32_t linesQueued;
+    uint32_t linesCoalesced;
+    uint32_t packetsSent;
+    uint32_t droppedFull;
+    uint32_t droppedStale;
+    uint32_t sendFailures;
+    uint8_t depthMax;
+    uint32_t waitMillisTotal;
+    uint32_t waitMillisMax;
+    uint64_t airtimeMicrosTotal;
+
+    void refill();
+};
+
+#endif // OUTBOUND_QUEUE_H
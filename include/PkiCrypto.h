@@ -0,0 +1,104 @@
+#ifndef PKI_CRYPTO_H
+#define PKI_CRYPTO_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "proto/meshtastic_protocol.h"
+#include "ChannelCrypto.h"
+
+// ESP32 builds take X25519 and SHA-256 from mbedtls; the portable versions
+// are for host builds
+#ifndef ESP_PLATFORM
+#define PKI_CRYPTO_SOFTWARE 1
+#endif
+
+#define PKI_KEY_SIZE      32
+#define PKI_TAG_SIZE      8
+#define PKI_OVERHEAD      12   // CCM tag + the random extra nonce
+#define PKI_MAX_PEERS     64   // Public keys learned from NodeInfo
+#define PKI_CACHE_SIZE    8    // Derived per-peer keys, least recently used evicted
+
+// Public key of another node
+struct PkiPeer {
+    uint32_t node;
+    uint32_t lastHeard;        // millis()
+    uint8_t publicKey[PKI_KEY_SIZE];
+};
+
+// AES-256 key derived for one peer: SHA-256 of the X25519 shared secret
+struct PkiSecret {
+    uint32_t node;             // 0 = unused
+    uint32_t lastUsed;         // Use counter, for LRU eviction
+    ChannelKey key;            // Expanded, ready for CCM
+};
+
+// Direct messages encrypted with Curve25519 as in Meshtastic: the AES-256-CCM
+// key is SHA-256(X25519(our private key, their public key)). The nonce is
+// the packet id, the sender and a random extra nonce, which travels after the
+// 8-byte tag. Scalar multiplication is the slow part, so derived keys are
+// cached per peer. Packets are handled on loop(); the tables stay behind a
+// mutex, which costs nothing uncontended, so setKeys() is safe from any task.
+class PkiCrypto {
+public:
+    PkiCrypto();
+
+    bool begin(uint32_t nodeNum);
+
+    // Set this node's key pair. A missing or mismatched public key is
+    // derived from the private key. Flushes cached secrets.
+    bool setKeys(const uint8_t* privateKey, const uint8_t* publicKey);
+    bool hasKeys();
+
+    // Learn public keys from NODEINFO_APP packets
+    bool handleNodeInfo(const meshtastic_MeshPacket& packet);
+
+    // Decrypt a direct message to this node in place. Returns false if it is
+    // not a PKI packet we can open.
+    bool decrypt(meshtastic_MeshPacket& packet);
+
+    // Encrypt a decoded packet to a node whose key we know. Returns false
+    // (leaving the packet untouched) if it has to go out on a channel.
+    bool encrypt(meshtastic_MeshPacket& packet);
+
+    void printStats();
+
+    // Primitives, public for the known-answer tests. x25519 returns false
+    // if the backend rejects the point.
+    static bool x25519(uint8_t* out, const uint8_t* scalar, const uint8_t* point);
+    static void sha256Key(const uint8_t* in, uint8_t* out);   // One 32-byte input
+    static bool derive(const uint8_t* privateKey, const uint8_t* publicKey, ChannelKey& out);
+    static void ccmEncrypt(ChannelKey& key, const uint8_t* nonce, uint8_t* data, size_t length, uint8_t* tag);
+    static bool ccmDecrypt(ChannelKey& key, const uint8_t* nonce, uint8_t* data, size_t length, const uint8_t* tag);
+
+private:
+    SemaphoreHandle_t lock;
+    uint32_t nodeNum;
+    bool keysLoaded;
+    uint8_t privateKey[PKI_KEY_SIZE];
+    uint8_t publicKey[PKI_KEY_SIZE];
+
+    PkiPeer peers[PKI_MAX_PEERS];
+    uint16_t peerCount;
+    PkiSecret cache[PKI_CACHE_SIZE];
+    uint32_t useCounter;
+
+    // Statistics
+    uint32_t decrypted;
+    uint32_t decryptFailed;
+    uint32_t encrypted;
+    uint32_t cacheHits;
+    uint32_t cacheMisses;
+    uint32_t deriveMicrosTotal;
+    uint32_t messageMicrosTotal;   // CCM only, excluding key derivation
+
+    PkiPeer* findPeer(uint32_t node);
+    ChannelKey* sharedKey(uint32_t node);
+    void dropSecret(uint32_t node);
+
+    static void makeNonce(uint32_t packetId, uint32_t from, uint32_t extraNonce, uint8_t* nonce);
+    static void ccmMac(ChannelKey& key, const uint8_t* nonce, const uint8_t* data, size_t length, uint8_t* mac);
+    static void ccmCtr(ChannelKey& key, const uint8_t* nonce, uint16_t counter, uint8_t* data, size_t length);
+};
+
+#endif // PKI_CRYPTO_H
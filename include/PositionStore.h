@@ -0,0 +1,121 @@
+#ifndef POSITION_STORE_H
+#define POSITION_STORE_H
+
+#include <Arduino.h>
+#include "proto/meshtastic_protocol.h"
+
+// Sized for the device; the native tests raise all three for 2,000 nodes
+#ifndef POSITION_MAX_NODES
+#define POSITION_MAX_NODES      256
+#endif
+#ifndef POSITION_NODE_BUCKETS
+#define POSITION_NODE_BUCKETS   64     // node number -> record hash
+#endif
+#ifndef POSITION_GRID_BUCKETS
+#define POSITION_GRID_BUCKETS   128    // grid cell -> record hash
+#endif
+
+// Grid cell size in 1e-7 degree units (0.1 deg, ~11 km of latitude)
+#define POSITION_CELL_SIZE      1000000
+#define POSITION_MAX_RING       16     // Rings searched before falling back to a full scan
+
+// Positions are queued from the BLE task and indexed in update()
+#define POSITION_QUEUE_DEPTH    8
+
+#define POSITION_NONE           0xFFFF
+
+// Compact fixed-point position, 28 bytes
+struct PositionRecord {
+    uint32_t node;
+    int32_t latitude_i;        // 1e-7 degrees
+    int32_t longitude_i;
+    uint32_t timestamp;        // Position time from the packet (epoch, 0 if unknown)
+    uint32_t heardAt;          // Uptime seconds of the last update
+    int16_t altitude;          // Meters
+    uint8_t precision;         // precision_bits (0 = full)
+    bool inUse;
+    uint16_t nodeNext;         // Chain in the node hash
+    uint16_t cellNext;         // Chain in the grid hash
+};
+
+struct PositionResult {
+    uint32_t node;
+    float distanceKm;
+};
+
+// Latest position per node with a hashed grid index. Queries visit only
+// the cells around the query point: "within R km" scans the covering
+// cells, "N nearest" expands ring by ring until no closer node can exist.
+class PositionStore {
+public:
+    PositionStore();
+
+    // Packets received on POSITION_APP, stored for packet.from
+    bool handlePacket(const meshtastic_MeshPacket& packet);
+
+    // A POSITION_APP packet stored for `node` instead of its sender: the
+    // phone's location, shared by the app, is this device's position
+    bool handlePacket(const meshtastic_MeshPacket& packet, uint32_t node);
+
+    // Index queued positions. Call from loop().
+    void update();
+
+    const PositionRecord* getPosition(uint32_t node);
+
+    // Up to maxResults nodes closest to (lat, lon), nearest first. Returns the count.
+    size_t nearest(int32_t latitude_i, int32_t longitude_i, PositionResult* results, size_t maxResults);
+
+    // Nodes within radiusKm of (lat, lon), nearest first. Returns the count.
+    size_t within(int32_t latitude_i, int32_t longitude_i, float radiusKm, PositionResult* results, size_t maxResults);
+
+    size_t size();
+
+    void printStats();
+
+private:
+    struct PendingPosition {
+        uint32_t node;
+        int32_t latitude_i;
+        int32_t longitude_i;
+        int32_t altitude;
+        uint32_t timestamp;
+        uint8_t precision;
+    };
+
+    PositionRecord records[POSITION_MAX_NODES];
+    uint16_t nodeBuckets[POSITION_NODE_BUCKETS];
+    uint16_t gridBuckets[POSITION_GRID_BUCKETS];
+    size_t count;
+
+    PendingPosition queue[POSITION_QUEUE_DEPTH];
+    volatile uint8_t queueHead;
+    volatile uint8_t queueTail;
+
+    // Statistics
+    uint32_t positionsReceived;
+    uint32_t positionsDropped;
+    uint32_t nodesEvicted;
+    uint32_t queryCount;
+    uint32_t queryMicrosTotal;
+    uint32_t queryMicrosMax;
+    uint32_t recordsVisited;
+
+    void storePosition(const PendingPosition& position);
+    uint16_t findNode(uint32_t node);
+    uint16_t allocateRecord();
+    void linkCell(uint16_t index);
+    void unlinkCell(uint16_t index);
+    void unlinkNode(uint16_t index);
+
+    static int32_t cellOf(int32_t coordinate);
+    static uint16_t cellBucket(int32_t cellLat, int32_t cellLon);
+    static float distanceKm(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2);
+
+    void visitCell(int32_t cellLat, int32_t cellLon, int32_t latitude_i, int32_t longitude_i,
+                   float limitKm, PositionResult* results, size_t maxResults, size_t* found);
+    void scanAll(int32_t latitude_i, int32_t longitude_i, float limitKm,
+                 PositionResult* results, size_t maxResults, size_t* found);
+    void finishQuery(unsigned long startMicros);
+};
+
+#endif // POSITION_STORE_H
@@ -0,0 +1,83 @@
+#ifndef SERIAL_STREAM_H
+#define SERIAL_STREAM_H
+
+#include <Arduino.h>
+#include <functional>
+
+// Meshtastic stream framing: START1 START2, big-endian length, protobuf
+#define STREAM_START1            0x94
+#define STREAM_START2            0xC3
+#define STREAM_HEADER_SIZE       4
+#define STREAM_MAX_FRAME         512     // Longer lengths are noise; resync
+#define STREAM_FRAME_TIMEOUT_MS  1000    // A frame cut off this long is dropped
+#define STREAM_LINE_MAX          256     // Console command line, bytes
+#define STREAM_READ_CHUNK        64      // Bytes taken from the UART per read
+#define STREAM_BAUD              115200  // Meshtastic serial API default
+#define STREAM_RX_BUFFER         4096    // Holds ~350 ms of input between loop() passes
+
+typedef std::function<void(const uint8_t* data, size_t length)> StreamFrameCallback;
+typedef std::function<void(const String& line)> StreamLineCallback;
+
+// Console and API on one serial port. Bytes are parsed incrementally as
+// they arrive, so update() never waits on the UART: framed ToRadio
+// protobufs go to the frame callback, and any other bytes are collected
+// into newline-terminated console commands, as the firmware's serial
+// console does alongside the API.
+class SerialStream {
+public:
+    explicit SerialStream(Stream& port);
+
+    void onFrame(StreamFrameCallback callback);
+    void onLine(StreamLineCallback callback);
+
+    // Read and parse whatever the port has buffered. Call from loop().
+    void update();
+
+    // Parse bytes as if they had arrived on the port
+    void feed(const uint8_t* data, size_t length);
+
+    // Write a framed FromRadio protobuf in one piece
+    bool send(const uint8_t* data, size_t length);
+
+    // A framed client has spoken since boot; FromRadio is mirrored to it
+    bool isActive();
+
+    void printStats();
+
+private:
+    enum State {
+        WAIT_START1,
+        WAIT_START2,
+        READ_LENGTH_HIGH,
+        READ_LENGTH_LOW,
+        READ_PAYLOAD
+    };
+
+    Stream& port;
+    StreamFrameCallback frameCallback;
+    StreamLineCallback lineCallback;
+
+    State state;
+    uint16_t frameLength;
+    uint16_t framePos;
+    uint8_t frame[STREAM_MAX_FRAME];
+    char line[STREAM_LINE_MAX + 1];
+    uint16_t lineLength;
+    bool lineOverflow;
+    unsigned long lastByteAt;
+    bool active;
+
+    // Statistics
+    uint32_t framesReceived;
+    uint32_t framesSent;
+    uint32_t bytesReceived;
+    uint32_t badLengths;
+    uint32_t timeouts;
+    uint32_t linesReceived;
+    uint32_t linesTruncated;
+
+    void consume(uint8_t byte);
+    void lineByte(uint8_t byte);
+};
+
+#endif // SERIAL_STREAM_H
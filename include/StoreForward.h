@@ -0,0 +1,179 @@
+#ifndef STORE_FORWARD_H
+#define STORE_FORWARD_H
+
+#include <Arduino.h>
+#include <functional>
+#include <esp_partition.h>
+#include "proto/meshtastic_protocol.h"
+#include "proto/meshtastic/storeforward.pb.h"
+
+#ifndef STORE_FORWARD_ENABLED
+#define STORE_FORWARD_ENABLED 1   // Gateways are always powered - act as S&F router
+#endif
+
+// History lives in the last SF_FLASH_SECTORS of the data partition
+// (XModem files use the space in front of it)
+#define SF_PARTITION_SUBTYPE   ESP_PARTITION_SUBTYPE_DATA_SPIFFS
+#define SF_SECTOR_SIZE         4096
+#define SF_FLASH_SECTORS       96
+#define SF_FLASH_BYTES         (SF_FLASH_SECTORS * SF_SECTOR_SIZE)
+#define SF_SECTOR_MAGIC        0x53463153  // "SF1S"
+#define SF_RECORD_MAGIC        0x5346      // "SF"
+
+// RAM index: 8 bytes per stored message, SF_INDEX_BYTES in all (40 KB at
+// the default). The ring holds about 4,900 records of 60-byte text, so a
+// smaller index would forget messages that are still in flash. Boards
+// short on RAM can build with a lower -D SF_MAX_MESSAGES.
+#ifndef SF_MAX_MESSAGES
+#define SF_MAX_MESSAGES        5120
+#endif
+#define SF_INDEX_BYTES         (SF_MAX_MESSAGES * 8)
+
+#define SF_HISTORY_WINDOW_MIN  240    // Default/maximum window a client may ask for
+#define SF_RETURN_MAX          100    // Messages replayed per history request
+#define SF_REPLAY_INTERVAL_MS  2000   // Airtime pacing between replayed packets
+#define SF_HEARTBEAT_PERIOD_S  900
+
+// Text packets and requests are queued from the BLE task and handled in update()
+#define SF_PENDING_DEPTH       8
+
+typedef std::function<void(uint32_t to, const meshtastic_Data& data)> StoreForwardSendCallback;
+
+// Encoding of a record's text. Records written before it was kept have 0.
+#define SF_TEXT_PLAIN          0      // TEXT_MESSAGE_APP
+#define SF_TEXT_UNISHOX        1      // TEXT_MESSAGE_COMPRESSED_APP, from stock firmware
+#define SF_TEXT_COMPRESSED     2      // TEXT_COMPRESSED_PORT
+
+// On-flash record; the text follows the header, padded to 4 bytes
+struct SFRecordHeader {
+    uint16_t magic;
+    uint8_t length;
+    uint8_t encoding;      // SF_TEXT_*
+    uint32_t rxTime;
+    uint32_t from;
+    uint32_t to;
+    uint32_t packetId;
+};
+
+// Index entries are appended in rxTime order, so the index stays sorted
+struct SFIndexEntry {
+    uint32_t rxTime;
+    uint8_t sector;
+    uint8_t toHash;        // Low byte of the destination, filters DMs without a flash read
+    uint16_t offset;       // Offset in the sector | SF_ENTRY_BROADCAST
+};
+
+#define SF_ENTRY_BROADCAST     0x8000
+#define SF_ENTRY_OFFSET_MASK   0x0FFF
+
+// Store & Forward router. Keeps recent text packets in a flash ring with a
+// compact time-sorted RAM index, replays history newer than a client's
+// window at a paced rate, and announces itself with heartbeats.
+class StoreForward {
+public:
+    StoreForward();
+
+    // Find the flash region and rebuild the index from it
+    bool begin();
+
+    void onSend(StoreForwardSendCallback callback);
+
+    // Record a text packet: plain, Unishox2 or TextCompressor text (any
+    // decoded packet is accepted, others are ignored)
+    void recordPacket(const meshtastic_MeshPacket& packet);
+
+    // Packets received on STORE_FORWARD_APP
+    bool handlePacket(const meshtastic_MeshPacket& packet);
+
+    // Store queued packets, serve requests, pace replay, send heartbeats.
+    // Call from loop().
+    void update();
+
+    void printStats();
+
+private:
+    struct PendingRecord {
+        SFRecordHeader header;
+        uint8_t text[sizeof(meshtastic_StoreAndForward_text_t::bytes)];
+    };
+
+    struct PendingRequest {
+        uint32_t from;
+        meshtastic_StoreAndForward_RequestResponse rr;
+        uint32_t window;
+        uint32_t lastRequest;
+    };
+
+    const esp_partition_t* partition;
+    uint32_t baseOffset;              // Partition offset of sector 0 of the ring
+    bool ready;
+
+    // Flash ring write position
+    uint8_t writeSector;
+    uint16_t writeOffset;
+    uint32_t sectorSeq;
+
+    // Index ring addressed by message number. Numbers start at 1: a
+    // last_request of 0 means the client has had nothing yet.
+    SFIndexEntry entries[SF_MAX_MESSAGES];
+    uint32_t firstNumber;
+    uint32_t nextNumber;
+
+    // Time base: radio epoch when known, otherwise continues after stored history
+    uint32_t epochBase;
+    unsigned long epochAt;
+    uint32_t bootTimeBase;
+    uint32_t lastRxTime;
+
+    // Active replay (one client at a time)
+    bool replaying;
+    uint32_t replayTo;
+    uint32_t replayNext;
+    uint32_t replayEnd;
+    uint16_t replayLeft;
+    unsigned long lastReplayAt;
+    unsigned long lastHeartbeatAt;
+
+    PendingRecord pendingRecords[SF_PENDING_DEPTH];
+    volatile uint8_t recordHead;
+    volatile uint8_t recordTail;
+    PendingRequest pendingRequests[SF_PENDING_DEPTH];
+    volatile uint8_t requestHead;
+    volatile uint8_t requestTail;
+
+    StoreForwardSendCallback sendCallback;
+
+    // Statistics
+    uint32_t messagesTotal;
+    uint32_t requests;
+    uint32_t requestsHistory;
+    uint32_t replayed;
+    uint32_t sectorsErased;
+    uint32_t writeErrors;
+    uint32_t droppedPending;
+    uint32_t queryCount;
+    uint32_t queryMicrosTotal;
+    uint32_t queryMicrosMax;
+
+    bool loadIndex();
+    void scanSector(uint8_t sector);
+    bool storeRecord(const PendingRecord& record);
+    bool advanceSector();
+    void appendEntry(const SFIndexEntry& entry);
+    SFIndexEntry& entryAt(uint32_t number);
+
+    uint32_t currentTime();
+    uint32_t lowerBound(uint32_t rxTime);
+    // lastRequest is the last message number a client got, 0 for none
+    uint32_t findHistory(uint32_t to, uint32_t since, uint32_t lastRequest, uint32_t* count, uint32_t* end);
+    bool entryMatches(const SFIndexEntry& entry, uint32_t to);
+
+    void handleRequest(const PendingRequest& request);
+    void startReplay(const PendingRequest& request);
+    void replayNextMessage();
+    void sendHeartbeat();
+    void sendStats(uint32_t to);
+    void sendResponse(uint32_t to, const meshtastic_StoreAndForward& message);
+};
+
+#endif // STORE_FORWARD_H
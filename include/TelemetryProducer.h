@@ -0,0 +1,98 @@
+#ifndef TELEMETRY_PRODUCER_H
+#define TELEMETRY_PRODUCER_H
+
+#include <Arduino.h>
+#include "proto/meshtastic_protocol.h"
+#include "FromRadioQueue.h"
+
+#define TELEMETRY_SEND_INTERVAL_MS   (15 * 60 * 1000UL)
+#define TELEMETRY_SEND_JITTER_MS     (60 * 1000UL)     // +/- around each interval
+#define TELEMETRY_FIRST_SEND_MS      (30 * 1000UL)     // After the first battery reading
+#define TELEMETRY_MIN_SPACING_MS     (60 * 1000UL)     // Floor for change-triggered sends
+
+// Change since the last *sent* frame that triggers an immediate send
+#define TELEMETRY_BATTERY_DELTA      5       // percent
+#define TELEMETRY_VOLTAGE_DELTA      0.10f   // volts
+
+// Airtime estimate for the mesh link (LongFast: SF11/BW250, ~1.07 kbps)
+#define TELEMETRY_AIRTIME_MS_PER_BYTE 7.5f
+#define TELEMETRY_AIRTIME_OVERHEAD    16     // LoRa header + preamble, in bytes
+#define TELEMETRY_AIRTIME_MINUTES     60     // air_util_tx window
+#define TELEMETRY_CHUTIL_MINUTES      5      // channel_utilization window
+
+#define TELEMETRY_FRAME_MAX           128
+
+// Publishes this device's DeviceMetrics. The FromRadio frame is encoded
+// once per change in readings; scheduled sends only patch the packet id
+// and uptime in place, so a send costs a few stores and a queue push.
+class TelemetryProducer {
+public:
+    TelemetryProducer();
+
+    void begin(uint32_t nodeNum);
+
+    void onSend(FromRadioSendCallback callback);
+
+    // Latest battery reading (from the ADC poll in main)
+    void updateBattery(uint8_t level, float voltage, bool charging);
+
+    // Account a mesh packet's airtime for channel/tx utilization
+    void recordAirtime(bool tx, size_t bytes);
+
+    // Send on schedule or on significant change. Call from loop().
+    void update();
+
+    // Current readings as a Telemetry message
+    meshtastic_Telemetry snapshot();
+
+    void printStats();
+
+private:
+    uint32_t nodeNum;
+    FromRadioSendCallback sendCallback;
+
+    // Readings
+    bool hasBattery;
+    uint8_t batteryLevel;
+    float voltage;
+    bool charging;
+
+    // Values in the last sent frame (hysteresis reference)
+    uint8_t sentLevel;
+    float sentVoltage;
+    bool sentCharging;
+
+    // Per-minute airtime bins (ms), lazily cleared as minutes roll over
+    uint16_t txAirtime[TELEMETRY_AIRTIME_MINUTES];
+    uint16_t rxAirtime[TELEMETRY_AIRTIME_MINUTES];
+    uint32_t binMinute[TELEMETRY_AIRTIME_MINUTES];
+
+    // Cached encoded frame
+    uint8_t frame[TELEMETRY_FRAME_MAX];
+    size_t frameLength;
+    size_t idOffset;
+    size_t metricsOffset;
+    size_t uptimeOffset;
+    size_t uptimeLength;
+    bool frameValid;
+
+    unsigned long nextSendAt;
+    unsigned long lastSendAt;
+
+    // Statistics
+    uint32_t scheduledSends;
+    uint32_t changeSends;
+    uint32_t encodes;
+    uint32_t encodeMicros;
+    uint32_t sendMicros;
+    uint32_t sendMicrosMax;
+
+    bool significantChange();
+    bool encodeFrame(uint32_t uptime);
+    void send(bool scheduled);
+    void scheduleNext(unsigned long interval, unsigned long jitter);
+    float utilization(uint8_t minutes, bool includeRx);
+    uint8_t binFor(uint32_t minute);
+};
+
+#endif // TELEMETRY_PRODUCER_H
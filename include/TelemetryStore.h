@@ -0,0 +1,144 @@
+#ifndef TELEMETRY_STORE_H
+#define TELEMETRY_STORE_H
+
+#include <Arduino.h>
+#include "proto/meshtastic_protocol.h"
+
+// Series are (node, metric) pairs drawn from a shared pool; the least
+// recently updated series is recycled when the pool is full
+#define TELEMETRY_SERIES_SLOTS     16
+
+// Per-series resolutions: raw samples, then 1-minute and 15-minute buckets.
+// Bucket rings only hold non-empty buckets, so sparse reporters
+// (typically every 15-30 minutes) still get hours of history.
+#define TELEMETRY_RAW_SAMPLES      32
+#define TELEMETRY_MINUTE_BUCKETS   30
+#define TELEMETRY_QUARTER_BUCKETS  48
+#define TELEMETRY_MINUTE_SECONDS   60
+#define TELEMETRY_QUARTER_SECONDS  900
+
+// Samples are queued from the BLE task and stored in update()
+#define TELEMETRY_QUEUE_DEPTH      32
+
+enum TelemetryMetric : uint8_t {
+    METRIC_BATTERY_LEVEL,
+    METRIC_VOLTAGE,
+    METRIC_CHANNEL_UTILIZATION,
+    METRIC_AIR_UTIL_TX,
+    METRIC_TEMPERATURE,
+    METRIC_RELATIVE_HUMIDITY,
+    METRIC_BAROMETRIC_PRESSURE,
+    METRIC_POWER_VOLTAGE,
+    METRIC_POWER_CURRENT,
+    METRIC_COUNT
+};
+
+struct TelemetrySummary {
+    float min;
+    float max;
+    float avg;
+    uint32_t count;       // Samples aggregated
+};
+
+// Raw sample stored as a delta from the previous one
+struct TelemetryDelta {
+    uint16_t seconds;
+    int16_t value;
+};
+
+// Aggregate of all samples in [start, start + width)
+struct TelemetryBucket {
+    uint32_t start;
+    int32_t sum;
+    int16_t min;
+    int16_t max;
+    uint16_t count;
+};
+
+struct TelemetrySeries {
+    bool inUse;
+    TelemetryMetric metric;
+    uint32_t node;
+
+    // Raw ring: the oldest sample is kept absolute, the rest as deltas
+    uint32_t baseTime;
+    int16_t baseValue;
+    uint32_t lastTime;
+    int16_t lastValue;
+    uint8_t rawHead;
+    uint8_t rawCount;     // Samples held (deltas + the base sample)
+    TelemetryDelta raw[TELEMETRY_RAW_SAMPLES - 1];
+
+    uint8_t minuteHead;
+    uint8_t minuteCount;
+    TelemetryBucket minutes[TELEMETRY_MINUTE_BUCKETS];
+
+    uint8_t quarterHead;
+    uint8_t quarterCount;
+    TelemetryBucket quarters[TELEMETRY_QUARTER_BUCKETS];
+};
+
+// Per-node telemetry time series in fixed memory. Values are quantized to
+// int16 per metric (e.g. millivolts, centidegrees); every sample feeds all
+// three resolutions, and window queries combine the finest data available
+// for each part of the window in O(buckets).
+class TelemetryStore {
+public:
+    TelemetryStore();
+
+    // Packets received on TELEMETRY_APP
+    bool handlePacket(const meshtastic_MeshPacket& packet);
+
+    // Queue every metric present in a Telemetry message for node
+    void record(uint32_t node, const meshtastic_Telemetry& telemetry);
+
+    // Store queued samples. Call from loop().
+    void update();
+
+    // Min/max/avg of the last windowSeconds. False if there is no data.
+    bool query(uint32_t node, TelemetryMetric metric, uint32_t windowSeconds, TelemetrySummary* out);
+
+    static const char* metricName(TelemetryMetric metric);
+    // Metric for a name as metricName() returns it; false if unknown
+    static bool metricFromName(const char* name, TelemetryMetric* out);
+    // Reading in the metric's unit and precision: "87%", "3.71V", "21.4C"
+    static void formatValue(TelemetryMetric metric, float value, char* out, size_t outSize, bool withUnit = true);
+
+    void printStats();
+
+private:
+    struct PendingSample {
+        uint32_t node;
+        uint32_t time;
+        TelemetryMetric metric;
+        float value;
+    };
+
+    TelemetrySeries series[TELEMETRY_SERIES_SLOTS];
+
+    PendingSample queue[TELEMETRY_QUEUE_DEPTH];
+    volatile uint8_t queueHead;
+    volatile uint8_t queueTail;
+
+    // Statistics
+    uint32_t packetsDecoded;
+    uint32_t samplesStored;
+    uint32_t samplesDropped;
+    uint32_t rawResets;
+    uint32_t seriesRecycled;
+    uint32_t queryCount;
+    uint32_t queryMicrosTotal;
+    uint32_t queryMicrosMax;
+
+    void queueSample(uint32_t node, TelemetryMetric metric, float value, uint32_t time);
+    void storeSample(const PendingSample& sample);
+    TelemetrySeries* findSeries(uint32_t node, TelemetryMetric metric);
+    TelemetrySeries* allocateSeries(uint32_t node, TelemetryMetric metric);
+
+    void appendRaw(TelemetrySeries& s, uint32_t time, int16_t value);
+    void addToBuckets(TelemetryBucket* ring, uint8_t capacity, uint8_t* head, uint8_t* count,
+                      uint32_t width, uint32_t time, int16_t value);
+    uint32_t oldestTime(const TelemetrySeries& s);
+};
+
+#endif // TELEMETRY_STORE_H
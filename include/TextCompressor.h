@@ -0,0 +1,46 @@
+#ifndef TEXT_COMPRESSOR_H
+#define TEXT_COMPRESSOR_H
+
+#include <Arduino.h>
+
+// Codes 0x00..TEXT_CODEBOOK_SIZE-1 index the static dictionary,
+// the two escape codes carry bytes the dictionary does not cover
+#define TEXT_CODEBOOK_SIZE    224
+#define TEXT_CODE_LITERAL     0xFE  // Next byte is a literal
+#define TEXT_CODE_LITERAL_RUN 0xFF  // Next byte is (run length - 1), then the run
+#define TEXT_MAX_ENTRY_LEN    7
+
+// Static-dictionary short-string compressor tuned for chat text
+// (smaz-style: greedy longest match against a fixed codebook).
+// Used for TEXT_COMPRESSED_PORT payloads; no heap allocation.
+class TextCompressor {
+public:
+    TextCompressor();
+
+    // Compress text into out. Returns compressed length, or 0 if it does not fit.
+    size_t compress(const uint8_t* text, size_t length, uint8_t* out, size_t maxLen);
+
+    // Decompress into out. Returns text length, or 0 on malformed input / overflow.
+    size_t decompress(const uint8_t* data, size_t length, uint8_t* out, size_t maxLen);
+
+    // Print compression ratio and ns/byte over all traffic seen so far
+    void printStats();
+
+private:
+    // Per first byte: codebook indexes of entries starting with it, longest first
+    uint8_t firstStart[256];
+    uint8_t firstCount[256];
+    uint8_t byFirst[TEXT_CODEBOOK_SIZE];
+
+    uint32_t compressCalls;
+    uint32_t compressIn;
+    uint32_t compressOut;
+    uint32_t compressMicros;
+    uint32_t decompressOut;
+    uint32_t decompressMicros;
+
+    void buildIndex();
+    bool flushLiterals(const uint8_t* run, size_t runLen, uint8_t* out, size_t maxLen, size_t* pos);
+};
+
+#endif // TEXT_COMPRESSOR_H
@@ -0,0 +1,66 @@
+#ifndef TEXT_LAYOUT_H
+#define TEXT_LAYOUT_H
+
+#include <Arduino.h>
+#include <U8g2lib.h>
+
+#define LAYOUT_MAX_LINES       24    // Lines kept per message; the rest is elided
+#define LAYOUT_MAX_LINE_CHARS  64    // Most glyphs on a line handed to drawStr
+#define LAYOUT_CACHE_SIZE      32    // Laid-out messages, indexed by slab slot
+
+// A message broken into lines: byte ranges into the message text
+struct LayoutLines {
+    uint32_t messageId;        // Whose layout the entry holds, 0 = empty
+    uint8_t count;
+    bool elided;               // Text continued past the last line
+    uint16_t start[LAYOUT_MAX_LINES];
+    uint8_t length[LAYOUT_MAX_LINES];    // Bytes of UTF-8
+    uint8_t width[LAYOUT_MAX_LINES];
+};
+
+// Word wrapping by pixel width for one U8g2 font. Glyph advances are read
+// from the font once into a table, and a message's line breaks are cached
+// in its slab slot, tagged with its id, so redrawing a message only maps its cached lines into
+// a stack buffer for drawStr - no String building or heap allocation.
+// Text is UTF-8; each code point is one glyph (see Utf8Text).
+class TextLayout {
+public:
+    TextLayout();
+
+    // Measure every glyph of `font` (which is left selected)
+    void begin(U8G2& u8g2, const uint8_t* font);
+
+    // Pixel width of `length` bytes of UTF-8 text
+    uint16_t width(const char* text, size_t length);
+
+    // Lines for the message in `slot`, laid out on first use or when the
+    // slot holds another message now. The first line starts `indent`
+    // pixels in (e.g. after the sender).
+    const LayoutLines& lines(uint8_t slot, uint32_t messageId, const char* text, size_t length,
+                             uint8_t maxWidth, uint8_t indent);
+
+    // Draw one cached line at (x, y). With `clipWidth`, the line is cut to
+    // end in "..." within that width (more lines follow but are not shown).
+    void drawLine(U8G2& u8g2, int x, int y, const char* text, const LayoutLines& lines, uint8_t line,
+                  uint8_t clipWidth = 0);
+
+    // Forget cached layouts (e.g. when the font or width changes)
+    void invalidate();
+
+    void printStats();
+
+private:
+    uint8_t glyphWidth[256];
+    LayoutLines cache[LAYOUT_CACHE_SIZE];
+
+    // Statistics
+    uint32_t cacheHits;
+    uint32_t cacheMisses;
+    uint32_t layoutMicrosTotal;
+
+    void layout(const char* text, size_t length, uint8_t maxWidth, uint8_t indent, LayoutLines& out);
+    uint8_t advance(const char* text, size_t length, size_t* pos);
+    size_t trimLast(const char* text, size_t length, uint16_t* lineWidth);
+};
+
+#endif // TEXT_LAYOUT_H
@@ -0,0 +1,56 @@
+#ifndef TORADIO_QUEUE_H
+#define TORADIO_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+// ToRadio frames waiting for loop(); each slot is a full frame copy
+#define TORADIO_QUEUE_DEPTH  8
+
+// Largest encoded meshtastic_ToRadio accepted from any client
+#define TORADIO_MAX_FRAME    512
+
+// Where a ToRadio frame came from
+enum ToRadioSource {
+    TORADIO_BLE,
+    TORADIO_SERIAL,
+    TORADIO_SOURCES
+};
+
+struct ToRadioFrame {
+    uint16_t length;
+    uint8_t source;
+    uint8_t data[TORADIO_MAX_FRAME];
+};
+
+// Ingress for ToRadio frames from every client. The BLE task and the serial
+// stream parser push from their own contexts; loop() pops and dispatches,
+// so packet handlers only ever run on loop(). Backed by a FreeRTOS queue,
+// which copies frames in and out and is safe with several producers.
+class ToRadioQueue {
+public:
+    ToRadioQueue();
+
+    bool begin();
+
+    // Copy a frame in. Never blocks; returns false if the queue is full or
+    // the frame too large.
+    bool push(ToRadioSource source, const uint8_t* data, size_t length);
+
+    // Oldest frame, if any. Call from loop().
+    bool pop(ToRadioFrame& frame);
+
+    void printStats();
+
+private:
+    QueueHandle_t queue;
+
+    // Statistics, updated from several tasks
+    std::atomic<uint32_t> received[TORADIO_SOURCES];
+    std::atomic<uint32_t> dropped;
+    uint8_t depthMax;
+};
+
+#endif // TORADIO_QUEUE_H
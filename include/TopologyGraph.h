@@ -0,0 +1,135 @@
+#ifndef TOPOLOGY_GRAPH_H
+#define TOPOLOGY_GRAPH_H
+
+#include <Arduino.h>
+#include "proto/meshtastic_protocol.h"
+
+#define TOPOLOGY_MAX_NODES       512
+#define TOPOLOGY_MAX_EDGES       8      // Out-edges kept per node
+#define TOPOLOGY_NODE_BUCKETS    128
+#define TOPOLOGY_CACHE_SLOTS     4      // Cached shortest-path trees
+#define TOPOLOGY_EDGE_TTL_MIN    (12 * 60)
+
+// Edge cost: a fixed hop cost plus a penalty for weak links (SNR in 0.25 dB)
+#define TOPOLOGY_HOP_COST        40
+#define TOPOLOGY_GOOD_SNR        40     // 10 dB - no penalty at or above
+#define TOPOLOGY_MAX_PENALTY     120
+#define TOPOLOGY_SNR_UNKNOWN     INT8_MIN
+
+// Edge updates are queued from the BLE task and applied in update()
+#define TOPOLOGY_QUEUE_DEPTH     32
+
+#define TOPOLOGY_NONE            0xFFFF
+#define TOPOLOGY_UNREACHABLE     0xFFFF
+
+#define TOPOLOGY_EDGE_ESTIMATED  0x01   // Reverse of a measured edge, not measured itself
+
+struct TopologyEdge {
+    uint16_t to;               // Node index
+    int8_t snr;                // 0.25 dB, as in RouteDiscovery
+    uint8_t flags;
+    uint16_t seenMinute;       // Uptime minutes when last reported
+};
+
+struct TopologyNode {
+    uint32_t num;
+    uint16_t next;             // Chain in the node hash
+    uint8_t edgeCount;
+    uint8_t inDegree;
+};
+
+// Single-source result: cost (or hop count) and predecessor per node
+struct TopologyTree {
+    bool valid;
+    bool weighted;             // SNR-weighted costs vs plain hop counts
+    uint16_t source;
+    uint32_t lastUsed;
+    uint16_t dist[TOPOLOGY_MAX_NODES];
+    uint16_t parent[TOPOLOGY_MAX_NODES];
+};
+
+// Mesh topology from traceroute replies and NeighborInfo broadcasts.
+// Adjacency is a fixed array of edges per node. Best-path (SNR-weighted)
+// and hop-count queries reuse cached single-source trees; an edge change
+// only drops the trees it can actually affect.
+class TopologyGraph {
+public:
+    TopologyGraph();
+
+    // Packets received on TRACEROUTE_APP / NEIGHBORINFO_APP
+    bool handleTraceroute(const meshtastic_MeshPacket& packet);
+    bool handleNeighborInfo(const meshtastic_MeshPacket& packet);
+
+    // Record a link heard by `to` from `from` (SNR in 0.25 dB)
+    void queueEdge(uint32_t from, uint32_t to, int8_t snr);
+
+    // Apply queued edges and expire stale ones. Call from loop().
+    void update();
+
+    // Lowest-cost path, written as node numbers from..to. Returns the
+    // number of nodes in the path (0 if unreachable).
+    size_t bestPath(uint32_t from, uint32_t to, uint32_t* path, size_t maxLength, uint16_t* cost = nullptr);
+
+    // Fewest hops from..to, or -1 if unreachable
+    int hopCount(uint32_t from, uint32_t to);
+
+    size_t nodeCount();
+    size_t edgeCount();
+
+    void printStats();
+
+private:
+    struct PendingEdge {
+        uint32_t from;
+        uint32_t to;
+        int8_t snr;
+    };
+
+    TopologyNode nodes[TOPOLOGY_MAX_NODES];
+    TopologyEdge edges[TOPOLOGY_MAX_NODES][TOPOLOGY_MAX_EDGES];
+    uint16_t nodeBuckets[TOPOLOGY_NODE_BUCKETS];
+    uint16_t nodesUsed;
+    uint32_t edgesUsed;
+
+    TopologyTree cache[TOPOLOGY_CACHE_SLOTS];
+    uint32_t useCounter;
+
+    // Dijkstra/BFS scratch: indexed binary heap (or FIFO) over node indexes
+    uint16_t heap[TOPOLOGY_MAX_NODES];
+    uint16_t heapPos[TOPOLOGY_MAX_NODES];
+    uint16_t heapSize;
+
+    PendingEdge queue[TOPOLOGY_QUEUE_DEPTH];
+    volatile uint8_t queueHead;
+    volatile uint8_t queueTail;
+    unsigned long lastExpiry;
+
+    // Statistics
+    uint32_t edgeUpdates;
+    uint32_t edgesExpired;
+    uint32_t updatesDropped;
+    uint32_t treesInvalidated;
+    uint32_t queries;
+    uint32_t cacheHits;
+    uint32_t queryMicrosTotal;
+    uint32_t queryMicrosMax;
+
+    uint16_t findNode(uint32_t num);
+    uint16_t addNode(uint32_t num);
+    TopologyEdge* findEdge(uint16_t from, uint16_t to);
+    void setEdge(uint16_t from, uint16_t to, int8_t snr, uint8_t flags);
+    void removeEdge(uint16_t from, uint8_t slot);
+    void expireEdges();
+
+    static uint16_t edgeCost(int8_t snr);
+    void edgeChanged(uint16_t from, uint16_t to, uint16_t oldCost, uint16_t newCost);
+
+    TopologyTree* getTree(uint16_t source, bool weighted);
+    void buildTree(TopologyTree& tree);
+    void heapPush(TopologyTree& tree, uint16_t node);
+    uint16_t heapPop(TopologyTree& tree);
+    void heapSiftUp(TopologyTree& tree, uint16_t position);
+    void finishQuery(unsigned long startMicros);
+};
+
+#endif // TOPOLOGY_GRAPH_H
@@ -0,0 +1,40 @@
+#ifndef UTF8_TEXT_H
+#define UTF8_TEXT_H
+
+#include <Arduino.h>
+
+#define UTF8_REPLACEMENT  0xFFFD   // Returned for malformed sequences
+#define UTF8_NO_GLYPH     0        // Code point takes no space on screen
+#define UTF8_FALLBACK     '?'      // Glyph for code points the fonts lack
+
+// UTF-8 for message text. Mesh payloads are untrusted bytes without a
+// terminator; sanitize() turns them into valid, NUL-terminated UTF-8 in one
+// pass. The display fonts cover Latin-1, so code points map to one font
+// glyph each, through a small table for common punctuation and symbols.
+// Nothing here allocates.
+class Utf8Text {
+public:
+    // Decode the code point at text[*pos] and advance *pos past it. Never
+    // reads past `length`; malformed input yields UTF8_REPLACEMENT and
+    // advances one byte.
+    static uint32_t decode(const char* text, size_t length, size_t* pos);
+
+    // Copy `length` bytes of untrusted text into out (at most outSize - 1
+    // bytes, cut on a code point boundary) and NUL-terminate it. Malformed
+    // bytes become UTF8_FALLBACK and control characters other than newline
+    // become spaces. Stops at an embedded NUL. May be done in place.
+    // Returns the bytes written.
+    static size_t sanitize(const uint8_t* in, size_t length, char* out, size_t outSize);
+
+    // Longest prefix of at most maxBytes that does not split a code point
+    static size_t truncate(const char* text, size_t length, size_t maxBytes);
+
+    // Font glyph (Latin-1) for a code point, UTF8_NO_GLYPH to skip it
+    static uint8_t toGlyph(uint32_t codepoint);
+
+    // Map UTF-8 text to one glyph byte per code point for drawStr.
+    // Returns the glyphs written (out is NUL-terminated).
+    static size_t toGlyphs(const char* text, size_t length, char* out, size_t outSize);
+};
+
+#endif // UTF8_TEXT_H
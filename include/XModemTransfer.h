@@ -0,0 +1,118 @@
+#ifndef XMODEM_TRANSFER_H
+#define XMODEM_TRANSFER_H
+
+#include <Arduino.h>
+#include <functional>
+#include <esp_partition.h>
+#include "proto/meshtastic_protocol.h"
+#include "FromRadioQueue.h"
+
+// Files are stored raw in the data partition: sector 0 holds the file
+// header, the contents start at the next sector.
+#define XMODEM_PARTITION_SUBTYPE ESP_PARTITION_SUBTYPE_DATA_SPIFFS
+#define XMODEM_SECTOR_SIZE       4096
+#define XMODEM_BLOCK_SIZE        128   // meshtastic_XModem.buffer
+#define XMODEM_FILE_MAGIC        0x58464D31  // "XFM1"
+#define XMODEM_MAX_FILENAME      64
+
+// Blocks the sender keeps in flight before waiting for an ACK (go-back-N)
+#define XMODEM_SEND_WINDOW       4
+#define XMODEM_TIMEOUT_MS        5000
+#define XMODEM_MAX_RETRIES       10
+
+struct XModemFileHeader {
+    uint32_t magic;
+    uint32_t length;
+    uint16_t crc16;        // CRC16-CCITT over the whole file
+    char name[XMODEM_MAX_FILENAME];
+};
+
+// Streaming XModem file transfer over ToRadio/FromRadio xmodemPacket.
+// Uploads (SOH seq 0 = filename) are written straight to flash one sector
+// at a time; downloads (STX seq 0 = filename) are read block by block, so
+// the file is never held in RAM.
+class XModemTransfer {
+public:
+    XModemTransfer();
+
+    bool begin();
+
+    void onSend(FromRadioSendCallback callback);
+
+    // A ToRadio.xmodemPacket from a client
+    void handlePacket(const meshtastic_XModem& packet);
+
+    // Retransmit or give up on timeout. Call from loop().
+    void update();
+
+    bool isActive();
+
+    // Copy the stored file into out if its name matches, it fits and its
+    // CRC checks out. Returns the file length, 0 otherwise.
+    size_t readFile(const char* name, uint8_t* out, size_t maxLen);
+
+    void printStats();
+
+private:
+    enum State {
+        XMODEM_IDLE,
+        XMODEM_RECEIVING,
+        XMODEM_SENDING,
+        XMODEM_SENDING_EOT
+    };
+
+    const esp_partition_t* partition;
+    State state;
+    XModemFileHeader header;
+
+    // Receive (upload) side
+    uint8_t sectorBuffer[XMODEM_SECTOR_SIZE];
+    size_t sectorFill;
+    uint32_t writeOffset;             // Bytes of file data flushed so far
+    uint16_t expectedSeq;
+    uint16_t runningCrc;
+
+    // Send (download) side
+    uint16_t baseSeq;                 // Oldest unacknowledged block
+    uint16_t nextSeq;                 // Next block to transmit
+    uint16_t lastSeq;                 // Final block of the file
+    uint16_t highestSent;             // Highest block transmitted so far
+    uint8_t retries;
+
+    unsigned long lastActivity;
+    unsigned long transferStartedAt;
+
+    FromRadioSendCallback sendCallback;
+
+    // Statistics
+    uint32_t filesReceived;
+    uint32_t filesSent;
+    uint32_t transfersAborted;
+    uint32_t blocksReceived;
+    uint32_t blocksSent;
+    uint32_t blocksResent;
+    uint32_t naksSent;
+    uint32_t sectorsWritten;
+    uint32_t lastTransferBytes;
+    unsigned long lastTransferMs;
+
+    void startReceive(const meshtastic_XModem& packet);
+    void receiveBlock(const meshtastic_XModem& packet);
+    void finishReceive();
+    void startSend(const meshtastic_XModem& packet);
+    void handleAck(uint16_t seq);
+    void fillWindow();
+    bool sendBlock(uint16_t seq);
+    void abort(bool notifyPeer);
+    void finishTransfer(uint32_t bytes);
+
+    bool flushSector();
+    bool readHeader(XModemFileHeader* out);
+    void sendControl(meshtastic_XModem_Control control, uint16_t seq);
+    void sendPacket(const meshtastic_XModem& packet);
+};
+
+// CRC16-CCITT (XModem variant: poly 0x1021, init 0)
+uint16_t xmodem_crc16(const uint8_t* data, size_t length, uint16_t crc = 0);
+
+#endif // XMODEM_TRANSFER_H
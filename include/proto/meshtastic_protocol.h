@@ -15,6 +15,8 @@ bool encode_mesh_packet(uint8_t *buffer, size_t buffer_size, const meshtastic_Me
 bool decode_mesh_packet(const uint8_t *buffer, size_t buffer_size, meshtastic_MeshPacket *packet);
 bool encode_to_radio(uint8_t *buffer, size_t buffer_size, const meshtastic_ToRadio *msg, size_t *bytes_written);
 bool decode_from_radio(const uint8_t *buffer, size_t buffer_size, meshtastic_FromRadio *msg);
+bool decode_to_radio(const uint8_t *buffer, size_t buffer_size, meshtastic_ToRadio *msg);
+bool encode_from_radio(uint8_t *buffer, size_t buffer_size, const meshtastic_FromRadio *msg, size_t *bytes_written);
 
 // Utility functions
 void init_mesh_packet(meshtastic_MeshPacket *packet);
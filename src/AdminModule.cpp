@@ -0,0 +1,401 @@
+#include "AdminModule.h"
+#include <pb_encode.h>
+#include <pb_decode.h>
+
+// Config oneof variants and where each is kept in LocalConfig /
+// LocalModuleConfig. Every variant of a oneof starts at the same address,
+// so sections are read and written through &payload_variant.
+struct SectionMap {
+    pb_size_t variantTag;
+    uint8_t field;
+    const pb_msgdesc_t* fields;
+};
+
+static const SectionMap CONFIG_SECTIONS[] = {
+    { meshtastic_Config_device_tag,    meshtastic_LocalConfig_device_tag,    meshtastic_Config_DeviceConfig_fields },
+    { meshtastic_Config_position_tag,  meshtastic_LocalConfig_position_tag,  meshtastic_Config_PositionConfig_fields },
+    { meshtastic_Config_power_tag,     meshtastic_LocalConfig_power_tag,     meshtastic_Config_PowerConfig_fields },
+    { meshtastic_Config_network_tag,   meshtastic_LocalConfig_network_tag,   meshtastic_Config_NetworkConfig_fields },
+    { meshtastic_Config_display_tag,   meshtastic_LocalConfig_display_tag,   meshtastic_Config_DisplayConfig_fields },
+    { meshtastic_Config_lora_tag,      meshtastic_LocalConfig_lora_tag,      meshtastic_Config_LoRaConfig_fields },
+    { meshtastic_Config_bluetooth_tag, meshtastic_LocalConfig_bluetooth_tag, meshtastic_Config_BluetoothConfig_fields },
+    { meshtastic_Config_security_tag,  meshtastic_LocalConfig_security_tag,  meshtastic_Config_SecurityConfig_fields },
+};
+
+static const SectionMap MODULE_SECTIONS[] = {
+    { meshtastic_ModuleConfig_mqtt_tag,                  meshtastic_LocalModuleConfig_mqtt_tag,
+      meshtastic_ModuleConfig_MQTTConfig_fields },
+    { meshtastic_ModuleConfig_serial_tag,                meshtastic_LocalModuleConfig_serial_tag,
+      meshtastic_ModuleConfig_SerialConfig_fields },
+    { meshtastic_ModuleConfig_external_notification_tag, meshtastic_LocalModuleConfig_external_notification_tag,
+      meshtastic_ModuleConfig_ExternalNotificationConfig_fields },
+    { meshtastic_ModuleConfig_store_forward_tag,         meshtastic_LocalModuleConfig_store_forward_tag,
+      meshtastic_ModuleConfig_StoreForwardConfig_fields },
+    { meshtastic_ModuleConfig_range_test_tag,            meshtastic_LocalModuleConfig_range_test_tag,
+      meshtastic_ModuleConfig_RangeTestConfig_fields },
+    { meshtastic_ModuleConfig_telemetry_tag,             meshtastic_LocalModuleConfig_telemetry_tag,
+      meshtastic_ModuleConfig_TelemetryConfig_fields },
+    { meshtastic_ModuleConfig_canned_message_tag,        meshtastic_LocalModuleConfig_canned_message_tag,
+      meshtastic_ModuleConfig_CannedMessageConfig_fields },
+    { meshtastic_ModuleConfig_audio_tag,                 meshtastic_LocalModuleConfig_audio_tag,
+      meshtastic_ModuleConfig_AudioConfig_fields },
+    { meshtastic_ModuleConfig_remote_hardware_tag,       meshtastic_LocalModuleConfig_remote_hardware_tag,
+      meshtastic_ModuleConfig_RemoteHardwareConfig_fields },
+    { meshtastic_ModuleConfig_neighbor_info_tag,         meshtastic_LocalModuleConfig_neighbor_info_tag,
+      meshtastic_ModuleConfig_NeighborInfoConfig_fields },
+    { meshtastic_ModuleConfig_ambient_lighting_tag,      meshtastic_LocalModuleConfig_ambient_lighting_tag,
+      meshtastic_ModuleConfig_AmbientLightingConfig_fields },
+    { meshtastic_ModuleConfig_detection_sensor_tag,      meshtastic_LocalModuleConfig_detection_sensor_tag,
+      meshtastic_ModuleConfig_DetectionSensorConfig_fields },
+    { meshtastic_ModuleConfig_paxcounter_tag,            meshtastic_LocalModuleConfig_paxcounter_tag,
+      meshtastic_ModuleConfig_PaxcounterConfig_fields },
+};
+
+static const SectionMap* findSection(const SectionMap* map, size_t count, pb_size_t variantTag) {
+    for (size_t i = 0; i < count; i++) {
+        if (map[i].variantTag == variantTag) {
+            return &map[i];
+        }
+    }
+    return nullptr;
+}
+
+AdminModule::AdminModule()
+    : store(nullptr)
+    , nodeNum(0)
+    , editing(false)
+    , editStartedAt(0)
+    , pendingSets(0)
+    , messagesHandled(0)
+    , messagesMalformed(0)
+    , unsupported(0)
+    , editsDiscarded(0)
+    , lastBatchBytes(0)
+    , lastBatchSets(0) {
+}
+
+bool AdminModule::begin(uint32_t nodeNum, ConfigStore* store) {
+    this->nodeNum = nodeNum;
+    this->store = store;
+
+    if (!store->hasImage()) {
+        Serial.println("Admin: no stored settings, writing defaults");
+        writeDefaults();
+        commit();
+    }
+    return true;
+}
+
+void AdminModule::onSend(FromRadioSendCallback callback) {
+    sendCallback = callback;
+}
+
+void AdminModule::onChannelChanged(std::function<void(int index)> callback) {
+    channelChanged = callback;
+}
+
+// --- Settings ---
+
+void AdminModule::writeDefaults() {
+    // Only sections that differ from all-zero need storing
+    meshtastic_Config_LoRaConfig lora = meshtastic_Config_LoRaConfig_init_default;
+    lora.use_preset = true;
+    lora.modem_preset = meshtastic_Config_LoRaConfig_ModemPreset_LONG_FAST;
+    lora.hop_limit = 3;
+    lora.tx_enabled = true;
+    store->write(CONFIG_LOCAL, meshtastic_LocalConfig_lora_tag, 0, meshtastic_Config_LoRaConfig_fields, &lora);
+
+    meshtastic_Config_BluetoothConfig bluetooth = meshtastic_Config_BluetoothConfig_init_default;
+    bluetooth.enabled = true;
+    store->write(CONFIG_LOCAL, meshtastic_LocalConfig_bluetooth_tag, 0,
+                 meshtastic_Config_BluetoothConfig_fields, &bluetooth);
+
+    // Primary channel with the default key, the rest disabled
+    for (int i = 0; i < ADMIN_MAX_CHANNELS; i++) {
+        meshtastic_Channel channel = meshtastic_Channel_init_default;
+        channel.index = i;
+        if (i == 0) {
+            channel.role = meshtastic_Channel_Role_PRIMARY;
+            channel.has_settings = true;
+            channel.settings.psk.size = 1;
+            channel.settings.psk.bytes[0] = 1;
+        }
+        store->write(CONFIG_CHANNELS, meshtastic_ChannelFile_channels_tag, i, meshtastic_Channel_fields, &channel);
+    }
+
+    meshtastic_User owner = meshtastic_User_init_default;
+    snprintf(owner.id, sizeof(owner.id), "!%08x", nodeNum);
+    snprintf(owner.long_name, sizeof(owner.long_name), "Meshtastic %04x", nodeNum & 0xFFFF);
+    snprintf(owner.short_name, sizeof(owner.short_name), "%04x", nodeNum & 0xFFFF);
+    uint64_t mac = ESP.getEfuseMac();
+    for (int i = 0; i < 6; i++) {
+        owner.macaddr[i] = mac >> (8 * i);
+    }
+    owner.hw_model = meshtastic_HardwareModel_HELTEC_V3;
+    store->write(CONFIG_OWNER, 0, 0, meshtastic_User_fields, &owner);
+}
+
+void AdminModule::commit() {
+    if (!store->isDirty()) {
+        pendingSets = 0;
+        return;
+    }
+    size_t written = store->commit();
+    if (written == 0) {
+        return;
+    }
+    lastBatchBytes = written;
+    lastBatchSets = pendingSets;
+    Serial.printf("Admin: committed %u change(s), %u bytes\n", pendingSets, written);
+    pendingSets = 0;
+}
+
+bool AdminModule::getChannel(uint8_t index, meshtastic_Channel* out) {
+    if (index >= ADMIN_MAX_CHANNELS ||
+        !store->read(CONFIG_CHANNELS, meshtastic_ChannelFile_channels_tag, index, meshtastic_Channel_fields, out)) {
+        return false;
+    }
+    out->index = index;
+    return true;
+}
+
+bool AdminModule::getOwner(meshtastic_User* out) {
+    return store->read(CONFIG_OWNER, 0, 0, meshtastic_User_fields, out);
+}
+
+// --- Admin messages ---
+
+bool AdminModule::handlePacket(const meshtastic_MeshPacket& packet) {
+    // Static: AdminMessage is large
+    static meshtastic_AdminMessage admin;
+
+    if (packet.which_payload_variant != meshtastic_MeshPacket_decoded_tag ||
+        packet.decoded.portnum != meshtastic_PortNum_ADMIN_APP ||
+        (packet.to != nodeNum && packet.to != 0)) {
+        return false;
+    }
+
+    memset(&admin, 0, sizeof(admin));
+    pb_istream_t stream = pb_istream_from_buffer(packet.decoded.payload.bytes, packet.decoded.payload.size);
+    if (!pb_decode(&stream, meshtastic_AdminMessage_fields, &admin)) {
+        Serial.println("Admin: malformed message");
+        messagesMalformed++;
+        return true;
+    }
+    handleAdmin(packet.id, admin);
+    return true;
+}
+
+void AdminModule::update() {
+    if (editing && millis() - editStartedAt >= ADMIN_EDIT_TIMEOUT_MS) {
+        Serial.printf("Admin: edit not committed in time, discarding %u change(s)\n", pendingSets);
+        editing = false;
+        pendingSets = 0;
+        editsDiscarded++;
+        store->discard();
+        // Staged channel and LoRa sets were already applied; reload the saved ones
+        if (channelChanged) {
+            channelChanged(-1);
+        }
+    }
+}
+
+void AdminModule::afterSet() {
+    pendingSets++;
+    if (!editing) {
+        commit();
+    }
+}
+
+void AdminModule::handleAdmin(uint32_t requestId, const meshtastic_AdminMessage& admin) {
+    static meshtastic_AdminMessage response;
+    memset(&response, 0, sizeof(response));
+    messagesHandled++;
+
+    switch (admin.which_payload_variant) {
+        case meshtastic_AdminMessage_get_channel_request_tag: {
+            // Request carries index + 1
+            uint32_t index = admin.get_channel_request - 1;
+            if (index >= ADMIN_MAX_CHANNELS) {
+                break;
+            }
+            response.which_payload_variant = meshtastic_AdminMessage_get_channel_response_tag;
+            getChannel(index, &response.get_channel_response);
+            sendResponse(requestId, response);
+            return;
+        }
+
+        case meshtastic_AdminMessage_get_owner_request_tag:
+            response.which_payload_variant = meshtastic_AdminMessage_get_owner_response_tag;
+            getOwner(&response.get_owner_response);
+            sendResponse(requestId, response);
+            return;
+
+        case meshtastic_AdminMessage_get_config_request_tag:
+            response.which_payload_variant = meshtastic_AdminMessage_get_config_response_tag;
+            if (getConfigSection(admin.get_config_request,
+                                 &response.get_config_response)) {
+                sendResponse(requestId, response);
+                return;
+            }
+            break;
+
+        case meshtastic_AdminMessage_get_module_config_request_tag:
+            response.which_payload_variant = meshtastic_AdminMessage_get_module_config_response_tag;
+            if (getModuleSection(admin.get_module_config_request,
+                                 &response.get_module_config_response)) {
+                sendResponse(requestId, response);
+                return;
+            }
+            break;
+
+        case meshtastic_AdminMessage_set_owner_tag:
+            if (setOwner(admin.set_owner)) {
+                afterSet();
+                return;
+            }
+            break;
+
+        case meshtastic_AdminMessage_set_channel_tag:
+            if (admin.set_channel.index >= 0 && admin.set_channel.index < ADMIN_MAX_CHANNELS &&
+                store->write(CONFIG_CHANNELS, meshtastic_ChannelFile_channels_tag, admin.set_channel.index,
+                             meshtastic_Channel_fields, &admin.set_channel)) {
+                afterSet();
+                if (channelChanged) {
+                    channelChanged(admin.set_channel.index);
+                }
+                return;
+            }
+            break;
+
+        case meshtastic_AdminMessage_set_config_tag:
+            if (setConfigSection(admin.set_config)) {
+                afterSet();
+                // Unnamed channels take their name (and key hash) from the preset
+                if (admin.set_config.which_payload_variant == meshtastic_Config_lora_tag && channelChanged) {
+                    channelChanged(-1);
+                }
+                return;
+            }
+            break;
+
+        case meshtastic_AdminMessage_set_module_config_tag:
+            if (setModuleSection(admin.set_module_config)) {
+                afterSet();
+                return;
+            }
+            break;
+
+        case meshtastic_AdminMessage_begin_edit_settings_tag:
+            editing = true;
+            editStartedAt = millis();
+            return;
+
+        case meshtastic_AdminMessage_commit_edit_settings_tag:
+            editing = false;
+            commit();
+            return;
+    }
+
+    unsupported++;
+    Serial.printf("Admin: unsupported request (variant %u)\n", admin.which_payload_variant);
+}
+
+bool AdminModule::getConfigSection(meshtastic_AdminMessage_ConfigType type, meshtastic_Config* out) {
+    // ConfigType values are the oneof tags minus one
+    pb_size_t tag = type + 1;
+    if (tag == meshtastic_Config_sessionkey_tag) {
+        // Empty message - remote admin sessions are not supported
+        out->which_payload_variant = tag;
+        return true;
+    }
+    const SectionMap* section = findSection(CONFIG_SECTIONS, sizeof(CONFIG_SECTIONS) / sizeof(CONFIG_SECTIONS[0]), tag);
+    if (section == nullptr) {
+        return false;
+    }
+    out->which_payload_variant = tag;
+    return store->read(CONFIG_LOCAL, section->field, 0, section->fields, &out->payload_variant);
+}
+
+bool AdminModule::setConfigSection(const meshtastic_Config& in) {
+    const SectionMap* section = findSection(CONFIG_SECTIONS, sizeof(CONFIG_SECTIONS) / sizeof(CONFIG_SECTIONS[0]),
+                                            in.which_payload_variant);
+    return section != nullptr && store->write(CONFIG_LOCAL, section->field, 0, section->fields, &in.payload_variant);
+}
+
+bool AdminModule::getModuleSection(meshtastic_AdminMessage_ModuleConfigType type, meshtastic_ModuleConfig* out) {
+    // ModuleConfigType values are the oneof tags minus one
+    pb_size_t tag = type + 1;
+    const SectionMap* section = findSection(MODULE_SECTIONS, sizeof(MODULE_SECTIONS) / sizeof(MODULE_SECTIONS[0]), tag);
+    if (section == nullptr) {
+        return false;
+    }
+    out->which_payload_variant = tag;
+    return store->read(CONFIG_MODULES, section->field, 0, section->fields, &out->payload_variant);
+}
+
+bool AdminModule::setModuleSection(const meshtastic_ModuleConfig& in) {
+    const SectionMap* section = findSection(MODULE_SECTIONS, sizeof(MODULE_SECTIONS) / sizeof(MODULE_SECTIONS[0]),
+                                            in.which_payload_variant);
+    return section != nullptr && store->write(CONFIG_MODULES, section->field, 0, section->fields, &in.payload_variant);
+}
+
+bool AdminModule::setOwner(const meshtastic_User& user) {
+    meshtastic_User owner;
+    if (!getOwner(&owner)) {
+        return false;
+    }
+    // id, MAC and hardware model belong to this device, not the client
+    memcpy(owner.long_name, user.long_name, sizeof(owner.long_name));
+    memcpy(owner.short_name, user.short_name, sizeof(owner.short_name));
+    owner.is_licensed = user.is_licensed;
+    owner.has_is_unmessagable = user.has_is_unmessagable;
+    owner.is_unmessagable = user.is_unmessagable;
+    return store->write(CONFIG_OWNER, 0, 0, meshtastic_User_fields, &owner);
+}
+
+void AdminModule::sendResponse(uint32_t requestId, const meshtastic_AdminMessage& response) {
+    if (!sendCallback) {
+        return;
+    }
+
+    static meshtastic_FromRadio fromRadio;
+    memset(&fromRadio, 0, sizeof(fromRadio));
+    fromRadio.which_payload_variant = meshtastic_FromRadio_packet_tag;
+    meshtastic_MeshPacket& packet = fromRadio.packet;
+    packet.from = nodeNum;
+    packet.to = nodeNum;
+    packet.id = esp_random();
+    packet.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    packet.decoded.portnum = meshtastic_PortNum_ADMIN_APP;
+    packet.decoded.request_id = requestId;
+
+    pb_ostream_t stream = pb_ostream_from_buffer(packet.decoded.payload.bytes, sizeof(packet.decoded.payload.bytes));
+    if (!pb_encode(&stream, meshtastic_AdminMessage_fields, &response)) {
+        Serial.println("Admin: response encode failed");
+        return;
+    }
+    packet.decoded.payload.size = stream.bytes_written;
+
+    uint8_t frame[FROMRADIO_MAX_FRAME];
+    size_t length;
+    if (!encode_from_radio(frame, sizeof(frame), &fromRadio, &length)) {
+        Serial.println("Admin: frame encode failed");
+        return;
+    }
+    sendCallback(frame, length);
+}
+
+void AdminModule::printStats() {
+    Serial.println("=== Admin Stats ===");
+    Serial.printf("Messages: %u handled, %u unsupported, %u malformed\n", messagesHandled, unsupported, messagesMalformed);
+    if (editing) {
+        Serial.printf("Edit open: %u change(s) staged\n", pendingSets);
+    }
+    if (editsDiscarded > 0) {
+        Serial.printf("Edits discarded after timeout: %u\n", editsDiscarded);
+    }
+    if (lastBatchSets > 0) {
+        Serial.printf("Last batch: %u change(s), %u flash bytes\n", lastBatchSets, lastBatchBytes);
+    }
+}
@@ -0,0 +1,323 @@
+#include "ChannelCrypto.h"
+#include <pb_decode.h>
+
+// The well-known Meshtastic default channel key (PSK index 1)
+static const uint8_t DEFAULT_PSK[16] = {
+    0xd4, 0xf1, 0xbb, 0x3a, 0x20, 0x29, 0x07, 0x59,
+    0xf0, 0xbc, 0xff, 0xab, 0xcf, 0x4e, 0x69, 0x01
+};
+
+#ifdef CHANNEL_CRYPTO_SOFTWARE
+
+static const uint8_t SBOX[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+static uint8_t xtime(uint8_t x) {
+    return (x << 1) ^ ((x & 0x80) ? 0x1b : 0);
+}
+
+static void expandKey(const uint8_t* key, uint8_t keyLength, uint8_t* roundKeys, uint8_t* rounds) {
+    uint8_t nk = keyLength / 4;
+    *rounds = nk + 6;
+    size_t words = 4 * (*rounds + 1);
+    memcpy(roundKeys, key, keyLength);
+
+    uint8_t rcon = 1;
+    for (size_t i = nk; i < words; i++) {
+        uint8_t t[4];
+        memcpy(t, roundKeys + 4 * (i - 1), 4);
+        if (i % nk == 0) {
+            uint8_t first = t[0];
+            t[0] = SBOX[t[1]] ^ rcon;
+            t[1] = SBOX[t[2]];
+            t[2] = SBOX[t[3]];
+            t[3] = SBOX[first];
+            rcon = xtime(rcon);
+        } else if (nk > 6 && i % nk == 4) {
+            for (int j = 0; j < 4; j++) {
+                t[j] = SBOX[t[j]];
+            }
+        }
+        for (int j = 0; j < 4; j++) {
+            roundKeys[4 * i + j] = roundKeys[4 * (i - nk) + j] ^ t[j];
+        }
+    }
+}
+
+static void aesEncryptBlock(const uint8_t* roundKeys, uint8_t rounds, const uint8_t* in, uint8_t* out) {
+    uint8_t s[16];
+    for (int i = 0; i < 16; i++) {
+        s[i] = in[i] ^ roundKeys[i];
+    }
+
+    for (uint8_t round = 1; round <= rounds; round++) {
+        // SubBytes + ShiftRows (state is column-major)
+        uint8_t t[16];
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 4; r++) {
+                t[4 * c + r] = SBOX[s[4 * ((c + r) % 4) + r]];
+            }
+        }
+
+        // MixColumns, skipped in the final round
+        if (round < rounds) {
+            for (int c = 0; c < 4; c++) {
+                uint8_t* col = t + 4 * c;
+                uint8_t all = col[0] ^ col[1] ^ col[2] ^ col[3];
+                uint8_t first = col[0];
+                col[0] ^= all ^ xtime(col[0] ^ col[1]);
+                col[1] ^= all ^ xtime(col[1] ^ col[2]);
+                col[2] ^= all ^ xtime(col[2] ^ col[3]);
+                col[3] ^= all ^ xtime(col[3] ^ first);
+            }
+        }
+
+        const uint8_t* roundKey = roundKeys + 16 * round;
+        for (int i = 0; i < 16; i++) {
+            s[i] = t[i] ^ roundKey[i];
+        }
+    }
+    memcpy(out, s, 16);
+}
+
+#endif // CHANNEL_CRYPTO_SOFTWARE
+
+ChannelCrypto::ChannelCrypto()
+    : packetsDecrypted(0)
+    , packetsFailed(0)
+    , bytesDecrypted(0)
+    , decryptMicrosTotal(0)
+    , trialDecrypts(0)
+    , noCandidate(0) {
+    for (int i = 0; i < CRYPTO_MAX_CHANNELS; i++) {
+        keys[i].valid = false;
+    }
+    for (int i = 0; i < 256; i++) {
+        hashSlots[i] = 0;
+    }
+}
+
+// --- Keys ---
+
+bool ChannelCrypto::expandPsk(const meshtastic_ChannelSettings_psk_t& psk, uint8_t* key, uint8_t* keyLength) {
+    if (psk.size == 0 || (psk.size == 1 && psk.bytes[0] == 0)) {
+        *keyLength = 0;  // Plaintext channel
+        return true;
+    }
+    if (psk.size == 1) {
+        // Default key, with index 2..10 added to the last byte
+        memcpy(key, DEFAULT_PSK, sizeof(DEFAULT_PSK));
+        key[sizeof(DEFAULT_PSK) - 1] += psk.bytes[0] - 1;
+        *keyLength = sizeof(DEFAULT_PSK);
+        return true;
+    }
+
+    // Short keys are zero-padded to the next AES key size
+    *keyLength = psk.size <= 16 ? 16 : 32;
+    memset(key, 0, *keyLength);
+    memcpy(key, psk.bytes, min((size_t)psk.size, (size_t)CRYPTO_MAX_KEY));
+    return psk.size == 16 || psk.size == 32;
+}
+
+void ChannelCrypto::setKey(ChannelKey& slot, const uint8_t* key, uint8_t keyLength) {
+    slot.keyLength = keyLength;
+    if (keyLength == 0) {
+        return;
+    }
+#ifdef CHANNEL_CRYPTO_SOFTWARE
+    expandKey(key, keyLength, slot.roundKeys, &slot.rounds);
+#else
+    mbedtls_aes_init(&slot.aes);
+    mbedtls_aes_setkey_enc(&slot.aes, key, keyLength * 8);
+#endif
+}
+
+uint8_t ChannelCrypto::channelHash(const char* name, const uint8_t* key, size_t keyLength) {
+    uint8_t hash = 0;
+    for (const char* c = name; *c; c++) {
+        hash ^= *c;
+    }
+    for (size_t i = 0; i < keyLength; i++) {
+        hash ^= key[i];
+    }
+    return hash;
+}
+
+const char* ChannelCrypto::presetName(meshtastic_Config_LoRaConfig_ModemPreset preset) {
+    switch (preset) {
+        case meshtastic_Config_LoRaConfig_ModemPreset_LONG_FAST:      return "LongFast";
+        case meshtastic_Config_LoRaConfig_ModemPreset_LONG_SLOW:      return "LongSlow";
+        case meshtastic_Config_LoRaConfig_ModemPreset_VERY_LONG_SLOW: return "VLongSlow";
+        case meshtastic_Config_LoRaConfig_ModemPreset_MEDIUM_SLOW:    return "MediumSlow";
+        case meshtastic_Config_LoRaConfig_ModemPreset_MEDIUM_FAST:    return "MediumFast";
+        case meshtastic_Config_LoRaConfig_ModemPreset_SHORT_SLOW:     return "ShortSlow";
+        case meshtastic_Config_LoRaConfig_ModemPreset_SHORT_FAST:     return "ShortFast";
+        case meshtastic_Config_LoRaConfig_ModemPreset_LONG_MODERATE:  return "LongMod";
+        case meshtastic_Config_LoRaConfig_ModemPreset_SHORT_TURBO:    return "ShortTurbo";
+        case meshtastic_Config_LoRaConfig_ModemPreset_LONG_TURBO:     return "LongTurbo";
+        default:                                                      return "Invalid";
+    }
+}
+
+void ChannelCrypto::setChannel(uint8_t index, const meshtastic_Channel& channel, const char* defaultName) {
+    if (index >= CRYPTO_MAX_CHANNELS) {
+        return;
+    }
+    ChannelKey& slot = keys[index];
+    // Drop the old key first: a disabled channel leaves the slot empty
+    if (slot.valid) {
+        slot.valid = false;
+        hashSlots[slot.hash] &= ~(1 << index);
+    }
+    if (channel.role == meshtastic_Channel_Role_DISABLED || !channel.has_settings) {
+        return;
+    }
+
+    uint8_t key[CRYPTO_MAX_KEY];
+    uint8_t keyLength;
+    if (!expandPsk(channel.settings.psk, key, &keyLength)) {
+        Serial.printf("Crypto: channel %u has a %u byte PSK, padded to %u\n",
+                      index, channel.settings.psk.size, keyLength);
+    }
+    setKey(slot, key, keyLength);
+
+    const char* name = channel.settings.name[0] ? channel.settings.name : defaultName;
+    slot.hash = channelHash(name, key, keyLength);
+    slot.valid = true;
+    hashSlots[slot.hash] |= 1 << index;
+}
+
+void ChannelCrypto::encryptBlock(ChannelKey& slot, const uint8_t* in, uint8_t* out) {
+#ifdef CHANNEL_CRYPTO_SOFTWARE
+    aesEncryptBlock(slot.roundKeys, slot.rounds, in, out);
+#else
+    mbedtls_aes_crypt_ecb(&slot.aes, MBEDTLS_AES_ENCRYPT, in, out);
+#endif
+}
+
+// --- AES-CTR ---
+
+void ChannelCrypto::makeNonce(uint32_t packetId, uint32_t from, uint8_t* nonce) {
+    // packet id as a little-endian uint64, then the sender, then the block counter
+    memset(nonce, 0, CRYPTO_BLOCK_SIZE);
+    for (int i = 0; i < 4; i++) {
+        nonce[i] = packetId >> (8 * i);
+        nonce[8 + i] = from >> (8 * i);
+    }
+}
+
+void ChannelCrypto::ctr(ChannelKey& slot, const uint8_t* nonce, uint8_t* data, size_t length) {
+    uint8_t counter[CRYPTO_BLOCK_SIZE];
+    uint8_t stream[CRYPTO_BLOCK_SIZE];
+    memcpy(counter, nonce, CRYPTO_BLOCK_SIZE);
+
+#ifdef CHANNEL_CRYPTO_SOFTWARE
+    for (size_t offset = 0; offset < length; offset += CRYPTO_BLOCK_SIZE) {
+        aesEncryptBlock(slot.roundKeys, slot.rounds, counter, stream);
+        size_t n = min((size_t)CRYPTO_BLOCK_SIZE, length - offset);
+        for (size_t i = 0; i < n; i++) {
+            data[offset + i] ^= stream[i];
+        }
+        // Big-endian increment of the whole block, as mbedtls does
+        for (int i = CRYPTO_BLOCK_SIZE - 1; i >= 0 && ++counter[i] == 0; i--) {
+        }
+    }
+#else
+    size_t streamOffset = 0;
+    mbedtls_aes_crypt_ctr(&slot.aes, length, &streamOffset, counter, stream, data, data);
+#endif
+}
+
+bool ChannelCrypto::crypt(uint8_t index, uint32_t packetId, uint32_t from, uint8_t* data, size_t length) {
+    if (index >= CRYPTO_MAX_CHANNELS || !keys[index].valid) {
+        return false;
+    }
+    if (keys[index].keyLength > 0) {
+        uint8_t nonce[CRYPTO_BLOCK_SIZE];
+        makeNonce(packetId, from, nonce);
+        ctr(keys[index], nonce, data, length);
+    }
+    return true;
+}
+
+bool ChannelCrypto::decrypt(meshtastic_MeshPacket& packet) {
+    if (packet.which_payload_variant != meshtastic_MeshPacket_encrypted_tag) {
+        return false;
+    }
+    unsigned long start = micros();
+
+    // Static: Data is large for the loop() stack
+    static meshtastic_Data data;
+    uint8_t* bytes = packet.encrypted.bytes;
+    size_t length = packet.encrypted.size;
+    uint8_t nonce[CRYPTO_BLOCK_SIZE];
+    makeNonce(packet.id, packet.from, nonce);
+
+    // Only channels whose hash matches get a trial decryption
+    uint8_t candidates = hashSlots[(uint8_t)packet.channel];
+    if (candidates == 0) {
+        noCandidate++;
+        return false;
+    }
+
+    for (uint8_t i = 0; candidates != 0; i++, candidates >>= 1) {
+        ChannelKey& slot = keys[i];
+        if (!(candidates & 1) || !slot.valid) {
+            continue;
+        }
+
+        trialDecrypts++;
+        if (slot.keyLength > 0) {
+            ctr(slot, nonce, bytes, length);
+        }
+        memset(&data, 0, sizeof(data));
+        pb_istream_t stream = pb_istream_from_buffer(bytes, length);
+        if (pb_decode(&stream, meshtastic_Data_fields, &data) && data.portnum != meshtastic_PortNum_UNKNOWN_APP) {
+            packet.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+            packet.decoded = data;
+            packet.channel = i;
+            packetsDecrypted++;
+            bytesDecrypted += length;
+            decryptMicrosTotal += micros() - start;
+            return true;
+        }
+
+        // Hash collision with the wrong key - restore the ciphertext
+        if (slot.keyLength > 0) {
+            ctr(slot, nonce, bytes, length);
+        }
+    }
+
+    packetsFailed++;
+    return false;
+}
+
+void ChannelCrypto::printStats() {
+    Serial.println("=== Crypto Stats ===");
+    int channels = 0;
+    for (int i = 0; i < CRYPTO_MAX_CHANNELS; i++) {
+        channels += keys[i].valid;
+    }
+    Serial.printf("Channel keys: %d, decrypted: %u (%u bytes), failed: %u\n",
+                  channels, packetsDecrypted, bytesDecrypted, packetsFailed);
+    Serial.printf("Trial decryptions: %u, no matching channel: %u\n", trialDecrypts, noCandidate);
+    if (packetsDecrypted > 0) {
+        Serial.printf("Decrypt + decode: %u us avg\n", decryptMicrosTotal / packetsDecrypted);
+    }
+}
@@ -0,0 +1,446 @@
+#include "ChunkedTransfer.h"
+#include <pb_encode.h>
+#include <pb_decode.h>
+
+// Bitmap with the low `count` bits set
+static uint32_t chunkMask(uint16_t count) {
+    return count >= 32 ? 0xFFFFFFFF : ((1UL << count) - 1);
+}
+
+// Encode callback for resend_chunks.chunks - one varint per missing index
+static bool encodeResendChunks(pb_ostream_t* stream, const pb_field_t* field, void* const* arg) {
+    uint32_t missing = *(const uint32_t*)*arg;
+    for (uint32_t i = 0; i < CHUNK_MAX_CHUNKS; i++) {
+        if (missing & (1UL << i)) {
+            if (!pb_encode_tag_for_field(stream, field) || !pb_encode_varint(stream, i)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Parse resend_chunks by hand: nanopb resets callbacks of oneof submessages
+// before decoding them, so the generated struct cannot deliver the indexes.
+// Accepts both packed and unpacked repeated encoding.
+static bool decodeResendChunks(pb_istream_t* stream, uint32_t* missing) {
+    pb_wire_type_t wireType;
+    uint32_t tag;
+    bool eof;
+
+    while (pb_decode_tag(stream, &wireType, &tag, &eof)) {
+        if (tag != meshtastic_resend_chunks_chunks_tag) {
+            if (!pb_skip_field(stream, wireType)) {
+                return false;
+            }
+            continue;
+        }
+
+        if (wireType == PB_WT_STRING) {
+            pb_istream_t packed;
+            if (!pb_make_string_substream(stream, &packed)) {
+                return false;
+            }
+            while (packed.bytes_left > 0) {
+                uint32_t index;
+                if (!pb_decode_varint32(&packed, &index)) {
+                    return false;
+                }
+                if (index < CHUNK_MAX_CHUNKS) {
+                    *missing |= 1UL << index;
+                }
+            }
+            if (!pb_close_string_substream(stream, &packed)) {
+                return false;
+            }
+        } else {
+            uint32_t index;
+            if (!pb_decode_varint32(stream, &index)) {
+                return false;
+            }
+            if (index < CHUNK_MAX_CHUNKS) {
+                *missing |= 1UL << index;
+            }
+        }
+    }
+    return eof;
+}
+
+// Parse a ChunkedPayloadResponse. Returns the oneof tag that was present.
+static bool decodeResponse(const uint8_t* buffer, size_t length, uint32_t* payloadId,
+                           pb_size_t* variant, uint32_t* missing) {
+    pb_istream_t stream = pb_istream_from_buffer(buffer, length);
+    pb_wire_type_t wireType;
+    uint32_t tag;
+    bool eof;
+
+    *payloadId = 0;
+    *variant = 0;
+    *missing = 0;
+
+    while (pb_decode_tag(&stream, &wireType, &tag, &eof)) {
+        if (tag == meshtastic_ChunkedPayloadResponse_payload_id_tag) {
+            if (!pb_decode_varint32(&stream, payloadId)) {
+                return false;
+            }
+        } else if (tag == meshtastic_ChunkedPayloadResponse_resend_chunks_tag && wireType == PB_WT_STRING) {
+            pb_istream_t sub;
+            if (!pb_make_string_substream(&stream, &sub)) {
+                return false;
+            }
+            bool ok = decodeResendChunks(&sub, missing);
+            if (!pb_close_string_substream(&stream, &sub) || !ok) {
+                return false;
+            }
+            *variant = tag;
+        } else if (tag == meshtastic_ChunkedPayloadResponse_request_transfer_tag ||
+                   tag == meshtastic_ChunkedPayloadResponse_accept_transfer_tag) {
+            uint32_t value;
+            if (!pb_decode_varint32(&stream, &value)) {
+                return false;
+            }
+            *variant = tag;
+        } else if (!pb_skip_field(&stream, wireType)) {
+            return false;
+        }
+    }
+    return eof;
+}
+
+ChunkedTransfer::ChunkedTransfer()
+    : sending(false)
+    , sendTo(0)
+    , sendPayloadId(0)
+    , sendData(nullptr)
+    , sendLength(0)
+    , sendChunkCount(0)
+    , sendPending(0)
+    , sendSent(0)
+    , lastChunkSentAt(0)
+    , lastResponseAt(0)
+    , sendProbes(0)
+    , completedNext(0)
+    , chunksSent(0)
+    , chunksResent(0)
+    , chunkBytesSent(0)
+    , chunksReceived(0)
+    , duplicateChunks(0)
+    , resendRequestsSent(0)
+    , transfersSent(0)
+    , transfersReceived(0)
+    , transfersFailed(0)
+    , payloadBytesSent(0)
+    , payloadBytesDelivered(0) {
+    memset(slots, 0, sizeof(slots));
+    memset(completed, 0, sizeof(completed));
+}
+
+void ChunkedTransfer::onSend(ChunkSendCallback callback) {
+    sendCallback = callback;
+}
+
+void ChunkedTransfer::onPayloadComplete(PayloadCallback callback) {
+    payloadCallback = callback;
+}
+
+uint32_t ChunkedTransfer::send(uint32_t to, const uint8_t* data, size_t length) {
+    if (sending) {
+        Serial.println("Chunked transfer already in progress");
+        return 0;
+    }
+    if (data == nullptr || length == 0 || length > CHUNK_MAX_PAYLOAD) {
+        Serial.printf("Chunked payload size %d not supported (max %d)\n", length, CHUNK_MAX_PAYLOAD);
+        return 0;
+    }
+
+    sending = true;
+    sendTo = to;
+    sendPayloadId = esp_random() | 1;  // Never 0
+    sendData = data;
+    sendLength = length;
+    sendChunkCount = (length + CHUNK_DATA_SIZE - 1) / CHUNK_DATA_SIZE;
+    sendPending = chunkMask(sendChunkCount);
+    sendSent = 0;
+    lastChunkSentAt = millis() - CHUNK_SEND_INTERVAL_MS;
+    lastResponseAt = millis();
+    sendProbes = 0;
+
+    Serial.printf("Chunked send #%08X: %d bytes in %d chunks to 0x%08X\n",
+                  sendPayloadId, length, sendChunkCount, to);
+    return sendPayloadId;
+}
+
+bool ChunkedTransfer::isSending() {
+    return sending;
+}
+
+bool ChunkedTransfer::sendChunk(uint16_t index) {
+    meshtastic_ChunkedPayload chunk = meshtastic_ChunkedPayload_init_zero;
+    chunk.payload_id = sendPayloadId;
+    chunk.chunk_count = sendChunkCount;
+    chunk.chunk_index = index;
+
+    size_t offset = (size_t)index * CHUNK_DATA_SIZE;
+    size_t length = min((size_t)CHUNK_DATA_SIZE, sendLength - offset);
+    memcpy(chunk.payload_chunk.bytes, sendData + offset, length);
+    chunk.payload_chunk.size = length;
+
+    meshtastic_Data data = meshtastic_Data_init_zero;
+    data.portnum = CHUNKED_PAYLOAD_PORT;
+    pb_ostream_t stream = pb_ostream_from_buffer(data.payload.bytes, sizeof(data.payload.bytes));
+    if (!pb_encode(&stream, meshtastic_ChunkedPayload_fields, &chunk)) {
+        Serial.printf("Chunk encode failed: %s\n", PB_GET_ERROR(&stream));
+        return false;
+    }
+    data.payload.size = stream.bytes_written;
+
+    if (sendCallback) {
+        sendCallback(sendTo, data);
+    }
+
+    if (sendSent & (1UL << index)) {
+        chunksResent++;
+    }
+    sendSent |= 1UL << index;
+    chunksSent++;
+    chunkBytesSent += length;
+    return true;
+}
+
+void ChunkedTransfer::sendResponse(uint32_t to, uint32_t payloadId, bool accept, uint32_t missing) {
+    meshtastic_ChunkedPayloadResponse response = meshtastic_ChunkedPayloadResponse_init_zero;
+    response.payload_id = payloadId;
+    if (accept) {
+        response.which_payload_variant = meshtastic_ChunkedPayloadResponse_accept_transfer_tag;
+        response.payload_variant.accept_transfer = true;
+    } else {
+        response.which_payload_variant = meshtastic_ChunkedPayloadResponse_resend_chunks_tag;
+        response.payload_variant.resend_chunks.chunks.funcs.encode = encodeResendChunks;
+        response.payload_variant.resend_chunks.chunks.arg = &missing;
+    }
+
+    meshtastic_Data data = meshtastic_Data_init_zero;
+    data.portnum = CHUNKED_RESPONSE_PORT;
+    pb_ostream_t stream = pb_ostream_from_buffer(data.payload.bytes, sizeof(data.payload.bytes));
+    if (!pb_encode(&stream, meshtastic_ChunkedPayloadResponse_fields, &response)) {
+        Serial.printf("Chunk response encode failed: %s\n", PB_GET_ERROR(&stream));
+        return;
+    }
+    data.payload.size = stream.bytes_written;
+
+    if (sendCallback) {
+        sendCallback(to, data);
+    }
+}
+
+bool ChunkedTransfer::handleChunkPacket(const meshtastic_MeshPacket& packet) {
+    const meshtastic_Data& data = packet.decoded;
+    meshtastic_ChunkedPayload chunk = meshtastic_ChunkedPayload_init_zero;
+
+    pb_istream_t stream = pb_istream_from_buffer(data.payload.bytes, data.payload.size);
+    if (!pb_decode(&stream, meshtastic_ChunkedPayload_fields, &chunk)) {
+        Serial.println("Chunk decode failed");
+        return false;
+    }
+
+    // Reject anything that would not fit the fixed reassembly buffer
+    if (chunk.chunk_count == 0 || chunk.chunk_count > CHUNK_MAX_CHUNKS ||
+        (size_t)chunk.chunk_count * CHUNK_DATA_SIZE > CHUNK_MAX_PAYLOAD ||
+        chunk.chunk_index >= chunk.chunk_count ||
+        chunk.payload_chunk.size == 0 || chunk.payload_chunk.size > CHUNK_DATA_SIZE ||
+        (chunk.chunk_index + 1 < chunk.chunk_count && chunk.payload_chunk.size != CHUNK_DATA_SIZE)) {
+        Serial.printf("Invalid chunk %d/%d\n", chunk.chunk_index, chunk.chunk_count);
+        return false;
+    }
+
+    if (wasCompleted(packet.from, chunk.payload_id)) {
+        // Our accept got lost - repeat it
+        duplicateChunks++;
+        sendResponse(packet.from, chunk.payload_id, true, 0);
+        return true;
+    }
+
+    ChunkReassembly* slot = findSlot(packet.from, chunk.payload_id);
+    if (slot == nullptr) {
+        slot = allocateSlot();
+        slot->active = true;
+        slot->from = packet.from;
+        slot->payloadId = chunk.payload_id;
+        slot->chunkCount = chunk.chunk_count;
+        slot->lastChunkLength = 0;
+        slot->received = 0;
+        slot->resendRequests = 0;
+        slot->startedAt = millis();
+    } else if (slot->chunkCount != chunk.chunk_count) {
+        return false;
+    }
+
+    uint32_t bit = 1UL << chunk.chunk_index;
+    if (slot->received & bit) {
+        duplicateChunks++;
+        return true;
+    }
+
+    memcpy(slot->data + (size_t)chunk.chunk_index * CHUNK_DATA_SIZE,
+           chunk.payload_chunk.bytes, chunk.payload_chunk.size);
+    slot->received |= bit;
+    if (chunk.chunk_index + 1 == chunk.chunk_count) {
+        slot->lastChunkLength = chunk.payload_chunk.size;
+    }
+    slot->lastActivity = millis();
+    slot->resendRequests = 0;
+    chunksReceived++;
+
+    if (slot->received == chunkMask(slot->chunkCount)) {
+        completeSlot(*slot);
+    }
+    return true;
+}
+
+bool ChunkedTransfer::handleResponsePacket(const meshtastic_MeshPacket& packet) {
+    uint32_t payloadId;
+    pb_size_t variant;
+    uint32_t missing;
+
+    if (!decodeResponse(packet.decoded.payload.bytes, packet.decoded.payload.size,
+                        &payloadId, &variant, &missing)) {
+        Serial.println("Chunk response decode failed");
+        return false;
+    }
+
+    if (!sending || payloadId != sendPayloadId) {
+        return false;
+    }
+    lastResponseAt = millis();
+    sendProbes = 0;
+
+    if (variant == meshtastic_ChunkedPayloadResponse_accept_transfer_tag) {
+        Serial.printf("Chunked send #%08X complete (%u chunks sent)\n", sendPayloadId, chunksSent);
+        sending = false;
+        transfersSent++;
+        payloadBytesSent += sendLength;
+    } else if (variant == meshtastic_ChunkedPayloadResponse_resend_chunks_tag) {
+        // Queue only what the receiver is missing
+        sendPending |= missing & chunkMask(sendChunkCount);
+    }
+    return true;
+}
+
+void ChunkedTransfer::update() {
+    unsigned long now = millis();
+
+    if (sending) {
+        if (sendPending && now - lastChunkSentAt >= CHUNK_SEND_INTERVAL_MS) {
+            uint16_t index = __builtin_ctz(sendPending);
+            sendPending &= ~(1UL << index);
+            sendChunk(index);
+            lastChunkSentAt = now;
+        } else if (!sendPending && now - max(lastChunkSentAt, lastResponseAt) > CHUNK_RESEND_TIMEOUT_MS &&
+                   sendProbes < CHUNK_MAX_RESEND_REQUESTS) {
+            // All sent but no accept: it was lost, or no chunk got through.
+            // The last chunk draws an accept or a resend request either way.
+            sendProbes++;
+            sendChunk(sendChunkCount - 1);
+            lastChunkSentAt = now;
+        }
+
+        if (now - lastResponseAt > CHUNK_TRANSFER_TIMEOUT_MS) {
+            Serial.printf("Chunked send #%08X timed out\n", sendPayloadId);
+            sending = false;
+            transfersFailed++;
+        }
+    }
+
+    for (int i = 0; i < CHUNK_REASSEMBLY_SLOTS; i++) {
+        ChunkReassembly& slot = slots[i];
+        if (!slot.active) {
+            continue;
+        }
+
+        if (now - slot.startedAt > CHUNK_TRANSFER_TIMEOUT_MS) {
+            Serial.printf("Chunked receive #%08X timed out\n", slot.payloadId);
+            slot.active = false;
+            transfersFailed++;
+        } else if (now - slot.lastActivity > CHUNK_RESEND_TIMEOUT_MS) {
+            if (slot.resendRequests >= CHUNK_MAX_RESEND_REQUESTS) {
+                Serial.printf("Chunked receive #%08X gave up\n", slot.payloadId);
+                slot.active = false;
+                transfersFailed++;
+                continue;
+            }
+            sendResponse(slot.from, slot.payloadId, false, missingChunks(slot));
+            slot.resendRequests++;
+            slot.lastActivity = now;
+            resendRequestsSent++;
+        }
+    }
+}
+
+ChunkReassembly* ChunkedTransfer::findSlot(uint32_t from, uint32_t payloadId) {
+    for (int i = 0; i < CHUNK_REASSEMBLY_SLOTS; i++) {
+        if (slots[i].active && slots[i].from == from && slots[i].payloadId == payloadId) {
+            return &slots[i];
+        }
+    }
+    return nullptr;
+}
+
+ChunkReassembly* ChunkedTransfer::allocateSlot() {
+    // Free slot first, otherwise evict the least recently active transfer
+    ChunkReassembly* victim = &slots[0];
+    for (int i = 0; i < CHUNK_REASSEMBLY_SLOTS; i++) {
+        if (!slots[i].active) {
+            return &slots[i];
+        }
+        if (slots[i].lastActivity < victim->lastActivity) {
+            victim = &slots[i];
+        }
+    }
+    Serial.printf("Reassembly budget full, dropping #%08X\n", victim->payloadId);
+    transfersFailed++;
+    return victim;
+}
+
+bool ChunkedTransfer::wasCompleted(uint32_t from, uint32_t payloadId) {
+    for (int i = 0; i < CHUNK_RECENT_COMPLETED; i++) {
+        if (completed[i].payloadId == payloadId && completed[i].from == from) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ChunkedTransfer::completeSlot(ChunkReassembly& slot) {
+    size_t length = (size_t)(slot.chunkCount - 1) * CHUNK_DATA_SIZE + slot.lastChunkLength;
+
+    Serial.printf("Chunked receive #%08X complete: %d bytes from 0x%08X\n",
+                  slot.payloadId, length, slot.from);
+    if (payloadCallback) {
+        payloadCallback(slot.from, slot.payloadId, slot.data, length);
+    }
+
+    completed[completedNext].from = slot.from;
+    completed[completedNext].payloadId = slot.payloadId;
+    completedNext = (completedNext + 1) % CHUNK_RECENT_COMPLETED;
+
+    sendResponse(slot.from, slot.payloadId, true, 0);
+    slot.active = false;
+    transfersReceived++;
+    payloadBytesDelivered += length;
+}
+
+uint32_t ChunkedTransfer::missingChunks(const ChunkReassembly& slot) {
+    return chunkMask(slot.chunkCount) & ~slot.received;
+}
+
+void ChunkedTransfer::printStats() {
+    Serial.println("=== Chunked Transfer Stats ===");
+    Serial.printf("Sent: %u transfers, %u chunks (%u resent)\n", transfersSent, chunksSent, chunksResent);
+    if (chunkBytesSent > 0) {
+        Serial.printf("Send goodput: %.1f%% (%u payload / %u chunk bytes)\n",
+                      100.0 * payloadBytesSent / chunkBytesSent, payloadBytesSent, chunkBytesSent);
+    }
+    Serial.printf("Received: %u transfers, %u bytes, %u chunks (%u duplicate)\n",
+                  transfersReceived, payloadBytesDelivered, chunksReceived, duplicateChunks);
+    Serial.printf("Resend requests: %u, failed transfers: %u\n", resendRequestsSent, transfersFailed);
+}
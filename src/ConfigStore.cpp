@@ -0,0 +1,276 @@
+#include "ConfigStore.h"
+#include <pb_encode.h>
+#include <pb_decode.h>
+
+// Two NVS slots: commits alternate between them
+static const char* SLOT_KEYS[2] = { "imageA", "imageB" };
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t length) {
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+ConfigStore::ConfigStore()
+    : activeSlot(1)
+    , loadMicros(0)
+    , reads(0)
+    , readMicrosTotal(0)
+    , commits(0)
+    , commitMicrosTotal(0)
+    , commitMicrosMax(0)
+    , flashBytesTotal(0) {
+}
+
+bool ConfigStore::begin() {
+    unsigned long start = micros();
+    if (!preferences.begin(CONFIG_NVS_NAMESPACE, false)) {
+        Serial.println("Config: failed to open NVS");
+        return false;
+    }
+
+    // Pick the newer of the two slots that passes its CRC
+    std::vector<uint8_t> other;
+    bool haveA = loadSlot(0, active);
+    bool haveB = loadSlot(1, other);
+    if (haveB && (!haveA || (int32_t)(((ConfigImageHeader*)other.data())->sequence -
+                                      ((ConfigImageHeader*)active.data())->sequence) > 0)) {
+        active.swap(other);
+        activeSlot = 1;
+    } else if (haveA) {
+        activeSlot = 0;
+    } else {
+        active.clear();
+    }
+    loadMicros = micros() - start;
+
+    if (active.empty()) {
+        return false;
+    }
+    const ConfigImageHeader* header = (const ConfigImageHeader*)active.data();
+    Serial.printf("Config: loaded %u byte image #%u (slot %c) in %u us\n",
+                  active.size(), header->sequence, 'A' + activeSlot, loadMicros);
+    return true;
+}
+
+bool ConfigStore::loadSlot(uint8_t slot, std::vector<uint8_t>& image) {
+    size_t length = preferences.getBytesLength(SLOT_KEYS[slot]);
+    if (length < sizeof(ConfigImageHeader) || length > CONFIG_IMAGE_MAX) {
+        return false;
+    }
+    image.resize(length);
+    if (preferences.getBytes(SLOT_KEYS[slot], image.data(), length) != length || !validate(image)) {
+        Serial.printf("Config: slot %c is invalid, ignoring\n", 'A' + slot);
+        image.clear();
+        return false;
+    }
+    return true;
+}
+
+bool ConfigStore::hasImage() {
+    return !current().empty();
+}
+
+std::vector<uint8_t>& ConfigStore::current() {
+    return pending.empty() ? active : pending;
+}
+
+size_t ConfigStore::dataStart(const std::vector<uint8_t>& image) {
+    const ConfigImageHeader* header = (const ConfigImageHeader*)image.data();
+    return sizeof(ConfigImageHeader) + header->sectionCount * sizeof(ConfigSectionEntry);
+}
+
+uint32_t ConfigStore::imageCrc(const std::vector<uint8_t>& image) {
+    ConfigImageHeader header = *(const ConfigImageHeader*)image.data();
+    header.crc32 = 0;
+    uint32_t crc = crc32Update(0, (const uint8_t*)&header, sizeof(header));
+    return crc32Update(crc, image.data() + sizeof(header), image.size() - sizeof(header));
+}
+
+bool ConfigStore::validate(const std::vector<uint8_t>& image) {
+    const ConfigImageHeader* header = (const ConfigImageHeader*)image.data();
+    if (header->magic != CONFIG_IMAGE_MAGIC || header->version != CONFIG_IMAGE_VERSION ||
+        header->length != image.size() || dataStart(image) > image.size() ||
+        header->crc32 != imageCrc(image)) {
+        return false;
+    }
+
+    const ConfigSectionEntry* table = (const ConfigSectionEntry*)(image.data() + sizeof(ConfigImageHeader));
+    size_t dataLength = image.size() - dataStart(image);
+    for (uint16_t i = 0; i < header->sectionCount; i++) {
+        if (table[i].offset + table[i].length > dataLength) {
+            return false;
+        }
+    }
+    return true;
+}
+
+ConfigSectionEntry* ConfigStore::findSection(std::vector<uint8_t>& image, ConfigMessage message,
+                                              uint8_t field, uint8_t index) {
+    if (image.empty()) {
+        return nullptr;
+    }
+    ConfigImageHeader* header = (ConfigImageHeader*)image.data();
+    ConfigSectionEntry* table = (ConfigSectionEntry*)(image.data() + sizeof(ConfigImageHeader));
+    for (uint16_t i = 0; i < header->sectionCount; i++) {
+        if (table[i].message == message && table[i].field == field && table[i].index == index) {
+            return &table[i];
+        }
+    }
+    return nullptr;
+}
+
+bool ConfigStore::read(ConfigMessage message, uint8_t field, uint8_t index, const pb_msgdesc_t* fields, void* out) {
+    unsigned long start = micros();
+    std::vector<uint8_t>& image = current();
+
+    // Only this section's bytes are decoded; a missing one yields defaults
+    const uint8_t* data = nullptr;
+    size_t length = 0;
+    const ConfigSectionEntry* entry = findSection(image, message, field, index);
+    if (entry != nullptr) {
+        data = image.data() + dataStart(image) + entry->offset;
+        length = entry->length;
+    }
+    pb_istream_t stream = pb_istream_from_buffer(data, length);
+    bool ok = pb_decode(&stream, fields, out);
+
+    reads++;
+    readMicrosTotal += micros() - start;
+    return ok;
+}
+
+bool ConfigStore::write(ConfigMessage message, uint8_t field, uint8_t index, const pb_msgdesc_t* fields, const void* in) {
+    static uint8_t encoded[CONFIG_SECTION_MAX];
+    pb_ostream_t stream = pb_ostream_from_buffer(encoded, sizeof(encoded));
+    if (!pb_encode(&stream, fields, in)) {
+        Serial.printf("Config: failed to encode section %u.%u[%u]\n", message, field, index);
+        return false;
+    }
+    size_t length = stream.bytes_written;
+
+    // Copy on first write; the committed image stays untouched until commit()
+    if (pending.empty()) {
+        if (active.empty()) {
+            ConfigImageHeader header = {};
+            header.magic = CONFIG_IMAGE_MAGIC;
+            header.version = CONFIG_IMAGE_VERSION;
+            pending.assign((const uint8_t*)&header, (const uint8_t*)&header + sizeof(header));
+        } else {
+            pending = active;
+        }
+    }
+
+    ConfigSectionEntry* entry = findSection(pending, message, field, index);
+    if (entry != nullptr && entry->length == length &&
+        memcmp(pending.data() + dataStart(pending) + entry->offset, encoded, length) == 0) {
+        return true;  // Unchanged
+    }
+    if (pending.size() + length + sizeof(ConfigSectionEntry) > CONFIG_IMAGE_MAX) {
+        Serial.println("Config: image full");
+        return false;
+    }
+
+    if (entry == nullptr) {
+        // New table entry; offsets are relative to the data, so none move
+        ConfigImageHeader* header = (ConfigImageHeader*)pending.data();
+        ConfigSectionEntry added = {};
+        added.message = message;
+        added.field = field;
+        added.index = index;
+        added.offset = pending.size() - dataStart(pending);
+        pending.insert(pending.begin() + dataStart(pending), (const uint8_t*)&added,
+                       (const uint8_t*)&added + sizeof(added));
+        header = (ConfigImageHeader*)pending.data();
+        header->sectionCount++;
+        entry = findSection(pending, message, field, index);
+    }
+
+    // Splice the new bytes over the old ones and shift later sections
+    size_t base = dataStart(pending);
+    uint16_t offset = entry->offset;
+    uint16_t oldLength = entry->length;
+    pending.erase(pending.begin() + base + offset, pending.begin() + base + offset + oldLength);
+    pending.insert(pending.begin() + base + offset, encoded, encoded + length);
+
+    ConfigImageHeader* header = (ConfigImageHeader*)pending.data();
+    ConfigSectionEntry* table = (ConfigSectionEntry*)(pending.data() + sizeof(ConfigImageHeader));
+    for (uint16_t i = 0; i < header->sectionCount; i++) {
+        ConfigSectionEntry& other = table[i];
+        if (other.message == message && other.field == field && other.index == index) {
+            other.length = length;
+        } else if (other.offset > offset || (other.offset == offset && other.length > 0)) {
+            // Empty sections may share an offset with the next one
+            other.offset = other.offset - oldLength + length;
+        }
+    }
+    return true;
+}
+
+bool ConfigStore::isDirty() {
+    return !pending.empty();
+}
+
+size_t ConfigStore::commit() {
+    if (pending.empty()) {
+        return 0;
+    }
+    unsigned long start = micros();
+
+    ConfigImageHeader* header = (ConfigImageHeader*)pending.data();
+    header->sequence = active.empty() ? 1 : ((const ConfigImageHeader*)active.data())->sequence + 1;
+    header->length = pending.size();
+    header->crc32 = imageCrc(pending);
+
+    // Never overwrite the image we would fall back to
+    uint8_t slot = activeSlot ^ 1;
+    if (preferences.putBytes(SLOT_KEYS[slot], pending.data(), pending.size()) != pending.size()) {
+        Serial.println("Config: NVS write failed");
+        return 0;
+    }
+    size_t written = pending.size();
+    active.swap(pending);
+    pending.clear();
+    pending.shrink_to_fit();
+    activeSlot = slot;
+
+    uint32_t elapsed = micros() - start;
+    commits++;
+    commitMicrosTotal += elapsed;
+    commitMicrosMax = max(commitMicrosMax, elapsed);
+    flashBytesTotal += written;
+    return written;
+}
+
+void ConfigStore::discard() {
+    pending.clear();
+    pending.shrink_to_fit();
+}
+
+size_t ConfigStore::residentBytes() {
+    return active.capacity() + pending.capacity();
+}
+
+void ConfigStore::printStats() {
+    Serial.println("=== Config Store Stats ===");
+    if (!active.empty()) {
+        const ConfigImageHeader* header = (const ConfigImageHeader*)active.data();
+        Serial.printf("Image #%u: %u bytes, %u sections, slot %c, loaded in %u us\n",
+                      header->sequence, active.size(), header->sectionCount, 'A' + activeSlot, loadMicros);
+    }
+    Serial.printf("RAM: %u bytes (%u pending) vs %u decoded\n", residentBytes(),
+                  pending.capacity(), sizeof(meshtastic_LocalConfig) + sizeof(meshtastic_LocalModuleConfig) +
+                  sizeof(meshtastic_ChannelFile) + sizeof(meshtastic_User));
+    if (reads > 0) {
+        Serial.printf("Section reads: %u, %u us avg\n", reads, readMicrosTotal / reads);
+    }
+    if (commits > 0) {
+        Serial.printf("Commits: %u, %u us avg, %u us max, %u flash bytes per commit\n",
+                      commits, commitMicrosTotal / commits, commitMicrosMax, flashBytesTotal / commits);
+    }
+}
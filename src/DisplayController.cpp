@@ -1,4 +1,5 @@
 #include "DisplayController.h"
+#include "Utf8Text.h"
 #include <Wire.h>
 
 // Board-defined pins from heltec_wifi_kit_32_V3 variant
@@ -16,6 +17,8 @@
 #define RST_OLED 21
 #endif
 
+#define FRAME_FRESH 0x80
+
 DisplayController::DisplayController() 
     : u8g2(U8G2_R0, /* reset=*/ RST_OLED) {
     currentStatus = "Starting...";
@@ -23,6 +26,36 @@ DisplayController::DisplayController()
     sleeping = false;
     batteryLevel = 100;
     isCharging = false;
+    framesBuilt = 0;
+    frameMicrosTotal = 0;
+    frameMicrosMax = 0;
+    conversation = -1;
+    conversationId = 0;
+    anchorSeq = 0;
+    detailSeq = 0;
+    detailLine = 0;
+    listTop = 0;
+    readySlot = 1;
+    backSlot = 0;
+    frontSlot = 2;
+    powerRequest = -1;
+    contrastRequest = -1;
+    power = POWER_FULL;
+    redrawPending = false;
+    lastActivity = 0;
+    lastPowerUpdate = 0;
+    memset(powerMillis, 0, sizeof(powerMillis));
+    flushTaskHandle = nullptr;
+    panelValid = false;
+    framesQueued = 0;
+    framesDropped = 0;
+    framesFlushed = 0;
+    stallMicrosTotal = 0;
+    stallMicrosMax = 0;
+    flushMicrosTotal = 0;
+    pagesSent = 0;
+    pagesSkipped = 0;
+    i2cBytes = 0;
 }
 
 bool DisplayController::begin() {
@@ -53,51 +86,206 @@ bool DisplayController::begin() {
     Serial.println("Test pattern sent to display");
     delay(2000);
     
+    // Glyph widths for message wrapping, measured once
+    layout.begin(u8g2, u8g2_font_5x7_tf);
+    
     u8g2.setFont(u8g2_font_6x10_tf);
     u8g2.setFontRefHeightExtendedText();
     u8g2.setDrawColor(1);
     u8g2.setFontPosTop();
     u8g2.setFontDirection(0);
     
+    // From here on, only the flush task talks to the panel
+    if (xTaskCreatePinnedToCore(flushTask, "display", 3072, this, 2, &flushTaskHandle, 1) != pdPASS) {
+        Serial.println("Failed to start display task");
+        return false;
+    }
+    
     displayEnabled = true;
+    lastActivity = millis();
+    lastPowerUpdate = lastActivity;
     showStartup();
     
     Serial.println("Display initialized successfully!");
     return true;
 }
 
-void DisplayController::drawHeader() {
+// Draw UTF-8 text in the current font, one glyph per code point (the
+// fonts have no glyphs past Latin-1; see Utf8Text for the fallbacks)
+void DisplayController::drawText(int x, int y, const char* text, bool rightAlign) {
+    char glyphs[LAYOUT_MAX_LINE_CHARS + 1];
+    Utf8Text::toGlyphs(text, strlen(text), glyphs, sizeof(glyphs));
+    if (rightAlign) {
+        x -= u8g2.getStrWidth(glyphs);
+    }
+    u8g2.drawStr(x, y, glyphs);
+}
+
+void DisplayController::drawHeader(const char* title) {
     u8g2.setFont(u8g2_font_6x10_tf);
-    u8g2.drawStr(0, 0, currentStatus.c_str());
+    drawText(0, 0, title != nullptr ? title : currentStatus.c_str());
     
     // Draw battery percentage and charging icon in upper right
     String batteryStr = String(batteryLevel) + "%";
     if (isCharging) {
         batteryStr = "⚡" + batteryStr;  // Lightning bolt for charging
     }
-    int batteryWidth = u8g2.getStrWidth(batteryStr.c_str());
-    u8g2.drawStr(128 - batteryWidth, 0, batteryStr.c_str());
+    drawText(128, 0, batteryStr.c_str(), true);
     
     u8g2.drawLine(0, 10, 128, 10);
 }
 
+// One-pixel bar on the right edge of the message area
+void DisplayController::drawScrollbar(int first, int visible, int total) {
+    if (total <= visible) {
+        return;
+    }
+    const int height = 64 - MESSAGE_AREA_TOP;
+    int thumb = max(height * visible / total, 3);
+    int y = MESSAGE_AREA_TOP + (height - thumb) * min(first, total - visible) / (total - visible);
+    u8g2.drawVLine(127, y, thumb);
+}
+
+// Hand the drawn frame to the flush task without waiting for the bus
+void DisplayController::sendFrame() {
+    unsigned long start = micros();
+    memcpy(frames[backSlot], u8g2.getBufferPtr(), DISPLAY_FRAME_SIZE);
+    uint8_t previous = readySlot.exchange(backSlot | FRAME_FRESH);
+    if (previous & FRAME_FRESH) {
+        framesDropped++;
+    }
+    backSlot = previous & ~FRAME_FRESH;
+    framesQueued++;
+    if (flushTaskHandle) {
+        xTaskNotifyGive(flushTaskHandle);
+    }
+    
+    uint32_t elapsed = micros() - start;
+    stallMicrosTotal += elapsed;
+    stallMicrosMax = max(stallMicrosMax, elapsed);
+}
+
+void DisplayController::setPowerSave(uint8_t level) {
+    powerRequest = level;
+    if (flushTaskHandle) {
+        xTaskNotifyGive(flushTaskHandle);
+    }
+}
+
+void DisplayController::setContrast(uint8_t level) {
+    contrastRequest = level;
+    if (flushTaskHandle) {
+        xTaskNotifyGive(flushTaskHandle);
+    }
+}
+
+// Send the pages (8-pixel rows) of a frame that differ from the panel
+void DisplayController::flushFrame(const uint8_t* frame) {
+    unsigned long start = micros();
+    const uint8_t tileWidth = 128 / 8;
+    const size_t pageBytes = tileWidth * 8;
+    
+    for (uint8_t page = 0; page < DISPLAY_PAGES; page++) {
+        const uint8_t* row = frame + page * pageBytes;
+        uint8_t* shown = panelFrame + page * pageBytes;
+        if (panelValid && memcmp(row, shown, pageBytes) == 0) {
+            pagesSkipped++;
+            continue;
+        }
+        memcpy(shown, row, pageBytes);
+        u8x8_DrawTile(u8g2.getU8x8(), 0, page, tileWidth, shown);
+        pagesSent++;
+        i2cBytes += pageBytes + I2C_PAGE_OVERHEAD;
+    }
+    panelValid = true;
+    framesFlushed++;
+    flushMicrosTotal += micros() - start;
+}
+
+void DisplayController::flushTask(void* param) {
+    DisplayController* self = static_cast<DisplayController*>(param);
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        
+        // Wake before drawing, blank before sleeping
+        int8_t power = self->powerRequest.exchange(-1);
+        if (power == 0) {
+            u8x8_SetPowerSave(self->u8g2.getU8x8(), 0);
+        }
+        int16_t contrast = self->contrastRequest.exchange(-1);
+        if (contrast >= 0) {
+            u8x8_SetContrast(self->u8g2.getU8x8(), contrast);
+        }
+        if (self->readySlot.load() & FRAME_FRESH) {
+            self->frontSlot = self->readySlot.exchange(self->frontSlot) & ~FRAME_FRESH;
+            self->flushFrame(self->frames[self->frontSlot]);
+        }
+        if (power > 0) {
+            u8x8_SetPowerSave(self->u8g2.getU8x8(), power);
+        }
+    }
+}
+
 void DisplayController::clear() {
     u8g2.clearBuffer();
-    u8g2.sendBuffer();
+    sendFrame();
+}
+
+void DisplayController::update() {
+    unsigned long now = millis();
+    powerMillis[sleeping ? POWER_OFF : power] += now - lastPowerUpdate;
+    lastPowerUpdate = now;
+    if (!displayEnabled || sleeping) {
+        return;
+    }
+    
+    unsigned long idle = now - lastActivity;
+    if (power == POWER_FULL && idle > DISPLAY_DIM_TIMEOUT) {
+        setContrast(DISPLAY_CONTRAST_DIM);
+        power = POWER_DIM;
+    } else if (power == POWER_DIM && idle > DISPLAY_OFF_TIMEOUT) {
+        // Panel RAM is kept, so waking shows the last frame at once
+        setPowerSave(1);
+        power = POWER_OFF;
+    }
+}
+
+bool DisplayController::activity() {
+    lastActivity = millis();
+    if (sleeping || power == POWER_FULL) {
+        return false;
+    }
+    bool wasOff = power == POWER_OFF;
+    if (wasOff) {
+        setPowerSave(0);
+    }
+    setContrast(DISPLAY_CONTRAST_FULL);
+    power = POWER_FULL;
+    redrawPending = true;
+    return wasOff;
+}
+
+bool DisplayController::needsRedraw() {
+    return redrawPending;
 }
 
 void DisplayController::sleep() {
     if (!sleeping) {
         u8g2.clearBuffer();
-        u8g2.sendBuffer();
-        u8g2.setPowerSave(1);  // Turn off display
+        sendFrame();
+        setPowerSave(1);  // Turn off display
         sleeping = true;
     }
 }
 
 void DisplayController::wake() {
     if (sleeping) {
-        u8g2.setPowerSave(0);  // Turn on display
+        setPowerSave(0);  // Turn on display
+        if (power != POWER_FULL) {
+            setContrast(DISPLAY_CONTRAST_FULL);
+            power = POWER_FULL;
+        }
+        lastActivity = millis();
         sleeping = false;
     }
 }
@@ -117,7 +305,7 @@ void DisplayController::showStartup() {
     w = u8g2.getStrWidth("LoRA/BLE Controller");
     u8g2.drawStr((128 - w) / 2, 40, "LoRA/BLE Controller");
     
-    u8g2.sendBuffer();
+    sendFrame();
 }
 
 void DisplayController::showScanning() {
@@ -129,7 +317,7 @@ void DisplayController::showScanning() {
     u8g2.drawStr(10, 30, "Searching for");
     u8g2.drawStr(10, 42, "Meshtastic devices");
     
-    u8g2.sendBuffer();
+    sendFrame();
 }
 
 void DisplayController::showConnecting(const String& deviceName) {
@@ -139,9 +327,9 @@ void DisplayController::showConnecting(const String& deviceName) {
     
     u8g2.setFont(u8g2_font_6x10_tf);
     u8g2.drawStr(10, 20, "Connecting to:");
-    u8g2.drawStr(10, 32, deviceName.c_str());
+    drawText(10, 32, deviceName.c_str());
     
-    u8g2.sendBuffer();
+    sendFrame();
 }
 
 void DisplayController::showConnected(const String& deviceName) {
@@ -151,10 +339,10 @@ void DisplayController::showConnected(const String& deviceName) {
     
     u8g2.setFont(u8g2_font_6x10_tf);
     u8g2.drawStr(10, 20, "Connected!");
-    u8g2.drawStr(10, 32, deviceName.c_str());
+    drawText(10, 32, deviceName.c_str());
     u8g2.drawStr(10, 50, "Waiting for msgs...");
     
-    u8g2.sendBuffer();
+    sendFrame();
 }
 
 void DisplayController::showDisconnected() {
@@ -166,7 +354,7 @@ void DisplayController::showDisconnected() {
     u8g2.drawStr(10, 30, "Disconnected");
     u8g2.drawStr(10, 42, "Retrying...");
     
-    u8g2.sendBuffer();
+    sendFrame();
 }
 
 void DisplayController::showKeyStatus(bool hasKeys) {
@@ -182,54 +370,373 @@ void DisplayController::showKeyStatus(bool hasKeys) {
         u8g2.drawStr(10, 32, "Import keys first");
     }
     
-    u8g2.sendBuffer();
+    sendFrame();
 }
 
-void DisplayController::drawMessage(int y, const String& sender, const String& text, bool isOwn) {
+const LayoutLines& DisplayController::layoutMessage(const Message& msg) {
+    // The first line starts after "<sender>: "
+    uint8_t indent = layout.width(msg.sender.c_str(), msg.sender.length()) + layout.width(": ", 2);
+    return layout.lines(msg.slot, msg.id, msg.text.c_str(), msg.text.length(), 126, indent);
+}
+
+// Draw lines [firstLine, endLine) of a message from y. If more lines follow,
+// the last one drawn ends in "...".
+void DisplayController::drawMessage(int y, const Message& msg, const LayoutLines& lines,
+                                    uint8_t firstLine, uint8_t endLine) {
     u8g2.setFont(u8g2_font_5x7_tf);
-    
-    // Draw sender
-    String prefix = isOwn ? "You: " : sender + ": ";
-    u8g2.drawStr(2, y, prefix.c_str());
-    
-    // Draw message text (truncate if needed)
-    String displayText = text;
-    if (displayText.length() > 20) {
-        displayText = displayText.substring(0, 17) + "...";
+    int x = 2;
+    if (firstLine == 0) {
+        drawText(x, y, msg.sender.c_str());
+        x += layout.width(msg.sender.c_str(), msg.sender.length());
+        u8g2.drawStr(x, y, ":");
+        x += layout.width(": ", 2);
+    }
+    for (uint8_t line = firstLine; line < endLine; line++) {
+        uint8_t clipWidth = (line == endLine - 1 && endLine < lines.count) ? 128 - x : 0;
+        layout.drawLine(u8g2, x, y, msg.text.c_str(), lines, line, clipWidth);
+        x = 2;
+        y += MESSAGE_FONT_HEIGHT;
     }
-    u8g2.drawStr(2, y + 9, displayText.c_str());
 }
 
-void DisplayController::showMessages(MessageHandler& messageHandler) {
+// Reaction counts, right-aligned on their own row: "👍2 ❤1"
+void DisplayController::drawReactions(int y, const Message& msg) {
+    char text[MAX_REACTIONS * (REACTION_SIZE + 4) + 1];
+    size_t length = 0;
+    for (uint8_t i = 0; i < msg.reactionCount; i++) {
+        length += snprintf(text + length, sizeof(text) - length, "%s%s%u",
+                           i > 0 ? " " : "", msg.reactions[i].emoji, msg.reactions[i].count);
+    }
+    u8g2.setFont(u8g2_font_5x7_tf);
+    drawText(126, y, text, true);
+}
+
+// Rows a message takes in the list: up to MESSAGE_LIST_LINES of text,
+// plus one for reactions
+uint8_t DisplayController::listRows(const Message& msg, const LayoutLines& lines) {
+    return constrain((int)lines.count, 1, MESSAGE_LIST_LINES) + (msg.reactionCount > 0 ? 1 : 0);
+}
+
+// Rows of the detail view: every line, plus one for reactions
+uint8_t DisplayController::detailRows(const Message& msg, const LayoutLines& lines) {
+    return lines.count + (msg.reactionCount > 0 ? 1 : 0);
+}
+
+// The conversation on screen: the one picked with the button while it
+// still exists, else the most recently active one
+int DisplayController::currentConversation(MessageHandler& messageHandler) {
+    if (messageHandler.getConversationCount() == 0) {
+        return -1;
+    }
+    if (conversation < 0 || conversation >= messageHandler.getConversationCount() ||
+        messageHandler.getConversation(conversation).id != conversationId) {
+        conversation = messageHandler.conversationAt(0);
+        conversationId = messageHandler.getConversation(conversation).id;
+        anchorSeq = 0;
+        detailSeq = 0;
+    }
+    return conversation;
+}
+
+// Conversation label, with the unread count of the others: "C0 +3"
+void DisplayController::drawConversationHeader(MessageHandler& messageHandler, int conv) {
+    char title[24];
+    messageHandler.conversationLabel(conv, title, sizeof(title));
+    int unread = 0;
+    for (int i = 0; i < messageHandler.getConversationCount(); i++) {
+        if (i != conv) {
+            unread += messageHandler.getConversation(i).unread;
+        }
+    }
+    if (unread > 0) {
+        size_t length = strlen(title);
+        snprintf(title + length, sizeof(title) - length, " +%d", unread);
+    }
+    drawHeader(title);
+}
+
+// Position of a message in the conversation, -1 if it has been dropped.
+// Sequence numbers are consecutive, so this is arithmetic, not a search.
+int DisplayController::messageIndex(MessageHandler& messageHandler, int conv, uint32_t seq) {
+    int msgCount = messageHandler.getConversation(conv).count;
+    if (msgCount == 0) {
+        return -1;
+    }
+    uint32_t oldest = messageHandler.conversationMessage(conv, 0).seq;
+    if (seq < oldest || seq - oldest >= (uint32_t)msgCount) {
+        return -1;
+    }
+    return seq - oldest;
+}
+
+// Messages up to the anchor, bottom-aligned; the top one may be cut. Only
+// the messages on screen are visited, using their cached line counts.
+void DisplayController::buildMessages(MessageHandler& messageHandler, int conv) {
+    unsigned long start = micros();
     u8g2.clearBuffer();
-    drawHeader();
     
-    int msgCount = messageHandler.getMessageCount();
+    int msgCount = conv >= 0 ? messageHandler.getConversation(conv).count : 0;
     if (msgCount == 0) {
+        drawHeader();
         u8g2.setFont(u8g2_font_6x10_tf);
         u8g2.drawStr(10, 30, "No messages yet");
-        u8g2.sendBuffer();
         return;
     }
+    drawConversationHeader(messageHandler, conv);
+    
+    int last = msgCount - 1;
+    if (anchorSeq != 0) {
+        // A scrolled-to message that has been dropped pins the oldest
+        int index = messageIndex(messageHandler, conv, anchorSeq);
+        last = index >= 0 ? index : 0;
+    }
     
-    // Show last 2-3 messages
-    int y = 14;
-    int startIdx = max(0, msgCount - 2);
+    const int screenLines = (64 - MESSAGE_AREA_TOP) / MESSAGE_FONT_HEIGHT;
+    int linesUsed = 0;
+    int first = last + 1;
+    while (first > 0 && linesUsed < screenLines) {
+        first--;
+        const Message& msg = messageHandler.conversationMessage(conv, first);
+        linesUsed += listRows(msg, layoutMessage(msg));
+    }
+    listTop = first;
     
-    for (int i = startIdx; i < msgCount && y < 60; i++) {
-        Message msg = messageHandler.getMessage(i);
-        drawMessage(y, msg.sender, msg.text, msg.isOwn);
-        y += 20;
+    int y = MESSAGE_AREA_TOP;
+    for (int i = first; i <= last; i++) {
+        const Message& msg = messageHandler.conversationMessage(conv, i);
+        const LayoutLines& lines = layoutMessage(msg);
+        uint8_t shown = min(lines.count, (uint8_t)MESSAGE_LIST_LINES);
+        uint8_t rows = listRows(msg, lines);
+        uint8_t skip = 0;
+        if (i == first && linesUsed > screenLines) {
+            skip = linesUsed - screenLines;
+        }
+        drawMessage(y, msg, lines, skip, shown);
+        if (msg.reactionCount > 0) {
+            drawReactions(y + (rows - 1 - skip) * MESSAGE_FONT_HEIGHT, msg);
+        }
+        y += (rows - skip) * MESSAGE_FONT_HEIGHT;
     }
+    drawScrollbar(first, last - first + 1, msgCount);
     
-    u8g2.sendBuffer();
+    uint32_t elapsed = micros() - start;
+    framesBuilt++;
+    frameMicrosTotal += elapsed;
+    frameMicrosMax = max(frameMicrosMax, elapsed);
+}
+
+// One message with all of its lines, from detailLine
+void DisplayController::buildDetail(MessageHandler& messageHandler, int conv, int index) {
+    u8g2.clearBuffer();
+    drawConversationHeader(messageHandler, conv);
+    
+    const int screenLines = (64 - MESSAGE_AREA_TOP) / MESSAGE_FONT_HEIGHT;
+    const Message& msg = messageHandler.conversationMessage(conv, index);
+    const LayoutLines& lines = layoutMessage(msg);
+    uint8_t endLine = min((int)lines.count, detailLine + screenLines);
+    drawMessage(MESSAGE_AREA_TOP, msg, lines, detailLine, endLine);
+    if (msg.reactionCount > 0 && lines.count - detailLine < screenLines) {
+        drawReactions(MESSAGE_AREA_TOP + (lines.count - detailLine) * MESSAGE_FONT_HEIGHT, msg);
+    }
+    drawScrollbar(detailLine, screenLines, detailRows(msg, lines));
+}
+
+void DisplayController::showMessages(MessageHandler& messageHandler) {
+    redrawPending = false;
+    int conv = currentConversation(messageHandler);
+    int index = conv >= 0 && detailSeq != 0 ? messageIndex(messageHandler, conv, detailSeq) : -1;
+    if (index >= 0) {
+        buildDetail(messageHandler, conv, index);
+    } else {
+        detailSeq = 0;
+        buildMessages(messageHandler, conv);
+    }
+    if (conv >= 0) {
+        messageHandler.markRead(conv);
+    }
+    sendFrame();
+}
+
+void DisplayController::scrollMessages(MessageHandler& messageHandler) {
+    int conv = currentConversation(messageHandler);
+    int index = conv >= 0 && detailSeq != 0 ? messageIndex(messageHandler, conv, detailSeq) : -1;
+    if (index >= 0) {
+        // Page down, keeping the last line of the previous page on screen
+        const int screenLines = (64 - MESSAGE_AREA_TOP) / MESSAGE_FONT_HEIGHT;
+        const Message& msg = messageHandler.conversationMessage(conv, index);
+        detailLine += screenLines - 1;
+        if (detailLine + 1 >= detailRows(msg, layoutMessage(msg))) {
+            detailLine = 0;
+        }
+    } else if (conv < 0 || listTop == 0) {
+        anchorSeq = 0;
+    } else {
+        // The message above the current bottom one becomes the bottom
+        int last = anchorSeq != 0 ? messageIndex(messageHandler, conv, anchorSeq)
+                                  : messageHandler.getConversation(conv).count - 1;
+        anchorSeq = messageHandler.conversationMessage(conv, max(last - 1, 0)).seq;
+    }
+    showMessages(messageHandler);
+}
+
+void DisplayController::toggleDetail(MessageHandler& messageHandler) {
+    int conv = currentConversation(messageHandler);
+    if (detailSeq != 0) {
+        detailSeq = 0;
+    } else if (conv >= 0 && messageHandler.getConversation(conv).count > 0) {
+        int index = anchorSeq != 0 ? messageIndex(messageHandler, conv, anchorSeq)
+                                   : messageHandler.getConversation(conv).count - 1;
+        detailSeq = messageHandler.conversationMessage(conv, max(index, 0)).seq;
+        detailLine = 0;
+    }
+    showMessages(messageHandler);
+}
+
+void DisplayController::nextConversation(MessageHandler& messageHandler) {
+    int conv = currentConversation(messageHandler);
+    if (conv >= 0) {
+        // Table order rather than recency, so repeated presses visit each once
+        conversation = (conv + 1) % messageHandler.getConversationCount();
+        conversationId = messageHandler.getConversation(conversation).id;
+        anchorSeq = 0;
+        detailSeq = 0;
+    }
+    showMessages(messageHandler);
+}
+
+void DisplayController::printStats() {
+    Serial.println("=== Display Stats ===");
+    if (framesBuilt > 0) {
+        Serial.printf("Message frames: %u, build %u us avg, %u us max\n",
+                      framesBuilt, frameMicrosTotal / framesBuilt, frameMicrosMax);
+    }
+    if (framesQueued > 0) {
+        Serial.printf("Frames: %u queued, %u dropped, %u flushed\n", framesQueued, framesDropped, framesFlushed);
+        Serial.printf("Handoff: %u us avg, %u us max (loop stall)\n",
+                      stallMicrosTotal / framesQueued, stallMicrosMax);
+    }
+    if (framesFlushed > 0) {
+        Serial.printf("Flush: %u us avg on the bus\n", flushMicrosTotal / framesFlushed);
+    }
+    if (framesFlushed > 0) {
+        Serial.printf("I2C: %u bytes, %u avg per frame (full frame %u)\n", i2cBytes, i2cBytes / framesFlushed,
+                      DISPLAY_PAGES * (DISPLAY_FRAME_SIZE / DISPLAY_PAGES + I2C_PAGE_OVERHEAD));
+    }
+    uint32_t pages = pagesSent + pagesSkipped;
+    if (pages > 0) {
+        Serial.printf("Pages: %u sent, %u unchanged (%u%% skipped)\n",
+                      pagesSent, pagesSkipped, pagesSkipped * 100 / pages);
+    }
+    uint32_t totalMillis = powerMillis[POWER_FULL] + powerMillis[POWER_DIM] + powerMillis[POWER_OFF];
+    if (totalMillis > 0) {
+        Serial.printf("Panel: %u s full, %u s dim, %u s off (%u%% on)\n",
+                      powerMillis[POWER_FULL] / 1000, powerMillis[POWER_DIM] / 1000, powerMillis[POWER_OFF] / 1000,
+                      (uint32_t)((uint64_t)(powerMillis[POWER_FULL] + powerMillis[POWER_DIM]) * 100 / totalMillis));
+        // Against staying at full contrast, at this duty cycle for a day
+        uint64_t savedMicroAmpMillis = (uint64_t)powerMillis[POWER_DIM] * (OLED_FULL_UA - OLED_DIM_UA)
+                                     + (uint64_t)powerMillis[POWER_OFF] * (OLED_FULL_UA - OLED_OFF_UA);
+        float savedMah = (float)savedMicroAmpMillis / totalMillis * 24.0f / 1000.0f;
+        Serial.printf("Panel: ~%.1f mAh/day saved\n", savedMah);
+    }
+    layout.printStats();
 }
 
 void DisplayController::showMessage(const Message& msg) {
     u8g2.clearBuffer();
     drawHeader();
-    drawMessage(14, msg.sender, msg.text, msg.isOwn);
-    u8g2.sendBuffer();
+    const LayoutLines& lines = layoutMessage(msg);
+    const int screenLines = (64 - MESSAGE_AREA_TOP) / MESSAGE_FONT_HEIGHT;
+    drawMessage(MESSAGE_AREA_TOP, msg, lines, 0, min((int)lines.count, screenLines));
+    sendFrame();
+}
+
+void DisplayController::showTelemetry(TelemetryStore& telemetry, uint32_t node, uint32_t windowSeconds) {
+    redrawPending = false;
+    char title[24];
+    if (windowSeconds % 3600 == 0) {
+        snprintf(title, sizeof(title), "%08X %uh", node, windowSeconds / 3600);
+    } else {
+        snprintf(title, sizeof(title), "%08X %um", node, windowSeconds / 60);
+    }
+    u8g2.clearBuffer();
+    drawHeader(title);
+    
+    u8g2.setFont(u8g2_font_5x7_tf);
+    int y = MESSAGE_AREA_TOP + MESSAGE_FONT_HEIGHT;
+    for (uint8_t metric = 0; metric < METRIC_COUNT && y + MESSAGE_FONT_HEIGHT <= 64; metric++) {
+        TelemetrySummary summary;
+        if (!telemetry.query(node, (TelemetryMetric)metric, windowSeconds, &summary)) {
+            continue;
+        }
+        drawText(2, y, TelemetryStore::metricName((TelemetryMetric)metric));
+        float values[] = { summary.min, summary.avg, summary.max };
+        for (int i = 0; i < 3; i++) {
+            char value[12];
+            TelemetryStore::formatValue((TelemetryMetric)metric, values[i], value, sizeof(value), false);
+            drawText(126 - (2 - i) * TELEMETRY_COLUMN_WIDTH, y, value, true);
+        }
+        y += MESSAGE_FONT_HEIGHT;
+    }
+    if (y == MESSAGE_AREA_TOP + MESSAGE_FONT_HEIGHT) {
+        u8g2.setFont(u8g2_font_6x10_tf);
+        u8g2.drawStr(10, 30, "No telemetry yet");
+    } else {
+        const char* columns[] = { "min", "avg", "max" };
+        for (int i = 0; i < 3; i++) {
+            drawText(126 - (2 - i) * TELEMETRY_COLUMN_WIDTH, MESSAGE_AREA_TOP, columns[i], true);
+        }
+    }
+    
+    sendFrame();
+}
+
+void DisplayController::showNearby(PositionStore& positions, uint32_t node) {
+    redrawPending = false;
+    u8g2.clearBuffer();
+    drawHeader("Nearby");
+    
+    const PositionRecord* origin = positions.getPosition(node);
+    if (origin == nullptr) {
+        u8g2.setFont(u8g2_font_6x10_tf);
+        u8g2.drawStr(10, 30, "No position yet");
+        u8g2.drawStr(10, 42, "Share phone GPS");
+        sendFrame();
+        return;
+    }
+    
+    // One extra: the node itself comes back at 0 km
+    PositionResult results[NEARBY_ROWS + 1];
+    size_t found = positions.nearest(origin->latitude_i, origin->longitude_i, results, NEARBY_ROWS + 1);
+    uint32_t now = millis() / 1000;
+    u8g2.setFont(u8g2_font_5x7_tf);
+    int y = MESSAGE_AREA_TOP;
+    for (size_t i = 0; i < found && y + MESSAGE_FONT_HEIGHT <= 64; i++) {
+        if (results[i].node == node) {
+            continue;
+        }
+        char text[16];
+        snprintf(text, sizeof(text), "%08X", results[i].node);
+        drawText(2, y, text);
+        snprintf(text, sizeof(text), "%.1fkm", results[i].distanceKm);
+        drawText(96, y, text, true);
+        
+        uint32_t age = now - positions.getPosition(results[i].node)->heardAt;
+        if (age < 60) {
+            snprintf(text, sizeof(text), "%us", age);
+        } else if (age < 3600) {
+            snprintf(text, sizeof(text), "%um", age / 60);
+        } else {
+            snprintf(text, sizeof(text), "%uh", age / 3600);
+        }
+        drawText(126, y, text, true);
+        y += MESSAGE_FONT_HEIGHT;
+    }
+    if (y == MESSAGE_AREA_TOP) {
+        u8g2.setFont(u8g2_font_6x10_tf);
+        u8g2.drawStr(10, 30, "No nodes heard");
+    }
+    
+    sendFrame();
 }
 
 void DisplayController::showLatestMessage(const Message& msg) {
@@ -238,31 +745,22 @@ void DisplayController::showLatestMessage(const Message& msg) {
 }
 
 void DisplayController::updateStatus(const String& status) {
-    currentStatus = status;
+    if (status != currentStatus) {
+        currentStatus = status;
+        redrawPending = true;
+    }
 }
 
 void DisplayController::updateBatteryLevel(uint8_t level) {
-    batteryLevel = level;
+    if (level != batteryLevel) {
+        batteryLevel = level;
+        redrawPending = true;
+    }
 }
 
 void DisplayController::updateChargingStatus(bool charging) {
-    isCharging = charging;
-}
-
-int DisplayController::wrapText(const String& text, int maxWidth, String* lines, int maxLines) {
-    // Simple text wrapping helper (can be enhanced)
-    int lineCount = 0;
-    String remaining = text;
-    
-    while (remaining.length() > 0 && lineCount < maxLines) {
-        if (remaining.length() <= 20) {
-            lines[lineCount++] = remaining;
-            break;
-        }
-        
-        lines[lineCount++] = remaining.substring(0, 20);
-        remaining = remaining.substring(20);
+    if (charging != isCharging) {
+        isCharging = charging;
+        redrawPending = true;
     }
-    
-    return lineCount;
 }
@@ -0,0 +1,109 @@
+#include "FromRadioQueue.h"
+
+FromRadioQueue::FromRadioQueue()
+    : head(0)
+    , count(0)
+    , nextId(1)
+    , overruns(0) {
+}
+
+uint32_t FromRadioQueue::push(const uint8_t* data, size_t length, uint8_t refs) {
+    if (data == nullptr || length == 0 || length > FROMRADIO_MAX_FRAME) {
+        return 0;
+    }
+
+    uint8_t slot;
+    if (count < FROMRADIO_QUEUE_DEPTH) {
+        slot = (head + count) % FROMRADIO_QUEUE_DEPTH;
+        count++;
+    } else {
+        // Full - overwrite the oldest frame, slow sessions will skip it
+        slot = head;
+        head = (head + 1) % FROMRADIO_QUEUE_DEPTH;
+        if (frames[slot].refs > 0) {
+            overruns++;
+        }
+    }
+
+    FromRadioFrame& frame = frames[slot];
+    frame.id = nextId++;
+    frame.length = length;
+    frame.refs = refs;
+    frame.queuedAt = millis();
+    memcpy(frame.data, data, length);
+
+    return frame.id;
+}
+
+const FromRadioFrame* FromRadioQueue::next(uint32_t afterId) const {
+    if (count == 0) {
+        return nullptr;
+    }
+
+    uint32_t oldest = oldestId();
+    uint32_t wanted = afterId + 1;
+    if (wanted < oldest) {
+        // Client fell behind the ring - resume from the oldest we still have
+        wanted = oldest;
+    }
+    if (wanted > lastId()) {
+        return nullptr;
+    }
+
+    uint8_t slot = (head + (wanted - oldest)) % FROMRADIO_QUEUE_DEPTH;
+    return &frames[slot];
+}
+
+void FromRadioQueue::retain(uint32_t afterId, uint32_t upToId) {
+    uint32_t id = max(afterId + 1, oldestId());
+    upToId = min(upToId, lastId());
+    for (; id <= upToId; id++) {
+        frameAt(id).refs++;
+    }
+}
+
+void FromRadioQueue::release(uint32_t afterId, uint32_t upToId) {
+    uint32_t id = max(afterId + 1, oldestId());
+    upToId = min(upToId, lastId());
+    for (; id <= upToId; id++) {
+        FromRadioFrame& frame = frameAt(id);
+        if (frame.refs > 0) {
+            frame.refs--;
+        }
+    }
+    trim();
+}
+
+void FromRadioQueue::expire() {
+    trim();
+}
+
+uint32_t FromRadioQueue::lastId() const {
+    return nextId - 1;
+}
+
+uint32_t FromRadioQueue::oldestId() const {
+    return nextId - count;
+}
+
+size_t FromRadioQueue::size() const {
+    return count;
+}
+
+uint32_t FromRadioQueue::getOverruns() const {
+    return overruns;
+}
+
+FromRadioFrame& FromRadioQueue::frameAt(uint32_t id) {
+    return frames[(head + (id - oldestId())) % FROMRADIO_QUEUE_DEPTH];
+}
+
+void FromRadioQueue::trim() {
+    // Reclaim frames every session has consumed, once nobody returning
+    // within the resume window could still ask for them
+    unsigned long now = millis();
+    while (count > 0 && frames[head].refs == 0 && now - frames[head].queuedAt > FROMRADIO_KEEP_MS) {
+        head = (head + 1) % FROMRADIO_QUEUE_DEPTH;
+        count--;
+    }
+}
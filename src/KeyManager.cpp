@@ -85,17 +85,52 @@ void KeyManager::clearKeys() {
     Serial.println("Keys cleared");
 }
 
+// Keys are stored as entered: 64 hex digits, or base64 as shown by the
+// Meshtastic apps. Returns the number of bytes decoded (0 if invalid).
+size_t KeyManager::decodeKey(const String& key, uint8_t* buffer, size_t maxLen) {
+    size_t length = key.length();
+    const char* text = key.c_str();
+
+    bool hex = length % 2 == 0 && length / 2 <= maxLen;
+    for (size_t i = 0; hex && i < length; i++) {
+        hex = isxdigit((unsigned char)text[i]);
+    }
+    if (hex) {
+        for (size_t i = 0; i < length / 2; i++) {
+            char byte[3] = { text[2 * i], text[2 * i + 1], 0 };
+            buffer[i] = strtoul(byte, nullptr, 16);
+        }
+        return length / 2;
+    }
+
+    static const char* ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uint32_t bits = 0;
+    int bitCount = 0;
+    size_t written = 0;
+    for (size_t i = 0; i < length && text[i] != '='; i++) {
+        const char* found = strchr(ALPHABET, text[i]);
+        if (found == nullptr || text[i] == 0) {
+            return 0;
+        }
+        bits = (bits << 6) | (found - ALPHABET);
+        bitCount += 6;
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            if (written == maxLen) {
+                return 0;
+            }
+            buffer[written++] = bits >> bitCount;
+        }
+    }
+    return written;
+}
+
 bool KeyManager::getPrivateKeyRaw(uint8_t* buffer, size_t maxLen) {
     String key = getPrivateKey();
     if (key.length() == 0) {
         return false;
     }
-    
-    // Store the key bytes (assumes hex or base64 string)
-    // This is a simplified version - you may need to add base64 decoding
-    size_t len = min((size_t)key.length(), maxLen);
-    memcpy(buffer, key.c_str(), len);
-    return true;
+    return decodeKey(key, buffer, maxLen) == KEY_SIZE;
 }
 
 bool KeyManager::getPublicKeyRaw(uint8_t* buffer, size_t maxLen) {
@@ -103,9 +138,5 @@ bool KeyManager::getPublicKeyRaw(uint8_t* buffer, size_t maxLen) {
     if (key.length() == 0) {
         return false;
     }
-    
-    // Store the key bytes (assumes hex or base64 string)
-    size_t len = min((size_t)key.length(), maxLen);
-    memcpy(buffer, key.c_str(), len);
-    return true;
+    return decodeKey(key, buffer, maxLen) == KEY_SIZE;
 }
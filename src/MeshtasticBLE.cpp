@@ -6,17 +6,29 @@ class MeshtasticBLE::ServerCallbacks: public BLEServerCallbacks {
 public:
     ServerCallbacks(MeshtasticBLE* p) : parent(p) {}
     
-    void onConnect(BLEServer* pServer) {
-        parent->connected = true;
-        Serial.println("Client connected!");
+    void onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) {
+        BLEEvent event;
+        event.type = BLE_EVENT_CONNECT;
+        event.connId = param->connect.conn_id;
+        memcpy(event.address, param->connect.remote_bda, sizeof(event.address));
+        event.publicAddress = param->connect.ble_addr_type == BLE_ADDR_TYPE_PUBLIC;
+        event.id = 0;
+        event.token = 0;
+        parent->postEvent(event);
+        Serial.printf("Client connected! (conn %d)\n", event.connId);
     }
     
-    void onDisconnect(BLEServer* pServer) {
-        parent->connected = false;
-        Serial.println("Client disconnected!");
-        // Restart advertising
-        delay(500);
-        parent->startAdvertising();
+    void onDisconnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) {
+        // Sessions and advertising are handled in update(), never block the BLE task here
+        BLEEvent event;
+        event.type = BLE_EVENT_DISCONNECT;
+        event.connId = param->disconnect.conn_id;
+        memcpy(event.address, param->disconnect.remote_bda, sizeof(event.address));
+        event.publicAddress = false;
+        event.id = 0;
+        event.token = 0;
+        parent->postEvent(event);
+        Serial.printf("Client disconnected! (conn %d)\n", event.connId);
     }
 };
 
@@ -40,6 +52,41 @@ public:
     }
 };
 
+static uint32_t readLE32(const uint8_t* bytes) {
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+           ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+// FromNum characteristic write callbacks - client reports the last
+// FromRadio id it received so the session resumes after that frame.
+// 4 bytes: last id, 0 if none yet. 8 bytes: last id, then a session
+// token the client picked; a later connection presenting the same token
+// takes over the session, whatever address the peer connects from.
+// This is an extension of the Meshtastic protocol: stock apps only read
+// and subscribe to FromNum and never write it. Without the write, only a
+// client with a public address resumes, and only from where it left off.
+class MeshtasticBLE::FromNumCallbacks: public BLECharacteristicCallbacks {
+    MeshtasticBLE* parent;
+public:
+    FromNumCallbacks(MeshtasticBLE* p) : parent(p) {}
+    
+    void onWrite(BLECharacteristic* pCharacteristic, esp_ble_gatts_cb_param_t* param) {
+        String value = pCharacteristic->getValue();
+        
+        if (value.length() == sizeof(uint32_t) || value.length() == 2 * sizeof(uint32_t)) {
+            const uint8_t* bytes = (const uint8_t*)value.c_str();
+            BLEEvent event;
+            event.type = BLE_EVENT_RESUME;
+            event.connId = param->write.conn_id;
+            memset(event.address, 0, sizeof(event.address));
+            event.publicAddress = false;
+            event.id = readLE32(bytes);
+            event.token = value.length() == 2 * sizeof(uint32_t) ? readLE32(bytes + 4) : 0;
+            parent->postEvent(event);
+        }
+    }
+};
+
 // KeyControl characteristic write callbacks
 class MeshtasticBLE::KeyControlCallbacks: public BLECharacteristicCallbacks {
     MeshtasticBLE* parent;
@@ -69,8 +116,19 @@ MeshtasticBLE::MeshtasticBLE()
     , pKeyControlChar(nullptr)
     , pBatteryService(nullptr)
     , pBatteryLevelChar(nullptr)
-    , connected(false)
-    , fromNum(0) {
+    , connectedCount(0)
+    , advertisingConfigured(false)
+    , rrNext(0)
+    , eventHead(0)
+    , eventTail(0)
+    , droppedEvents(0)
+    , advertisingRestartPending(false)
+    , advertisingRestartAt(0)
+    , reconnectCount(0)
+    , resumedSessions(0) {
+    memset(sessions, 0, sizeof(sessions));
+    memset(firstFrameMillisTotal, 0, sizeof(firstFrameMillisTotal));
+    memset(firstFrameCount, 0, sizeof(firstFrameCount));
 }
 
 MeshtasticBLE::~MeshtasticBLE() {
@@ -106,17 +164,21 @@ bool MeshtasticBLE::begin(const String& name) {
     );
     // BLE2902 descriptor automatically added by NimBLE for notify characteristic
     
-    // Create FromNum characteristic (notify - indicates new data available)
+    // Create FromNum characteristic (notify - indicates new data available,
+    // write - client reports last seen FromRadio id to resume a session;
+    // the write is our extension, see FromNumCallbacks)
     pFromNumChar = pService->createCharacteristic(
         FROMNUM_UUID,
-        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY
+        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY |
+        BLECharacteristic::PROPERTY_WRITE
     );
+    pFromNumChar->setCallbacks(new FromNumCallbacks(this));
     // BLE2902 descriptor automatically added by NimBLE for notify characteristic
     
     // Create KeyControl characteristic (writable - receives key import commands)
     pKeyControlChar = pService->createCharacteristic(
         KEY_CONTROL_UUID,
-        BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_WRITE_NR
+        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_WRITE_NR
     );
     pKeyControlChar->setCallbacks(new KeyControlCallbacks(this));
     
@@ -151,11 +213,15 @@ bool MeshtasticBLE::begin(const String& name) {
 
 void MeshtasticBLE::startAdvertising() {
     BLEAdvertising* pAdvertising = pServer->getAdvertising();
-    pAdvertising->addServiceUUID(MESHTASTIC_SERVICE_UUID);
-    pAdvertising->addServiceUUID(BATTERY_SERVICE_UUID);
-    pAdvertising->setScanResponse(true);
-    pAdvertising->setMinPreferred(0x06);  // Functions for iPhone connection optimization
-    pAdvertising->setMaxPreferred(0x12);
+    if (!advertisingConfigured) {
+        // Configure once, advertising is restarted after every (dis)connect
+        pAdvertising->addServiceUUID(MESHTASTIC_SERVICE_UUID);
+        pAdvertising->addServiceUUID(BATTERY_SERVICE_UUID);
+        pAdvertising->setScanResponse(true);
+        pAdvertising->setMinPreferred(0x06);  // Functions for iPhone connection optimization
+        pAdvertising->setMaxPreferred(0x12);
+        advertisingConfigured = true;
+    }
     pAdvertising->start();
     Serial.println("BLE advertising started");
 }
@@ -166,7 +232,294 @@ void MeshtasticBLE::stopAdvertising() {
 }
 
 bool MeshtasticBLE::isConnected() {
-    return connected;
+    return connectedCount > 0;
+}
+
+uint8_t MeshtasticBLE::getConnectedCount() {
+    return connectedCount;
+}
+
+void MeshtasticBLE::update() {
+    processEvents();
+    expireSessions();
+    fromRadioQueue.expire();
+    
+    // Restart advertising outside the BLE callbacks while slots are free
+    if (advertisingRestartPending && (long)(millis() - advertisingRestartAt) >= 0) {
+        advertisingRestartPending = false;
+        if (connectedCount < MAX_BLE_CLIENTS) {
+            startAdvertising();
+        }
+    }
+    
+    if (connectedCount > 0) {
+        scheduleNotifications();
+    }
+}
+
+void MeshtasticBLE::postEvent(const BLEEvent& event) {
+    uint8_t next = (eventTail + 1) % BLE_EVENT_QUEUE_DEPTH;
+    if (next == eventHead) {
+        droppedEvents++;
+        return;
+    }
+    events[eventTail] = event;
+    eventTail = next;
+}
+
+void MeshtasticBLE::processEvents() {
+    while (eventHead != eventTail) {
+        const BLEEvent& event = events[eventHead];
+        
+        switch (event.type) {
+            case BLE_EVENT_CONNECT:
+                openSession(event.connId, event.address, event.publicAddress);
+                break;
+            case BLE_EVENT_DISCONNECT:
+                closeSession(event.connId);
+                break;
+            case BLE_EVENT_RESUME:
+                resumeSession(event.connId, event.id, event.token);
+                break;
+        }
+        
+        eventHead = (eventHead + 1) % BLE_EVENT_QUEUE_DEPTH;
+    }
+}
+
+void MeshtasticBLE::openSession(uint16_t connId, const uint8_t* address, bool publicAddress) {
+    unsigned long now = millis();
+    BLEClientSession* session = nullptr;
+    
+    // Same peer back within the resume window - continue where it left off.
+    // Only a public address identifies the peer: phones connect from
+    // private addresses that rotate, and are matched by token on FromNum
+    for (int i = 0; i < BLE_SESSION_SLOTS && publicAddress; i++) {
+        BLEClientSession& s = sessions[i];
+        if (s.inUse && !s.connected && s.publicAddress && memcmp(s.address, address, sizeof(s.address)) == 0) {
+            session = &s;
+            session->resumed = true;
+            resumedSessions++;
+            Serial.printf("Session resumed (%lu ms offline, %u frames pending)\n",
+                          now - s.disconnectedAt, fromRadioQueue.lastId() - s.cursor);
+            break;
+        }
+    }
+    
+    if (session == nullptr) {
+        // New session - claim a free slot, or the stalest disconnected one
+        for (int i = 0; i < BLE_SESSION_SLOTS; i++) {
+            BLEClientSession& s = sessions[i];
+            if (!s.inUse) {
+                session = &s;
+                break;
+            }
+            if (!s.connected && (session == nullptr || s.disconnectedAt < session->disconnectedAt)) {
+                session = &s;
+            }
+        }
+        if (session == nullptr) {
+            Serial.println("No free BLE session slot");
+            return;
+        }
+        if (session->inUse) {
+            fromRadioQueue.release(session->cursor, fromRadioQueue.lastId());
+        }
+        
+        // Client resyncs from scratch, nothing old is replayed
+        memset(session, 0, sizeof(*session));
+        session->inUse = true;
+        memcpy(session->address, address, sizeof(session->address));
+        session->publicAddress = publicAddress;
+        session->cursor = fromRadioQueue.lastId();
+        Serial.println("New session started");
+    }
+    
+    session->connected = true;
+    session->connId = connId;
+    session->deficit = 0;
+    session->connectedAt = now;
+    session->awaitingFirstFrame = true;
+    connectedCount++;
+    reconnectCount++;
+    
+    // The stack stops advertising on connect - keep accepting more clients
+    scheduleAdvertising(0);
+}
+
+void MeshtasticBLE::closeSession(uint16_t connId) {
+    BLEClientSession* session = findSession(connId);
+    if (session == nullptr) {
+        return;
+    }
+    
+    // Keep the cursor (and its frame references) for the resume window
+    session->connected = false;
+    session->disconnectedAt = millis();
+    connectedCount--;
+    
+    scheduleAdvertising(ADVERTISING_RESTART_DELAY_MS);
+}
+
+void MeshtasticBLE::resumeSession(uint16_t connId, uint32_t id, uint32_t token) {
+    BLEClientSession* session = findSession(connId);
+    if (session == nullptr) {
+        return;
+    }
+    
+    if (token != 0 && token != session->resumeToken) {
+        // The session this client left, if still resumable, replaces the
+        // one opened for the connection: it holds the frames sent since
+        for (int i = 0; i < BLE_SESSION_SLOTS; i++) {
+            BLEClientSession& s = sessions[i];
+            if (!s.inUse || s.connected || s.resumeToken != token) {
+                continue;
+            }
+            fromRadioQueue.release(session->cursor, fromRadioQueue.lastId());
+            s.connected = true;
+            s.connId = connId;
+            memcpy(s.address, session->address, sizeof(s.address));
+            s.publicAddress = session->publicAddress;
+            s.deficit = 0;
+            s.connectedAt = session->connectedAt;
+            s.awaitingFirstFrame = session->awaitingFirstFrame;
+            s.resumed = true;
+            session->inUse = false;
+            session = &s;
+            resumedSessions++;
+            Serial.printf("Session %08X resumed (%lu ms offline)\n", token, millis() - s.disconnectedAt);
+            break;
+        }
+        session->resumeToken = token;
+    }
+    
+    // Ids start at 1: a client that has seen nothing only registers its token
+    if (id == 0) {
+        return;
+    }
+    if (id > fromRadioQueue.lastId()) {
+        id = fromRadioQueue.lastId();
+    }
+    
+    // Move the cursor, re-referencing frames the client asks to see again
+    if (id < session->cursor) {
+        fromRadioQueue.retain(id, session->cursor);
+    } else {
+        fromRadioQueue.release(session->cursor, id);
+    }
+    session->cursor = id;
+    
+    Serial.printf("Client resumed after FromRadio #%u (%u newer queued)\n",
+                  id, fromRadioQueue.lastId() - id);
+}
+
+void MeshtasticBLE::expireSessions() {
+    unsigned long now = millis();
+    for (int i = 0; i < BLE_SESSION_SLOTS; i++) {
+        BLEClientSession& s = sessions[i];
+        if (s.inUse && !s.connected && now - s.disconnectedAt > SESSION_RESUME_WINDOW_MS) {
+            fromRadioQueue.release(s.cursor, fromRadioQueue.lastId());
+            s.inUse = false;
+        }
+    }
+}
+
+void MeshtasticBLE::scheduleAdvertising(unsigned long delayMs) {
+    advertisingRestartPending = true;
+    advertisingRestartAt = millis() + delayMs;
+}
+
+uint8_t MeshtasticBLE::liveSessionCount() {
+    uint8_t live = 0;
+    for (int i = 0; i < BLE_SESSION_SLOTS; i++) {
+        if (sessions[i].inUse) {
+            live++;
+        }
+    }
+    return live;
+}
+
+BLEClientSession* MeshtasticBLE::findSession(uint16_t connId) {
+    for (int i = 0; i < BLE_SESSION_SLOTS; i++) {
+        if (sessions[i].inUse && sessions[i].connected && sessions[i].connId == connId) {
+            return &sessions[i];
+        }
+    }
+    return nullptr;
+}
+
+void MeshtasticBLE::scheduleNotifications() {
+    // Deficit round robin: every backlogged client earns one quantum per
+    // round, so a slow or congested client cannot stall the others
+    for (int n = 0; n < BLE_SESSION_SLOTS; n++) {
+        BLEClientSession& s = sessions[(rrNext + n) % BLE_SESSION_SLOTS];
+        if (!s.inUse || !s.connected) {
+            continue;
+        }
+        
+        const FromRadioFrame* frame = fromRadioQueue.next(s.cursor);
+        if (frame == nullptr) {
+            s.deficit = 0;
+            continue;
+        }
+        
+        s.deficit += FROMRADIO_DRR_QUANTUM;
+        while (frame != nullptr && frame->length <= s.deficit) {
+            if (!notifyClient(s, *frame)) {
+                s.congestedRounds++;
+                break;
+            }
+            s.deficit -= frame->length;
+            frame = fromRadioQueue.next(s.cursor);
+        }
+        
+        if (frame == nullptr) {
+            s.deficit = 0;
+        } else if (s.deficit > FROMRADIO_DRR_QUANTUM) {
+            // Don't let a congested client bank credit for a later burst
+            s.deficit = FROMRADIO_DRR_QUANTUM;
+        }
+    }
+    
+    rrNext = (rrNext + 1) % BLE_SESSION_SLOTS;
+}
+
+bool MeshtasticBLE::notifyClient(BLEClientSession& session, const FromRadioFrame& frame) {
+    esp_gatt_if_t gattsIf = pServer->getGattsIf();
+    
+    // Notify this connection only - every client has its own cursor
+    esp_err_t err = esp_ble_gatts_send_indicate(gattsIf, session.connId,
+                                                pFromRadioChar->getHandle(),
+                                                frame.length, (uint8_t*)frame.data, false);
+    if (err != ESP_OK) {
+        return false;
+    }
+    
+    // Update FromNum to indicate new data
+    uint8_t fromNumBytes[4] = {
+        (uint8_t)frame.id, (uint8_t)(frame.id >> 8),
+        (uint8_t)(frame.id >> 16), (uint8_t)(frame.id >> 24)
+    };
+    esp_ble_gatts_send_indicate(gattsIf, session.connId, pFromNumChar->getHandle(),
+                                sizeof(fromNumBytes), fromNumBytes, false);
+    
+    if (frame.id > session.cursor + 1) {
+        session.framesSkipped += frame.id - session.cursor - 1;
+    }
+    fromRadioQueue.release(session.cursor, frame.id);
+    session.cursor = frame.id;
+    session.framesSent++;
+    
+    if (session.awaitingFirstFrame) {
+        session.awaitingFirstFrame = false;
+        session.firstFrameLatency = millis() - session.connectedAt;
+        firstFrameMillisTotal[session.resumed] += session.firstFrameLatency;
+        firstFrameCount[session.resumed]++;
+    }
+    
+    Serial.printf("Sent %d bytes via FromRadio to conn %d (packet #%u)\n",
+                  frame.length, session.connId, frame.id);
+    return true;
 }
 
 bool MeshtasticBLE::sendFromRadio(uint8_t* data, size_t length) {
@@ -175,19 +528,23 @@ bool MeshtasticBLE::sendFromRadio(uint8_t* data, size_t length) {
         return false;
     }
     
-    // Update the characteristic value
+    // Connects and resume writes from the BLE task first, so a client's
+    // last seen id is applied before this frame is notified to it
+    processEvents();
+    
+    // One shared copy, referenced by every live session
+    uint32_t id = fromRadioQueue.push(data, length, liveSessionCount());
+    if (id == 0) {
+        Serial.printf("FromRadio frame too large (%d bytes)\n", length);
+        return false;
+    }
+    
+    // Latest frame stays readable, FromNum reports its id
     pFromRadioChar->setValue(data, length);
+    pFromNumChar->setValue(id);
     
-    // Notify connected clients if any
-    if (connected) {
-        pFromRadioChar->notify();
-        
-        // Update FromNum to indicate new data
-        fromNum++;
-        pFromNumChar->setValue(fromNum);
-        pFromNumChar->notify();
-        
-        Serial.printf("Sent %d bytes via FromRadio (packet #%d)\n", length, fromNum);
+    if (connectedCount > 0) {
+        scheduleNotifications();
     }
     
     return true;
@@ -214,11 +571,51 @@ void MeshtasticBLE::updateBatteryLevel(uint8_t level) {
     pBatteryLevelChar->setValue(&level, 1);
     
     // Notify connected clients
-    if (connected) {
+    if (connectedCount > 0) {
         pBatteryLevelChar->notify();
     }
 }
 
+void MeshtasticBLE::setKeyCommandResponse(const String& response) {
+    if (pKeyControlChar == nullptr) {
+        return;
+    }
+    pKeyControlChar->setValue(response.c_str());
+}
+
 String MeshtasticBLE::getDeviceName() {
     return deviceName;
 }
+
+void MeshtasticBLE::printStats() {
+    Serial.println("=== BLE Session Stats ===");
+    Serial.printf("Clients: %d/%d connected, %u connections (resumed: %u)\n",
+                  connectedCount, MAX_BLE_CLIENTS, reconnectCount, resumedSessions);
+    Serial.printf("Queued frames: %u (last id #%u, overruns: %u)\n",
+                  fromRadioQueue.size(), fromRadioQueue.lastId(), fromRadioQueue.getOverruns());
+    if (droppedEvents > 0) {
+        Serial.printf("Dropped BLE events: %u\n", droppedEvents);
+    }
+    // A fresh session waits for the next new frame; a resumed one starts
+    // with what it missed, so the two averages compare the reconnect paths
+    for (int resumed = 1; resumed >= 0; resumed--) {
+        if (firstFrameCount[resumed] > 0) {
+            Serial.printf("Connect -> first FromRadio (%s): %u ms avg over %u\n",
+                          resumed ? "resumed" : "fresh",
+                          firstFrameMillisTotal[resumed] / firstFrameCount[resumed], firstFrameCount[resumed]);
+        }
+    }
+    
+    for (int i = 0; i < BLE_SESSION_SLOTS; i++) {
+        const BLEClientSession& s = sessions[i];
+        if (!s.inUse) {
+            continue;
+        }
+        Serial.printf("  [%d] %02X:%02X:%02X:%02X:%02X:%02X token %08X %s cursor #%u sent %u skipped %u congested %u\n",
+                      i, s.address[0], s.address[1], s.address[2],
+                      s.address[3], s.address[4], s.address[5], s.resumeToken,
+                      s.connected ? "online" : "resumable",
+                      s.cursor, s.framesSent, s.framesSkipped, s.congestedRounds);
+        Serial.printf("      Connect -> first FromRadio: %lu ms\n", s.firstFrameLatency);
+    }
+}
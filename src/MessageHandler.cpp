@@ -1,13 +1,45 @@
 #include "MessageHandler.h"
+#include "Utf8Text.h"
 
 // Payload buffer for encoding/decoding
 static uint8_t payload_buffer[256];
 
-MessageHandler::MessageHandler() {
+// Expanded text of a TEXT_COMPRESSED_PORT payload
+static uint8_t text_buffer[MAX_TEXT_LENGTH + 1];
+
+// Home position of a packet id in the index (Fibonacci hashing)
+static inline uint32_t packetHash(uint32_t packetId) {
+    return ((packetId * 2654435769u) >> 16) & (MESSAGE_INDEX_SIZE - 1);
+}
+
+MessageHandler::MessageHandler()
+    : freeCount(0)
+    , conversationCount(0)
+    , nextConversationId(1)
+    , textCompression(TEXT_COMPRESSION_ENABLED)
+    , portHandlerCount(0)
+    , nextMessageId(1)
+    , nodeNum(0)
+    , lastPacketId(0)
+    , duplicates(0)
+    , evictedByQuota(0)
+    , evictedByLru(0)
+    , reactionsReceived(0)
+    , reactionsDropped(0)
+    , compressedSent(0)
+    , rawSent(0)
+    , compressedReceived(0)
+    , unishoxIgnored(0) {
 }
 
 bool MessageHandler::begin() {
-    messages.clear();
+    clearMessages();
+    
+    // Last four bytes of the factory MAC
+    uint64_t mac = ESP.getEfuseMac();
+    nodeNum = ((uint32_t)(mac >> 16) & 0xFF) << 24 | ((uint32_t)(mac >> 24) & 0xFF) << 16 |
+              ((uint32_t)(mac >> 32) & 0xFF) << 8 | ((uint32_t)(mac >> 40) & 0xFF);
+    
     Serial.println("Message handler initialized with official Meshtastic protobufs");
     return true;
 }
@@ -34,20 +66,59 @@ bool MessageHandler::decodeFromRadio(const uint8_t* data, size_t length) {
     if (fromRadio.which_payload_variant == meshtastic_FromRadio_packet_tag) {
         meshtastic_MeshPacket packet = fromRadio.packet;
         
+        // Channel traffic we hold the key for is decrypted here
+        if (packet.which_payload_variant == meshtastic_MeshPacket_encrypted_tag && packetDecrypter) {
+            packetDecrypter(packet);
+        }
+        
         // Check if packet has decoded data (not encrypted)
         if (packet.which_payload_variant == meshtastic_MeshPacket_decoded_tag) {
             meshtastic_Data decoded = packet.decoded;
             
+            if (packetObserver) {
+                packetObserver(packet);
+            }
+            
             // Check if it's a text message
             if (decoded.portnum == meshtastic_PortNum_TEXT_MESSAGE_APP) {
-                // Extract text from payload bytes
-                String text = String((char*)decoded.payload.bytes);
-                text = text.substring(0, decoded.payload.size); // Limit to actual size
-                String sender = String(packet.from, HEX);
+                // Payload bytes are not terminated and may not be valid UTF-8
+                Utf8Text::sanitize(decoded.payload.bytes, decoded.payload.size,
+                                   (char*)text_buffer, sizeof(text_buffer));
+                String text = String((char*)text_buffer);
                 
                 Serial.printf("Received message from 0x%08X: %s\n", packet.from, text.c_str());
-                addMessage(sender, text, false);
-                return true;
+                return handleText(packet, text);
+            }
+            
+            // Compressed text message - expand and handle like plain text
+            if (decoded.portnum == TEXT_COMPRESSED_PORT) {
+                size_t textLen = compressor.decompress(decoded.payload.bytes, decoded.payload.size,
+                                                       text_buffer, MAX_TEXT_LENGTH);
+                if (textLen == 0) {
+                    Serial.println("Decompress failed");
+                    return false;
+                }
+                Utf8Text::sanitize(text_buffer, textLen, (char*)text_buffer, sizeof(text_buffer));
+                
+                String text = String((char*)text_buffer);
+                
+                Serial.printf("Received compressed message from 0x%08X (%d -> %d bytes): %s\n",
+                              packet.from, decoded.payload.size, textLen, text.c_str());
+                compressedReceived++;
+                return handleText(packet, text);
+            }
+            
+            // Unishox2 text from stock firmware; there is no decoder for it here
+            if (decoded.portnum == meshtastic_PortNum_TEXT_MESSAGE_COMPRESSED_APP) {
+                unishoxIgnored++;
+                return false;
+            }
+            
+            // Hand other ports to their registered module
+            for (int i = 0; i < portHandlerCount; i++) {
+                if (portHandlers[i].port == decoded.portnum) {
+                    return portHandlers[i].handler(packet);
+                }
             }
         }
     }
@@ -55,31 +126,101 @@ bool MessageHandler::decodeFromRadio(const uint8_t* data, size_t length) {
     return false;
 }
 
-bool MessageHandler::createTextMessage(const String& text, uint8_t* buffer, size_t* length, size_t maxLen) {
-    // Initialize ToRadio message
-    meshtastic_ToRadio toRadio = meshtastic_ToRadio_init_zero;
-    meshtastic_MeshPacket packet = meshtastic_MeshPacket_init_zero;
+bool MessageHandler::onPort(meshtastic_PortNum port, PacketHandler handler) {
+    if (portHandlerCount >= MAX_PORT_HANDLERS) {
+        Serial.printf("No room for port %d handler\n", port);
+        return false;
+    }
+    portHandlers[portHandlerCount].port = port;
+    portHandlers[portHandlerCount].handler = handler;
+    portHandlerCount++;
+    return true;
+}
+
+void MessageHandler::onPacket(PacketHandler observer) {
+    packetObserver = observer;
+}
+
+void MessageHandler::onEncrypted(CryptHandler decrypter) {
+    packetDecrypter = decrypter;
+}
+
+void MessageHandler::onOutgoing(CryptHandler encrypter) {
+    packetEncrypter = encrypter;
+}
+
+void MessageHandler::setTextCompression(bool enabled) {
+    textCompression = enabled;
+}
+
+bool MessageHandler::getTextCompression() {
+    return textCompression;
+}
+
+bool MessageHandler::createTextMessage(const char* text, size_t textLength, uint8_t* buffer, size_t* length, size_t maxLen) {
     meshtastic_Data msgData = meshtastic_Data_init_zero;
     
-    // Set up the Data message
-    msgData.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+    // With compression on, use the compressed text port whenever it is
+    // smaller than raw text (airtime is the scarce resource). Compression
+    // can also fit text that would otherwise be truncated. The codec bytes
+    // are the whole payload: meshtastic_Compressed would repeat the port
+    // and add 4 bytes of framing that only the firmware's own Unishox2
+    // path reads.
+    size_t textLen = textLength;
+    size_t compressedLen = 0;
+    if (textCompression) {
+        compressedLen = compressor.compress((const uint8_t*)text, textLen,
+                                            msgData.payload.bytes, sizeof(msgData.payload.bytes));
+    }
+    
+    if (compressedLen > 0 && compressedLen < textLen) {
+        msgData.portnum = TEXT_COMPRESSED_PORT;
+        msgData.payload.size = compressedLen;
+        compressedSent++;
+    } else {
+        // Set up the Data message
+        msgData.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+        
+        // Copy text to payload, cut between code points (the payload is
+        // length-delimited, so it can use every byte)
+        textLen = Utf8Text::truncate(text, textLen, sizeof(msgData.payload.bytes));
+        memcpy(msgData.payload.bytes, text, textLen);
+        msgData.payload.size = textLen;
+        rawSent++;
+    }
     
-    // Copy text to payload
-    size_t textLen = text.length();
-    if (textLen > sizeof(msgData.payload.bytes) - 1) {
-        textLen = sizeof(msgData.payload.bytes) - 1;
+    if (!createDataPacket(msgData, BROADCAST_ADDR, buffer, length, maxLen)) {
+        return false;
     }
-    memcpy(msgData.payload.bytes, text.c_str(), textLen);
-    msgData.payload.size = textLen;
+    
+    Serial.printf("Created message, encoded %zu bytes\n", *length);
+    return true;
+}
+
+bool MessageHandler::createDataPacket(const meshtastic_Data& data, uint32_t to, uint8_t* buffer, size_t* length, size_t maxLen) {
+    // Initialize ToRadio message
+    meshtastic_ToRadio toRadio = meshtastic_ToRadio_init_zero;
+    meshtastic_MeshPacket packet = meshtastic_MeshPacket_init_zero;
     
     // Set up the MeshPacket
     packet.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
-    packet.decoded = msgData;
-    packet.to = 0xFFFFFFFF; // Broadcast address
+    packet.decoded = data;
+    packet.to = to;
     packet.want_ack = false;
     packet.hop_limit = 3; // Default hop limit
     packet.priority = meshtastic_MeshPacket_Priority_DEFAULT;
     
+    // Our own id, so replies and reactions to what we send can be matched
+    packet.id = esp_random();
+    if (packet.id == 0) {
+        packet.id = 1;
+    }
+    lastPacketId = packet.id;
+    
+    if (packetEncrypter) {
+        packetEncrypter(packet);
+    }
+    
     // Set up ToRadio message
     toRadio.which_payload_variant = meshtastic_ToRadio_packet_tag;
     toRadio.packet = packet;
@@ -92,48 +233,300 @@ bool MessageHandler::createTextMessage(const String& text, uint8_t* buffer, size
     }
     
     *length = bytes_written;
-    Serial.printf("Created message, encoded %zu bytes\n", *length);
     return true;
 }
 
-void MessageHandler::addMessage(const String& sender, const String& text, bool isOwn) {
-    Message msg;
+// Store text from the mesh. Reactions are counted on the message they
+// react to; a packet that is already stored is dropped. Text addressed to
+// this node is a direct message; the rest belongs to its channel.
+bool MessageHandler::handleText(const meshtastic_MeshPacket& packet, const String& text) {
+    if (findPacket(packet.id) != nullptr) {
+        duplicates++;
+        return false;
+    }
+    if (packet.decoded.emoji != 0 && packet.decoded.reply_id != 0) {
+        return addReaction(packet.decoded.reply_id, text.c_str());
+    }
+    bool direct = packet.to == nodeNum && packet.to != BROADCAST_ADDR;
+    addMessage(String(packet.from, HEX), text, false, direct ? packet.from : packet.channel, direct,
+               packet.id, packet.decoded.reply_id);
+    return true;
+}
+
+bool MessageHandler::addReaction(uint32_t parentId, const char* emoji) {
+    Message* msg = (Message*)findPacket(parentId);
+    if (msg == nullptr) {
+        reactionsDropped++;
+        return false;
+    }
+    
+    char key[REACTION_SIZE];
+    size_t length = Utf8Text::truncate(emoji, strlen(emoji), REACTION_SIZE - 1);
+    memcpy(key, emoji, length);
+    key[length] = '\0';
+    
+    for (uint8_t i = 0; i < msg->reactionCount; i++) {
+        if (strcmp(msg->reactions[i].emoji, key) == 0) {
+            if (msg->reactions[i].count < 255) {
+                msg->reactions[i].count++;
+            }
+            reactionsReceived++;
+            return true;
+        }
+    }
+    if (msg->reactionCount >= MAX_REACTIONS) {
+        reactionsDropped++;
+        return false;
+    }
+    Reaction& reaction = msg->reactions[msg->reactionCount++];
+    memcpy(reaction.emoji, key, sizeof(key));
+    reaction.count = 1;
+    reactionsReceived++;
+    return true;
+}
+
+// Position of a packet id in the index, -1 if absent (linear probing)
+int MessageHandler::indexSlot(uint32_t packetId) {
+    uint32_t i = packetHash(packetId);
+    for (int probe = 0; probe < MESSAGE_INDEX_SIZE; probe++) {
+        uint8_t entry = packetIndex[i];
+        if (entry == 0) {
+            return -1;
+        }
+        if (messages[entry - 1].packetId == packetId) {
+            return i;
+        }
+        i = (i + 1) & (MESSAGE_INDEX_SIZE - 1);
+    }
+    return -1;
+}
+
+// Remove a packet id, shifting the rest of its probe run back so that
+// lookups never need tombstones
+void MessageHandler::indexRemove(uint32_t packetId) {
+    int found = indexSlot(packetId);
+    if (found < 0) {
+        return;
+    }
+    uint32_t hole = found;
+    uint32_t i = found;
+    while (true) {
+        i = (i + 1) & (MESSAGE_INDEX_SIZE - 1);
+        uint8_t entry = packetIndex[i];
+        if (entry == 0) {
+            break;
+        }
+        // The entry may fill the hole if the hole lies between its home and here
+        uint32_t home = packetHash(messages[entry - 1].packetId);
+        if (((i - home) & (MESSAGE_INDEX_SIZE - 1)) >= ((i - hole) & (MESSAGE_INDEX_SIZE - 1))) {
+            packetIndex[hole] = entry;
+            hole = i;
+        }
+    }
+    packetIndex[hole] = 0;
+}
+
+const Message* MessageHandler::findPacket(uint32_t packetId) {
+    if (packetId == 0) {
+        return nullptr;
+    }
+    int i = indexSlot(packetId);
+    return i < 0 ? nullptr : &messages[packetIndex[i] - 1];
+}
+
+// Move a conversation to the front of the recency list
+void MessageHandler::touchConversation(int conversation) {
+    int rank = 0;
+    while (recent[rank] != conversation) {
+        rank++;
+    }
+    for (; rank > 0; rank--) {
+        recent[rank] = recent[rank - 1];
+    }
+    recent[0] = conversation;
+}
+
+// Free the oldest message of a conversation
+void MessageHandler::evictOldest(int conversation) {
+    Conversation& conv = conversations[conversation];
+    uint8_t slot = conv.slots[conv.head];
+    if (messages[slot].packetId != 0) {
+        indexRemove(messages[slot].packetId);
+    }
+    conv.head = (conv.head + 1) % CONVERSATION_QUOTA;
+    conv.count--;
+    conv.unread = min(conv.unread, conv.count);
+    freeSlots[freeCount++] = slot;
+}
+
+// Find or open the conversation for a channel or peer. With every entry
+// in use, the least recently active conversation is closed for it.
+int MessageHandler::conversationFor(uint32_t peer, bool direct) {
+    for (int rank = 0; rank < conversationCount; rank++) {
+        Conversation& conv = conversations[recent[rank]];
+        if (conv.peer == peer && conv.direct == direct) {
+            return recent[rank];
+        }
+    }
+    
+    int index;
+    if (conversationCount < MAX_CONVERSATIONS) {
+        index = conversationCount;
+        recent[conversationCount++] = index;
+    } else {
+        index = recent[conversationCount - 1];
+        while (conversations[index].count > 0) {
+            evictOldest(index);
+            evictedByLru++;
+        }
+    }
+    
+    Conversation& conv = conversations[index];
+    conv.id = nextConversationId++;
+    conv.peer = peer;
+    conv.direct = direct;
+    conv.count = 0;
+    conv.head = 0;
+    conv.unread = 0;
+    conv.nextSeq = 1;
+    return index;
+}
+
+void MessageHandler::addMessage(const String& sender, const String& text, bool isOwn,
+                                uint32_t peer, bool direct, uint32_t packetId, uint32_t replyId) {
+    int conversation = conversationFor(peer, direct);
+    Conversation& conv = conversations[conversation];
+    touchConversation(conversation);
+    
+    // A conversation at its quota recycles its own oldest message, so a
+    // busy channel cannot push out direct messages. Otherwise a full slab
+    // gives up the oldest message of the least recently active conversation.
+    if (conv.count == CONVERSATION_QUOTA) {
+        evictOldest(conversation);
+        evictedByQuota++;
+    } else if (freeCount == 0) {
+        int victim = conversation;
+        for (int rank = conversationCount - 1; rank > 0; rank--) {
+            if (conversations[recent[rank]].count > 0) {
+                victim = recent[rank];
+                break;
+            }
+        }
+        evictOldest(victim);
+        evictedByLru++;
+    }
+    
+    uint8_t slot = freeSlots[--freeCount];
+    Message& msg = messages[slot];
+    msg.id = nextMessageId++;
+    msg.seq = conv.nextSeq++;
+    msg.slot = slot;
+    msg.conversation = conversation;
+    msg.packetId = packetId;
+    msg.replyId = replyId;
     msg.sender = sender;
     msg.text = text;
     msg.timestamp = millis();
     msg.isOwn = isOwn;
+    msg.reactionCount = 0;
     
-    messages.push_back(msg);
+    conv.slots[(conv.head + conv.count) % CONVERSATION_QUOTA] = slot;
+    conv.count++;
+    if (!isOwn) {
+        conv.unread++;
+    }
     
-    // Keep only last MAX_MESSAGES
-    while (messages.size() > MAX_MESSAGES) {
-        messages.erase(messages.begin());
+    if (packetId != 0 && indexSlot(packetId) < 0) {
+        uint32_t i = packetHash(packetId);
+        while (packetIndex[i] != 0) {
+            i = (i + 1) & (MESSAGE_INDEX_SIZE - 1);
+        }
+        packetIndex[i] = slot + 1;
     }
 }
 
-void MessageHandler::addSentMessage(const String& text) {
-    addMessage("You", text, true);
+void MessageHandler::addSentMessage(const char* text, size_t length) {
+    addMessage("You", String(text, length), true, 0, false, lastPacketId);
 }
 
 int MessageHandler::getMessageCount() {
-    return messages.size();
+    return MAX_MESSAGES - freeCount;
+}
+
+int MessageHandler::getConversationCount() {
+    return conversationCount;
 }
 
-Message MessageHandler::getMessage(int index) {
-    if (index >= 0 && index < messages.size()) {
-        return messages[index];
+int MessageHandler::conversationAt(int rank) {
+    return recent[rank];
+}
+
+const Conversation& MessageHandler::getConversation(int conversation) {
+    return conversations[conversation];
+}
+
+const Message& MessageHandler::conversationMessage(int conversation, int index) {
+    const Conversation& conv = conversations[conversation];
+    return messages[conv.slots[(conv.head + index) % CONVERSATION_QUOTA]];
+}
+
+void MessageHandler::markRead(int conversation) {
+    conversations[conversation].unread = 0;
+}
+
+void MessageHandler::conversationLabel(int conversation, char* out, size_t outSize) {
+    const Conversation& conv = conversations[conversation];
+    if (conv.direct) {
+        snprintf(out, outSize, "D%08x", conv.peer);
+    } else {
+        snprintf(out, outSize, "C%u", conv.peer);
     }
-    return Message();
 }
 
-Message MessageHandler::getLatestMessage() {
-    if (messages.size() > 0) {
-        return messages[messages.size() - 1];
+int MessageHandler::findConversation(const char* label) {
+    bool direct = label[0] == 'D' || label[0] == 'd';
+    if (!direct && label[0] != 'C' && label[0] != 'c') {
+        return -1;
     }
-    return Message();
+    uint32_t peer = strtoul(label + 1, nullptr, direct ? 16 : 10);
+    for (int rank = 0; rank < conversationCount; rank++) {
+        const Conversation& conv = conversations[recent[rank]];
+        if (conv.peer == peer && conv.direct == direct) {
+            return recent[rank];
+        }
+    }
+    return -1;
 }
 
 void MessageHandler::clearMessages() {
-    messages.clear();
+    for (int i = 0; i < MAX_MESSAGES; i++) {
+        freeSlots[i] = MAX_MESSAGES - 1 - i;
+    }
+    freeCount = MAX_MESSAGES;
+    conversationCount = 0;
+    memset(packetIndex, 0, sizeof(packetIndex));
     Serial.println("Message history cleared");
 }
+
+uint32_t MessageHandler::getNodeNum() {
+    return nodeNum;
+}
+
+void MessageHandler::printStats() {
+    Serial.println("=== Message Stats ===");
+    Serial.printf("Messages stored: %d/%d in %d conversations\n",
+                  getMessageCount(), MAX_MESSAGES, conversationCount);
+    for (int rank = 0; rank < conversationCount; rank++) {
+        char label[12];
+        conversationLabel(recent[rank], label, sizeof(label));
+        Serial.printf("  %s: %u messages, %u unread\n", label,
+                      conversations[recent[rank]].count, conversations[recent[rank]].unread);
+    }
+    Serial.printf("Evicted: %u at quota, %u least recent\n", evictedByQuota, evictedByLru);
+    Serial.printf("Reactions: %u counted, %u dropped; %u duplicate packets\n",
+                  reactionsReceived, reactionsDropped, duplicates);
+    Serial.printf("Sent: %u compressed, %u raw (compression %s)\n",
+                  compressedSent, rawSent, textCompression ? "on" : "off");
+    Serial.printf("Received compressed: %u (%u Unishox2 ignored)\n", compressedReceived, unishoxIgnored);
+    compressor.printStats();
+}
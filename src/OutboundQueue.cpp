@@ -0,0 +1,203 @@
+#include "OutboundQueue.h"
+#include "Utf8Text.h"
+
+// Legal duty cycle per region in percent, as the firmware's region table
+static uint8_t regionDutyCycle(meshtastic_Config_LoRaConfig_RegionCode region) {
+    switch (region) {
+        case meshtastic_Config_LoRaConfig_RegionCode_EU_433:
+        case meshtastic_Config_LoRaConfig_RegionCode_EU_868:
+        case meshtastic_Config_LoRaConfig_RegionCode_UA_433:
+            return 10;
+        case meshtastic_Config_LoRaConfig_RegionCode_UA_868:
+            return 1;
+        default:
+            return 100;
+    }
+}
+
+// Bandwidth (Hz), spreading factor and coding rate of each modem preset
+static void presetModem(meshtastic_Config_LoRaConfig_ModemPreset preset,
+                        uint32_t* bandwidthHz, uint8_t* spreadFactor, uint8_t* codingRate) {
+    switch (preset) {
+        case meshtastic_Config_LoRaConfig_ModemPreset_SHORT_TURBO:    *bandwidthHz = 500000; *spreadFactor = 7;  *codingRate = 5; break;
+        case meshtastic_Config_LoRaConfig_ModemPreset_SHORT_FAST:     *bandwidthHz = 250000; *spreadFactor = 7;  *codingRate = 5; break;
+        case meshtastic_Config_LoRaConfig_ModemPreset_SHORT_SLOW:     *bandwidthHz = 250000; *spreadFactor = 8;  *codingRate = 5; break;
+        case meshtastic_Config_LoRaConfig_ModemPreset_MEDIUM_FAST:    *bandwidthHz = 250000; *spreadFactor = 9;  *codingRate = 5; break;
+        case meshtastic_Config_LoRaConfig_ModemPreset_MEDIUM_SLOW:    *bandwidthHz = 250000; *spreadFactor = 10; *codingRate = 5; break;
+        case meshtastic_Config_LoRaConfig_ModemPreset_LONG_MODERATE:  *bandwidthHz = 125000; *spreadFactor = 11; *codingRate = 8; break;
+        case meshtastic_Config_LoRaConfig_ModemPreset_LONG_SLOW:      *bandwidthHz = 125000; *spreadFactor = 12; *codingRate = 8; break;
+        case meshtastic_Config_LoRaConfig_ModemPreset_VERY_LONG_SLOW: *bandwidthHz = 62500;  *spreadFactor = 12; *codingRate = 8; break;
+        case meshtastic_Config_LoRaConfig_ModemPreset_LONG_TURBO:     *bandwidthHz = 500000; *spreadFactor = 11; *codingRate = 8; break;
+        default:                                                      *bandwidthHz = 250000; *spreadFactor = 11; *codingRate = 5; break;
+    }
+}
+
+OutboundQueue::OutboundQueue()
+    : head(0)
+    , count(0)
+    , spreadFactor(11)
+    , bandwidthHz(250000)
+    , codingRate(5)
+    , dutyPermille(500)
+    , tokens(0)
+    , capacity(0)
+    , lastRefill(0)
+    , linesQueued(0)
+    , linesCoalesced(0)
+    , packetsSent(0)
+    , droppedFull(0)
+    , droppedStale(0)
+    , sendFailures(0)
+    , depthMax(0)
+    , waitMillisTotal(0)
+    , waitMillisMax(0)
+    , airtimeMicrosTotal(0) {
+}
+
+void OutboundQueue::configure(const meshtastic_Config_LoRaConfig& lora) {
+    presetModem(lora.modem_preset, &bandwidthHz, &spreadFactor, &codingRate);
+    if (!lora.use_preset) {
+        // Custom settings; the app sends 31 and 62 for 31.25 and 62.5 kHz
+        if (lora.bandwidth == 31) {
+            bandwidthHz = 31250;
+        } else if (lora.bandwidth == 62) {
+            bandwidthHz = 62500;
+        } else if (lora.bandwidth > 0) {
+            bandwidthHz = lora.bandwidth * 1000;
+        }
+        if (lora.spread_factor >= 7 && lora.spread_factor <= 12) {
+            spreadFactor = lora.spread_factor;
+        }
+        if (lora.coding_rate >= 5 && lora.coding_rate <= 8) {
+            codingRate = lora.coding_rate;
+        }
+    }
+
+    uint8_t duty = lora.override_duty_cycle ? 100 : regionDutyCycle(lora.region);
+    dutyPermille = duty * OUTBOUND_POLITE_PERCENT / 10;
+    capacity = OUTBOUND_BURST_PACKETS * airtimeMicros(OUTBOUND_MAX_PACKET);
+    tokens = capacity;
+    lastRefill = millis();
+
+    Serial.printf("Outbound: SF%u BW%u CR4/%u, %u.%u%% airtime, %u ms per full packet\n",
+                  spreadFactor, bandwidthHz / 1000, codingRate, dutyPermille / 10, dutyPermille % 10,
+                  airtimeMicros(OUTBOUND_MAX_PACKET) / 1000);
+}
+
+void OutboundQueue::onSend(OutboundSendCallback callback) {
+    sendCallback = callback;
+}
+
+// Semtech time-on-air: explicit header, CRC on, low data rate
+// optimization when a symbol takes 16 ms or more
+uint32_t OutboundQueue::airtimeMicros(size_t bytes) const {
+    float symbolMicros = (float)(1UL << spreadFactor) * 1000000.0f / bandwidthHz;
+    int lowDataRate = symbolMicros >= 16000.0f ? 1 : 0;
+    int numerator = 8 * (int)bytes - 4 * spreadFactor + 28 + 16;
+    int denominator = 4 * (spreadFactor - 2 * lowDataRate);
+    int payloadSymbols = 8 + max((numerator + denominator - 1) / denominator, 0) * codingRate;
+    return (uint32_t)((OUTBOUND_PREAMBLE + 4.25f + payloadSymbols) * symbolMicros);
+}
+
+bool OutboundQueue::push(const char* text, size_t length) {
+    unsigned long now = millis();
+    length = Utf8Text::truncate(text, length, MAX_TEXT_LENGTH);
+
+    // Join a line that follows closely onto the one still waiting
+    if (count > 0) {
+        Entry& last = entries[(head + count - 1) % OUTBOUND_QUEUE_DEPTH];
+        if (now - last.appendedAt < OUTBOUND_COALESCE_MS && last.length + 1 + length <= OUTBOUND_PACKET_TEXT) {
+            last.text[last.length++] = '\n';
+            memcpy(last.text + last.length, text, length);
+            last.length += length;
+            last.text[last.length] = '\0';
+            last.appendedAt = now;
+            linesQueued++;
+            linesCoalesced++;
+            return true;
+        }
+    }
+
+    if (count == OUTBOUND_QUEUE_DEPTH) {
+        droppedFull++;
+        Serial.println("Outbound queue full, line dropped");
+        return false;
+    }
+    Entry& entry = entries[(head + count) % OUTBOUND_QUEUE_DEPTH];
+    memcpy(entry.text, text, length);
+    entry.text[length] = '\0';
+    entry.length = length;
+    entry.queuedAt = now;
+    entry.appendedAt = now;
+    count++;
+    depthMax = max(depthMax, count);
+    linesQueued++;
+    return true;
+}
+
+void OutboundQueue::refill() {
+    unsigned long now = millis();
+    uint64_t earned = (uint64_t)(now - lastRefill) * dutyPermille;
+    lastRefill = now;
+    int64_t next = tokens + (int64_t)earned;
+    tokens = next > capacity ? capacity : next;
+}
+
+void OutboundQueue::update() {
+    refill();
+    if (count == 0) {
+        return;
+    }
+
+    Entry& entry = entries[head];
+    unsigned long now = millis();
+    if (now - entry.queuedAt > OUTBOUND_MAX_WAIT_MS) {
+        droppedStale++;
+        head = (head + 1) % OUTBOUND_QUEUE_DEPTH;
+        count--;
+        return;
+    }
+    // The newest line is held briefly in case more of a paste follows
+    if (count == 1 && now - entry.appendedAt < OUTBOUND_COALESCE_MS) {
+        return;
+    }
+    // Wait for a packet's worth of airtime. Compression can only make it
+    // shorter; the bucket is charged what was actually sent.
+    uint32_t estimate = airtimeMicros(min(entry.length + OUTBOUND_PACKET_OVERHEAD, OUTBOUND_MAX_PACKET));
+    if (tokens < (int32_t)estimate || !sendCallback) {
+        return;
+    }
+
+    size_t sent = sendCallback(entry.text, entry.length);
+    if (sent > 0) {
+        uint32_t airtime = airtimeMicros(min(sent, (size_t)OUTBOUND_MAX_PACKET));
+        tokens -= airtime;
+        airtimeMicrosTotal += airtime;
+        packetsSent++;
+        uint32_t waited = now - entry.queuedAt;
+        waitMillisTotal += waited;
+        waitMillisMax = max(waitMillisMax, waited);
+    } else {
+        sendFailures++;
+    }
+    head = (head + 1) % OUTBOUND_QUEUE_DEPTH;
+    count--;
+}
+
+size_t OutboundQueue::size() const {
+    return count;
+}
+
+void OutboundQueue::printStats() {
+    Serial.println("=== Outbound Queue Stats ===");
+    Serial.printf("Depth: %u now, %u max of %d; bucket %d/%u ms of airtime at %u.%u%%\n",
+                  count, depthMax, OUTBOUND_QUEUE_DEPTH, max(tokens, (int32_t)0) / 1000, capacity / 1000,
+                  dutyPermille / 10, dutyPermille % 10);
+    Serial.printf("Lines: %u queued, %u coalesced; %u packets sent, %u failed\n",
+                  linesQueued, linesCoalesced, packetsSent, sendFailures);
+    Serial.printf("Dropped: %u queue full, %u waited too long\n", droppedFull, droppedStale);
+    if (packetsSent > 0) {
+        Serial.printf("Wait: %u ms avg, %u ms max; airtime %u ms total\n",
+                      waitMillisTotal / packetsSent, waitMillisMax, (uint32_t)(airtimeMicrosTotal / 1000));
+    }
+}
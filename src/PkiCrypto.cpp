@@ -0,0 +1,626 @@
+#include "PkiCrypto.h"
+#include <pb_encode.h>
+#include <pb_decode.h>
+
+#ifdef PKI_CRYPTO_SOFTWARE
+
+// --- X25519 (RFC 7748), 16 x 16-bit limbs ---
+// Runs once per peer thanks to the secret cache, so compact beats fast here.
+
+typedef int64_t fe[16];
+
+static const fe FE_121665 = { 0xDB41, 1 };
+
+static void feCarry(fe o) {
+    for (int i = 0; i < 16; i++) {
+        o[i] += (int64_t)1 << 16;
+        int64_t c = o[i] >> 16;
+        o[(i + 1) * (i < 15)] += c - 1 + 37 * (c - 1) * (i == 15);
+        o[i] -= c * ((int64_t)1 << 16);
+    }
+}
+
+// Constant-time swap of p and q when b is 1
+static void feSwap(fe p, fe q, int64_t b) {
+    int64_t mask = ~(b - 1);
+    for (int i = 0; i < 16; i++) {
+        int64_t t = mask & (p[i] ^ q[i]);
+        p[i] ^= t;
+        q[i] ^= t;
+    }
+}
+
+static void fePack(uint8_t* out, const fe n) {
+    fe m, t;
+    memcpy(t, n, sizeof(fe));
+    feCarry(t);
+    feCarry(t);
+    feCarry(t);
+    for (int j = 0; j < 2; j++) {
+        m[0] = t[0] - 0xffed;
+        for (int i = 1; i < 15; i++) {
+            m[i] = t[i] - 0xffff - ((m[i - 1] >> 16) & 1);
+            m[i - 1] &= 0xffff;
+        }
+        m[15] = t[15] - 0x7fff - ((m[14] >> 16) & 1);
+        int64_t borrow = (m[15] >> 16) & 1;
+        m[14] &= 0xffff;
+        feSwap(t, m, 1 - borrow);
+    }
+    for (int i = 0; i < 16; i++) {
+        out[2 * i] = t[i] & 0xff;
+        out[2 * i + 1] = t[i] >> 8;
+    }
+}
+
+static void feUnpack(fe out, const uint8_t* n) {
+    for (int i = 0; i < 16; i++) {
+        out[i] = n[2 * i] + ((int64_t)n[2 * i + 1] << 8);
+    }
+    out[15] &= 0x7fff;
+}
+
+static void feAdd(fe o, const fe a, const fe b) {
+    for (int i = 0; i < 16; i++) {
+        o[i] = a[i] + b[i];
+    }
+}
+
+static void feSub(fe o, const fe a, const fe b) {
+    for (int i = 0; i < 16; i++) {
+        o[i] = a[i] - b[i];
+    }
+}
+
+static void feMul(fe o, const fe a, const fe b) {
+    int64_t t[31] = {};
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 16; j++) {
+            t[i + j] += a[i] * b[j];
+        }
+    }
+    // 2^256 = 38 mod p
+    for (int i = 0; i < 15; i++) {
+        t[i] += 38 * t[i + 16];
+    }
+    memcpy(o, t, sizeof(fe));
+    feCarry(o);
+    feCarry(o);
+}
+
+static void feInvert(fe o, const fe in) {
+    // in^(p - 2)
+    fe c;
+    memcpy(c, in, sizeof(fe));
+    for (int a = 253; a >= 0; a--) {
+        feMul(c, c, c);
+        if (a != 2 && a != 4) {
+            feMul(c, c, in);
+        }
+    }
+    memcpy(o, c, sizeof(fe));
+}
+
+static void x25519Ladder(uint8_t* out, const uint8_t* scalar, const uint8_t* point) {
+    uint8_t z[32];
+    memcpy(z, scalar, 32);
+    z[31] = (z[31] & 127) | 64;
+    z[0] &= 248;
+
+    fe x, a = { 1 }, b, c = { 0 }, d = { 1 }, e, f;
+    feUnpack(x, point);
+    memcpy(b, x, sizeof(fe));
+
+    // Montgomery ladder
+    for (int i = 254; i >= 0; i--) {
+        int64_t bit = (z[i >> 3] >> (i & 7)) & 1;
+        feSwap(a, b, bit);
+        feSwap(c, d, bit);
+        feAdd(e, a, c);
+        feSub(a, a, c);
+        feAdd(c, b, d);
+        feSub(b, b, d);
+        feMul(d, e, e);
+        feMul(f, a, a);
+        feMul(a, c, a);
+        feMul(c, b, e);
+        feAdd(e, a, c);
+        feSub(a, a, c);
+        feMul(b, a, a);
+        feSub(c, d, f);
+        feMul(a, c, FE_121665);
+        feAdd(a, a, d);
+        feMul(c, c, a);
+        feMul(a, d, f);
+        feMul(d, b, x);
+        feMul(b, e, e);
+        feSwap(a, b, bit);
+        feSwap(c, d, bit);
+    }
+    feInvert(c, c);
+    feMul(a, a, c);
+    fePack(out, a);
+}
+
+// --- SHA-256 (FIPS 180-4), for the shared secret only ---
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static void sha256Block(uint32_t* h, const uint8_t* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 |
+               (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t v[8];
+    memcpy(v, h, sizeof(v));
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = rotr(v[4], 6) ^ rotr(v[4], 11) ^ rotr(v[4], 25);
+        uint32_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+        uint32_t t1 = v[7] + s1 + ch + SHA256_K[i] + w[i];
+        uint32_t s0 = rotr(v[0], 2) ^ rotr(v[0], 13) ^ rotr(v[0], 22);
+        uint32_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+        memmove(v + 1, v, 7 * sizeof(uint32_t));
+        v[4] += t1;
+        v[0] = t1 + s0 + maj;
+    }
+    for (int i = 0; i < 8; i++) {
+        h[i] += v[i];
+    }
+}
+
+// Hash a single 32-byte input (always fits one padded block)
+static void sha256Single(const uint8_t* in, uint8_t* out) {
+    uint32_t h[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    uint8_t block[64] = {};
+    memcpy(block, in, PKI_KEY_SIZE);
+    block[PKI_KEY_SIZE] = 0x80;
+    block[62] = (PKI_KEY_SIZE * 8) >> 8;
+    block[63] = (PKI_KEY_SIZE * 8) & 0xff;
+    sha256Block(h, block);
+    for (int i = 0; i < 8; i++) {
+        out[4 * i] = h[i] >> 24;
+        out[4 * i + 1] = h[i] >> 16;
+        out[4 * i + 2] = h[i] >> 8;
+        out[4 * i + 3] = h[i];
+    }
+}
+
+#else
+
+#include <mbedtls/ecp.h>
+#include <mbedtls/sha256.h>
+#include <mbedtls/version.h>
+
+// Randomness for the scalar blinding mbedtls_ecp_mul does
+static int fillRandom(void*, unsigned char* out, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        out[i] = esp_random();
+    }
+    return 0;
+}
+
+#endif // PKI_CRYPTO_SOFTWARE
+
+bool PkiCrypto::x25519(uint8_t* out, const uint8_t* scalar, const uint8_t* point) {
+#ifdef PKI_CRYPTO_SOFTWARE
+    x25519Ladder(out, scalar, point);
+    return true;
+#else
+    // mbedtls wants a clamped scalar and a u-coordinate below 2^255
+    uint8_t z[PKI_KEY_SIZE];
+    uint8_t u[PKI_KEY_SIZE];
+    memcpy(z, scalar, PKI_KEY_SIZE);
+    z[31] = (z[31] & 127) | 64;
+    z[0] &= 248;
+    memcpy(u, point, PKI_KEY_SIZE);
+    u[31] &= 127;
+
+    mbedtls_ecp_group group;
+    mbedtls_mpi d;
+    mbedtls_ecp_point q, r;
+    mbedtls_ecp_group_init(&group);
+    mbedtls_mpi_init(&d);
+    mbedtls_ecp_point_init(&q);
+    mbedtls_ecp_point_init(&r);
+
+    bool ok = mbedtls_ecp_group_load(&group, MBEDTLS_ECP_DP_CURVE25519) == 0 &&
+              mbedtls_mpi_read_binary_le(&d, z, PKI_KEY_SIZE) == 0 &&
+              mbedtls_mpi_read_binary_le(&q.X, u, PKI_KEY_SIZE) == 0 &&
+              mbedtls_mpi_lset(&q.Z, 1) == 0 &&
+              mbedtls_ecp_mul(&group, &r, &d, &q, fillRandom, nullptr) == 0 &&
+              mbedtls_mpi_write_binary_le(&r.X, out, PKI_KEY_SIZE) == 0;
+
+    mbedtls_ecp_point_free(&r);
+    mbedtls_ecp_point_free(&q);
+    mbedtls_mpi_free(&d);
+    mbedtls_ecp_group_free(&group);
+    memset(z, 0, sizeof(z));
+    return ok;
+#endif
+}
+
+void PkiCrypto::sha256Key(const uint8_t* in, uint8_t* out) {
+#ifdef PKI_CRYPTO_SOFTWARE
+    sha256Single(in, out);
+#elif MBEDTLS_VERSION_NUMBER >= 0x03000000
+    mbedtls_sha256(in, PKI_KEY_SIZE, out, 0);
+#else
+    mbedtls_sha256_ret(in, PKI_KEY_SIZE, out, 0);
+#endif
+}
+
+PkiCrypto::PkiCrypto()
+    : lock(nullptr)
+    , nodeNum(0)
+    , keysLoaded(false)
+    , peerCount(0)
+    , useCounter(0)
+    , decrypted(0)
+    , decryptFailed(0)
+    , encrypted(0)
+    , cacheHits(0)
+    , cacheMisses(0)
+    , deriveMicrosTotal(0)
+    , messageMicrosTotal(0) {
+    memset(cache, 0, sizeof(cache));
+}
+
+bool PkiCrypto::begin(uint32_t nodeNum) {
+    this->nodeNum = nodeNum;
+    lock = xSemaphoreCreateMutex();
+    return lock != nullptr;
+}
+
+bool PkiCrypto::setKeys(const uint8_t* privateKey, const uint8_t* publicKey) {
+    static const uint8_t BASE_POINT[PKI_KEY_SIZE] = { 9 };
+    uint8_t derived[PKI_KEY_SIZE];
+    if (!x25519(derived, privateKey, BASE_POINT)) {
+        Serial.println("PKI: private key rejected");
+        return false;
+    }
+    if (publicKey != nullptr && memcmp(derived, publicKey, PKI_KEY_SIZE) != 0) {
+        Serial.println("PKI: public key does not match the private key, using the derived one");
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    memcpy(this->privateKey, privateKey, PKI_KEY_SIZE);
+    memcpy(this->publicKey, derived, PKI_KEY_SIZE);
+    memset(cache, 0, sizeof(cache));
+    keysLoaded = true;
+    xSemaphoreGive(lock);
+    return true;
+}
+
+bool PkiCrypto::hasKeys() {
+    return keysLoaded;
+}
+
+// --- Peers and the secret cache (call with the lock held) ---
+
+PkiPeer* PkiCrypto::findPeer(uint32_t node) {
+    for (uint16_t i = 0; i < peerCount; i++) {
+        if (peers[i].node == node) {
+            return &peers[i];
+        }
+    }
+    return nullptr;
+}
+
+void PkiCrypto::dropSecret(uint32_t node) {
+    for (int i = 0; i < PKI_CACHE_SIZE; i++) {
+        if (cache[i].node == node) {
+            cache[i].node = 0;
+        }
+    }
+}
+
+bool PkiCrypto::derive(const uint8_t* privateKey, const uint8_t* publicKey, ChannelKey& out) {
+    uint8_t shared[PKI_KEY_SIZE];
+    if (!x25519(shared, privateKey, publicKey)) {
+        return false;
+    }
+
+    // A low-order public key gives an all-zero secret
+    uint8_t any = 0;
+    for (int i = 0; i < PKI_KEY_SIZE; i++) {
+        any |= shared[i];
+    }
+    if (any == 0) {
+        return false;
+    }
+
+    uint8_t key[PKI_KEY_SIZE];
+    sha256Key(shared, key);
+    ChannelCrypto::setKey(out, key, PKI_KEY_SIZE);
+    return true;
+}
+
+ChannelKey* PkiCrypto::sharedKey(uint32_t node) {
+    useCounter++;
+    PkiSecret* victim = &cache[0];
+    for (int i = 0; i < PKI_CACHE_SIZE; i++) {
+        if (cache[i].node == node) {
+            cache[i].lastUsed = useCounter;
+            cacheHits++;
+            return &cache[i].key;
+        }
+        if (cache[i].node == 0 || (victim->node != 0 && cache[i].lastUsed < victim->lastUsed)) {
+            victim = &cache[i];
+        }
+    }
+
+    PkiPeer* peer = findPeer(node);
+    if (peer == nullptr) {
+        return nullptr;
+    }
+    cacheMisses++;
+    unsigned long start = micros();
+    victim->node = 0;
+    if (!derive(privateKey, peer->publicKey, victim->key)) {
+        Serial.printf("PKI: rejected public key of 0x%08X\n", node);
+        return nullptr;
+    }
+    deriveMicrosTotal += micros() - start;
+    victim->node = node;
+    victim->lastUsed = useCounter;
+    return &victim->key;
+}
+
+bool PkiCrypto::handleNodeInfo(const meshtastic_MeshPacket& packet) {
+    meshtastic_User user = meshtastic_User_init_zero;
+    pb_istream_t stream = pb_istream_from_buffer(packet.decoded.payload.bytes, packet.decoded.payload.size);
+    if (!pb_decode(&stream, meshtastic_User_fields, &user)) {
+        Serial.printf("PKI: malformed NodeInfo from 0x%08X\n", packet.from);
+        return false;
+    }
+    if (user.public_key.size != PKI_KEY_SIZE || packet.from == nodeNum) {
+        return true;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    PkiPeer* peer = findPeer(packet.from);
+    if (peer == nullptr) {
+        if (peerCount < PKI_MAX_PEERS) {
+            peer = &peers[peerCount++];
+        } else {
+            // Forget the node heard from least recently
+            peer = &peers[0];
+            for (uint16_t i = 1; i < peerCount; i++) {
+                if ((int32_t)(peers[i].lastHeard - peer->lastHeard) < 0) {
+                    peer = &peers[i];
+                }
+            }
+            dropSecret(peer->node);
+        }
+        peer->node = packet.from;
+    } else if (memcmp(peer->publicKey, user.public_key.bytes, PKI_KEY_SIZE) != 0) {
+        Serial.printf("PKI: 0x%08X changed its public key\n", packet.from);
+        dropSecret(packet.from);
+    }
+    memcpy(peer->publicKey, user.public_key.bytes, PKI_KEY_SIZE);
+    peer->lastHeard = millis();
+    xSemaphoreGive(lock);
+    return true;
+}
+
+// --- AES-CCM: 13-byte nonce, 8-byte tag, no associated data ---
+
+void PkiCrypto::makeNonce(uint32_t packetId, uint32_t from, uint32_t extraNonce, uint8_t* nonce) {
+    // Packet id (64-bit LE, upper half replaced by the extra nonce), then the sender
+    memset(nonce, 0, 13);
+    for (int i = 0; i < 4; i++) {
+        nonce[i] = packetId >> (8 * i);
+        nonce[4 + i] = extraNonce >> (8 * i);
+        nonce[8 + i] = from >> (8 * i);
+    }
+}
+
+void PkiCrypto::ccmMac(ChannelKey& key, const uint8_t* nonce, const uint8_t* data, size_t length, uint8_t* mac) {
+    // B0: flags (tag size, 2-byte length field), nonce, message length
+    uint8_t block[CRYPTO_BLOCK_SIZE];
+    block[0] = ((PKI_TAG_SIZE - 2) / 2) << 3 | 1;
+    memcpy(block + 1, nonce, 13);
+    block[14] = length >> 8;
+    block[15] = length & 0xff;
+    ChannelCrypto::encryptBlock(key, block, mac);
+
+    for (size_t offset = 0; offset < length; offset += CRYPTO_BLOCK_SIZE) {
+        size_t n = min((size_t)CRYPTO_BLOCK_SIZE, length - offset);
+        for (size_t i = 0; i < n; i++) {
+            mac[i] ^= data[offset + i];
+        }
+        ChannelCrypto::encryptBlock(key, mac, mac);
+    }
+}
+
+void PkiCrypto::ccmCtr(ChannelKey& key, const uint8_t* nonce, uint16_t counter, uint8_t* data, size_t length) {
+    uint8_t block[CRYPTO_BLOCK_SIZE];
+    uint8_t stream[CRYPTO_BLOCK_SIZE];
+    block[0] = 1;
+    memcpy(block + 1, nonce, 13);
+
+    for (size_t offset = 0; offset < length; offset += CRYPTO_BLOCK_SIZE, counter++) {
+        block[14] = counter >> 8;
+        block[15] = counter & 0xff;
+        ChannelCrypto::encryptBlock(key, block, stream);
+        size_t n = min((size_t)CRYPTO_BLOCK_SIZE, length - offset);
+        for (size_t i = 0; i < n; i++) {
+            data[offset + i] ^= stream[i];
+        }
+    }
+}
+
+void PkiCrypto::ccmEncrypt(ChannelKey& key, const uint8_t* nonce, uint8_t* data, size_t length, uint8_t* tag) {
+    uint8_t mac[CRYPTO_BLOCK_SIZE];
+    ccmMac(key, nonce, data, length, mac);
+    ccmCtr(key, nonce, 1, data, length);
+    memcpy(tag, mac, PKI_TAG_SIZE);
+    ccmCtr(key, nonce, 0, tag, PKI_TAG_SIZE);
+}
+
+bool PkiCrypto::ccmDecrypt(ChannelKey& key, const uint8_t* nonce, uint8_t* data, size_t length, const uint8_t* tag) {
+    uint8_t expected[PKI_TAG_SIZE];
+    memcpy(expected, tag, PKI_TAG_SIZE);
+    ccmCtr(key, nonce, 0, expected, PKI_TAG_SIZE);
+    ccmCtr(key, nonce, 1, data, length);
+
+    uint8_t mac[CRYPTO_BLOCK_SIZE];
+    ccmMac(key, nonce, data, length, mac);
+    uint8_t diff = 0;
+    for (int i = 0; i < PKI_TAG_SIZE; i++) {
+        diff |= mac[i] ^ expected[i];
+    }
+    if (diff != 0) {
+        ccmCtr(key, nonce, 1, data, length);  // Put the ciphertext back
+        return false;
+    }
+    return true;
+}
+
+// --- Packets ---
+
+bool PkiCrypto::decrypt(meshtastic_MeshPacket& packet) {
+    // PKI packets go out on channel 0 (no hash) to a single node
+    if (packet.which_payload_variant != meshtastic_MeshPacket_encrypted_tag || !keysLoaded ||
+        packet.channel != 0 || packet.to != nodeNum || packet.encrypted.size <= PKI_OVERHEAD) {
+        return false;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    ChannelKey* key = sharedKey(packet.from);
+    if (key == nullptr) {
+        xSemaphoreGive(lock);
+        return false;
+    }
+    unsigned long start = micros();
+
+    uint8_t* bytes = packet.encrypted.bytes;
+    size_t length = packet.encrypted.size - PKI_OVERHEAD;
+    const uint8_t* tail = bytes + length + PKI_TAG_SIZE;
+    uint32_t extraNonce = tail[0] | tail[1] << 8 | tail[2] << 16 | (uint32_t)tail[3] << 24;
+    uint8_t nonce[13];
+    makeNonce(packet.id, packet.from, extraNonce, nonce);
+    bool ok = ccmDecrypt(*key, nonce, bytes, length, bytes + length);
+
+    // Static: Data is large for the loop() stack
+    static meshtastic_Data data;
+    memset(&data, 0, sizeof(data));
+    if (ok) {
+        pb_istream_t stream = pb_istream_from_buffer(bytes, length);
+        ok = pb_decode(&stream, meshtastic_Data_fields, &data);
+    }
+    if (ok) {
+        packet.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+        packet.decoded = data;
+        packet.pki_encrypted = true;
+        memcpy(packet.public_key.bytes, findPeer(packet.from)->publicKey, PKI_KEY_SIZE);
+        packet.public_key.size = PKI_KEY_SIZE;
+        decrypted++;
+        messageMicrosTotal += micros() - start;
+    } else {
+        decryptFailed++;
+    }
+    xSemaphoreGive(lock);
+    return ok;
+}
+
+bool PkiCrypto::encrypt(meshtastic_MeshPacket& packet) {
+    if (packet.which_payload_variant != meshtastic_MeshPacket_decoded_tag || !keysLoaded ||
+        packet.to == 0xFFFFFFFF || packet.to == 0 || packet.to == nodeNum) {
+        return false;
+    }
+    // Same exemptions as the Meshtastic firmware: these must stay readable by relays
+    switch (packet.decoded.portnum) {
+        case meshtastic_PortNum_TRACEROUTE_APP:
+        case meshtastic_PortNum_NODEINFO_APP:
+        case meshtastic_PortNum_ROUTING_APP:
+        case meshtastic_PortNum_POSITION_APP:
+            return false;
+        default:
+            break;
+    }
+
+    static uint8_t buffer[sizeof(meshtastic_MeshPacket_encrypted_t::bytes)];
+    pb_ostream_t stream = pb_ostream_from_buffer(buffer, sizeof(buffer) - PKI_OVERHEAD);
+    if (!pb_encode(&stream, meshtastic_Data_fields, &packet.decoded)) {
+        return false;
+    }
+    size_t length = stream.bytes_written;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    ChannelKey* key = sharedKey(packet.to);
+    if (key == nullptr) {
+        xSemaphoreGive(lock);
+        return false;
+    }
+    unsigned long start = micros();
+
+    if (packet.id == 0) {
+        packet.id = esp_random();
+    }
+    packet.from = nodeNum;
+    uint32_t extraNonce = esp_random();
+    uint8_t nonce[13];
+    makeNonce(packet.id, packet.from, extraNonce, nonce);
+    ccmEncrypt(*key, nonce, buffer, length, buffer + length);
+    for (int i = 0; i < 4; i++) {
+        buffer[length + PKI_TAG_SIZE + i] = extraNonce >> (8 * i);
+    }
+
+    packet.which_payload_variant = meshtastic_MeshPacket_encrypted_tag;
+    memcpy(packet.encrypted.bytes, buffer, length + PKI_OVERHEAD);
+    packet.encrypted.size = length + PKI_OVERHEAD;
+    packet.channel = 0;
+    packet.pki_encrypted = true;
+    memcpy(packet.public_key.bytes, findPeer(packet.to)->publicKey, PKI_KEY_SIZE);
+    packet.public_key.size = PKI_KEY_SIZE;
+
+    encrypted++;
+    messageMicrosTotal += micros() - start;
+    xSemaphoreGive(lock);
+    return true;
+}
+
+void PkiCrypto::printStats() {
+    Serial.println("=== PKI Stats ===");
+    int cached = 0;
+    for (int i = 0; i < PKI_CACHE_SIZE; i++) {
+        cached += cache[i].node != 0;
+    }
+    Serial.printf("Keys: %s, peers: %u, cached secrets: %d/%d\n", keysLoaded ? "loaded" : "none",
+                  peerCount, cached, PKI_CACHE_SIZE);
+    Serial.printf("Decrypted: %u (%u failed), encrypted: %u\n", decrypted, decryptFailed, encrypted);
+    uint32_t lookups = cacheHits + cacheMisses;
+    if (lookups > 0) {
+        Serial.printf("Secret cache: %u hits, %u misses (%u%% hit rate)\n",
+                      cacheHits, cacheMisses, cacheHits * 100 / lookups);
+    }
+    if (cacheMisses > 0) {
+        Serial.printf("Key derivation: %u us avg\n", deriveMicrosTotal / cacheMisses);
+    }
+    if (decrypted + encrypted > 0) {
+        Serial.printf("Per message: %u us avg\n", messageMicrosTotal / (decrypted + encrypted));
+    }
+}
@@ -0,0 +1,309 @@
+#include "PositionStore.h"
+#include <pb_decode.h>
+
+#define EARTH_RADIUS_KM   6371.0f
+#define DEG_TO_RAD_E7     (PI / 180.0f / 1e7f)
+#define CELL_KM           (POSITION_CELL_SIZE * DEG_TO_RAD_E7 * EARTH_RADIUS_KM)
+
+PositionStore::PositionStore()
+    : count(0)
+    , queueHead(0)
+    , queueTail(0)
+    , positionsReceived(0)
+    , positionsDropped(0)
+    , nodesEvicted(0)
+    , queryCount(0)
+    , queryMicrosTotal(0)
+    , queryMicrosMax(0)
+    , recordsVisited(0) {
+    memset(records, 0, sizeof(records));
+    for (int i = 0; i < POSITION_NODE_BUCKETS; i++) {
+        nodeBuckets[i] = POSITION_NONE;
+    }
+    for (int i = 0; i < POSITION_GRID_BUCKETS; i++) {
+        gridBuckets[i] = POSITION_NONE;
+    }
+}
+
+bool PositionStore::handlePacket(const meshtastic_MeshPacket& packet) {
+    return handlePacket(packet, packet.from);
+}
+
+bool PositionStore::handlePacket(const meshtastic_MeshPacket& packet, uint32_t node) {
+    meshtastic_Position position = meshtastic_Position_init_zero;
+    pb_istream_t stream = pb_istream_from_buffer(packet.decoded.payload.bytes, packet.decoded.payload.size);
+    if (!pb_decode(&stream, meshtastic_Position_fields, &position)) {
+        Serial.printf("Position: malformed packet from 0x%08X\n", node);
+        return false;
+    }
+
+    // No fix yet
+    if (!position.has_latitude_i || !position.has_longitude_i ||
+        (position.latitude_i == 0 && position.longitude_i == 0)) {
+        return false;
+    }
+
+    uint8_t next = (queueTail + 1) % POSITION_QUEUE_DEPTH;
+    if (next == queueHead) {
+        positionsDropped++;
+        return false;
+    }
+
+    PendingPosition& pending = queue[queueTail];
+    pending.node = node;
+    pending.latitude_i = position.latitude_i;
+    pending.longitude_i = position.longitude_i;
+    pending.altitude = position.has_altitude ? position.altitude : 0;
+    pending.timestamp = position.timestamp ? position.timestamp : position.time;
+    pending.precision = position.precision_bits;
+    queueTail = next;
+    return true;
+}
+
+void PositionStore::update() {
+    while (queueHead != queueTail) {
+        storePosition(queue[queueHead]);
+        queueHead = (queueHead + 1) % POSITION_QUEUE_DEPTH;
+    }
+}
+
+void PositionStore::storePosition(const PendingPosition& position) {
+    uint16_t index = findNode(position.node);
+    if (index == POSITION_NONE) {
+        index = allocateRecord();
+        PositionRecord& record = records[index];
+        record.node = position.node;
+        record.inUse = true;
+        record.nodeNext = nodeBuckets[position.node % POSITION_NODE_BUCKETS];
+        nodeBuckets[position.node % POSITION_NODE_BUCKETS] = index;
+        count++;
+    } else {
+        unlinkCell(index);
+    }
+
+    PositionRecord& record = records[index];
+    record.latitude_i = position.latitude_i;
+    record.longitude_i = position.longitude_i;
+    record.altitude = constrain(position.altitude, INT16_MIN, INT16_MAX);
+    record.timestamp = position.timestamp;
+    record.precision = position.precision;
+    record.heardAt = millis() / 1000;
+    linkCell(index);
+    positionsReceived++;
+}
+
+const PositionRecord* PositionStore::getPosition(uint32_t node) {
+    uint16_t index = findNode(node);
+    return index == POSITION_NONE ? nullptr : &records[index];
+}
+
+size_t PositionStore::size() {
+    return count;
+}
+
+uint16_t PositionStore::findNode(uint32_t node) {
+    uint16_t index = nodeBuckets[node % POSITION_NODE_BUCKETS];
+    while (index != POSITION_NONE && records[index].node != node) {
+        index = records[index].nodeNext;
+    }
+    return index;
+}
+
+uint16_t PositionStore::allocateRecord() {
+    uint16_t oldest = 0;
+    for (uint16_t i = 0; i < POSITION_MAX_NODES; i++) {
+        if (!records[i].inUse) {
+            return i;
+        }
+        if (records[i].heardAt < records[oldest].heardAt) {
+            oldest = i;
+        }
+    }
+
+    // Full - forget the node heard from longest ago
+    unlinkCell(oldest);
+    unlinkNode(oldest);
+    records[oldest].inUse = false;
+    count--;
+    nodesEvicted++;
+    return oldest;
+}
+
+int32_t PositionStore::cellOf(int32_t coordinate) {
+    // Floor division, so cells do not straddle the equator/meridian
+    return coordinate >= 0 ? coordinate / POSITION_CELL_SIZE
+                           : -((-(int64_t)coordinate + POSITION_CELL_SIZE - 1) / POSITION_CELL_SIZE);
+}
+
+uint16_t PositionStore::cellBucket(int32_t cellLat, int32_t cellLon) {
+    uint32_t hash = (uint32_t)cellLat * 73856093u ^ (uint32_t)cellLon * 19349663u;
+    return hash % POSITION_GRID_BUCKETS;
+}
+
+void PositionStore::linkCell(uint16_t index) {
+    PositionRecord& record = records[index];
+    uint16_t bucket = cellBucket(cellOf(record.latitude_i), cellOf(record.longitude_i));
+    record.cellNext = gridBuckets[bucket];
+    gridBuckets[bucket] = index;
+}
+
+void PositionStore::unlinkCell(uint16_t index) {
+    PositionRecord& record = records[index];
+    uint16_t* link = &gridBuckets[cellBucket(cellOf(record.latitude_i), cellOf(record.longitude_i))];
+    while (*link != POSITION_NONE && *link != index) {
+        link = &records[*link].cellNext;
+    }
+    if (*link == index) {
+        *link = record.cellNext;
+    }
+}
+
+void PositionStore::unlinkNode(uint16_t index) {
+    uint16_t* link = &nodeBuckets[records[index].node % POSITION_NODE_BUCKETS];
+    while (*link != POSITION_NONE && *link != index) {
+        link = &records[*link].nodeNext;
+    }
+    if (*link == index) {
+        *link = records[index].nodeNext;
+    }
+}
+
+float PositionStore::distanceKm(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2) {
+    // Equirectangular approximation - well within position precision at mesh ranges
+    float meanLat = ((float)lat1 + (float)lat2) / 2 * DEG_TO_RAD_E7;
+    float x = ((float)lon2 - (float)lon1) * DEG_TO_RAD_E7 * cosf(meanLat);
+    float y = ((float)lat2 - (float)lat1) * DEG_TO_RAD_E7;
+    return EARTH_RADIUS_KM * sqrtf(x * x + y * y);
+}
+
+// Insert into the nearest-first result list, keeping at most maxResults
+static void insertResult(PositionResult* results, size_t maxResults, size_t* found, uint32_t node, float distance) {
+    size_t pos = *found;
+    if (pos == maxResults) {
+        if (distance >= results[maxResults - 1].distanceKm) {
+            return;
+        }
+        pos--;
+    } else {
+        (*found)++;
+    }
+    while (pos > 0 && results[pos - 1].distanceKm > distance) {
+        results[pos] = results[pos - 1];
+        pos--;
+    }
+    results[pos].node = node;
+    results[pos].distanceKm = distance;
+}
+
+void PositionStore::visitCell(int32_t cellLat, int32_t cellLon, int32_t latitude_i, int32_t longitude_i,
+                              float limitKm, PositionResult* results, size_t maxResults, size_t* found) {
+    for (uint16_t index = gridBuckets[cellBucket(cellLat, cellLon)]; index != POSITION_NONE;
+         index = records[index].cellNext) {
+        const PositionRecord& record = records[index];
+        // Buckets are shared by colliding cells
+        if (cellOf(record.latitude_i) != cellLat || cellOf(record.longitude_i) != cellLon) {
+            continue;
+        }
+        recordsVisited++;
+        float distance = distanceKm(latitude_i, longitude_i, record.latitude_i, record.longitude_i);
+        if (distance <= limitKm) {
+            insertResult(results, maxResults, found, record.node, distance);
+        }
+    }
+}
+
+void PositionStore::scanAll(int32_t latitude_i, int32_t longitude_i, float limitKm,
+                            PositionResult* results, size_t maxResults, size_t* found) {
+    *found = 0;
+    for (uint16_t i = 0; i < POSITION_MAX_NODES; i++) {
+        if (!records[i].inUse) {
+            continue;
+        }
+        recordsVisited++;
+        float distance = distanceKm(latitude_i, longitude_i, records[i].latitude_i, records[i].longitude_i);
+        if (distance <= limitKm) {
+            insertResult(results, maxResults, found, records[i].node, distance);
+        }
+    }
+}
+
+void PositionStore::finishQuery(unsigned long startMicros) {
+    uint32_t elapsed = micros() - startMicros;
+    queryCount++;
+    queryMicrosTotal += elapsed;
+    queryMicrosMax = max(queryMicrosMax, elapsed);
+}
+
+size_t PositionStore::nearest(int32_t latitude_i, int32_t longitude_i, PositionResult* results, size_t maxResults) {
+    if (maxResults == 0 || count == 0) {
+        return 0;
+    }
+    unsigned long start = micros();
+
+    int32_t centerLat = cellOf(latitude_i);
+    int32_t centerLon = cellOf(longitude_i);
+    // Narrowest cell dimension here bounds how close ring r+1 can be
+    float cellKm = CELL_KM * min(1.0f, cosf(latitude_i * DEG_TO_RAD_E7));
+    size_t found = 0;
+
+    for (int32_t ring = 0; ring <= POSITION_MAX_RING; ring++) {
+        for (int32_t dLat = -ring; dLat <= ring; dLat++) {
+            // Only the border of the ring; the inside was visited already
+            int32_t step = (dLat == -ring || dLat == ring) ? 1 : 2 * ring;
+            for (int32_t dLon = -ring; dLon <= ring; dLon += step) {
+                visitCell(centerLat + dLat, centerLon + dLon, latitude_i, longitude_i,
+                          INFINITY, results, maxResults, &found);
+            }
+        }
+
+        if (found == count || (found == maxResults && results[found - 1].distanceKm <= ring * cellKm)) {
+            finishQuery(start);
+            return found;
+        }
+    }
+
+    // Sparse neighbourhood or near a pole - the grid does not help
+    scanAll(latitude_i, longitude_i, INFINITY, results, maxResults, &found);
+    finishQuery(start);
+    return found;
+}
+
+size_t PositionStore::within(int32_t latitude_i, int32_t longitude_i, float radiusKm,
+                             PositionResult* results, size_t maxResults) {
+    if (maxResults == 0 || count == 0) {
+        return 0;
+    }
+    unsigned long start = micros();
+    size_t found = 0;
+
+    float lonCellKm = CELL_KM * cosf(latitude_i * DEG_TO_RAD_E7);
+    int32_t spanLat = ceilf(radiusKm / CELL_KM);
+    int32_t spanLon = lonCellKm > 0.01f ? (int32_t)ceilf(radiusKm / lonCellKm) : INT32_MAX;
+
+    if (spanLon == INT32_MAX || (int64_t)(2 * spanLat + 1) * (2 * spanLon + 1) > POSITION_MAX_NODES) {
+        // More cells than nodes - a plain scan is cheaper
+        scanAll(latitude_i, longitude_i, radiusKm, results, maxResults, &found);
+    } else {
+        int32_t centerLat = cellOf(latitude_i);
+        int32_t centerLon = cellOf(longitude_i);
+        for (int32_t dLat = -spanLat; dLat <= spanLat; dLat++) {
+            for (int32_t dLon = -spanLon; dLon <= spanLon; dLon++) {
+                visitCell(centerLat + dLat, centerLon + dLon, latitude_i, longitude_i,
+                          radiusKm, results, maxResults, &found);
+            }
+        }
+    }
+
+    finishQuery(start);
+    return found;
+}
+
+void PositionStore::printStats() {
+    Serial.println("=== Position Stats ===");
+    Serial.printf("Nodes: %u/%u (%u bytes), %u updates, %u evicted, %u dropped\n",
+                  count, POSITION_MAX_NODES, sizeof(records), positionsReceived, nodesEvicted, positionsDropped);
+    if (queryCount > 0) {
+        Serial.printf("Query: %u us avg, %u us max, %u records visited per query\n",
+                      queryMicrosTotal / queryCount, queryMicrosMax, recordsVisited / queryCount);
+    }
+}
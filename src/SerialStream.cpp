@@ -0,0 +1,168 @@
+#include "SerialStream.h"
+
+SerialStream::SerialStream(Stream& port)
+    : port(port)
+    , state(WAIT_START1)
+    , frameLength(0)
+    , framePos(0)
+    , lineLength(0)
+    , lineOverflow(false)
+    , lastByteAt(0)
+    , active(false)
+    , framesReceived(0)
+    , framesSent(0)
+    , bytesReceived(0)
+    , badLengths(0)
+    , timeouts(0)
+    , linesReceived(0)
+    , linesTruncated(0) {
+}
+
+void SerialStream::onFrame(StreamFrameCallback callback) {
+    frameCallback = callback;
+}
+
+void SerialStream::onLine(StreamLineCallback callback) {
+    lineCallback = callback;
+}
+
+void SerialStream::update() {
+    // A client that stopped mid-frame must not swallow what comes next
+    if (state != WAIT_START1 && millis() - lastByteAt > STREAM_FRAME_TIMEOUT_MS) {
+        timeouts++;
+        state = WAIT_START1;
+    }
+
+    uint8_t chunk[STREAM_READ_CHUNK];
+    int available;
+    while ((available = port.available()) > 0) {
+        // No more than is buffered, so the read cannot wait
+        size_t length = port.readBytes(chunk, min(available, (int)sizeof(chunk)));
+        if (length == 0) {
+            break;
+        }
+        lastByteAt = millis();
+        feed(chunk, length);
+    }
+}
+
+void SerialStream::feed(const uint8_t* data, size_t length) {
+    bytesReceived += length;
+    size_t i = 0;
+    while (i < length) {
+        if (state == READ_PAYLOAD) {
+            // Bulk copy: payload bytes need no per-byte decisions
+            size_t take = min((size_t)(frameLength - framePos), length - i);
+            memcpy(frame + framePos, data + i, take);
+            framePos += take;
+            i += take;
+            if (framePos == frameLength) {
+                framesReceived++;
+                active = true;
+                // Bytes before a frame (e.g. wake-up bytes) are not a command
+                lineLength = 0;
+                lineOverflow = false;
+                state = WAIT_START1;
+                if (frameCallback) {
+                    frameCallback(frame, frameLength);
+                }
+            }
+        } else {
+            consume(data[i++]);
+        }
+    }
+}
+
+void SerialStream::consume(uint8_t byte) {
+    switch (state) {
+        case WAIT_START1:
+            if (byte == STREAM_START1) {
+                state = WAIT_START2;
+            } else {
+                lineByte(byte);
+            }
+            break;
+        case WAIT_START2:
+            state = WAIT_START1;
+            if (byte == STREAM_START2) {
+                state = READ_LENGTH_HIGH;
+            } else {
+                // Not a frame after all: the first byte was text
+                lineByte(STREAM_START1);
+                consume(byte);
+            }
+            break;
+        case READ_LENGTH_HIGH:
+            frameLength = byte << 8;
+            state = READ_LENGTH_LOW;
+            break;
+        case READ_LENGTH_LOW:
+            frameLength |= byte;
+            if (frameLength == 0 || frameLength > STREAM_MAX_FRAME) {
+                // Noise that looked like a header; look for the next one
+                badLengths++;
+                state = WAIT_START1;
+            } else {
+                framePos = 0;
+                state = READ_PAYLOAD;
+            }
+            break;
+        case READ_PAYLOAD:
+            break;   // Handled in feed()
+    }
+}
+
+void SerialStream::lineByte(uint8_t byte) {
+    if (byte == '\r') {
+        return;
+    }
+    if (byte != '\n') {
+        if (lineLength < STREAM_LINE_MAX) {
+            line[lineLength++] = byte;
+        } else {
+            lineOverflow = true;
+        }
+        return;
+    }
+
+    line[lineLength] = '\0';
+    if (lineOverflow) {
+        linesTruncated++;
+    }
+    lineLength = 0;
+    lineOverflow = false;
+    linesReceived++;
+    if (lineCallback) {
+        lineCallback(String(line));
+    }
+}
+
+bool SerialStream::send(const uint8_t* data, size_t length) {
+    if (length == 0 || length > STREAM_MAX_FRAME) {
+        return false;
+    }
+    // One write, so log output from other tasks cannot land inside the frame
+    uint8_t buffer[STREAM_HEADER_SIZE + STREAM_MAX_FRAME];
+    buffer[0] = STREAM_START1;
+    buffer[1] = STREAM_START2;
+    buffer[2] = length >> 8;
+    buffer[3] = length & 0xFF;
+    memcpy(buffer + STREAM_HEADER_SIZE, data, length);
+    if (port.write(buffer, STREAM_HEADER_SIZE + length) != STREAM_HEADER_SIZE + length) {
+        return false;
+    }
+    framesSent++;
+    return true;
+}
+
+bool SerialStream::isActive() {
+    return active;
+}
+
+void SerialStream::printStats() {
+    Serial.println("=== Serial Stream Stats ===");
+    Serial.printf("API client: %s; frames %u in, %u out; %u bytes in\n",
+                  active ? "yes" : "no", framesReceived, framesSent, bytesReceived);
+    Serial.printf("Resyncs: %u bad lengths, %u timeouts\n", badLengths, timeouts);
+    Serial.printf("Console: %u lines, %u truncated\n", linesReceived, linesTruncated);
+}
@@ -0,0 +1,559 @@
+#include "StoreForward.h"
+#include "MessageHandler.h"
+#include <pb_encode.h>
+#include <pb_decode.h>
+
+struct SFSectorHeader {
+    uint32_t magic;
+    uint32_t seq;
+};
+
+static_assert(sizeof(SFIndexEntry) * SF_MAX_MESSAGES == SF_INDEX_BYTES, "S&F index entry grew");
+
+static size_t recordSize(uint8_t textLength) {
+    return (sizeof(SFRecordHeader) + textLength + 3) & ~(size_t)3;
+}
+
+StoreForward::StoreForward()
+    : partition(nullptr)
+    , baseOffset(0)
+    , ready(false)
+    , writeSector(0)
+    , writeOffset(0)
+    , sectorSeq(0)
+    , firstNumber(1)
+    , nextNumber(1)
+    , epochBase(0)
+    , epochAt(0)
+    , bootTimeBase(0)
+    , lastRxTime(0)
+    , replaying(false)
+    , replayTo(0)
+    , replayNext(0)
+    , replayEnd(0)
+    , replayLeft(0)
+    , lastReplayAt(0)
+    , lastHeartbeatAt(0)
+    , recordHead(0)
+    , recordTail(0)
+    , requestHead(0)
+    , requestTail(0)
+    , messagesTotal(0)
+    , requests(0)
+    , requestsHistory(0)
+    , replayed(0)
+    , sectorsErased(0)
+    , writeErrors(0)
+    , droppedPending(0)
+    , queryCount(0)
+    , queryMicrosTotal(0)
+    , queryMicrosMax(0) {
+}
+
+bool StoreForward::begin() {
+#if STORE_FORWARD_ENABLED
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, SF_PARTITION_SUBTYPE, NULL);
+    if (partition == nullptr || partition->size < SF_FLASH_BYTES) {
+        Serial.println("S&F: no room in the data partition, router disabled");
+        return false;
+    }
+    baseOffset = partition->size - SF_FLASH_BYTES;
+
+    unsigned long start = millis();
+    if (!loadIndex()) {
+        Serial.println("S&F: failed to initialize history ring");
+        return false;
+    }
+    ready = true;
+
+    Serial.printf("S&F: router ready, %u messages in history (index rebuilt in %lu ms)\n",
+                  nextNumber - firstNumber, millis() - start);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void StoreForward::onSend(StoreForwardSendCallback callback) {
+    sendCallback = callback;
+}
+
+void StoreForward::recordPacket(const meshtastic_MeshPacket& packet) {
+    if (!ready || packet.which_payload_variant != meshtastic_MeshPacket_decoded_tag ||
+        packet.decoded.payload.size == 0) {
+        return;
+    }
+    uint8_t encoding;
+    if (packet.decoded.portnum == meshtastic_PortNum_TEXT_MESSAGE_APP) {
+        encoding = SF_TEXT_PLAIN;
+    } else if (packet.decoded.portnum == meshtastic_PortNum_TEXT_MESSAGE_COMPRESSED_APP) {
+        encoding = SF_TEXT_UNISHOX;
+    } else if (packet.decoded.portnum == TEXT_COMPRESSED_PORT) {
+        encoding = SF_TEXT_COMPRESSED;
+    } else {
+        return;
+    }
+
+    uint8_t next = (recordTail + 1) % SF_PENDING_DEPTH;
+    if (next == recordHead) {
+        droppedPending++;
+        return;
+    }
+
+    PendingRecord& record = pendingRecords[recordTail];
+    record.header.magic = SF_RECORD_MAGIC;
+    record.header.length = min((size_t)packet.decoded.payload.size, sizeof(record.text));
+    record.header.encoding = encoding;
+    record.header.rxTime = packet.rx_time;
+    record.header.from = packet.from;
+    record.header.to = packet.to;
+    record.header.packetId = packet.id;
+    memcpy(record.text, packet.decoded.payload.bytes, record.header.length);
+    recordTail = next;
+}
+
+bool StoreForward::handlePacket(const meshtastic_MeshPacket& packet) {
+    if (!ready) {
+        return false;
+    }
+
+    meshtastic_StoreAndForward message = meshtastic_StoreAndForward_init_zero;
+    pb_istream_t stream = pb_istream_from_buffer(packet.decoded.payload.bytes, packet.decoded.payload.size);
+    if (!pb_decode(&stream, meshtastic_StoreAndForward_fields, &message)) {
+        Serial.printf("S&F: malformed request from 0x%08X\n", packet.from);
+        return false;
+    }
+
+    // Only client requests are ours to answer; other routers' traffic is ignored
+    if (message.rr < meshtastic_StoreAndForward_RequestResponse_CLIENT_ERROR) {
+        return false;
+    }
+
+    uint8_t next = (requestTail + 1) % SF_PENDING_DEPTH;
+    if (next == requestHead) {
+        droppedPending++;
+        return false;
+    }
+
+    PendingRequest& request = pendingRequests[requestTail];
+    request.from = packet.from;
+    request.rr = message.rr;
+    request.window = 0;
+    request.lastRequest = 0;
+    if (message.which_variant == meshtastic_StoreAndForward_history_tag) {
+        request.window = message.variant.history.window;
+        request.lastRequest = message.variant.history.last_request;
+    }
+    requestTail = next;
+    return true;
+}
+
+void StoreForward::update() {
+    if (!ready) {
+        return;
+    }
+
+    while (recordHead != recordTail) {
+        PendingRecord& record = pendingRecords[recordHead];
+        if (!storeRecord(record)) {
+            writeErrors++;
+        }
+        recordHead = (recordHead + 1) % SF_PENDING_DEPTH;
+    }
+
+    while (requestHead != requestTail) {
+        handleRequest(pendingRequests[requestHead]);
+        requestHead = (requestHead + 1) % SF_PENDING_DEPTH;
+    }
+
+    unsigned long now = millis();
+    if (replaying && now - lastReplayAt >= SF_REPLAY_INTERVAL_MS) {
+        lastReplayAt = now;
+        replayNextMessage();
+    }
+
+    if (lastHeartbeatAt == 0 || now - lastHeartbeatAt >= SF_HEARTBEAT_PERIOD_S * 1000UL) {
+        lastHeartbeatAt = now;
+        sendHeartbeat();
+    }
+}
+
+// --- Flash ring ---
+
+bool StoreForward::loadIndex() {
+    // Order the written sectors by sequence number, then replay their records
+    uint8_t order[SF_FLASH_SECTORS];
+    uint32_t seqs[SF_FLASH_SECTORS];
+    uint8_t used = 0;
+
+    for (uint8_t sector = 0; sector < SF_FLASH_SECTORS; sector++) {
+        SFSectorHeader header;
+        if (esp_partition_read(partition, baseOffset + sector * SF_SECTOR_SIZE, &header, sizeof(header)) != ESP_OK ||
+            header.magic != SF_SECTOR_MAGIC) {
+            continue;
+        }
+        // Insertion sort - at most SF_FLASH_SECTORS entries, once at boot
+        uint8_t pos = used++;
+        while (pos > 0 && seqs[pos - 1] > header.seq) {
+            seqs[pos] = seqs[pos - 1];
+            order[pos] = order[pos - 1];
+            pos--;
+        }
+        seqs[pos] = header.seq;
+        order[pos] = sector;
+    }
+
+    if (used == 0) {
+        // Fresh ring: start at sector 0
+        writeSector = SF_FLASH_SECTORS - 1;
+        return advanceSector();
+    }
+
+    for (uint8_t i = 0; i < used; i++) {
+        scanSector(order[i]);
+    }
+    writeSector = order[used - 1];
+    sectorSeq = seqs[used - 1];
+
+    // Keep the clock monotonic across reboots until the radio tells us the time
+    bootTimeBase = lastRxTime + 1;
+    return true;
+}
+
+void StoreForward::scanSector(uint8_t sector) {
+    uint32_t sectorOffset = baseOffset + sector * SF_SECTOR_SIZE;
+    uint16_t offset = sizeof(SFSectorHeader);
+
+    while (offset + sizeof(SFRecordHeader) <= SF_SECTOR_SIZE) {
+        SFRecordHeader header;
+        if (esp_partition_read(partition, sectorOffset + offset, &header, sizeof(header)) != ESP_OK ||
+            header.magic != SF_RECORD_MAGIC || offset + recordSize(header.length) > SF_SECTOR_SIZE) {
+            break;
+        }
+
+        SFIndexEntry entry;
+        entry.rxTime = max(header.rxTime, lastRxTime);
+        entry.sector = sector;
+        entry.toHash = header.to & 0xFF;
+        entry.offset = offset | (header.to == BROADCAST_ADDR ? SF_ENTRY_BROADCAST : 0);
+        appendEntry(entry);
+        lastRxTime = entry.rxTime;
+
+        offset += recordSize(header.length);
+    }
+
+    writeOffset = offset;
+}
+
+bool StoreForward::storeRecord(const PendingRecord& record) {
+    size_t size = recordSize(record.header.length);
+    if (writeOffset + size > SF_SECTOR_SIZE && !advanceSector()) {
+        return false;
+    }
+
+    uint8_t buffer[sizeof(PendingRecord) + 4];
+    memset(buffer, 0xFF, size);
+    memcpy(buffer, &record.header, sizeof(SFRecordHeader));
+    memcpy(buffer + sizeof(SFRecordHeader), record.text, record.header.length);
+
+    // Packets without a radio timestamp get ours; either way the index stays sorted
+    SFRecordHeader* header = (SFRecordHeader*)buffer;
+    if (header->rxTime != 0) {
+        epochBase = header->rxTime;
+        epochAt = millis();
+    }
+    header->rxTime = max(currentTime(), lastRxTime);
+
+    uint32_t offset = baseOffset + writeSector * SF_SECTOR_SIZE + writeOffset;
+    if (esp_partition_write(partition, offset, buffer, size) != ESP_OK) {
+        Serial.println("S&F: flash write failed");
+        return false;
+    }
+
+    SFIndexEntry entry;
+    entry.rxTime = header->rxTime;
+    entry.sector = writeSector;
+    entry.toHash = header->to & 0xFF;
+    entry.offset = writeOffset | (header->to == BROADCAST_ADDR ? SF_ENTRY_BROADCAST : 0);
+    appendEntry(entry);
+
+    lastRxTime = header->rxTime;
+    writeOffset += size;
+    messagesTotal++;
+    return true;
+}
+
+bool StoreForward::advanceSector() {
+    uint8_t sector = (writeSector + 1) % SF_FLASH_SECTORS;
+
+    // The oldest messages live in the sector we are about to reuse
+    while (firstNumber < nextNumber && entryAt(firstNumber).sector == sector) {
+        firstNumber++;
+    }
+    if (replaying && replayNext < firstNumber) {
+        replayNext = firstNumber;
+    }
+
+    uint32_t offset = baseOffset + sector * SF_SECTOR_SIZE;
+    SFSectorHeader header = { SF_SECTOR_MAGIC, sectorSeq + 1 };
+    if (esp_partition_erase_range(partition, offset, SF_SECTOR_SIZE) != ESP_OK ||
+        esp_partition_write(partition, offset, &header, sizeof(header)) != ESP_OK) {
+        Serial.println("S&F: sector erase failed");
+        return false;
+    }
+
+    writeSector = sector;
+    writeOffset = sizeof(SFSectorHeader);
+    sectorSeq++;
+    sectorsErased++;
+    return true;
+}
+
+void StoreForward::appendEntry(const SFIndexEntry& entry) {
+    if (nextNumber - firstNumber >= SF_MAX_MESSAGES) {
+        // Index full - forget the oldest message (its flash space is reused later)
+        firstNumber++;
+    }
+    entryAt(nextNumber) = entry;
+    nextNumber++;
+}
+
+SFIndexEntry& StoreForward::entryAt(uint32_t number) {
+    return entries[number % SF_MAX_MESSAGES];
+}
+
+// --- History queries ---
+
+uint32_t StoreForward::currentTime() {
+    if (epochBase != 0) {
+        return epochBase + (millis() - epochAt) / 1000;
+    }
+    return bootTimeBase + millis() / 1000;
+}
+
+uint32_t StoreForward::lowerBound(uint32_t rxTime) {
+    // First message number with entry.rxTime >= rxTime
+    uint32_t lo = firstNumber;
+    uint32_t hi = nextNumber;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (entryAt(mid).rxTime < rxTime) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool StoreForward::entryMatches(const SFIndexEntry& entry, uint32_t to) {
+    return (entry.offset & SF_ENTRY_BROADCAST) || entry.toHash == (to & 0xFF);
+}
+
+uint32_t StoreForward::findHistory(uint32_t to, uint32_t since, uint32_t lastRequest, uint32_t* count, uint32_t* end) {
+    unsigned long start = micros();
+
+    uint32_t first = lowerBound(since);
+    if (lastRequest != 0 && lastRequest >= first && lastRequest < nextNumber) {
+        // Client already has everything up to lastRequest
+        first = lastRequest + 1;
+    }
+
+    // Candidate count: DMs are matched on the destination hash here and
+    // checked exactly when the record is read back for replay
+    uint32_t matches = 0;
+    uint32_t n = first;
+    for (; n < nextNumber && matches < SF_RETURN_MAX; n++) {
+        if (entryMatches(entryAt(n), to)) {
+            matches++;
+        }
+    }
+    *count = matches;
+    *end = n;
+
+    uint32_t elapsed = micros() - start;
+    queryCount++;
+    queryMicrosTotal += elapsed;
+    queryMicrosMax = max(queryMicrosMax, elapsed);
+    return first;
+}
+
+void StoreForward::handleRequest(const PendingRequest& request) {
+    requests++;
+
+    switch (request.rr) {
+        case meshtastic_StoreAndForward_RequestResponse_CLIENT_HISTORY:
+            requestsHistory++;
+            startReplay(request);
+            break;
+
+        case meshtastic_StoreAndForward_RequestResponse_CLIENT_STATS:
+            sendStats(request.from);
+            break;
+
+        case meshtastic_StoreAndForward_RequestResponse_CLIENT_PING: {
+            meshtastic_StoreAndForward pong = meshtastic_StoreAndForward_init_zero;
+            pong.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_PONG;
+            sendResponse(request.from, pong);
+            break;
+        }
+
+        case meshtastic_StoreAndForward_RequestResponse_CLIENT_ABORT:
+            if (replaying && replayTo == request.from) {
+                Serial.printf("S&F: replay to 0x%08X aborted\n", request.from);
+                replaying = false;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void StoreForward::startReplay(const PendingRequest& request) {
+    meshtastic_StoreAndForward response = meshtastic_StoreAndForward_init_zero;
+
+    if (replaying && replayTo != request.from) {
+        response.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_BUSY;
+        sendResponse(request.from, response);
+        return;
+    }
+
+    uint32_t window = request.window;
+    if (window == 0 || window > SF_HISTORY_WINDOW_MIN) {
+        window = SF_HISTORY_WINDOW_MIN;
+    }
+    uint32_t now = currentTime();
+    uint32_t since = now > window * 60 ? now - window * 60 : 0;
+
+    uint32_t count;
+    replayNext = findHistory(request.from, since, request.lastRequest, &count, &replayEnd);
+    replayTo = request.from;
+    replayLeft = count;
+    replaying = count > 0;
+    lastReplayAt = millis();
+
+    response.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_HISTORY;
+    response.which_variant = meshtastic_StoreAndForward_history_tag;
+    response.variant.history.history_messages = count;
+    response.variant.history.window = window * 60000;
+    response.variant.history.last_request = replayEnd - 1;  // Ask again from here for the rest
+    sendResponse(request.from, response);
+
+    Serial.printf("S&F: 0x%08X asked for %u min of history, replaying %u messages\n",
+                  request.from, window, count);
+}
+
+void StoreForward::replayNextMessage() {
+    while (replayNext < replayEnd && replayLeft > 0) {
+        uint32_t number = replayNext++;
+        if (number < firstNumber) {
+            continue;
+        }
+        const SFIndexEntry& entry = entryAt(number);
+        if (!entryMatches(entry, replayTo)) {
+            continue;
+        }
+
+        PendingRecord record;
+        uint32_t offset = baseOffset + entry.sector * SF_SECTOR_SIZE + (entry.offset & SF_ENTRY_OFFSET_MASK);
+        if (esp_partition_read(partition, offset, &record.header, sizeof(record.header)) != ESP_OK ||
+            record.header.magic != SF_RECORD_MAGIC ||
+            esp_partition_read(partition, offset + sizeof(SFRecordHeader), record.text, record.header.length) != ESP_OK) {
+            continue;
+        }
+        replayLeft--;
+
+        bool broadcast = record.header.to == BROADCAST_ADDR;
+        if ((!broadcast && record.header.to != replayTo) || record.header.from == replayTo) {
+            // Hash collision or the client's own message - costs no airtime
+            continue;
+        }
+
+        if (record.header.encoding != SF_TEXT_PLAIN) {
+            // StoreAndForward.text cannot say how its bytes are packed, so
+            // compressed text goes back out on its own port
+            meshtastic_Data data = meshtastic_Data_init_zero;
+            data.portnum = record.header.encoding == SF_TEXT_UNISHOX ? meshtastic_PortNum_TEXT_MESSAGE_COMPRESSED_APP
+                                                                     : TEXT_COMPRESSED_PORT;
+            data.payload.size = record.header.length;
+            memcpy(data.payload.bytes, record.text, record.header.length);
+            if (sendCallback) {
+                sendCallback(replayTo, data);
+            }
+            replayed++;
+            return;
+        }
+
+        meshtastic_StoreAndForward message = meshtastic_StoreAndForward_init_zero;
+        message.rr = broadcast ? meshtastic_StoreAndForward_RequestResponse_ROUTER_TEXT_BROADCAST
+                               : meshtastic_StoreAndForward_RequestResponse_ROUTER_TEXT_DIRECT;
+        message.which_variant = meshtastic_StoreAndForward_text_tag;
+        message.variant.text.size = record.header.length;
+        memcpy(message.variant.text.bytes, record.text, record.header.length);
+        sendResponse(replayTo, message);
+        replayed++;
+        return;
+    }
+
+    replaying = false;
+}
+
+void StoreForward::sendHeartbeat() {
+    meshtastic_StoreAndForward message = meshtastic_StoreAndForward_init_zero;
+    message.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_HEARTBEAT;
+    message.which_variant = meshtastic_StoreAndForward_heartbeat_tag;
+    message.variant.heartbeat.period = SF_HEARTBEAT_PERIOD_S;
+    message.variant.heartbeat.secondary = 0;
+    sendResponse(BROADCAST_ADDR, message);
+}
+
+void StoreForward::sendStats(uint32_t to) {
+    meshtastic_StoreAndForward message = meshtastic_StoreAndForward_init_zero;
+    message.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_STATS;
+    message.which_variant = meshtastic_StoreAndForward_stats_tag;
+    meshtastic_StoreAndForward_Statistics& stats = message.variant.stats;
+    stats.messages_total = messagesTotal;
+    stats.messages_saved = nextNumber - firstNumber;
+    stats.messages_max = SF_MAX_MESSAGES;
+    stats.up_time = millis() / 1000;
+    stats.requests = requests;
+    stats.requests_history = requestsHistory;
+    stats.heartbeat = true;
+    stats.return_max = SF_RETURN_MAX;
+    stats.return_window = SF_HISTORY_WINDOW_MIN;
+    sendResponse(to, message);
+}
+
+void StoreForward::sendResponse(uint32_t to, const meshtastic_StoreAndForward& message) {
+    if (!sendCallback) {
+        return;
+    }
+
+    meshtastic_Data data = meshtastic_Data_init_zero;
+    data.portnum = meshtastic_PortNum_STORE_FORWARD_APP;
+    pb_ostream_t stream = pb_ostream_from_buffer(data.payload.bytes, sizeof(data.payload.bytes));
+    if (!pb_encode(&stream, meshtastic_StoreAndForward_fields, &message)) {
+        Serial.println("S&F: encode failed");
+        return;
+    }
+    data.payload.size = stream.bytes_written;
+    sendCallback(to, data);
+}
+
+void StoreForward::printStats() {
+    Serial.println("=== Store & Forward Stats ===");
+    if (!ready) {
+        Serial.println("Router disabled");
+        return;
+    }
+    Serial.printf("History: %u/%u messages (%u KB index), %u stored total, %u sectors erased\n",
+                  nextNumber - firstNumber, SF_MAX_MESSAGES, SF_INDEX_BYTES / 1024, messagesTotal, sectorsErased);
+    Serial.printf("Requests: %u (%u history), %u messages replayed%s\n",
+                  requests, requestsHistory, replayed, replaying ? ", replay in progress" : "");
+    if (queryCount > 0) {
+        Serial.printf("History query: %u us avg, %u us max over %u queries\n",
+                      queryMicrosTotal / queryCount, queryMicrosMax, queryCount);
+    }
+    Serial.printf("Write errors: %u, dropped while busy: %u\n", writeErrors, droppedPending);
+}
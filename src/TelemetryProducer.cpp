@@ -0,0 +1,281 @@
+#include "TelemetryProducer.h"
+#include <pb_encode.h>
+
+// Placeholder id used to locate the id bytes in the encoded frame
+#define TELEMETRY_ID_SENTINEL 0x7E1E7E1E
+
+// Encoded DeviceMetrics with every field present: tag+byte for the battery
+// level (< 128), three tag+fixed32 floats and the uptime tag, then the
+// uptime varint
+#define METRICS_FIXED_BYTES   18
+
+static size_t varintLength(uint32_t value) {
+    size_t length = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        length++;
+    }
+    return length;
+}
+
+static void writeVarint(uint8_t* out, uint32_t value) {
+    while (value >= 0x80) {
+        *out++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    *out = value;
+}
+
+static void writeFixed32(uint8_t* out, uint32_t value) {
+    out[0] = value;
+    out[1] = value >> 8;
+    out[2] = value >> 16;
+    out[3] = value >> 24;
+}
+
+static void writeFloat(uint8_t* out, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    writeFixed32(out, bits);
+}
+
+TelemetryProducer::TelemetryProducer()
+    : nodeNum(0)
+    , hasBattery(false)
+    , batteryLevel(0)
+    , voltage(0)
+    , charging(false)
+    , sentLevel(0)
+    , sentVoltage(0)
+    , sentCharging(false)
+    , frameLength(0)
+    , idOffset(0)
+    , metricsOffset(0)
+    , uptimeOffset(0)
+    , uptimeLength(0)
+    , frameValid(false)
+    , nextSendAt(0)
+    , lastSendAt(0)
+    , scheduledSends(0)
+    , changeSends(0)
+    , encodes(0)
+    , encodeMicros(0)
+    , sendMicros(0)
+    , sendMicrosMax(0) {
+    memset(txAirtime, 0, sizeof(txAirtime));
+    memset(rxAirtime, 0, sizeof(rxAirtime));
+    memset(binMinute, 0, sizeof(binMinute));
+}
+
+void TelemetryProducer::begin(uint32_t nodeNum) {
+    this->nodeNum = nodeNum;
+}
+
+void TelemetryProducer::onSend(FromRadioSendCallback callback) {
+    sendCallback = callback;
+}
+
+void TelemetryProducer::updateBattery(uint8_t level, float voltage, bool charging) {
+    // Meshtastic reports > 100 while externally powered
+    this->batteryLevel = charging ? 101 : level;
+    this->voltage = voltage;
+    this->charging = charging;
+
+    if (!hasBattery) {
+        hasBattery = true;
+        scheduleNext(TELEMETRY_FIRST_SEND_MS, TELEMETRY_FIRST_SEND_MS / 2);
+    }
+}
+
+uint8_t TelemetryProducer::binFor(uint32_t minute) {
+    uint8_t bin = minute % TELEMETRY_AIRTIME_MINUTES;
+    if (binMinute[bin] != minute) {
+        binMinute[bin] = minute;
+        txAirtime[bin] = 0;
+        rxAirtime[bin] = 0;
+    }
+    return bin;
+}
+
+void TelemetryProducer::recordAirtime(bool tx, size_t bytes) {
+    uint8_t bin = binFor(millis() / 60000);
+    uint32_t ms = (bytes + TELEMETRY_AIRTIME_OVERHEAD) * TELEMETRY_AIRTIME_MS_PER_BYTE;
+    uint16_t* bins = tx ? txAirtime : rxAirtime;
+    bins[bin] = min((uint32_t)UINT16_MAX, bins[bin] + ms);
+}
+
+float TelemetryProducer::utilization(uint8_t minutes, bool includeRx) {
+    uint32_t now = millis() / 60000;
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < minutes && i <= now; i++) {
+        uint8_t bin = (now - i) % TELEMETRY_AIRTIME_MINUTES;
+        if (binMinute[bin] != now - i) {
+            continue;
+        }
+        total += txAirtime[bin];
+        if (includeRx) {
+            total += rxAirtime[bin];
+        }
+    }
+    return 100.0f * total / (minutes * 60000.0f);
+}
+
+meshtastic_Telemetry TelemetryProducer::snapshot() {
+    meshtastic_Telemetry telemetry = meshtastic_Telemetry_init_zero;
+    telemetry.which_variant = meshtastic_Telemetry_device_metrics_tag;
+    meshtastic_DeviceMetrics& m = telemetry.variant.device_metrics;
+    m.has_battery_level = true;
+    m.battery_level = batteryLevel;
+    m.has_voltage = true;
+    m.voltage = voltage;
+    m.has_channel_utilization = true;
+    m.channel_utilization = utilization(TELEMETRY_CHUTIL_MINUTES, true);
+    m.has_air_util_tx = true;
+    m.air_util_tx = utilization(TELEMETRY_AIRTIME_MINUTES, false);
+    m.has_uptime_seconds = true;
+    m.uptime_seconds = millis() / 1000;
+    return telemetry;
+}
+
+bool TelemetryProducer::encodeFrame(uint32_t uptime) {
+    unsigned long start = micros();
+    frameValid = false;
+
+    meshtastic_Telemetry telemetry = snapshot();
+    telemetry.variant.device_metrics.uptime_seconds = uptime;
+
+    meshtastic_FromRadio fromRadio = meshtastic_FromRadio_init_zero;
+    fromRadio.which_payload_variant = meshtastic_FromRadio_packet_tag;
+    meshtastic_MeshPacket& packet = fromRadio.packet;
+    packet.from = nodeNum;
+    packet.to = 0xFFFFFFFF;  // Broadcast
+    packet.id = TELEMETRY_ID_SENTINEL;
+    packet.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    packet.decoded.portnum = meshtastic_PortNum_TELEMETRY_APP;
+
+    pb_ostream_t stream = pb_ostream_from_buffer(packet.decoded.payload.bytes, sizeof(packet.decoded.payload.bytes));
+    if (!pb_encode(&stream, meshtastic_Telemetry_fields, &telemetry)) {
+        Serial.println("Telemetry: encode failed");
+        return false;
+    }
+    packet.decoded.payload.size = stream.bytes_written;
+
+    if (!encode_from_radio(frame, sizeof(frame), &fromRadio, &frameLength)) {
+        Serial.println("Telemetry: frame encode failed");
+        return false;
+    }
+
+    // Locate the patchable fields: the id (tag 6, fixed32) and the metrics,
+    // which end the payload
+    idOffset = 0;
+    const uint8_t idTag = (meshtastic_MeshPacket_id_tag << 3) | PB_WT_32BIT;
+    for (size_t i = 0; i + 5 <= frameLength; i++) {
+        uint32_t value = frame[i + 1] | frame[i + 2] << 8 | frame[i + 3] << 16 | (uint32_t)frame[i + 4] << 24;
+        if (frame[i] == idTag && value == TELEMETRY_ID_SENTINEL) {
+            idOffset = i + 1;
+            break;
+        }
+    }
+
+    const uint8_t* payload = packet.decoded.payload.bytes;
+    size_t payloadLength = packet.decoded.payload.size;
+    uptimeLength = varintLength(uptime);
+    size_t payloadOffset = 0;
+    for (size_t i = 0; i + payloadLength <= frameLength; i++) {
+        if (memcmp(frame + i, payload, payloadLength) == 0) {
+            payloadOffset = i;
+            break;
+        }
+    }
+    uptimeOffset = payloadOffset + payloadLength - uptimeLength;
+    metricsOffset = uptimeOffset - METRICS_FIXED_BYTES;
+
+    encodes++;
+    encodeMicros += micros() - start;
+
+    if (idOffset == 0 || payloadOffset == 0 ||
+        frame[metricsOffset] != ((meshtastic_DeviceMetrics_battery_level_tag << 3) | PB_WT_VARINT) ||
+        frame[uptimeOffset - 1] != ((meshtastic_DeviceMetrics_uptime_seconds_tag << 3) | PB_WT_VARINT)) {
+        Serial.println("Telemetry: unexpected frame layout");
+        return false;
+    }
+
+    frameValid = true;
+    return true;
+}
+
+bool TelemetryProducer::significantChange() {
+    return abs((int)batteryLevel - (int)sentLevel) >= TELEMETRY_BATTERY_DELTA ||
+           fabsf(voltage - sentVoltage) >= TELEMETRY_VOLTAGE_DELTA ||
+           charging != sentCharging;
+}
+
+void TelemetryProducer::scheduleNext(unsigned long interval, unsigned long jitter) {
+    // Spread sends so nodes booted together do not transmit together
+    nextSendAt = millis() + interval - jitter + esp_random() % (2 * jitter + 1);
+}
+
+void TelemetryProducer::update() {
+    if (!hasBattery || !sendCallback) {
+        return;
+    }
+
+    unsigned long now = millis();
+    if ((long)(now - nextSendAt) >= 0) {
+        send(true);
+    } else if (lastSendAt != 0 && now - lastSendAt >= TELEMETRY_MIN_SPACING_MS && significantChange()) {
+        send(false);
+    }
+}
+
+void TelemetryProducer::send(bool scheduled) {
+    unsigned long start = micros();
+    uint32_t uptime = millis() / 1000;
+
+    if (!frameValid || varintLength(uptime) != uptimeLength) {
+        if (!encodeFrame(uptime)) {
+            scheduleNext(TELEMETRY_SEND_INTERVAL_MS, TELEMETRY_SEND_JITTER_MS);
+            return;
+        }
+    }
+
+    // Patch the fresh readings into the cached frame
+    frame[metricsOffset + 1] = batteryLevel;
+    writeFloat(frame + metricsOffset + 3, voltage);
+    writeFloat(frame + metricsOffset + 8, utilization(TELEMETRY_CHUTIL_MINUTES, true));
+    writeFloat(frame + metricsOffset + 13, utilization(TELEMETRY_AIRTIME_MINUTES, false));
+    writeVarint(frame + uptimeOffset, uptime);
+    writeFixed32(frame + idOffset, esp_random());
+
+    sendCallback(frame, frameLength);
+
+    uint32_t elapsed = micros() - start;
+    sendMicros += elapsed;
+    sendMicrosMax = max(sendMicrosMax, elapsed);
+
+    sentLevel = batteryLevel;
+    sentVoltage = voltage;
+    sentCharging = charging;
+    lastSendAt = millis();
+    if (scheduled) {
+        scheduledSends++;
+    } else {
+        changeSends++;
+    }
+    scheduleNext(TELEMETRY_SEND_INTERVAL_MS, TELEMETRY_SEND_JITTER_MS);
+}
+
+void TelemetryProducer::printStats() {
+    Serial.println("=== Local Telemetry Stats ===");
+    Serial.printf("Battery %u%%, %.2fV, ch util %.1f%%, air tx %.2f%%\n", batteryLevel, voltage,
+                  utilization(TELEMETRY_CHUTIL_MINUTES, true), utilization(TELEMETRY_AIRTIME_MINUTES, false));
+    uint32_t sends = scheduledSends + changeSends;
+    Serial.printf("Sent: %u scheduled, %u on change, %u encodes\n", scheduledSends, changeSends, encodes);
+    if (sends > 0) {
+        Serial.printf("Per send: %u us avg, %u us max (encode %u us avg)\n",
+                      sendMicros / sends, sendMicrosMax, encodes ? encodeMicros / encodes : 0);
+    }
+    if (hasBattery) {
+        Serial.printf("Next scheduled send in %ld s\n", (long)(nextSendAt - millis()) / 1000);
+    }
+}
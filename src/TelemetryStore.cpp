@@ -0,0 +1,378 @@
+#include "TelemetryStore.h"
+#include <pb_decode.h>
+
+// Quantization: stored value = reading * scale, clamped to int16
+static const float METRIC_SCALE[METRIC_COUNT] = {
+    1,      // battery level, %
+    1000,   // voltage, mV
+    100,    // channel utilization, 0.01%
+    100,    // air util tx, 0.01%
+    100,    // temperature, 0.01 C
+    100,    // relative humidity, 0.01%
+    10,     // barometric pressure, 0.1 hPa
+    1000,   // power voltage, mV
+    1       // power current, mA
+};
+
+static const char* METRIC_NAMES[METRIC_COUNT] = {
+    "battery", "voltage", "ch_util", "air_tx", "temp", "humidity", "pressure", "pwr_v", "pwr_ma"
+};
+
+// Shown to users: decimals and unit per metric
+static const uint8_t METRIC_DECIMALS[METRIC_COUNT] = { 0, 2, 1, 1, 1, 0, 0, 2, 0 };
+static const char* METRIC_UNITS[METRIC_COUNT] = { "%", "V", "%", "%", "C", "%", "hPa", "V", "mA" };
+
+static int16_t quantize(TelemetryMetric metric, float value) {
+    float scaled = value * METRIC_SCALE[metric];
+    if (scaled > 32767) return 32767;
+    if (scaled < -32767) return -32767;
+    return (int16_t)lroundf(scaled);
+}
+
+TelemetryStore::TelemetryStore()
+    : queueHead(0)
+    , queueTail(0)
+    , packetsDecoded(0)
+    , samplesStored(0)
+    , samplesDropped(0)
+    , rawResets(0)
+    , seriesRecycled(0)
+    , queryCount(0)
+    , queryMicrosTotal(0)
+    , queryMicrosMax(0) {
+    memset(series, 0, sizeof(series));
+}
+
+const char* TelemetryStore::metricName(TelemetryMetric metric) {
+    return metric < METRIC_COUNT ? METRIC_NAMES[metric] : "?";
+}
+
+bool TelemetryStore::metricFromName(const char* name, TelemetryMetric* out) {
+    for (uint8_t i = 0; i < METRIC_COUNT; i++) {
+        if (strcmp(name, METRIC_NAMES[i]) == 0) {
+            *out = (TelemetryMetric)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TelemetryStore::formatValue(TelemetryMetric metric, float value, char* out, size_t outSize, bool withUnit) {
+    if (metric >= METRIC_COUNT) {
+        snprintf(out, outSize, "?");
+        return;
+    }
+    snprintf(out, outSize, "%.*f%s", METRIC_DECIMALS[metric], value, withUnit ? METRIC_UNITS[metric] : "");
+}
+
+bool TelemetryStore::handlePacket(const meshtastic_MeshPacket& packet) {
+    meshtastic_Telemetry telemetry = meshtastic_Telemetry_init_zero;
+    pb_istream_t stream = pb_istream_from_buffer(packet.decoded.payload.bytes, packet.decoded.payload.size);
+    if (!pb_decode(&stream, meshtastic_Telemetry_fields, &telemetry)) {
+        Serial.printf("Telemetry: malformed packet from 0x%08X\n", packet.from);
+        return false;
+    }
+
+    packetsDecoded++;
+    record(packet.from, telemetry);
+    return true;
+}
+
+void TelemetryStore::record(uint32_t node, const meshtastic_Telemetry& telemetry) {
+    uint32_t now = millis() / 1000;
+
+    switch (telemetry.which_variant) {
+        case meshtastic_Telemetry_device_metrics_tag: {
+            const meshtastic_DeviceMetrics& m = telemetry.variant.device_metrics;
+            if (m.has_battery_level) queueSample(node, METRIC_BATTERY_LEVEL, m.battery_level, now);
+            if (m.has_voltage) queueSample(node, METRIC_VOLTAGE, m.voltage, now);
+            if (m.has_channel_utilization) queueSample(node, METRIC_CHANNEL_UTILIZATION, m.channel_utilization, now);
+            if (m.has_air_util_tx) queueSample(node, METRIC_AIR_UTIL_TX, m.air_util_tx, now);
+            break;
+        }
+
+        case meshtastic_Telemetry_environment_metrics_tag: {
+            const meshtastic_EnvironmentMetrics& m = telemetry.variant.environment_metrics;
+            if (m.has_temperature) queueSample(node, METRIC_TEMPERATURE, m.temperature, now);
+            if (m.has_relative_humidity) queueSample(node, METRIC_RELATIVE_HUMIDITY, m.relative_humidity, now);
+            if (m.has_barometric_pressure) queueSample(node, METRIC_BAROMETRIC_PRESSURE, m.barometric_pressure, now);
+            break;
+        }
+
+        case meshtastic_Telemetry_power_metrics_tag: {
+            const meshtastic_PowerMetrics& m = telemetry.variant.power_metrics;
+            if (m.has_ch1_voltage) queueSample(node, METRIC_POWER_VOLTAGE, m.ch1_voltage, now);
+            if (m.has_ch1_current) queueSample(node, METRIC_POWER_CURRENT, m.ch1_current, now);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void TelemetryStore::queueSample(uint32_t node, TelemetryMetric metric, float value, uint32_t time) {
+    uint8_t next = (queueTail + 1) % TELEMETRY_QUEUE_DEPTH;
+    if (next == queueHead) {
+        samplesDropped++;
+        return;
+    }
+    PendingSample& sample = queue[queueTail];
+    sample.node = node;
+    sample.time = time;
+    sample.metric = metric;
+    sample.value = value;
+    queueTail = next;
+}
+
+void TelemetryStore::update() {
+    while (queueHead != queueTail) {
+        storeSample(queue[queueHead]);
+        queueHead = (queueHead + 1) % TELEMETRY_QUEUE_DEPTH;
+    }
+}
+
+void TelemetryStore::storeSample(const PendingSample& sample) {
+    TelemetrySeries* s = findSeries(sample.node, sample.metric);
+    if (s == nullptr) {
+        s = allocateSeries(sample.node, sample.metric);
+    }
+
+    int16_t value = quantize(sample.metric, sample.value);
+    appendRaw(*s, sample.time, value);
+    addToBuckets(s->minutes, TELEMETRY_MINUTE_BUCKETS, &s->minuteHead, &s->minuteCount,
+                 TELEMETRY_MINUTE_SECONDS, sample.time, value);
+    addToBuckets(s->quarters, TELEMETRY_QUARTER_BUCKETS, &s->quarterHead, &s->quarterCount,
+                 TELEMETRY_QUARTER_SECONDS, sample.time, value);
+    samplesStored++;
+}
+
+TelemetrySeries* TelemetryStore::findSeries(uint32_t node, TelemetryMetric metric) {
+    for (int i = 0; i < TELEMETRY_SERIES_SLOTS; i++) {
+        if (series[i].inUse && series[i].node == node && series[i].metric == metric) {
+            return &series[i];
+        }
+    }
+    return nullptr;
+}
+
+TelemetrySeries* TelemetryStore::allocateSeries(uint32_t node, TelemetryMetric metric) {
+    TelemetrySeries* slot = nullptr;
+    for (int i = 0; i < TELEMETRY_SERIES_SLOTS; i++) {
+        if (!series[i].inUse) {
+            slot = &series[i];
+            break;
+        }
+        if (slot == nullptr || series[i].lastTime < slot->lastTime) {
+            slot = &series[i];
+        }
+    }
+
+    if (slot->inUse) {
+        seriesRecycled++;
+    }
+    memset(slot, 0, sizeof(*slot));
+    slot->inUse = true;
+    slot->node = node;
+    slot->metric = metric;
+    return slot;
+}
+
+void TelemetryStore::appendRaw(TelemetrySeries& s, uint32_t time, int16_t value) {
+    if (s.rawCount > 0) {
+        uint32_t dt = time - s.lastTime;
+        int32_t dv = (int32_t)value - s.lastValue;
+        if (dt <= UINT16_MAX && dv >= INT16_MIN && dv <= INT16_MAX) {
+            if (s.rawCount == TELEMETRY_RAW_SAMPLES) {
+                // Drop the oldest sample: its successor becomes the new base
+                const TelemetryDelta& oldest = s.raw[s.rawHead];
+                s.baseTime += oldest.seconds;
+                s.baseValue += oldest.value;
+                s.rawHead = (s.rawHead + 1) % (TELEMETRY_RAW_SAMPLES - 1);
+                s.rawCount--;
+            }
+            TelemetryDelta& delta = s.raw[(s.rawHead + s.rawCount - 1) % (TELEMETRY_RAW_SAMPLES - 1)];
+            delta.seconds = dt;
+            delta.value = dv;
+            s.rawCount++;
+            s.lastTime = time;
+            s.lastValue = value;
+            return;
+        }
+        // Gap or jump too large for a delta - restart the raw ring here
+        // (older history is still in the buckets)
+        rawResets++;
+    }
+
+    s.baseTime = time;
+    s.baseValue = value;
+    s.lastTime = time;
+    s.lastValue = value;
+    s.rawHead = 0;
+    s.rawCount = 1;
+}
+
+void TelemetryStore::addToBuckets(TelemetryBucket* ring, uint8_t capacity, uint8_t* head, uint8_t* count,
+                                  uint32_t width, uint32_t time, int16_t value) {
+    uint32_t start = time - time % width;
+
+    if (*count > 0) {
+        TelemetryBucket& newest = ring[(*head + *count - 1) % capacity];
+        if (newest.start == start) {
+            newest.sum += value;
+            newest.min = min(newest.min, value);
+            newest.max = max(newest.max, value);
+            if (newest.count < UINT16_MAX) {
+                newest.count++;
+            }
+            return;
+        }
+    }
+
+    if (*count == capacity) {
+        *head = (*head + 1) % capacity;
+        (*count)--;
+    }
+    TelemetryBucket& bucket = ring[(*head + *count) % capacity];
+    bucket.start = start;
+    bucket.sum = value;
+    bucket.min = value;
+    bucket.max = value;
+    bucket.count = 1;
+    (*count)++;
+}
+
+uint32_t TelemetryStore::oldestTime(const TelemetrySeries& s) {
+    uint32_t oldest = s.baseTime;
+    if (s.quarterCount > 0) {
+        oldest = min(oldest, s.quarters[s.quarterHead].start);
+    }
+    return oldest;
+}
+
+bool TelemetryStore::query(uint32_t node, TelemetryMetric metric, uint32_t windowSeconds, TelemetrySummary* out) {
+    unsigned long startMicros = micros();
+
+    TelemetrySeries* s = findSeries(node, metric);
+    if (s == nullptr || out == nullptr) {
+        return false;
+    }
+
+    uint32_t now = millis() / 1000;
+    uint32_t from = now > windowSeconds ? now - windowSeconds : 0;
+
+    int32_t lo = INT16_MAX;
+    int32_t hi = INT16_MIN;
+    int64_t sum = 0;
+    uint32_t count = 0;
+
+    // Buckets cover the part of the window older than the raw ring. Pick the
+    // finer resolution if it reaches back far enough; the split is on a bucket
+    // boundary so no sample is counted twice.
+    uint32_t split = 0;
+    if (from < s->baseTime) {
+        const TelemetryBucket* ring = s->minutes;
+        uint8_t capacity = TELEMETRY_MINUTE_BUCKETS;
+        uint8_t head = s->minuteHead;
+        uint8_t ringCount = s->minuteCount;
+        uint32_t width = TELEMETRY_MINUTE_SECONDS;
+        if (ringCount == 0 || ring[head].start > from) {
+            ring = s->quarters;
+            capacity = TELEMETRY_QUARTER_BUCKETS;
+            head = s->quarterHead;
+            ringCount = s->quarterCount;
+            width = TELEMETRY_QUARTER_SECONDS;
+        }
+
+        split = (s->baseTime + width - 1) / width * width;
+        for (uint8_t i = 0; i < ringCount; i++) {
+            const TelemetryBucket& bucket = ring[(head + i) % capacity];
+            if (bucket.start >= split) {
+                break;
+            }
+            if (bucket.start + width <= from) {
+                continue;
+            }
+            lo = min(lo, (int32_t)bucket.min);
+            hi = max(hi, (int32_t)bucket.max);
+            sum += bucket.sum;
+            count += bucket.count;
+        }
+    }
+
+    // Raw samples from the split (or window start) onwards
+    uint32_t time = s->baseTime;
+    int32_t value = s->baseValue;
+    for (uint8_t i = 0; i < s->rawCount; i++) {
+        if (i > 0) {
+            const TelemetryDelta& delta = s->raw[(s->rawHead + i - 1) % (TELEMETRY_RAW_SAMPLES - 1)];
+            time += delta.seconds;
+            value += delta.value;
+        }
+        if (time < from || time < split) {
+            continue;
+        }
+        lo = min(lo, value);
+        hi = max(hi, value);
+        sum += value;
+        count++;
+    }
+
+    uint32_t elapsed = micros() - startMicros;
+    queryCount++;
+    queryMicrosTotal += elapsed;
+    queryMicrosMax = max(queryMicrosMax, elapsed);
+
+    if (count == 0) {
+        return false;
+    }
+
+    float scale = METRIC_SCALE[metric];
+    out->min = lo / scale;
+    out->max = hi / scale;
+    out->avg = (float)sum / count / scale;
+    out->count = count;
+    return true;
+}
+
+void TelemetryStore::printStats() {
+    Serial.println("=== Telemetry Stats ===");
+    Serial.printf("Packets: %u, samples stored: %u, dropped: %u, raw resets: %u\n",
+                  packetsDecoded, samplesStored, samplesDropped, rawResets);
+
+    uint32_t inUse = 0;
+    for (int i = 0; i < TELEMETRY_SERIES_SLOTS; i++) {
+        if (series[i].inUse) inUse++;
+    }
+    Serial.printf("Series: %u/%u in use (%u bytes each), %u recycled\n",
+                  inUse, TELEMETRY_SERIES_SLOTS, sizeof(TelemetrySeries), seriesRecycled);
+
+    // Memory per node-hour: series bytes held for a node over the time they cover
+    uint32_t now = millis() / 1000;
+    for (int i = 0; i < TELEMETRY_SERIES_SLOTS; i++) {
+        if (!series[i].inUse) continue;
+        bool first = true;
+        for (int j = 0; j < i; j++) {
+            if (series[j].inUse && series[j].node == series[i].node) first = false;
+        }
+        if (!first) continue;
+
+        uint32_t nodeSeries = 0;
+        uint32_t oldest = now;
+        for (int j = i; j < TELEMETRY_SERIES_SLOTS; j++) {
+            if (series[j].inUse && series[j].node == series[i].node) {
+                nodeSeries++;
+                oldest = min(oldest, oldestTime(series[j]));
+            }
+        }
+        float hours = max(now - oldest, (uint32_t)1) / 3600.0;
+        uint32_t bytes = nodeSeries * sizeof(TelemetrySeries);
+        Serial.printf("Node 0x%08X: %u series, %.2f h covered, %.0f bytes/node-hour\n",
+                      series[i].node, nodeSeries, hours, bytes / hours);
+    }
+
+    if (queryCount > 0) {
+        Serial.printf("Query: %u us avg, %u us max over %u queries\n",
+                      queryMicrosTotal / queryCount, queryMicrosMax, queryCount);
+    }
+}
@@ -0,0 +1,215 @@
+#include "TextCompressor.h"
+
+// Static codebook, built from typical mesh chat traffic: every printable
+// ASCII character (so plain text never needs escapes) plus frequent
+// English bigrams, word endings and short chat words.
+static const char* const CODEBOOK[TEXT_CODEBOOK_SIZE] PROGMEM = {
+    " ", "e", "t", "a", "o", "i", "n", "s", "r", "h", "l", "d",
+    "c", "u", "m", "f", "p", "g", "w", "y", "b", "v", "k", "x",
+    "j", "q", "z", "E", "T", "A", "O", "I", "N", "S", "R", "H",
+    "L", "D", "C", "U", "M", "F", "P", "G", "W", "Y", "B", "V",
+    "K", "X", "J", "Q", "Z", "0", "1", "2", "3", "4", "5", "6",
+    "7", "8", "9", ".", ",", "!", "?", "'", "\"", ":", ";", "-",
+    "(", ")", "/", "@", "#", "&", "*", "+", "=", "_", "\n", "e ",
+    "s ", "t ", "d ", "y ", "n ", "o ", "r ", ", ", ". ", "? ", "! ", "th",
+    "he", "in", "er", "an", "re", "on", "at", "en", "nd", "es", "or", "te",
+    "ed", "is", "it", "al", "ar", "st", "nt", "ng", "se", "ha", "ou", "le",
+    "ve", "me", "hi", "ll", "ea", "ri", "ro", "ne", "ce", "co", "de", "li",
+    "ch", "ma", "be", "om", "ur", "wh", " th", " a ", " i", " w", " s", " c",
+    " b", " h", " m", " f", " t", " o", " y", "the ", "the", "and ", "ing ", "ing",
+    "ion", "ent", "for ", "you ", "you", "are ", "was ", "that ", "this ", "with ", "have ", "not ",
+    "but ", "can ", "all ", "what ", "just ", "will ", "get ", "out ", "how ", "now ", "see ", "know ",
+    "here", "there", "going ", "good", "back ", "time", "home", "meet", "ok ", "ok", "lol", "yes",
+    "no ", "hey", "Hi ", "hi ", "I'm ", "I ", "my ", "me ", "we ", "it ", "is ", "be ",
+    "so ", "do ", "to ", "of ", "in ", "on ", "at ", "up ", "thanks", "please", "where ", "when ",
+    "mesh", "node", "test", "should", "there ", "need", "today", "ight"
+};
+
+static uint8_t codebookLength[TEXT_CODEBOOK_SIZE];
+
+TextCompressor::TextCompressor()
+    : compressCalls(0)
+    , compressIn(0)
+    , compressOut(0)
+    , compressMicros(0)
+    , decompressOut(0)
+    , decompressMicros(0) {
+    buildIndex();
+}
+
+void TextCompressor::buildIndex() {
+    // Bucket codebook entries by first byte (counting sort)
+    memset(firstCount, 0, sizeof(firstCount));
+    for (int i = 0; i < TEXT_CODEBOOK_SIZE; i++) {
+        codebookLength[i] = strlen(CODEBOOK[i]);
+        firstCount[(uint8_t)CODEBOOK[i][0]]++;
+    }
+
+    int start = 0;
+    for (int c = 0; c < 256; c++) {
+        firstStart[c] = start;
+        start += firstCount[c];
+    }
+
+    uint8_t fill[256];
+    memset(fill, 0, sizeof(fill));
+    for (int i = 0; i < TEXT_CODEBOOK_SIZE; i++) {
+        uint8_t c = (uint8_t)CODEBOOK[i][0];
+        byFirst[firstStart[c] + fill[c]++] = i;
+    }
+
+    // Longest entry first within each bucket, so the first hit is the best greedy match
+    for (int c = 0; c < 256; c++) {
+        uint8_t* bucket = &byFirst[firstStart[c]];
+        for (int i = 1; i < firstCount[c]; i++) {
+            uint8_t entry = bucket[i];
+            int j = i - 1;
+            while (j >= 0 && codebookLength[bucket[j]] < codebookLength[entry]) {
+                bucket[j + 1] = bucket[j];
+                j--;
+            }
+            bucket[j + 1] = entry;
+        }
+    }
+}
+
+bool TextCompressor::flushLiterals(const uint8_t* run, size_t runLen, uint8_t* out, size_t maxLen, size_t* pos) {
+    while (runLen > 0) {
+        size_t chunk = min(runLen, (size_t)256);
+        size_t needed = (chunk == 1) ? 2 : chunk + 2;
+        if (*pos + needed > maxLen) {
+            return false;
+        }
+
+        if (chunk == 1) {
+            out[(*pos)++] = TEXT_CODE_LITERAL;
+        } else {
+            out[(*pos)++] = TEXT_CODE_LITERAL_RUN;
+            out[(*pos)++] = chunk - 1;
+        }
+        memcpy(out + *pos, run, chunk);
+        *pos += chunk;
+
+        run += chunk;
+        runLen -= chunk;
+    }
+    return true;
+}
+
+size_t TextCompressor::compress(const uint8_t* text, size_t length, uint8_t* out, size_t maxLen) {
+    unsigned long start = micros();
+    size_t pos = 0;
+    size_t i = 0;
+    const uint8_t* literalStart = nullptr;
+    size_t literalLen = 0;
+
+    while (i < length) {
+        uint8_t c = text[i];
+        const uint8_t* bucket = &byFirst[firstStart[c]];
+        int match = -1;
+
+        for (int k = 0; k < firstCount[c]; k++) {
+            uint8_t entry = bucket[k];
+            uint8_t len = codebookLength[entry];
+            if (len <= length - i && memcmp(text + i, CODEBOOK[entry], len) == 0) {
+                match = entry;
+                break;
+            }
+        }
+
+        if (match < 0) {
+            // Not in the dictionary (e.g. UTF-8) - collect into a literal run
+            if (literalLen == 0) {
+                literalStart = text + i;
+            }
+            literalLen++;
+            i++;
+            continue;
+        }
+
+        if (literalLen > 0) {
+            if (!flushLiterals(literalStart, literalLen, out, maxLen, &pos)) {
+                return 0;
+            }
+            literalLen = 0;
+        }
+        if (pos >= maxLen) {
+            return 0;
+        }
+        out[pos++] = match;
+        i += codebookLength[match];
+    }
+
+    if (literalLen > 0 && !flushLiterals(literalStart, literalLen, out, maxLen, &pos)) {
+        return 0;
+    }
+
+    compressCalls++;
+    compressIn += length;
+    compressOut += pos;
+    compressMicros += micros() - start;
+    return pos;
+}
+
+size_t TextCompressor::decompress(const uint8_t* data, size_t length, uint8_t* out, size_t maxLen) {
+    unsigned long start = micros();
+    size_t pos = 0;
+    size_t i = 0;
+
+    while (i < length) {
+        uint8_t code = data[i++];
+        const uint8_t* src;
+        size_t len;
+        bool literal = true;
+
+        if (code == TEXT_CODE_LITERAL) {
+            len = 1;
+        } else if (code == TEXT_CODE_LITERAL_RUN) {
+            if (i >= length) {
+                return 0;
+            }
+            len = (size_t)data[i++] + 1;
+        } else if (code < TEXT_CODEBOOK_SIZE) {
+            len = codebookLength[code];
+            literal = false;
+        } else {
+            return 0;
+        }
+
+        if (literal) {
+            // Literal bytes follow the code in the input
+            if (len > length - i) {
+                return 0;
+            }
+            src = data + i;
+            i += len;
+        } else {
+            src = (const uint8_t*)CODEBOOK[code];
+        }
+
+        if (len > maxLen - pos) {
+            return 0;
+        }
+        memcpy(out + pos, src, len);
+        pos += len;
+    }
+
+    decompressOut += pos;
+    decompressMicros += micros() - start;
+    return pos;
+}
+
+void TextCompressor::printStats() {
+    Serial.println("=== Text Compression Stats ===");
+    if (compressIn == 0) {
+        Serial.println("No text compressed yet");
+    } else {
+        Serial.printf("Compressed %u msgs: %u -> %u bytes (%.1f%%)\n",
+                      compressCalls, compressIn, compressOut, 100.0 * compressOut / compressIn);
+        Serial.printf("Compress: %.0f ns/byte\n", 1000.0 * compressMicros / compressIn);
+    }
+    if (decompressOut > 0) {
+        Serial.printf("Decompress: %u bytes, %.0f ns/byte\n",
+                      decompressOut, 1000.0 * decompressMicros / decompressOut);
+    }
+}
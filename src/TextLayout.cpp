@@ -0,0 +1,184 @@
+#include "TextLayout.h"
+#include "Utf8Text.h"
+
+static const char ELLIPSIS[] = "...";
+
+TextLayout::TextLayout()
+    : cacheHits(0)
+    , cacheMisses(0)
+    , layoutMicrosTotal(0) {
+    memset(glyphWidth, 0, sizeof(glyphWidth));
+    invalidate();
+}
+
+void TextLayout::begin(U8G2& u8g2, const uint8_t* font) {
+    u8g2.setFont(font);
+    // Advance widths (not bounding boxes), so a run's width is their sum
+    for (int c = 32; c < 256; c++) {
+        glyphWidth[c] = u8g2_GetGlyphWidth(u8g2.getU8g2(), c);
+    }
+    invalidate();
+}
+
+void TextLayout::invalidate() {
+    for (int i = 0; i < LAYOUT_CACHE_SIZE; i++) {
+        cache[i].messageId = 0;
+    }
+}
+
+uint16_t TextLayout::width(const char* text, size_t length) {
+    uint16_t total = 0;
+    size_t pos = 0;
+    while (pos < length) {
+        total += advance(text, length, &pos);
+    }
+    return total;
+}
+
+// Width of the code point at *pos, which is moved past it
+uint8_t TextLayout::advance(const char* text, size_t length, size_t* pos) {
+    uint8_t glyph = Utf8Text::toGlyph(Utf8Text::decode(text, length, pos));
+    return glyph == UTF8_NO_GLYPH ? 0 : glyphWidth[glyph];
+}
+
+// Drop the last code point of text[0, length); returns the new length
+size_t TextLayout::trimLast(const char* text, size_t length, uint16_t* lineWidth) {
+    size_t last = length - 1;
+    while (last > 0 && ((uint8_t)text[last] & 0xC0) == 0x80) {
+        last--;
+    }
+    size_t pos = last;
+    *lineWidth -= advance(text, length, &pos);
+    return last;
+}
+
+const LayoutLines& TextLayout::lines(uint8_t slot, uint32_t messageId, const char* text, size_t length,
+                                     uint8_t maxWidth, uint8_t indent) {
+    // Stored ids are not contiguous, so they would collide; slots cannot
+    LayoutLines& entry = cache[slot % LAYOUT_CACHE_SIZE];
+    if (entry.messageId == messageId) {
+        cacheHits++;
+        return entry;
+    }
+
+    cacheMisses++;
+    unsigned long start = micros();
+    layout(text, length, maxWidth, indent, entry);
+    entry.messageId = messageId;
+    layoutMicrosTotal += micros() - start;
+    return entry;
+}
+
+void TextLayout::layout(const char* text, size_t length, uint8_t maxWidth, uint8_t indent, LayoutLines& out) {
+    out.count = 0;
+    out.elided = false;
+    size_t pos = 0;
+    uint16_t available = indent < maxWidth ? maxWidth - indent : 0;
+
+    while (pos < length && out.count < LAYOUT_MAX_LINES) {
+        // Wrapped lines do not start with the space they were broken at
+        if (out.count > 0) {
+            while (pos < length && text[pos] == ' ') {
+                pos++;
+            }
+            if (pos == length) {
+                break;
+            }
+        }
+
+        // Lines break between code points, never inside one
+        size_t lineStart = pos;
+        size_t lastSpace = 0;
+        uint16_t lineWidth = 0;
+        uint16_t widthAtSpace = 0;
+        uint8_t glyphs = 0;
+        while (pos < length && text[pos] != '\n') {
+            size_t next = pos;
+            uint8_t glyph = advance(text, length, &next);
+            if (lineWidth + glyph > available || glyphs >= LAYOUT_MAX_LINE_CHARS || next - lineStart > 255) {
+                break;
+            }
+            if (text[pos] == ' ') {
+                lastSpace = pos;
+                widthAtSpace = lineWidth;
+            }
+            lineWidth += glyph;
+            glyphs++;
+            pos = next;
+        }
+
+        size_t lineEnd = pos;
+        if (pos < length && text[pos] == '\n') {
+            pos++;
+        } else if (pos < length && lastSpace > lineStart) {
+            // Break at the last word boundary that fit
+            lineEnd = lastSpace;
+            lineWidth = widthAtSpace;
+            pos = lastSpace + 1;
+        } else if (pos < length && lineEnd == lineStart) {
+            // A single glyph wider than the line: place it anyway
+            lineWidth = advance(text, length, &pos);
+            lineEnd = pos;
+        }
+
+        out.start[out.count] = lineStart;
+        out.length[out.count] = lineEnd - lineStart;
+        out.width[out.count] = min(lineWidth, (uint16_t)255);
+        out.count++;
+        available = maxWidth;
+    }
+
+    while (pos < length && (text[pos] == ' ' || text[pos] == '\n')) {
+        pos++;
+    }
+    if (pos < length && out.count > 0) {
+        // Trim the last line until the ellipsis fits after it
+        out.elided = true;
+        uint8_t last = out.count - 1;
+        uint16_t lastAvailable = last == 0 ? maxWidth - min(indent, maxWidth) : maxWidth;
+        uint16_t ellipsis = width(ELLIPSIS, sizeof(ELLIPSIS) - 1);
+        uint16_t lastWidth = out.width[last];
+        while (out.length[last] > 0 && lastWidth + ellipsis > lastAvailable) {
+            out.length[last] = trimLast(text + out.start[last], out.length[last], &lastWidth);
+        }
+        out.width[last] = lastWidth;
+    }
+}
+
+void TextLayout::drawLine(U8G2& u8g2, int x, int y, const char* text, const LayoutLines& lines, uint8_t line,
+                          uint8_t clipWidth) {
+    char buffer[LAYOUT_MAX_LINE_CHARS + sizeof(ELLIPSIS)];
+    const char* start = text + lines.start[line];
+    size_t length = lines.length[line];
+    bool ellipsis = lines.elided && line == lines.count - 1;
+
+    if (clipWidth > 0) {
+        uint16_t lineWidth = lines.width[line];
+        uint16_t ellipsisWidth = width(ELLIPSIS, sizeof(ELLIPSIS) - 1);
+        while (length > 0 && lineWidth + ellipsisWidth > clipWidth) {
+            length = trimLast(start, length, &lineWidth);
+        }
+        ellipsis = true;
+    }
+
+    // One font glyph per code point
+    length = Utf8Text::toGlyphs(start, length, buffer, LAYOUT_MAX_LINE_CHARS + 1);
+    if (ellipsis) {
+        memcpy(buffer + length, ELLIPSIS, sizeof(ELLIPSIS) - 1);
+        length += sizeof(ELLIPSIS) - 1;
+    }
+    buffer[length] = '\0';
+    u8g2.drawStr(x, y, buffer);
+}
+
+void TextLayout::printStats() {
+    Serial.println("=== Text Layout Stats ===");
+    uint32_t lookups = cacheHits + cacheMisses;
+    if (lookups > 0) {
+        Serial.printf("Layout cache: %u hits, %u misses (%u%% hit rate)\n",
+                      cacheHits, cacheMisses, cacheHits * 100 / lookups);
+    }
+    if (cacheMisses > 0) {
+        Serial.printf("Layout: %u us avg per message\n", layoutMicrosTotal / cacheMisses);
+    }
+}
@@ -0,0 +1,56 @@
+#include "ToRadioQueue.h"
+
+static const char* const SOURCE_NAMES[TORADIO_SOURCES] = { "BLE", "serial" };
+
+ToRadioQueue::ToRadioQueue()
+    : queue(nullptr)
+    , dropped(0)
+    , depthMax(0) {
+    for (int i = 0; i < TORADIO_SOURCES; i++) {
+        received[i] = 0;
+    }
+}
+
+bool ToRadioQueue::begin() {
+    queue = xQueueCreate(TORADIO_QUEUE_DEPTH, sizeof(ToRadioFrame));
+    if (queue == nullptr) {
+        Serial.println("ToRadio queue allocation failed");
+        return false;
+    }
+    return true;
+}
+
+bool ToRadioQueue::push(ToRadioSource source, const uint8_t* data, size_t length) {
+    if (queue == nullptr || length == 0 || length > TORADIO_MAX_FRAME) {
+        dropped++;
+        return false;
+    }
+    ToRadioFrame frame;
+    frame.length = length;
+    frame.source = source;
+    memcpy(frame.data, data, length);
+    if (xQueueSend(queue, &frame, 0) != pdTRUE) {
+        dropped++;
+        return false;
+    }
+    received[source]++;
+    return true;
+}
+
+bool ToRadioQueue::pop(ToRadioFrame& frame) {
+    if (queue == nullptr) {
+        return false;
+    }
+    uint8_t depth = uxQueueMessagesWaiting(queue);
+    depthMax = max(depthMax, depth);
+    return xQueueReceive(queue, &frame, 0) == pdTRUE;
+}
+
+void ToRadioQueue::printStats() {
+    Serial.println("=== ToRadio Ingress Stats ===");
+    for (int i = 0; i < TORADIO_SOURCES; i++) {
+        Serial.printf("From %s: %u frames\n", SOURCE_NAMES[i], received[i].load());
+    }
+    Serial.printf("Dropped: %u (queue full or oversized), max depth %u of %d\n",
+                  dropped.load(), depthMax, TORADIO_QUEUE_DEPTH);
+}
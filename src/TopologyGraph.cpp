@@ -0,0 +1,500 @@
+#include "TopologyGraph.h"
+#include <pb_decode.h>
+
+TopologyGraph::TopologyGraph()
+    : nodesUsed(0)
+    , edgesUsed(0)
+    , useCounter(0)
+    , heapSize(0)
+    , queueHead(0)
+    , queueTail(0)
+    , lastExpiry(0)
+    , edgeUpdates(0)
+    , edgesExpired(0)
+    , updatesDropped(0)
+    , treesInvalidated(0)
+    , queries(0)
+    , cacheHits(0)
+    , queryMicrosTotal(0)
+    , queryMicrosMax(0) {
+    memset(nodes, 0, sizeof(nodes));
+    for (int i = 0; i < TOPOLOGY_NODE_BUCKETS; i++) {
+        nodeBuckets[i] = TOPOLOGY_NONE;
+    }
+    for (int i = 0; i < TOPOLOGY_CACHE_SLOTS; i++) {
+        cache[i].valid = false;
+    }
+    for (int i = 0; i < TOPOLOGY_MAX_NODES; i++) {
+        heapPos[i] = TOPOLOGY_NONE;
+    }
+}
+
+// --- Packet decoding ---
+
+bool TopologyGraph::handleTraceroute(const meshtastic_MeshPacket& packet) {
+    // Requests are still collecting hops; only replies carry the full route
+    if (packet.decoded.request_id == 0) {
+        return false;
+    }
+
+    meshtastic_RouteDiscovery route = meshtastic_RouteDiscovery_init_zero;
+    pb_istream_t stream = pb_istream_from_buffer(packet.decoded.payload.bytes, packet.decoded.payload.size);
+    if (!pb_decode(&stream, meshtastic_RouteDiscovery_fields, &route)) {
+        Serial.printf("Topology: malformed traceroute from 0x%08X\n", packet.from);
+        return false;
+    }
+
+    // Towards: requester -> route[] -> responder, SNR measured at each receiver
+    uint32_t previous = packet.to;
+    for (pb_size_t i = 0; i <= route.route_count; i++) {
+        uint32_t hop = i < route.route_count ? route.route[i] : packet.from;
+        int8_t snr = i < route.snr_towards_count ? route.snr_towards[i] : TOPOLOGY_SNR_UNKNOWN;
+        queueEdge(previous, hop, snr);
+        previous = hop;
+    }
+
+    // Back: responder -> route_back[] -> requester (only if it was recorded)
+    if (route.snr_back_count > 0) {
+        previous = packet.from;
+        for (pb_size_t i = 0; i <= route.route_back_count; i++) {
+            uint32_t hop = i < route.route_back_count ? route.route_back[i] : packet.to;
+            int8_t snr = i < route.snr_back_count ? route.snr_back[i] : TOPOLOGY_SNR_UNKNOWN;
+            queueEdge(previous, hop, snr);
+            previous = hop;
+        }
+    }
+    return true;
+}
+
+bool TopologyGraph::handleNeighborInfo(const meshtastic_MeshPacket& packet) {
+    meshtastic_NeighborInfo info = meshtastic_NeighborInfo_init_zero;
+    pb_istream_t stream = pb_istream_from_buffer(packet.decoded.payload.bytes, packet.decoded.payload.size);
+    if (!pb_decode(&stream, meshtastic_NeighborInfo_fields, &info)) {
+        Serial.printf("Topology: malformed neighbor info from 0x%08X\n", packet.from);
+        return false;
+    }
+
+    uint32_t node = info.node_id ? info.node_id : packet.from;
+    for (pb_size_t i = 0; i < info.neighbors_count; i++) {
+        // Neighbor SNR is in dB as heard by `node`
+        float snr = constrain(info.neighbors[i].snr * 4, -127.0f, 127.0f);
+        queueEdge(info.neighbors[i].node_id, node, (int8_t)snr);
+    }
+    return true;
+}
+
+void TopologyGraph::queueEdge(uint32_t from, uint32_t to, int8_t snr) {
+    // Unknown relays are reported as the broadcast address
+    if (from == to || from == 0 || to == 0 || from == 0xFFFFFFFF || to == 0xFFFFFFFF) {
+        return;
+    }
+
+    uint8_t next = (queueTail + 1) % TOPOLOGY_QUEUE_DEPTH;
+    if (next == queueHead) {
+        updatesDropped++;
+        return;
+    }
+    queue[queueTail].from = from;
+    queue[queueTail].to = to;
+    queue[queueTail].snr = snr;
+    queueTail = next;
+}
+
+void TopologyGraph::update() {
+    while (queueHead != queueTail) {
+        const PendingEdge& pending = queue[queueHead];
+        uint16_t from = addNode(pending.from);
+        uint16_t to = addNode(pending.to);
+        if (from != TOPOLOGY_NONE && to != TOPOLOGY_NONE) {
+            setEdge(from, to, pending.snr, 0);
+            // Links are roughly symmetric - assume the reverse until it is measured
+            setEdge(to, from, pending.snr, TOPOLOGY_EDGE_ESTIMATED);
+        } else {
+            updatesDropped++;
+        }
+        queueHead = (queueHead + 1) % TOPOLOGY_QUEUE_DEPTH;
+    }
+
+    if (millis() - lastExpiry >= 60000) {
+        lastExpiry = millis();
+        expireEdges();
+    }
+}
+
+// --- Nodes and edges ---
+
+uint16_t TopologyGraph::findNode(uint32_t num) {
+    uint16_t index = nodeBuckets[num % TOPOLOGY_NODE_BUCKETS];
+    while (index != TOPOLOGY_NONE && nodes[index].num != num) {
+        index = nodes[index].next;
+    }
+    return index;
+}
+
+uint16_t TopologyGraph::addNode(uint32_t num) {
+    uint16_t index = findNode(num);
+    if (index != TOPOLOGY_NONE) {
+        return index;
+    }
+
+    if (nodesUsed < TOPOLOGY_MAX_NODES) {
+        index = nodesUsed++;
+        // Cached trees were built without it: unreachable until an edge to it changes them
+        for (int i = 0; i < TOPOLOGY_CACHE_SLOTS; i++) {
+            cache[i].dist[index] = TOPOLOGY_UNREACHABLE;
+            cache[i].parent[index] = TOPOLOGY_NONE;
+        }
+    } else {
+        // Recycle a node whose links have all expired
+        for (uint16_t i = 0; i < TOPOLOGY_MAX_NODES; i++) {
+            if (nodes[i].edgeCount == 0 && nodes[i].inDegree == 0) {
+                index = i;
+                break;
+            }
+        }
+        if (index == TOPOLOGY_NONE) {
+            return TOPOLOGY_NONE;
+        }
+        uint16_t* link = &nodeBuckets[nodes[index].num % TOPOLOGY_NODE_BUCKETS];
+        while (*link != index) {
+            link = &nodes[*link].next;
+        }
+        *link = nodes[index].next;
+
+        // Trees may still name the old node
+        for (int i = 0; i < TOPOLOGY_CACHE_SLOTS; i++) {
+            cache[i].valid = false;
+        }
+    }
+
+    TopologyNode& node = nodes[index];
+    node.num = num;
+    node.edgeCount = 0;
+    node.inDegree = 0;
+    node.next = nodeBuckets[num % TOPOLOGY_NODE_BUCKETS];
+    nodeBuckets[num % TOPOLOGY_NODE_BUCKETS] = index;
+    return index;
+}
+
+TopologyEdge* TopologyGraph::findEdge(uint16_t from, uint16_t to) {
+    for (uint8_t i = 0; i < nodes[from].edgeCount; i++) {
+        if (edges[from][i].to == to) {
+            return &edges[from][i];
+        }
+    }
+    return nullptr;
+}
+
+uint16_t TopologyGraph::edgeCost(int8_t snr) {
+    if (snr == TOPOLOGY_SNR_UNKNOWN) {
+        snr = 0;
+    }
+    return TOPOLOGY_HOP_COST + constrain(TOPOLOGY_GOOD_SNR - snr, 0, TOPOLOGY_MAX_PENALTY);
+}
+
+void TopologyGraph::setEdge(uint16_t from, uint16_t to, int8_t snr, uint8_t flags) {
+    uint16_t minute = millis() / 60000;
+    bool estimated = flags & TOPOLOGY_EDGE_ESTIMATED;
+
+    TopologyEdge* edge = findEdge(from, to);
+    if (edge != nullptr) {
+        if (estimated && !(edge->flags & TOPOLOGY_EDGE_ESTIMATED)) {
+            // Never let a guess override a measurement
+            return;
+        }
+        uint16_t oldCost = edgeCost(edge->snr);
+        edge->snr = snr;
+        edge->flags = flags;
+        edge->seenMinute = minute;
+        edgeUpdates++;
+        if (edgeCost(snr) != oldCost) {
+            edgeChanged(from, to, oldCost, edgeCost(snr));
+        }
+        return;
+    }
+
+    TopologyNode& node = nodes[from];
+    if (node.edgeCount == TOPOLOGY_MAX_EDGES) {
+        // Make room: drop an estimated edge, else (for a measured edge) the stalest one
+        int victim = -1;
+        for (uint8_t i = 0; i < node.edgeCount; i++) {
+            if (edges[from][i].flags & TOPOLOGY_EDGE_ESTIMATED) {
+                victim = i;
+                break;
+            }
+        }
+        if (victim < 0 && !estimated) {
+            victim = 0;
+            for (uint8_t i = 1; i < node.edgeCount; i++) {
+                if ((uint16_t)(minute - edges[from][i].seenMinute) > (uint16_t)(minute - edges[from][victim].seenMinute)) {
+                    victim = i;
+                }
+            }
+        }
+        if (victim < 0) {
+            return;
+        }
+        removeEdge(from, victim);
+    }
+
+    TopologyEdge& added = edges[from][node.edgeCount++];
+    added.to = to;
+    added.snr = snr;
+    added.flags = flags;
+    added.seenMinute = minute;
+    nodes[to].inDegree++;
+    edgesUsed++;
+    edgeUpdates++;
+    edgeChanged(from, to, TOPOLOGY_UNREACHABLE, edgeCost(snr));
+}
+
+void TopologyGraph::removeEdge(uint16_t from, uint8_t slot) {
+    TopologyNode& node = nodes[from];
+    TopologyEdge removed = edges[from][slot];
+    edges[from][slot] = edges[from][node.edgeCount - 1];
+    node.edgeCount--;
+    nodes[removed.to].inDegree--;
+    edgesUsed--;
+    edgeChanged(from, removed.to, edgeCost(removed.snr), TOPOLOGY_UNREACHABLE);
+}
+
+void TopologyGraph::expireEdges() {
+    uint16_t minute = millis() / 60000;
+    for (uint16_t from = 0; from < nodesUsed; from++) {
+        for (int slot = nodes[from].edgeCount - 1; slot >= 0; slot--) {
+            if ((uint16_t)(minute - edges[from][slot].seenMinute) > TOPOLOGY_EDGE_TTL_MIN) {
+                removeEdge(from, slot);
+                edgesExpired++;
+            }
+        }
+    }
+}
+
+// --- Cached shortest-path trees ---
+
+void TopologyGraph::edgeChanged(uint16_t from, uint16_t to, uint16_t oldCost, uint16_t newCost) {
+    for (int i = 0; i < TOPOLOGY_CACHE_SLOTS; i++) {
+        TopologyTree& tree = cache[i];
+        if (!tree.valid) {
+            continue;
+        }
+
+        uint16_t before = oldCost;
+        uint16_t after = newCost;
+        if (!tree.weighted) {
+            // Hop trees only care whether the edge exists
+            before = oldCost == TOPOLOGY_UNREACHABLE ? TOPOLOGY_UNREACHABLE : 1;
+            after = newCost == TOPOLOGY_UNREACHABLE ? TOPOLOGY_UNREACHABLE : 1;
+        }
+        if (before == after) {
+            continue;
+        }
+
+        bool affected;
+        if (after < before) {
+            // Cheaper edge: matters only if it now offers a shorter way to `to`
+            affected = tree.dist[from] != TOPOLOGY_UNREACHABLE &&
+                       (uint32_t)tree.dist[from] + after < tree.dist[to];
+        } else {
+            // Dearer or gone: matters only if the tree used it
+            affected = tree.parent[to] == from;
+        }
+        if (affected) {
+            tree.valid = false;
+            treesInvalidated++;
+        }
+    }
+}
+
+TopologyTree* TopologyGraph::getTree(uint16_t source, bool weighted) {
+    TopologyTree* slot = &cache[0];
+    for (int i = 0; i < TOPOLOGY_CACHE_SLOTS; i++) {
+        TopologyTree& tree = cache[i];
+        if (tree.valid && tree.source == source && tree.weighted == weighted) {
+            tree.lastUsed = ++useCounter;
+            cacheHits++;
+            return &tree;
+        }
+        if (!tree.valid || (slot->valid && tree.lastUsed < slot->lastUsed)) {
+            slot = &tree;
+        }
+    }
+
+    slot->source = source;
+    slot->weighted = weighted;
+    buildTree(*slot);
+    slot->valid = true;
+    slot->lastUsed = ++useCounter;
+    return slot;
+}
+
+void TopologyGraph::heapSiftUp(TopologyTree& tree, uint16_t position) {
+    uint16_t node = heap[position];
+    while (position > 0) {
+        uint16_t parent = (position - 1) / 2;
+        if (tree.dist[heap[parent]] <= tree.dist[node]) {
+            break;
+        }
+        heap[position] = heap[parent];
+        heapPos[heap[position]] = position;
+        position = parent;
+    }
+    heap[position] = node;
+    heapPos[node] = position;
+}
+
+void TopologyGraph::heapPush(TopologyTree& tree, uint16_t node) {
+    if (heapPos[node] == TOPOLOGY_NONE) {
+        heap[heapSize] = node;
+        heapPos[node] = heapSize;
+        heapSize++;
+    }
+    // New entry or decreased key
+    heapSiftUp(tree, heapPos[node]);
+}
+
+uint16_t TopologyGraph::heapPop(TopologyTree& tree) {
+    uint16_t top = heap[0];
+    heapPos[top] = TOPOLOGY_NONE;
+    heapSize--;
+    if (heapSize == 0) {
+        return top;
+    }
+
+    uint16_t node = heap[heapSize];
+    uint16_t position = 0;
+    while (true) {
+        uint16_t child = 2 * position + 1;
+        if (child >= heapSize) {
+            break;
+        }
+        if (child + 1 < heapSize && tree.dist[heap[child + 1]] < tree.dist[heap[child]]) {
+            child++;
+        }
+        if (tree.dist[heap[child]] >= tree.dist[node]) {
+            break;
+        }
+        heap[position] = heap[child];
+        heapPos[heap[position]] = position;
+        position = child;
+    }
+    heap[position] = node;
+    heapPos[node] = position;
+    return top;
+}
+
+void TopologyGraph::buildTree(TopologyTree& tree) {
+    for (uint16_t i = 0; i < nodesUsed; i++) {
+        tree.dist[i] = TOPOLOGY_UNREACHABLE;
+        tree.parent[i] = TOPOLOGY_NONE;
+    }
+    tree.dist[tree.source] = 0;
+
+    if (!tree.weighted) {
+        // BFS, with the heap array as a FIFO
+        uint16_t head = 0;
+        uint16_t tail = 0;
+        heap[tail++] = tree.source;
+        while (head < tail) {
+            uint16_t node = heap[head++];
+            for (uint8_t i = 0; i < nodes[node].edgeCount; i++) {
+                uint16_t to = edges[node][i].to;
+                if (tree.dist[to] == TOPOLOGY_UNREACHABLE) {
+                    tree.dist[to] = tree.dist[node] + 1;
+                    tree.parent[to] = node;
+                    heap[tail++] = to;
+                }
+            }
+        }
+        return;
+    }
+
+    // Dijkstra with an indexed heap (decrease-key in place)
+    heapSize = 0;
+    heapPush(tree, tree.source);
+    while (heapSize > 0) {
+        uint16_t node = heapPop(tree);
+        for (uint8_t i = 0; i < nodes[node].edgeCount; i++) {
+            const TopologyEdge& edge = edges[node][i];
+            uint32_t cost = min((uint32_t)tree.dist[node] + edgeCost(edge.snr), (uint32_t)TOPOLOGY_UNREACHABLE - 1);
+            if (cost < tree.dist[edge.to]) {
+                tree.dist[edge.to] = cost;
+                tree.parent[edge.to] = node;
+                heapPush(tree, edge.to);
+            }
+        }
+    }
+}
+
+void TopologyGraph::finishQuery(unsigned long startMicros) {
+    uint32_t elapsed = micros() - startMicros;
+    queries++;
+    queryMicrosTotal += elapsed;
+    queryMicrosMax = max(queryMicrosMax, elapsed);
+}
+
+size_t TopologyGraph::bestPath(uint32_t from, uint32_t to, uint32_t* path, size_t maxLength, uint16_t* cost) {
+    unsigned long start = micros();
+    uint16_t source = findNode(from);
+    uint16_t target = findNode(to);
+    if (source == TOPOLOGY_NONE || target == TOPOLOGY_NONE || maxLength == 0) {
+        return 0;
+    }
+
+    TopologyTree* tree = getTree(source, true);
+    if (tree->dist[target] == TOPOLOGY_UNREACHABLE) {
+        finishQuery(start);
+        return 0;
+    }
+
+    // Walk predecessors back from the target, then reverse
+    size_t length = 0;
+    for (uint16_t node = target; node != TOPOLOGY_NONE && length < maxLength; node = tree->parent[node]) {
+        path[length++] = nodes[node].num;
+    }
+    for (size_t i = 0; i < length / 2; i++) {
+        uint32_t swap = path[i];
+        path[i] = path[length - 1 - i];
+        path[length - 1 - i] = swap;
+    }
+    if (cost != nullptr) {
+        *cost = tree->dist[target];
+    }
+
+    finishQuery(start);
+    return length;
+}
+
+int TopologyGraph::hopCount(uint32_t from, uint32_t to) {
+    unsigned long start = micros();
+    uint16_t source = findNode(from);
+    uint16_t target = findNode(to);
+    if (source == TOPOLOGY_NONE || target == TOPOLOGY_NONE) {
+        return -1;
+    }
+
+    TopologyTree* tree = getTree(source, false);
+    int hops = tree->dist[target] == TOPOLOGY_UNREACHABLE ? -1 : tree->dist[target];
+    finishQuery(start);
+    return hops;
+}
+
+size_t TopologyGraph::nodeCount() {
+    return nodesUsed;
+}
+
+size_t TopologyGraph::edgeCount() {
+    return edgesUsed;
+}
+
+void TopologyGraph::printStats() {
+    Serial.println("=== Topology Stats ===");
+    Serial.printf("Graph: %u nodes, %u edges (%u bytes)\n",
+                  nodesUsed, edgesUsed, sizeof(nodes) + sizeof(edges) + sizeof(cache));
+    Serial.printf("Edge updates: %u, expired: %u, dropped: %u, trees invalidated: %u\n",
+                  edgeUpdates, edgesExpired, updatesDropped, treesInvalidated);
+    if (queries > 0) {
+        Serial.printf("Queries: %u (%u cached), %u us avg, %u us max\n",
+                      queries, cacheHits, queryMicrosTotal / queries, queryMicrosMax);
+    }
+}
@@ -0,0 +1,166 @@
+#include "Utf8Text.h"
+
+// Code points outside Latin-1 that have a close glyph, sorted for bsearch
+struct GlyphFallback {
+    uint32_t codepoint;
+    uint8_t glyph;
+};
+
+static const GlyphFallback GLYPH_FALLBACKS[] = {
+    {0x200B, UTF8_NO_GLYPH},   // Zero width space
+    {0x200C, UTF8_NO_GLYPH},   // Zero width non-joiner
+    {0x200D, UTF8_NO_GLYPH},   // Zero width joiner (emoji sequences)
+    {0x2010, '-'}, {0x2011, '-'}, {0x2012, '-'}, {0x2013, '-'}, {0x2014, '-'}, {0x2015, '-'},
+    {0x2018, '\''}, {0x2019, '\''}, {0x201A, ','}, {0x201B, '\''},
+    {0x201C, '"'}, {0x201D, '"'}, {0x201E, '"'},
+    {0x2022, 0xB7},            // Bullet as middle dot
+    {0x2026, '.'},
+    {0x2032, '\''}, {0x2033, '"'}, {0x2039, '<'}, {0x203A, '>'},
+    {0x2060, UTF8_NO_GLYPH},   // Word joiner
+    {0x20AC, 'E'},             // Euro sign
+    {0x2190, '<'}, {0x2191, '^'}, {0x2192, '>'}, {0x2193, 'v'},
+    {0x2212, '-'}, {0x2264, '<'}, {0x2265, '>'},
+    {0x26A1, '+'},             // High voltage (charging)
+    {0x2705, 'v'},             // Check mark button
+    {0x2713, 'v'}, {0x2714, 'v'}, {0x2717, 'x'}, {0x2718, 'x'},
+    {0x274C, 'x'},             // Cross mark
+    {0xFE0E, UTF8_NO_GLYPH},   // Variation selectors
+    {0xFE0F, UTF8_NO_GLYPH},
+    {0xFEFF, UTF8_NO_GLYPH},   // Byte order mark
+    {0x1F3FB, UTF8_NO_GLYPH}, {0x1F3FC, UTF8_NO_GLYPH}, {0x1F3FD, UTF8_NO_GLYPH},   // Skin tones
+    {0x1F3FE, UTF8_NO_GLYPH}, {0x1F3FF, UTF8_NO_GLYPH},
+    {0x1F44D, '+'}, {0x1F44E, '-'},   // Thumbs up / down reactions
+};
+
+uint32_t Utf8Text::decode(const char* text, size_t length, size_t* pos) {
+    size_t p = *pos;
+    uint8_t lead = text[p];
+    if (lead < 0x80) {
+        *pos = p + 1;
+        return lead;
+    }
+
+    size_t extra;
+    uint32_t codepoint;
+    uint32_t minimum;
+    if ((lead & 0xE0) == 0xC0) {
+        extra = 1;
+        codepoint = lead & 0x1F;
+        minimum = 0x80;
+    } else if ((lead & 0xF0) == 0xE0) {
+        extra = 2;
+        codepoint = lead & 0x0F;
+        minimum = 0x800;
+    } else if ((lead & 0xF8) == 0xF0) {
+        extra = 3;
+        codepoint = lead & 0x07;
+        minimum = 0x10000;
+    } else {
+        *pos = p + 1;
+        return UTF8_REPLACEMENT;
+    }
+
+    if (length - p <= extra) {
+        *pos = p + 1;
+        return UTF8_REPLACEMENT;
+    }
+    for (size_t i = 1; i <= extra; i++) {
+        uint8_t next = text[p + i];
+        if ((next & 0xC0) != 0x80) {
+            *pos = p + 1;
+            return UTF8_REPLACEMENT;
+        }
+        codepoint = (codepoint << 6) | (next & 0x3F);
+    }
+    // Overlong forms, surrogates and values past Unicode are malformed too
+    if (codepoint < minimum || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+        *pos = p + 1;
+        return UTF8_REPLACEMENT;
+    }
+
+    *pos = p + extra + 1;
+    return codepoint;
+}
+
+size_t Utf8Text::sanitize(const uint8_t* in, size_t length, char* out, size_t outSize) {
+    if (outSize == 0) {
+        return 0;
+    }
+    const char* text = (const char*)in;
+    size_t inPos = 0;
+    size_t outPos = 0;
+
+    while (inPos < length && in[inPos] != 0) {
+        size_t start = inPos;
+        uint32_t codepoint = decode(text, length, &inPos);
+        size_t sequence = inPos - start;
+
+        // Output never outgrows input, so working in place is safe
+        if (outPos + (codepoint == UTF8_REPLACEMENT && sequence == 1 ? 1 : sequence) > outSize - 1) {
+            break;
+        }
+        if (codepoint == UTF8_REPLACEMENT && sequence == 1) {
+            out[outPos++] = UTF8_FALLBACK;
+        } else if ((codepoint < 0x20 && codepoint != '\n') || codepoint == 0x7F) {
+            out[outPos++] = ' ';
+        } else {
+            memmove(out + outPos, text + start, sequence);
+            outPos += sequence;
+        }
+    }
+
+    out[outPos] = '\0';
+    return outPos;
+}
+
+size_t Utf8Text::truncate(const char* text, size_t length, size_t maxBytes) {
+    if (length <= maxBytes) {
+        return length;
+    }
+    // Back up over continuation bytes to the start of the split code point
+    size_t cut = maxBytes;
+    while (cut > 0 && ((uint8_t)text[cut] & 0xC0) == 0x80) {
+        cut--;
+    }
+    return cut;
+}
+
+uint8_t Utf8Text::toGlyph(uint32_t codepoint) {
+    if (codepoint < 0x80) {
+        return codepoint < 0x20 || codepoint == 0x7F ? ' ' : codepoint;
+    }
+    if (codepoint >= 0xA0 && codepoint <= 0xFF) {
+        return codepoint;   // The _tf fonts carry Latin-1
+    }
+
+    size_t low = 0;
+    size_t high = sizeof(GLYPH_FALLBACKS) / sizeof(GLYPH_FALLBACKS[0]);
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (GLYPH_FALLBACKS[mid].codepoint < codepoint) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low < sizeof(GLYPH_FALLBACKS) / sizeof(GLYPH_FALLBACKS[0]) && GLYPH_FALLBACKS[low].codepoint == codepoint) {
+        return GLYPH_FALLBACKS[low].glyph;
+    }
+    return UTF8_FALLBACK;
+}
+
+size_t Utf8Text::toGlyphs(const char* text, size_t length, char* out, size_t outSize) {
+    if (outSize == 0) {
+        return 0;
+    }
+    size_t pos = 0;
+    size_t count = 0;
+    while (pos < length && count < outSize - 1) {
+        uint8_t glyph = toGlyph(decode(text, length, &pos));
+        if (glyph != UTF8_NO_GLYPH) {
+            out[count++] = glyph;
+        }
+    }
+    out[count] = '\0';
+    return count;
+}
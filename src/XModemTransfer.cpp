@@ -0,0 +1,426 @@
+#include "XModemTransfer.h"
+#include "StoreForward.h"
+
+uint16_t xmodem_crc16(const uint8_t* data, size_t length, uint16_t crc) {
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+XModemTransfer::XModemTransfer()
+    : partition(nullptr)
+    , state(XMODEM_IDLE)
+    , sectorFill(0)
+    , writeOffset(0)
+    , expectedSeq(0)
+    , runningCrc(0)
+    , baseSeq(0)
+    , nextSeq(0)
+    , lastSeq(0)
+    , highestSent(0)
+    , retries(0)
+    , lastActivity(0)
+    , transferStartedAt(0)
+    , filesReceived(0)
+    , filesSent(0)
+    , transfersAborted(0)
+    , blocksReceived(0)
+    , blocksSent(0)
+    , blocksResent(0)
+    , naksSent(0)
+    , sectorsWritten(0)
+    , lastTransferBytes(0)
+    , lastTransferMs(0) {
+    memset(&header, 0, sizeof(header));
+}
+
+bool XModemTransfer::begin() {
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, XMODEM_PARTITION_SUBTYPE, NULL);
+    if (partition == nullptr) {
+        Serial.println("XModem: no data partition for file storage");
+        return false;
+    }
+
+    Serial.printf("XModem: using partition '%s' (%u bytes)\n", partition->label, partition->size);
+    return true;
+}
+
+void XModemTransfer::onSend(FromRadioSendCallback callback) {
+    sendCallback = callback;
+}
+
+bool XModemTransfer::isActive() {
+    return state != XMODEM_IDLE;
+}
+
+void XModemTransfer::update() {
+    if (state == XMODEM_IDLE || millis() - lastActivity < XMODEM_TIMEOUT_MS) {
+        return;
+    }
+
+    if (++retries > XMODEM_MAX_RETRIES) {
+        Serial.println("XModem: too many retries, aborting");
+        abort(true);
+        return;
+    }
+    lastActivity = millis();
+
+    switch (state) {
+        case XMODEM_RECEIVING:
+            sendControl(meshtastic_XModem_Control_NAK, expectedSeq);
+            naksSent++;
+            break;
+        case XMODEM_SENDING:
+            // Go back to the oldest unacknowledged block
+            nextSeq = baseSeq;
+            fillWindow();
+            break;
+        case XMODEM_SENDING_EOT:
+            sendControl(meshtastic_XModem_Control_EOT, 0);
+            break;
+        default:
+            break;
+    }
+}
+
+void XModemTransfer::handlePacket(const meshtastic_XModem& packet) {
+    switch (packet.control) {
+        case meshtastic_XModem_Control_SOH:
+        case meshtastic_XModem_Control_STX:
+            if (packet.seq == 0) {
+                // Seq 0 carries the filename: SOH = upload, STX = download
+                if (state != XMODEM_IDLE) {
+                    abort(false);
+                }
+                if (packet.control == meshtastic_XModem_Control_SOH) {
+                    startReceive(packet);
+                } else {
+                    startSend(packet);
+                }
+            } else if (state == XMODEM_RECEIVING) {
+                receiveBlock(packet);
+            } else {
+                sendControl(meshtastic_XModem_Control_NAK, packet.seq);
+            }
+            break;
+
+        case meshtastic_XModem_Control_ACK:
+            if (state == XMODEM_SENDING) {
+                handleAck(packet.seq);
+            } else if (state == XMODEM_SENDING_EOT && (packet.seq == 0 || packet.seq > lastSeq)) {
+                filesSent++;
+                finishTransfer(header.length);
+            }
+            break;
+
+        case meshtastic_XModem_Control_NAK:
+            if ((state == XMODEM_SENDING || state == XMODEM_SENDING_EOT) &&
+                packet.seq >= baseSeq && packet.seq <= lastSeq) {
+                // Peer wants `seq` again - everything before it arrived
+                state = XMODEM_SENDING;
+                baseSeq = packet.seq;
+                nextSeq = packet.seq;
+                lastActivity = millis();
+                fillWindow();
+            }
+            break;
+
+        case meshtastic_XModem_Control_EOT:
+            if (state == XMODEM_RECEIVING) {
+                finishReceive();
+            }
+            break;
+
+        case meshtastic_XModem_Control_CAN:
+            if (state != XMODEM_IDLE) {
+                Serial.println("XModem: transfer cancelled by peer");
+                abort(false);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void XModemTransfer::startReceive(const meshtastic_XModem& packet) {
+    if (partition == nullptr) {
+        sendControl(meshtastic_XModem_Control_CAN, 0);
+        return;
+    }
+
+    memset(&header, 0, sizeof(header));
+    size_t nameLen = min((size_t)packet.buffer.size, (size_t)XMODEM_MAX_FILENAME - 1);
+    memcpy(header.name, packet.buffer.bytes, nameLen);
+
+    // Invalidate the stored file before overwriting its data
+    if (esp_partition_erase_range(partition, 0, XMODEM_SECTOR_SIZE) != ESP_OK) {
+        Serial.println("XModem: flash erase failed");
+        sendControl(meshtastic_XModem_Control_CAN, 0);
+        return;
+    }
+
+    state = XMODEM_RECEIVING;
+    sectorFill = 0;
+    writeOffset = 0;
+    expectedSeq = 1;
+    runningCrc = 0;
+    retries = 0;
+    lastActivity = millis();
+    transferStartedAt = lastActivity;
+
+    Serial.printf("XModem: receiving '%s'\n", header.name);
+    sendControl(meshtastic_XModem_Control_ACK, 0);
+}
+
+void XModemTransfer::receiveBlock(const meshtastic_XModem& packet) {
+    bool crcOk = xmodem_crc16(packet.buffer.bytes, packet.buffer.size) == packet.crc16;
+    lastActivity = millis();
+
+    if (crcOk && packet.seq < expectedSeq) {
+        // Duplicate of a block we already stored - our ACK got lost
+        sendControl(meshtastic_XModem_Control_ACK, packet.seq);
+        return;
+    }
+
+    if (!crcOk || packet.seq != expectedSeq) {
+        // Corrupt or out of order - ask for the block we need next
+        sendControl(meshtastic_XModem_Control_NAK, expectedSeq);
+        naksSent++;
+        return;
+    }
+
+    // The tail of the partition holds the Store & Forward history
+    if (XMODEM_SECTOR_SIZE + writeOffset + sectorFill + packet.buffer.size > partition->size - SF_FLASH_BYTES) {
+        Serial.println("XModem: file does not fit the partition");
+        abort(true);
+        return;
+    }
+
+    // Stage into the sector buffer, flushing whole sectors as they fill
+    const uint8_t* src = packet.buffer.bytes;
+    size_t remaining = packet.buffer.size;
+    while (remaining > 0) {
+        size_t chunk = min(remaining, (size_t)XMODEM_SECTOR_SIZE - sectorFill);
+        memcpy(sectorBuffer + sectorFill, src, chunk);
+        sectorFill += chunk;
+        src += chunk;
+        remaining -= chunk;
+
+        if (sectorFill == XMODEM_SECTOR_SIZE && !flushSector()) {
+            abort(true);
+            return;
+        }
+    }
+
+    runningCrc = xmodem_crc16(packet.buffer.bytes, packet.buffer.size, runningCrc);
+    expectedSeq++;
+    retries = 0;
+    blocksReceived++;
+    sendControl(meshtastic_XModem_Control_ACK, packet.seq);
+}
+
+void XModemTransfer::finishReceive() {
+    if (sectorFill > 0 && !flushSector()) {
+        abort(true);
+        return;
+    }
+
+    header.magic = XMODEM_FILE_MAGIC;
+    header.length = writeOffset;
+    header.crc16 = runningCrc;
+    if (esp_partition_write(partition, 0, &header, sizeof(header)) != ESP_OK) {
+        Serial.println("XModem: header write failed");
+        abort(true);
+        return;
+    }
+
+    sendControl(meshtastic_XModem_Control_ACK, expectedSeq);
+    filesReceived++;
+    finishTransfer(writeOffset);
+}
+
+void XModemTransfer::startSend(const meshtastic_XModem& packet) {
+    XModemFileHeader stored;
+    char name[XMODEM_MAX_FILENAME];
+    size_t nameLen = min((size_t)packet.buffer.size, (size_t)XMODEM_MAX_FILENAME - 1);
+    memcpy(name, packet.buffer.bytes, nameLen);
+    name[nameLen] = '\0';
+
+    if (!readHeader(&stored) || strcmp(stored.name, name) != 0) {
+        Serial.printf("XModem: file '%s' not found\n", name);
+        sendControl(meshtastic_XModem_Control_NAK, 0);
+        return;
+    }
+
+    header = stored;
+    state = XMODEM_SENDING;
+    baseSeq = 1;
+    nextSeq = 1;
+    highestSent = 0;
+    lastSeq = (header.length + XMODEM_BLOCK_SIZE - 1) / XMODEM_BLOCK_SIZE;
+    retries = 0;
+    lastActivity = millis();
+    transferStartedAt = lastActivity;
+
+    Serial.printf("XModem: sending '%s' (%u bytes)\n", header.name, header.length);
+    fillWindow();
+}
+
+void XModemTransfer::handleAck(uint16_t seq) {
+    if (seq < baseSeq || seq > lastSeq) {
+        return;  // Stale ACK
+    }
+
+    // ACKs are cumulative - the window slides past `seq`
+    baseSeq = seq + 1;
+    if (nextSeq < baseSeq) {
+        nextSeq = baseSeq;
+    }
+    retries = 0;
+    lastActivity = millis();
+    fillWindow();
+}
+
+void XModemTransfer::fillWindow() {
+    while (nextSeq <= lastSeq && nextSeq < baseSeq + XMODEM_SEND_WINDOW) {
+        if (!sendBlock(nextSeq)) {
+            abort(true);
+            return;
+        }
+        nextSeq++;
+    }
+
+    if (baseSeq > lastSeq) {
+        state = XMODEM_SENDING_EOT;
+        sendControl(meshtastic_XModem_Control_EOT, 0);
+    }
+}
+
+bool XModemTransfer::sendBlock(uint16_t seq) {
+    meshtastic_XModem packet = meshtastic_XModem_init_zero;
+    uint32_t offset = (uint32_t)(seq - 1) * XMODEM_BLOCK_SIZE;
+    size_t length = min((uint32_t)XMODEM_BLOCK_SIZE, header.length - offset);
+
+    // Read straight from flash, one block at a time
+    if (esp_partition_read(partition, XMODEM_SECTOR_SIZE + offset, packet.buffer.bytes, length) != ESP_OK) {
+        Serial.println("XModem: flash read failed");
+        return false;
+    }
+
+    packet.control = meshtastic_XModem_Control_SOH;
+    packet.seq = seq;
+    packet.buffer.size = length;
+    packet.crc16 = xmodem_crc16(packet.buffer.bytes, length);
+    sendPacket(packet);
+
+    blocksSent++;
+    if (seq <= highestSent) {
+        blocksResent++;
+    } else {
+        highestSent = seq;
+    }
+    return true;
+}
+
+void XModemTransfer::abort(bool notifyPeer) {
+    if (notifyPeer) {
+        sendControl(meshtastic_XModem_Control_CAN, 0);
+    }
+    state = XMODEM_IDLE;
+    transfersAborted++;
+}
+
+void XModemTransfer::finishTransfer(uint32_t bytes) {
+    lastTransferBytes = bytes;
+    lastTransferMs = millis() - transferStartedAt;
+    state = XMODEM_IDLE;
+
+    Serial.printf("XModem: '%s' done, %u bytes in %lu ms\n", header.name, bytes, lastTransferMs);
+}
+
+bool XModemTransfer::flushSector() {
+    size_t offset = XMODEM_SECTOR_SIZE + writeOffset;
+
+    // writeOffset is always sector aligned here, so each flush is one erase + one write
+    if (esp_partition_erase_range(partition, offset, XMODEM_SECTOR_SIZE) != ESP_OK ||
+        esp_partition_write(partition, offset, sectorBuffer, sectorFill) != ESP_OK) {
+        Serial.println("XModem: flash write failed");
+        return false;
+    }
+
+    writeOffset += sectorFill;
+    sectorFill = 0;
+    sectorsWritten++;
+    return true;
+}
+
+size_t XModemTransfer::readFile(const char* name, uint8_t* out, size_t maxLen) {
+    XModemFileHeader stored;
+    // An upload in progress has already invalidated the stored file
+    if (state == XMODEM_RECEIVING || !readHeader(&stored) || strcmp(stored.name, name) != 0) {
+        return 0;
+    }
+    if (stored.length == 0 || stored.length > maxLen) {
+        Serial.printf("XModem: '%s' is %u bytes, %u fit\n", name, stored.length, maxLen);
+        return 0;
+    }
+    if (esp_partition_read(partition, XMODEM_SECTOR_SIZE, out, stored.length) != ESP_OK ||
+        xmodem_crc16(out, stored.length) != stored.crc16) {
+        Serial.printf("XModem: '%s' failed its CRC check\n", name);
+        return 0;
+    }
+    return stored.length;
+}
+
+bool XModemTransfer::readHeader(XModemFileHeader* out) {
+    if (partition == nullptr ||
+        esp_partition_read(partition, 0, out, sizeof(*out)) != ESP_OK ||
+        out->magic != XMODEM_FILE_MAGIC) {
+        return false;
+    }
+    out->name[XMODEM_MAX_FILENAME - 1] = '\0';
+    return true;
+}
+
+void XModemTransfer::sendControl(meshtastic_XModem_Control control, uint16_t seq) {
+    meshtastic_XModem packet = meshtastic_XModem_init_zero;
+    packet.control = control;
+    packet.seq = seq;
+    sendPacket(packet);
+}
+
+void XModemTransfer::sendPacket(const meshtastic_XModem& packet) {
+    static meshtastic_FromRadio fromRadio;
+    uint8_t buffer[meshtastic_XModem_size + 16];
+    size_t length = 0;
+
+    memset(&fromRadio, 0, sizeof(fromRadio));
+    fromRadio.which_payload_variant = meshtastic_FromRadio_xmodemPacket_tag;
+    fromRadio.xmodemPacket = packet;
+
+    if (!encode_from_radio(buffer, sizeof(buffer), &fromRadio, &length)) {
+        Serial.println("XModem: encode failed");
+        return;
+    }
+
+    if (sendCallback) {
+        sendCallback(buffer, length);
+    }
+}
+
+void XModemTransfer::printStats() {
+    Serial.println("=== XModem Stats ===");
+    Serial.printf("Files: %u received, %u sent, %u aborted\n", filesReceived, filesSent, transfersAborted);
+    Serial.printf("Blocks: %u received, %u sent (%u resent), %u NAKs sent\n",
+                  blocksReceived, blocksSent, blocksResent, naksSent);
+    Serial.printf("Flash sectors written: %u\n", sectorsWritten);
+    if (lastTransferMs > 0) {
+        Serial.printf("Last transfer: %u bytes in %lu ms (%.0f B/s)\n",
+                      lastTransferBytes, lastTransferMs, 1000.0 * lastTransferBytes / lastTransferMs);
+    }
+}
@@ -3,6 +3,20 @@
 #include "KeyManager.h"
 #include "MessageHandler.h"
 #include "DisplayController.h"
+#include "ChunkedTransfer.h"
+#include "XModemTransfer.h"
+#include "StoreForward.h"
+#include "TelemetryStore.h"
+#include "TelemetryProducer.h"
+#include "PositionStore.h"
+#include "TopologyGraph.h"
+#include "ConfigStore.h"
+#include "AdminModule.h"
+#include "ChannelCrypto.h"
+#include "PkiCrypto.h"
+#include "OutboundQueue.h"
+#include "ToRadioQueue.h"
+#include "SerialStream.h"
 
 // PRG button (GPIO0 on ESP32)
 #define PRG_BUTTON 0
@@ -25,19 +39,52 @@ MeshtasticBLE bleServer;
 KeyManager keyManager;
 MessageHandler messageHandler;
 DisplayController display;
+ChunkedTransfer chunkedTransfer;
+XModemTransfer xmodem;
+StoreForward storeForward;
+TelemetryStore telemetry;
+TelemetryProducer localTelemetry;
+OutboundQueue outbound;
+ToRadioQueue toRadioQueue;
+SerialStream serialStream(Serial);
+PositionStore positions;
+TopologyGraph topology;
+ConfigStore configStore;
+AdminModule admin;
+ChannelCrypto channelCrypto;
+PkiCrypto pki;
 
 // Button state
 unsigned long buttonPressTime = 0;
 bool buttonWasPressed = false;
 bool sleepMode = false;
+bool buttonWoke = false;  // The current press turned the display back on
 int clickCount = 0;
 unsigned long lastClickTime = 0;
 
 // Battery state
 uint8_t batteryLevel = 100;
+float batteryVoltage = 0;
 unsigned long lastBatteryUpdate = 0;
 const unsigned long BATTERY_UPDATE_INTERVAL = 30000;  // Update every 30 seconds
 
+// Query commands written over BLE are answered from loop(), where the
+// stores they read are updated
+#define QUERY_COMMAND_MAX 64
+#define QUERY_MAX_RESULTS 8
+#define QUERY_MAX_PATH 16
+#define QUERY_MAX_MESSAGES 4
+#define TELEMETRY_DEFAULT_WINDOW 3600   // TELEM: and the telemetry screen, in seconds
+char pendingQuery[QUERY_COMMAND_MAX];
+volatile bool queryPending = false;
+
+// File sent by SEND:, loaded from XModem storage; chunked transfer reads it
+// in place until the receiver has accepted it
+uint8_t outgoingFile[CHUNK_MAX_PAYLOAD];
+
+// Set when keys are imported (possibly from the BLE task); reloaded in loop()
+volatile bool pkiKeysChanged = true;
+
 // State management
 enum AppState {
     STATE_INIT,
@@ -47,17 +94,450 @@ enum AppState {
 };
 
 AppState currentState = STATE_INIT;
-unsigned long lastDisplayUpdate = 0;
-const unsigned long DISPLAY_UPDATE_INTERVAL = 1000; // Update display every second
+bool messagesChanged = false;  // A received or sent message for loop() to redraw
+// Screens that four clicks cycle through after the message list
+enum InfoScreen {
+    SCREEN_MESSAGES,
+    SCREEN_TELEMETRY,   // The node and window of the last TELEM: query, this device over the last hour until then
+    SCREEN_NEARBY,      // Nodes closest to this device's position
+    SCREEN_COUNT
+};
+InfoScreen infoScreen = SCREEN_MESSAGES;
+uint32_t telemetryNode = 0;
+uint32_t telemetryWindow = TELEMETRY_DEFAULT_WINDOW;
+bool keyCheckMessageShown = false;
 
-// BLE callback for received data (from connected client)
-void onBLEDataReceived(uint8_t* data, size_t length) {
+// A ToRadio frame from a BLE or serial client, dispatched on loop().
+// The frame is decoded once and routed by payload variant and port.
+void onToRadio(uint8_t* data, size_t length) {
+    // Static: ToRadio is large
+    static meshtastic_ToRadio toRadio;
     Serial.printf("Received %d bytes from client\n", length);
     
-    // Process the received data
+    memset(&toRadio, 0, sizeof(toRadio));
+    if (decode_to_radio(data, length, &toRadio) && toRadio.which_payload_variant != 0) {
+        switch (toRadio.which_payload_variant) {
+            case meshtastic_ToRadio_xmodemPacket_tag:
+                // File transfers to and from flash
+                xmodem.handlePacket(toRadio.xmodemPacket);
+                break;
+            case meshtastic_ToRadio_packet_tag:
+                // With location sharing on, the app sends the phone's position:
+                // this device has no GPS, so that is its own position
+                if (toRadio.packet.which_payload_variant == meshtastic_MeshPacket_decoded_tag &&
+                    toRadio.packet.decoded.portnum == meshtastic_PortNum_POSITION_APP) {
+                    positions.handlePacket(toRadio.packet, messageHandler.getNodeNum());
+                    break;
+                }
+                // Settings for this node arrive as ADMIN_APP packets addressed to it
+                admin.handlePacket(toRadio.packet);
+                break;
+            default:
+                break;
+        }
+        return;
+    }
+    
+    // Not a ToRadio request: mesh traffic relayed as FromRadio
     if (messageHandler.processReceivedData(data, length)) {
-        // New message received - update display
-        display.showMessages(messageHandler);
+        // New message received - loop() redraws; only it draws frames
+        messagesChanged = true;
+    }
+}
+
+// FromRadio to every client: BLE sessions, and the serial port once a
+// framed client has spoken there
+bool sendFromRadio(uint8_t* data, size_t length) {
+    if (serialStream.isActive()) {
+        serialStream.send(data, length);
+    }
+    return bleServer.sendFromRadio(data, length);
+}
+
+// Encode a Data payload for the mesh and hand it to the clients
+void sendMeshData(uint32_t to, const meshtastic_Data& data) {
+    uint8_t buffer[FROMRADIO_MAX_FRAME];
+    size_t length;
+    if (messageHandler.createDataPacket(data, to, buffer, &length, sizeof(buffer))) {
+        sendFromRadio(buffer, length);
+        localTelemetry.recordAirtime(true, data.payload.size);
+    }
+}
+
+// Expand channel keys and hashes from the stored channels and modem preset.
+// `index` reloads a single channel, -1 all of them.
+void loadChannelKeys(int index) {
+    meshtastic_Config_LoRaConfig lora = meshtastic_Config_LoRaConfig_init_default;
+    configStore.read(CONFIG_LOCAL, meshtastic_LocalConfig_lora_tag, 0, meshtastic_Config_LoRaConfig_fields, &lora);
+    const char* defaultName = lora.use_preset ? ChannelCrypto::presetName(lora.modem_preset) : "Custom";
+    outbound.configure(lora);   // Modem and region also pace outgoing text
+    
+    for (uint8_t i = 0; i < ADMIN_MAX_CHANNELS; i++) {
+        if (index >= 0 && i != index) {
+            continue;
+        }
+        meshtastic_Channel channel = meshtastic_Channel_init_default;
+        admin.getChannel(i, &channel);
+        channelCrypto.setChannel(i, channel, defaultName);
+    }
+}
+
+// Hand the imported key pair to PKI direct messages
+void loadPkiKeys() {
+    uint8_t privateKey[KEY_SIZE];
+    uint8_t publicKey[KEY_SIZE];
+    if (!keyManager.getPrivateKeyRaw(privateKey, sizeof(privateKey))) {
+        if (keyManager.hasPrivateKey()) {
+            Serial.println("PKI: private key is not 32 bytes of hex or base64");
+        }
+        return;
+    }
+    bool hasPublic = keyManager.getPublicKeyRaw(publicKey, sizeof(publicKey));
+    pki.setKeys(privateKey, hasPublic ? publicKey : nullptr);
+}
+
+bool isQueryCommand(const String& cmd) {
+    return cmd.startsWith("NEAREST:") || cmd.startsWith("WITHIN:") ||
+           cmd.startsWith("ROUTE:") || cmd.startsWith("HOPS:") ||
+           cmd.startsWith("CONVOS:") || cmd.startsWith("CONVO:") ||
+           cmd.startsWith("SEND:") || cmd.startsWith("TELEM:");
+}
+
+// SEND:<node>,<file> - chunk the file uploaded over XModem to a node
+void runSendCommand(const String& cmd, String& response) {
+    String args = cmd.substring(cmd.indexOf(':') + 1);
+    int comma = args.indexOf(',');
+    if (comma < 0) {
+        response = "ERR usage SEND:<node>,<file>";
+        return;
+    }
+    uint32_t to = strtoul(args.substring(0, comma).c_str(), nullptr, 16);
+    String name = args.substring(comma + 1);
+    if (chunkedTransfer.isSending()) {
+        response = "ERR transfer in progress";
+        return;
+    }
+    size_t length = xmodem.readFile(name.c_str(), outgoingFile, sizeof(outgoingFile));
+    if (length == 0) {
+        response = "ERR no file " + name + " (max " + String(CHUNK_MAX_PAYLOAD) + " bytes)";
+        return;
+    }
+    uint32_t payloadId = chunkedTransfer.send(to, outgoingFile, length);
+    if (payloadId == 0) {
+        response = "ERR send failed";
+        return;
+    }
+    char entry[48];
+    snprintf(entry, sizeof(entry), "OK #%08X %u bytes to %08X", payloadId, length, to);
+    response = entry;
+}
+
+// Answer CONVOS: (conversations, most recent first: "<label> <count> <unread>;")
+// and CONVO:<label>[,<n>] (its last n messages: "<sender>: <text>;")
+void runConversationQuery(const String& cmd, String& response) {
+    response = "";
+    if (cmd.startsWith("CONVOS:")) {
+        for (int rank = 0; rank < messageHandler.getConversationCount(); rank++) {
+            int conv = messageHandler.conversationAt(rank);
+            const Conversation& conversation = messageHandler.getConversation(conv);
+            char label[12];
+            char entry[32];
+            messageHandler.conversationLabel(conv, label, sizeof(label));
+            snprintf(entry, sizeof(entry), "%s %u %u;", label, conversation.count, conversation.unread);
+            response += entry;
+        }
+    } else {
+        String args = cmd.substring(cmd.indexOf(':') + 1);
+        int wanted = 1;
+        int comma = args.indexOf(',');
+        if (comma >= 0) {
+            wanted = constrain(args.substring(comma + 1).toInt(), 1, QUERY_MAX_MESSAGES);
+            args = args.substring(0, comma);
+        }
+        int conv = messageHandler.findConversation(args.c_str());
+        if (conv < 0) {
+            response = "ERR no conversation " + args;
+            return;
+        }
+        int count = messageHandler.getConversation(conv).count;
+        for (int i = max(count - wanted, 0); i < count; i++) {
+            const Message& msg = messageHandler.conversationMessage(conv, i);
+            response += msg.sender + ": " + msg.text + ";";
+        }
+    }
+    if (response.length() == 0) {
+        response = "NONE";
+    }
+}
+
+// Window in seconds, minutes ("15m") or hours ("2h"); 0 if malformed
+uint32_t parseWindow(String text) {
+    uint32_t unit = 1;
+    if (text.endsWith("m")) {
+        unit = 60;
+    } else if (text.endsWith("h")) {
+        unit = 3600;
+    }
+    if (unit > 1) {
+        text = text.substring(0, text.length() - 1);
+    }
+    long value = text.toInt();
+    return value > 0 ? value * unit : 0;
+}
+
+// Answer TELEM:<node>[,<metric>[,<window>]] with "<metric> <min>/<avg>/<max><unit> n<samples>;"
+// for one metric, or for every metric the node reported in the window.
+// An empty node is this device; the window defaults to an hour.
+void runTelemetryQuery(const String& cmd, String& response) {
+    String args = cmd.substring(cmd.indexOf(':') + 1);
+    String metricArg;
+    String windowArg;
+    int comma = args.indexOf(',');
+    if (comma >= 0) {
+        metricArg = args.substring(comma + 1);
+        args = args.substring(0, comma);
+        comma = metricArg.indexOf(',');
+        if (comma >= 0) {
+            windowArg = metricArg.substring(comma + 1);
+            metricArg = metricArg.substring(0, comma);
+        }
+    }
+    uint32_t node = args.length() > 0 ? strtoul(args.c_str(), nullptr, 16) : messageHandler.getNodeNum();
+    
+    uint8_t first = 0;
+    uint8_t last = METRIC_COUNT - 1;
+    if (metricArg.length() > 0) {
+        TelemetryMetric metric;
+        if (!TelemetryStore::metricFromName(metricArg.c_str(), &metric)) {
+            response = "ERR no metric " + metricArg;
+            return;
+        }
+        first = last = metric;
+    }
+    uint32_t window = windowArg.length() > 0 ? parseWindow(windowArg) : TELEMETRY_DEFAULT_WINDOW;
+    if (window == 0) {
+        response = "ERR bad window " + windowArg;
+        return;
+    }
+    
+    response = "";
+    for (uint8_t metric = first; metric <= last; metric++) {
+        TelemetrySummary summary;
+        if (!telemetry.query(node, (TelemetryMetric)metric, window, &summary)) {
+            continue;
+        }
+        char lo[12], avg[12], hi[12], entry[64];
+        TelemetryStore::formatValue((TelemetryMetric)metric, summary.min, lo, sizeof(lo), false);
+        TelemetryStore::formatValue((TelemetryMetric)metric, summary.avg, avg, sizeof(avg), false);
+        TelemetryStore::formatValue((TelemetryMetric)metric, summary.max, hi, sizeof(hi));
+        snprintf(entry, sizeof(entry), "%s %s/%s/%s n%u;",
+                 TelemetryStore::metricName((TelemetryMetric)metric), lo, avg, hi, summary.count);
+        response += entry;
+    }
+    if (response.length() == 0) {
+        response = "NONE";
+    }
+    
+    // The telemetry screen follows the last query
+    telemetryNode = node;
+    telemetryWindow = window;
+}
+
+// Answer ROUTE:<to>[,<from>] / HOPS:<to>[,<from>] from the topology graph
+void runRouteQuery(const String& cmd, String& response) {
+    String args = cmd.substring(cmd.indexOf(':') + 1);
+    uint32_t from = messageHandler.getNodeNum();
+    int comma = args.indexOf(',');
+    if (comma >= 0) {
+        from = strtoul(args.substring(comma + 1).c_str(), nullptr, 16);
+        args = args.substring(0, comma);
+    }
+    uint32_t to = strtoul(args.c_str(), nullptr, 16);
+    
+    if (cmd.startsWith("HOPS:")) {
+        int hops = topology.hopCount(from, to);
+        response = hops < 0 ? String("NONE") : String(hops);
+        return;
+    }
+    
+    uint32_t path[QUERY_MAX_PATH];
+    uint16_t cost = 0;
+    size_t length = topology.bestPath(from, to, path, QUERY_MAX_PATH, &cost);
+    if (length == 0) {
+        response = "NONE";
+        return;
+    }
+    response = "";
+    for (size_t i = 0; i < length; i++) {
+        char hop[10];
+        snprintf(hop, sizeof(hop), i == 0 ? "%08X" : ">%08X", path[i]);
+        response += hop;
+    }
+    response += " cost " + String(cost);
+}
+
+// Answer NEAREST:<n>[,<node>] / WITHIN:<km>[,<node>] around a node
+// (this device by default), or a route query. Returns false if cmd is
+// not a query.
+bool runQueryCommand(const String& cmd, String& response) {
+    if (!isQueryCommand(cmd)) {
+        return false;
+    }
+    if (cmd.startsWith("ROUTE:") || cmd.startsWith("HOPS:")) {
+        runRouteQuery(cmd, response);
+        return true;
+    }
+    if (cmd.startsWith("CONVO")) {
+        runConversationQuery(cmd, response);
+        return true;
+    }
+    if (cmd.startsWith("SEND:")) {
+        runSendCommand(cmd, response);
+        return true;
+    }
+    if (cmd.startsWith("TELEM:")) {
+        runTelemetryQuery(cmd, response);
+        return true;
+    }
+    bool nearestQuery = cmd.startsWith("NEAREST:");
+    
+    // <count or km>[,<node hex> | ,<lat>,<lon>]: around a node (this device
+    // by default), or around a point in decimal degrees
+    String args = cmd.substring(cmd.indexOf(':') + 1);
+    uint32_t reference = messageHandler.getNodeNum();
+    int32_t latitude_i = 0;
+    int32_t longitude_i = 0;
+    bool hasPoint = false;
+    int comma = args.indexOf(',');
+    if (comma >= 0) {
+        String where = args.substring(comma + 1);
+        args = args.substring(0, comma);
+        int split = where.indexOf(',');
+        if (split >= 0) {
+            double latitude = strtod(where.substring(0, split).c_str(), nullptr);
+            double longitude = strtod(where.substring(split + 1).c_str(), nullptr);
+            if (fabs(latitude) > 90 || fabs(longitude) > 180) {
+                response = "ERR bad position";
+                return true;
+            }
+            latitude_i = lround(latitude * 1e7);
+            longitude_i = lround(longitude * 1e7);
+            reference = 0;
+            hasPoint = true;
+        } else {
+            reference = strtoul(where.c_str(), nullptr, 16);
+        }
+    }
+    
+    if (!hasPoint) {
+        const PositionRecord* origin = positions.getPosition(reference);
+        if (origin == nullptr) {
+            // This device's own position comes from the phone's location sharing
+            response = "ERR no position for " + String(reference, HEX);
+            return true;
+        }
+        latitude_i = origin->latitude_i;
+        longitude_i = origin->longitude_i;
+    }
+    
+    PositionResult results[QUERY_MAX_RESULTS];
+    size_t found;
+    size_t wanted = QUERY_MAX_RESULTS;
+    if (nearestQuery) {
+        // One extra: the reference node itself comes back at 0 km
+        wanted = constrain(args.toInt(), 1, QUERY_MAX_RESULTS - 1);
+        found = positions.nearest(latitude_i, longitude_i, results, wanted + 1);
+    } else {
+        found = positions.within(latitude_i, longitude_i, args.toFloat(), results, QUERY_MAX_RESULTS);
+    }
+    
+    response = "";
+    size_t listed = 0;
+    for (size_t i = 0; i < found && listed < wanted; i++) {
+        if (!hasPoint && results[i].node == reference) {
+            continue;
+        }
+        listed++;
+        char entry[24];
+        snprintf(entry, sizeof(entry), "%08X %.1fkm;", results[i].node, results[i].distanceKm);
+        response += entry;
+    }
+    if (response.length() == 0) {
+        response = "NONE";
+    }
+    return true;
+}
+
+// Serial commands while waiting for keys
+void handleKeyCommand(const String& cmd) {
+    if (cmd.startsWith("IMPORT_PRIVATE:")) {
+        String key = cmd.substring(15);
+        key.trim();
+        if (keyManager.importPrivateKey(key)) {
+            pkiKeysChanged = true;
+            Serial.println("✓ Private key imported");
+        }
+    } else if (cmd.startsWith("IMPORT_PUBLIC:")) {
+        String key = cmd.substring(14);
+        key.trim();
+        if (keyManager.importPublicKey(key)) {
+            pkiKeysChanged = true;
+            Serial.println("✓ Public key imported");
+        }
+    } else if (cmd == "SKIP_KEYS") {
+        Serial.println("Skipping key check...");
+        currentState = STATE_ADVERTISING;
+        keyCheckMessageShown = false;
+    } else {
+        Serial.println("Unknown command: " + cmd);
+    }
+}
+
+// Serial commands while connected; anything else is sent as a message
+void handleConsoleCommand(const String& msg) {
+    if (msg == "/stats") {
+        bleServer.printStats();
+        messageHandler.printStats();
+        chunkedTransfer.printStats();
+        xmodem.printStats();
+        storeForward.printStats();
+        telemetry.printStats();
+        localTelemetry.printStats();
+        outbound.printStats();
+        toRadioQueue.printStats();
+        serialStream.printStats();
+        positions.printStats();
+        topology.printStats();
+        admin.printStats();
+        configStore.printStats();
+        channelCrypto.printStats();
+        pki.printStats();
+        display.printStats();
+    } else if (msg == "/compress on" || msg == "/compress off") {
+        // Port 302 text is unreadable to stock nodes - only for meshes running this codec
+        messageHandler.setTextCompression(msg == "/compress on");
+        Serial.printf("Text compression %s\n", messageHandler.getTextCompression() ? "on" : "off");
+    } else if (isQueryCommand(msg)) {
+        String response;
+        runQueryCommand(msg, response);
+        Serial.println(response);
+    } else if (msg.length() > 0) {
+        if (outbound.push(msg.c_str(), msg.length())) {
+            Serial.printf("Queued message: %s\n", msg.c_str());
+        }
+    }
+}
+
+// A console line from the serial port, outside any API frame
+void onSerialLine(const String& line) {
+    String cmd = line;
+    cmd.trim();
+    if (currentState == STATE_KEY_CHECK) {
+        handleKeyCommand(cmd);
+    } else if (currentState == STATE_CONNECTED) {
+        handleConsoleCommand(cmd);
+    } else if (cmd.length() > 0) {
+        Serial.println("Not connected, ignored: " + cmd);
     }
 }
 
@@ -76,6 +556,7 @@ uint8_t readBatteryLevel() {
     
     // Debug output
     Serial.printf("Battery ADC: %.0f, Voltage: %.2fV\n", adcAverage, voltage);
+    batteryVoltage = voltage;
     
     // Convert voltage to percentage
     float percentage = ((voltage - BATTERY_MIN_VOLTAGE) / (BATTERY_MAX_VOLTAGE - BATTERY_MIN_VOLTAGE)) * 100.0;
@@ -87,6 +568,22 @@ uint8_t readBatteryLevel() {
     return (uint8_t)percentage;
 }
 
+// Redraw whichever screen four clicks last selected
+void showInfoScreen() {
+    switch (infoScreen) {
+        case SCREEN_TELEMETRY:
+            display.showTelemetry(telemetry, telemetryNode != 0 ? telemetryNode : messageHandler.getNodeNum(),
+                                  telemetryWindow);
+            break;
+        case SCREEN_NEARBY:
+            display.showNearby(positions, messageHandler.getNodeNum());
+            break;
+        default:
+            display.showMessages(messageHandler);
+            break;
+    }
+}
+
 void shutdownDevice() {
     Serial.println("\n=== SHUTDOWN SEQUENCE ===");
     Serial.println("5 clicks detected - shutting down...");
@@ -113,7 +610,8 @@ void shutdownDevice() {
 }
 
 void setup() {
-    Serial.begin(115200);
+    Serial.setRxBufferSize(STREAM_RX_BUFFER);
+    Serial.begin(STREAM_BAUD);
     delay(1000);
     
     // Initialize PRG button
@@ -143,6 +641,99 @@ void setup() {
     // Initialize message handler
     messageHandler.begin();
     
+    // Config, channels and owner, edited by the client via AdminMessage
+    configStore.begin();
+    admin.begin(messageHandler.getNodeNum(), &configStore);
+    admin.onSend([](uint8_t* data, size_t length) {
+        sendFromRadio(data, length);
+    });
+    
+    // Text typed on the console waits for airtime under the region's duty cycle
+    outbound.onSend([](const char* text, size_t length) -> size_t {
+        uint8_t buffer[FROMRADIO_MAX_FRAME];
+        size_t encoded;
+        if (!messageHandler.createTextMessage(text, length, buffer, &encoded, sizeof(buffer)) ||
+            !sendFromRadio(buffer, encoded)) {
+            Serial.println("Failed to send message");
+            return 0;
+        }
+        Serial.println("Message sent to client!");
+        localTelemetry.recordAirtime(true, encoded);
+        messageHandler.addSentMessage(text, length);
+        messagesChanged = true;
+        return encoded;
+    });
+    
+    // Channel PSKs: encrypted packets are decrypted before routing
+    loadChannelKeys(-1);
+    admin.onChannelChanged(loadChannelKeys);
+    
+    // PKI direct messages: peer keys come from NodeInfo, secrets are cached per peer
+    pki.begin(messageHandler.getNodeNum());
+    messageHandler.onPort(meshtastic_PortNum_NODEINFO_APP, [](const meshtastic_MeshPacket& packet) {
+        return pki.handleNodeInfo(packet);
+    });
+    messageHandler.onEncrypted([](meshtastic_MeshPacket& packet) {
+        return pki.decrypt(packet) || channelCrypto.decrypt(packet);
+    });
+    messageHandler.onOutgoing([](meshtastic_MeshPacket& packet) {
+        return pki.encrypt(packet);
+    });
+    
+    // Chunked transfers for payloads larger than one packet
+    messageHandler.onPort(CHUNKED_PAYLOAD_PORT, [](const meshtastic_MeshPacket& packet) {
+        return chunkedTransfer.handleChunkPacket(packet);
+    });
+    messageHandler.onPort(CHUNKED_RESPONSE_PORT, [](const meshtastic_MeshPacket& packet) {
+        return chunkedTransfer.handleResponsePacket(packet);
+    });
+    chunkedTransfer.onSend(sendMeshData);
+    chunkedTransfer.onPayloadComplete([](uint32_t from, uint32_t payloadId, const uint8_t* data, size_t length) {
+        Serial.printf("Received %d byte payload #%08X from 0x%08X\n", length, payloadId, from);
+    });
+    
+    // XModem file transfers (configs, maps) straight to flash
+    xmodem.begin();
+    xmodem.onSend([](uint8_t* data, size_t length) {
+        sendFromRadio(data, length);
+    });
+    
+    // Telemetry from other nodes, kept as downsampled time series
+    messageHandler.onPort(meshtastic_PortNum_TELEMETRY_APP, [](const meshtastic_MeshPacket& packet) {
+        return telemetry.handlePacket(packet);
+    });
+    
+    // This device's own DeviceMetrics, sent on a jittered schedule
+    localTelemetry.begin(messageHandler.getNodeNum());
+    localTelemetry.onSend([](uint8_t* data, size_t length) {
+        sendFromRadio(data, length);
+    });
+    
+    // Latest position per node, grid-indexed for nearest/within queries
+    messageHandler.onPort(meshtastic_PortNum_POSITION_APP, [](const meshtastic_MeshPacket& packet) {
+        return positions.handlePacket(packet);
+    });
+    
+    // Mesh topology from traceroute replies and neighbor reports
+    messageHandler.onPort(meshtastic_PortNum_TRACEROUTE_APP, [](const meshtastic_MeshPacket& packet) {
+        return topology.handleTraceroute(packet);
+    });
+    messageHandler.onPort(meshtastic_PortNum_NEIGHBORINFO_APP, [](const meshtastic_MeshPacket& packet) {
+        return topology.handleNeighborInfo(packet);
+    });
+    
+    // Store & Forward router: keep text history, replay it on request
+    storeForward.begin();
+    messageHandler.onPacket([](const meshtastic_MeshPacket& packet) {
+        storeForward.recordPacket(packet);
+        localTelemetry.recordAirtime(false, packet.decoded.payload.size);
+        return true;
+    });
+    messageHandler.onPort(meshtastic_PortNum_STORE_FORWARD_APP, [](const meshtastic_MeshPacket& packet) {
+        return storeForward.handlePacket(packet);
+    });
+    storeForward.onSend(sendMeshData);
+    
     // Initialize BLE Server
     if (!bleServer.begin("Meshtastic-ESP32")) {
         Serial.println("Failed to initialize BLE Server!");
@@ -150,8 +741,16 @@ void setup() {
         return;
     }
     
-    // Register BLE data callback
-    bleServer.onDataReceived(onBLEDataReceived);
+    // ToRadio from BLE and from framed serial clients shares one queue,
+    // drained on loop()
+    toRadioQueue.begin();
+    bleServer.onDataReceived([](uint8_t* data, size_t length) {
+        toRadioQueue.push(TORADIO_BLE, data, length);
+    });
+    serialStream.onFrame([](const uint8_t* data, size_t length) {
+        toRadioQueue.push(TORADIO_SERIAL, data, length);
+    });
+    serialStream.onLine(onSerialLine);
     
     // Register BLE key command callback
     bleServer.onKeyCommand([](const String& cmd) {
@@ -161,6 +760,7 @@ void setup() {
             String key = cmd.substring(15);
             key.trim();
             if (keyManager.importPrivateKey(key)) {
+                pkiKeysChanged = true;
                 Serial.println("✓ Private key imported via BLE");
             } else {
                 Serial.println("✗ Failed to import private key via BLE");
@@ -169,6 +769,7 @@ void setup() {
             String key = cmd.substring(14);
             key.trim();
             if (keyManager.importPublicKey(key)) {
+                pkiKeysChanged = true;
                 Serial.println("✓ Public key imported via BLE");
             } else {
                 Serial.println("✗ Failed to import public key via BLE");
@@ -176,6 +777,13 @@ void setup() {
         } else if (cmd == "SKIP_KEYS") {
             Serial.println("Skipping key check via BLE...");
             currentState = STATE_ADVERTISING;
+        } else if (isQueryCommand(cmd)) {
+            // Stores are not thread-safe - answer from loop()
+            if (!queryPending) {
+                strncpy(pendingQuery, cmd.c_str(), sizeof(pendingQuery) - 1);
+                pendingQuery[sizeof(pendingQuery) - 1] = '\0';
+                queryPending = true;
+            }
         } else if (cmd == "STATUS") {
             // Send key status back
             if (keyManager.hasKeys()) {
@@ -196,9 +804,41 @@ void setup() {
 
 void loop() {
     unsigned long currentTime = millis();
-    static bool keyCheckMessageShown = false;
     
-    // Handle PRG button for sleep mode toggle
+    // Serial console lines and API frames, without waiting on the UART
+    serialStream.update();
+    ToRadioFrame frame;
+    while (toRadioQueue.pop(frame)) {
+        onToRadio(frame.data, frame.length);
+    }
+    
+    // Deferred BLE work: advertising restart, queued FromRadio frames
+    bleServer.update();
+    chunkedTransfer.update();
+    xmodem.update();
+    storeForward.update();
+    telemetry.update();
+    localTelemetry.update();
+    outbound.update();
+    display.update();
+    positions.update();
+    topology.update();
+    admin.update();
+    
+    if (pkiKeysChanged) {
+        pkiKeysChanged = false;
+        loadPkiKeys();
+    }
+    
+    if (queryPending) {
+        String response;
+        runQueryCommand(String(pendingQuery), response);
+        bleServer.setKeyCommandResponse(response);
+        Serial.printf("Query %s: %s\n", pendingQuery, response.c_str());
+        queryPending = false;
+    }
+    
+    // Handle PRG button: sleep toggle, message scrolling, shutdown
     bool buttonPressed = (digitalRead(PRG_BUTTON) == LOW);
     
     // Update battery level periodically
@@ -207,6 +847,8 @@ void loop() {
         bool charging = (digitalRead(VBUS_PIN) == HIGH);  // HIGH when USB connected
         
         bleServer.updateBatteryLevel(batteryLevel);
+        localTelemetry.updateBattery(batteryLevel, batteryVoltage, charging);
+        telemetry.record(messageHandler.getNodeNum(), localTelemetry.snapshot());
         display.updateBatteryLevel(batteryLevel);
         display.updateChargingStatus(charging);
         
@@ -218,11 +860,14 @@ void loop() {
         // Button just pressed
         buttonPressTime = currentTime;
         buttonWasPressed = true;
+        buttonWoke = display.activity();
     } else if (!buttonPressed && buttonWasPressed) {
         // Button just released
         unsigned long pressDuration = currentTime - buttonPressTime;
         
-        if (pressDuration >= LONG_PRESS_TIME) {
+        if (buttonWoke) {
+            // The press only turned the idle display back on
+        } else if (pressDuration >= LONG_PRESS_TIME) {
             // Long press detected - toggle sleep mode
             sleepMode = !sleepMode;
             clickCount = 0;  // Reset click counter
@@ -242,7 +887,7 @@ void loop() {
                         display.showScanning();
                         break;
                     case STATE_CONNECTED:
-                        display.showConnected(bleServer.getDeviceName());
+                        display.showMessages(messageHandler);
                         break;
                     default:
                         break;
@@ -267,8 +912,24 @@ void loop() {
         buttonWasPressed = false;
     }
     
-    // Reset click counter if timeout exceeded
+    // A click sequence ends when no click follows within the timeout:
+    // one click scrolls the message list, two open or close a message,
+    // three switch conversation, four step messages -> telemetry -> nearby
     if (clickCount > 0 && currentTime - lastClickTime > MULTI_CLICK_TIMEOUT) {
+        if (currentState == STATE_CONNECTED && !sleepMode) {
+            InfoScreen previous = infoScreen;
+            infoScreen = SCREEN_MESSAGES;
+            if (clickCount == 1) {
+                display.scrollMessages(messageHandler);
+            } else if (clickCount == 2) {
+                display.toggleDetail(messageHandler);
+            } else if (clickCount == 3) {
+                display.nextConversation(messageHandler);
+            } else if (clickCount == 4) {
+                infoScreen = (InfoScreen)((previous + 1) % SCREEN_COUNT);
+                showInfoScreen();
+            }
+        }
         clickCount = 0;
     }
     
@@ -295,32 +956,6 @@ void loop() {
                     keyCheckMessageShown = true;
                 }
                 
-                // Wait for serial input
-                if (Serial.available()) {
-                    String cmd = Serial.readStringUntil('\n');
-                    cmd.trim();
-                    
-                    if (cmd.startsWith("IMPORT_PRIVATE:")) {
-                        String key = cmd.substring(15);
-                        key.trim();
-                        if (keyManager.importPrivateKey(key)) {
-                            Serial.println("✓ Private key imported");
-                        }
-                    } else if (cmd.startsWith("IMPORT_PUBLIC:")) {
-                        String key = cmd.substring(14);
-                        key.trim();
-                        if (keyManager.importPublicKey(key)) {
-                            Serial.println("✓ Public key imported");
-                        }
-                    } else if (cmd == "SKIP_KEYS") {
-                        Serial.println("Skipping key check...");
-                        currentState = STATE_ADVERTISING;
-                        keyCheckMessageShown = false;
-                    } else {
-                        Serial.println("Unknown command: " + cmd);
-                    }
-                }
-                
                 // Small delay to prevent tight loop
                 delay(100);
             }
@@ -343,7 +978,6 @@ void loop() {
                     display.showConnected(bleServer.getDeviceName());
                     currentState = STATE_CONNECTED;
                     advMessageShown = false;
-                    delay(1000);
                 }
                 
                 delay(100);
@@ -355,39 +989,21 @@ void loop() {
             if (!bleServer.isConnected()) {
                 Serial.println("Client disconnected!");
                 display.showDisconnected();
-                delay(2000);
                 currentState = STATE_ADVERTISING;
                 break;
             }
             
-            // Update display periodically
-            if (currentTime - lastDisplayUpdate > DISPLAY_UPDATE_INTERVAL) {
+            // Redraw only when something on screen changed; a new message
+            // also wakes an idle display
+            if (messagesChanged) {
+                messagesChanged = false;
+                infoScreen = SCREEN_MESSAGES;
+                display.activity();
                 display.showMessages(messageHandler);
-                lastDisplayUpdate = currentTime;
+            } else if (display.needsRedraw()) {
+                showInfoScreen();
             }
             
-            // Check for serial commands to send messages
-            if (Serial.available()) {
-                String msg = Serial.readStringUntil('\n');
-                msg.trim();
-                
-                if (msg.length() > 0) {
-                    Serial.printf("Sending message: %s\n", msg.c_str());
-                    
-                    uint8_t buffer[256];
-                    size_t length;
-                    
-                    if (messageHandler.createTextMessage(msg, buffer, &length, sizeof(buffer))) {
-                        if (bleServer.sendFromRadio(buffer, length)) {
-                            Serial.println("Message sent to client!");
-                            messageHandler.addSentMessage(msg);
-                            display.showMessages(messageHandler);
-                        } else {
-                            Serial.println("Failed to send message");
-                        }
-                    }
-                }
-            }
             break;
             
         default:
@@ -59,3 +59,22 @@ bool decode_from_radio(const uint8_t *buffer, size_t buffer_size, meshtastic_Fro
     pb_istream_t stream = pb_istream_from_buffer(buffer, buffer_size);
     return pb_decode(&stream, meshtastic_FromRadio_fields, msg);
 }
+
+// Decode ToRadio message from buffer
+bool decode_to_radio(const uint8_t *buffer, size_t buffer_size, meshtastic_ToRadio *msg) {
+    pb_istream_t stream = pb_istream_from_buffer(buffer, buffer_size);
+    return pb_decode(&stream, meshtastic_ToRadio_fields, msg);
+}
+
+// Encode FromRadio message to buffer
+bool encode_from_radio(uint8_t *buffer, size_t buffer_size, const meshtastic_FromRadio *msg, size_t *bytes_written) {
+    pb_ostream_t stream = pb_ostream_from_buffer(buffer, buffer_size);
+    
+    bool status = pb_encode(&stream, meshtastic_FromRadio_fields, msg);
+    
+    if (status && bytes_written) {
+        *bytes_written = stream.bytes_written;
+    }
+    
+    return status;
+}
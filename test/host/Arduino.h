@@ -0,0 +1,367 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Host stand-in for the Arduino-ESP32 core, just enough of it to build the
+// portable modules in [env:native]. The clock runs in real time but can be
+// pushed forward with hostAdvanceMillis(), and Serial output is captured
+// instead of printed so tests can inspect it.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+
+using std::min;
+using std::max;
+
+#define HEX 16
+#define DEC 10
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define PROGMEM
+#define IRAM_ATTR
+#define ADC_11db 3
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+template<class T, class L, class H>
+auto constrain(T x, L lo, H hi) -> decltype(x + lo) {
+    return x < lo ? lo : (x > hi ? hi : x);
+}
+
+// --- Time ---
+
+inline const std::chrono::steady_clock::time_point hostClockStart = std::chrono::steady_clock::now();
+inline std::atomic<uint64_t> hostClockOffsetMicros{0};
+
+inline unsigned long micros() {
+    auto elapsed = std::chrono::steady_clock::now() - hostClockStart;
+    return (unsigned long)(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() +
+                           hostClockOffsetMicros.load());
+}
+
+inline unsigned long millis() {
+    return micros() / 1000;
+}
+
+// Jump the clock forward without sleeping (timeouts, history windows)
+inline void hostAdvanceMillis(unsigned long ms) {
+    hostClockOffsetMicros += (uint64_t)ms * 1000;
+}
+
+// Waits in setup code only; advance the clock instead of sleeping
+inline void delay(unsigned long ms) {
+    hostAdvanceMillis(ms);
+}
+
+inline void delayMicroseconds(unsigned int us) {
+    hostClockOffsetMicros += us;
+}
+
+inline void yield() {
+    std::this_thread::yield();
+}
+
+// --- Random numbers: seeded, so test runs repeat ---
+
+inline std::mt19937& hostRandom() {
+    static std::mt19937 generator(0x4d455348);
+    return generator;
+}
+
+inline void randomSeed(unsigned long seed) {
+    hostRandom().seed(seed);
+}
+
+inline uint32_t esp_random() {
+    return hostRandom()();
+}
+
+inline long random(long howBig) {
+    return howBig <= 0 ? 0 : (long)(esp_random() % (uint32_t)howBig);
+}
+
+inline long random(long howSmall, long howBig) {
+    return howSmall >= howBig ? howSmall : howSmall + random(howBig - howSmall);
+}
+
+// --- GPIO, ADC and power: inert ---
+
+typedef int gpio_num_t;
+
+inline void pinMode(int, int) {}
+inline void digitalWrite(int, int) {}
+inline int digitalRead(int) { return HIGH; }
+inline int analogRead(int) { return 0; }
+inline uint32_t analogReadMilliVolts(int) { return 0; }
+inline void analogReadResolution(int) {}
+inline void analogSetAttenuation(int) {}
+inline void esp_sleep_enable_ext0_wakeup(gpio_num_t, int) {}
+inline void esp_deep_sleep_start() { exit(0); }
+
+struct EspClass {
+    uint32_t getFreeHeap() { return 256 * 1024; }
+    uint32_t getCycleCount() { return (uint32_t)(micros() * 240); }
+    uint64_t getEfuseMac() { return 0x0000a1b2c3d4e5f6ULL; }
+};
+inline EspClass ESP;
+
+// --- String ---
+
+class String {
+public:
+    String(const char* s = "") : s(s ? s : "") {}
+    String(const char* s, unsigned int length) : s(s, length) {}
+    String(const std::string& s) : s(s) {}
+    explicit String(char c) : s(1, c) {}
+    String(int value, unsigned char base = 10) : s(format((long long)value, base)) {}
+    String(unsigned int value, unsigned char base = 10) : s(formatUnsigned(value, base)) {}
+    String(long value, unsigned char base = 10) : s(format((long long)value, base)) {}
+    String(unsigned long value, unsigned char base = 10) : s(formatUnsigned(value, base)) {}
+    String(unsigned char value, unsigned char base = 10) : s(formatUnsigned(value, base)) {}
+    String(float value, unsigned int decimals = 2) : s(formatFloat(value, decimals)) {}
+    String(double value, unsigned int decimals = 2) : s(formatFloat(value, decimals)) {}
+
+    const char* c_str() const { return s.c_str(); }
+    unsigned int length() const { return s.length(); }
+    bool isEmpty() const { return s.empty(); }
+    bool reserve(unsigned int size) { s.reserve(size); return true; }
+
+    char charAt(unsigned int index) const { return index < s.length() ? s[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    char& operator[](unsigned int index) { return s[index]; }
+    void setCharAt(unsigned int index, char c) { if (index < s.length()) s[index] = c; }
+
+    String substring(unsigned int from) const { return from < s.length() ? String(s.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) std::swap(from, to);
+        if (from >= s.length()) return String();
+        return String(s.substr(from, min(to, (unsigned int)s.length()) - from));
+    }
+
+    int indexOf(char c, unsigned int from = 0) const { return position(s.find(c, from)); }
+    int indexOf(const char* str, unsigned int from = 0) const { return position(s.find(str, from)); }
+    int indexOf(const String& str, unsigned int from = 0) const { return position(s.find(str.s, from)); }
+    int lastIndexOf(char c) const { return position(s.rfind(c)); }
+    int lastIndexOf(const String& str) const { return position(s.rfind(str.s)); }
+
+    bool startsWith(const String& prefix) const { return s.compare(0, prefix.s.length(), prefix.s) == 0; }
+    bool endsWith(const String& suffix) const {
+        return s.length() >= suffix.s.length() &&
+               s.compare(s.length() - suffix.s.length(), suffix.s.length(), suffix.s) == 0;
+    }
+    bool equals(const String& other) const { return s == other.s; }
+    bool equalsIgnoreCase(const String& other) const {
+        return s.length() == other.s.length() &&
+               std::equal(s.begin(), s.end(), other.s.begin(),
+                          [](char a, char b) { return tolower((unsigned char)a) == tolower((unsigned char)b); });
+    }
+
+    void trim() {
+        size_t start = s.find_first_not_of(" \t\r\n");
+        size_t end = s.find_last_not_of(" \t\r\n");
+        s = start == std::string::npos ? std::string() : s.substr(start, end - start + 1);
+    }
+    void toUpperCase() { for (char& c : s) c = toupper((unsigned char)c); }
+    void toLowerCase() { for (char& c : s) c = tolower((unsigned char)c); }
+    void remove(unsigned int index) { if (index < s.length()) s.erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < s.length()) s.erase(index, count); }
+    void replace(const String& find, const String& with) {
+        if (find.s.empty()) return;
+        for (size_t at = s.find(find.s); at != std::string::npos; at = s.find(find.s, at + with.s.length())) {
+            s.replace(at, find.s.length(), with.s);
+        }
+    }
+
+    long toInt() const { return atol(s.c_str()); }
+    float toFloat() const { return (float)atof(s.c_str()); }
+    double toDouble() const { return atof(s.c_str()); }
+
+    void getBytes(unsigned char* buf, unsigned int size, unsigned int index = 0) const {
+        if (size == 0) return;
+        size_t n = index < s.length() ? min((size_t)size - 1, s.length() - index) : 0;
+        memcpy(buf, s.data() + index, n);
+        buf[n] = 0;
+    }
+    void toCharArray(char* buf, unsigned int size, unsigned int index = 0) const {
+        getBytes((unsigned char*)buf, size, index);
+    }
+
+    bool concat(const String& other) { s += other.s; return true; }
+    String& operator+=(const String& other) { s += other.s; return *this; }
+    String& operator+=(const char* other) { s += other; return *this; }
+    String& operator+=(char c) { s += c; return *this; }
+    template<class T> String& operator+=(T value) { return *this += String(value); }
+
+    bool operator==(const String& other) const { return s == other.s; }
+    bool operator==(const char* other) const { return s == other; }
+    bool operator!=(const String& other) const { return s != other.s; }
+    bool operator!=(const char* other) const { return s != other; }
+    bool operator<(const String& other) const { return s < other.s; }
+
+private:
+    std::string s;
+
+    static int position(size_t at) { return at == std::string::npos ? -1 : (int)at; }
+    static std::string formatUnsigned(unsigned long long value, unsigned char base) {
+        if (value == 0) return "0";
+        std::string out;
+        while (value > 0) {
+            out.insert(out.begin(), "0123456789abcdefghijklmnopqrstuvwxyz"[value % base]);
+            value /= base;
+        }
+        return out;
+    }
+    static std::string format(long long value, unsigned char base) {
+        if (base != 10) return formatUnsigned((unsigned long)value, base);
+        return value < 0 ? "-" + formatUnsigned(-(unsigned long long)value, base) : formatUnsigned(value, base);
+    }
+    static std::string formatFloat(double value, unsigned int decimals) {
+        char buf[48];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, value);
+        return buf;
+    }
+};
+
+inline String operator+(const String& a, const String& b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, const char* b) { String r(a); r += b; return r; }
+inline String operator+(const char* a, const String& b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, char b) { String r(a); r += b; return r; }
+template<class T> String operator+(const String& a, T b) { String r(a); r += String(b); return r; }
+
+// --- Print / Stream / Serial ---
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t byte) = 0;
+    virtual size_t write(const uint8_t* data, size_t length) {
+        size_t n = 0;
+        while (n < length && write(data[n])) n++;
+        return n;
+    }
+    size_t write(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t print(const char* text) { return write(text); }
+    size_t print(const String& text) { return write(text.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    template<class T> size_t print(T value) { return print(String(value)); }
+    size_t println() { return write("\r\n"); }
+    template<class T> size_t println(T value) { return print(value) + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[512];
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        return n > 0 ? write((const uint8_t*)buf, min((size_t)n, sizeof(buf) - 1)) : 0;
+    }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long ms) { timeoutMs = ms; }
+    size_t readBytes(uint8_t* buffer, size_t length) {
+        size_t n = 0;
+        for (int c; n < length && (c = read()) >= 0;) buffer[n++] = (uint8_t)c;
+        return n;
+    }
+    size_t readBytes(char* buffer, size_t length) { return readBytes((uint8_t*)buffer, length); }
+    String readStringUntil(char terminator) {
+        String out;
+        for (int c; (c = read()) >= 0 && c != terminator;) out += (char)c;
+        return out;
+    }
+
+protected:
+    unsigned long timeoutMs = 1000;
+};
+
+// A UART: tests feed its receive side and read back what was written.
+// Output is also echoed to stdout when HOST_SERIAL_ECHO is set.
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long) {}
+    void end() {}
+    size_t setRxBufferSize(size_t size) { return size; }
+    operator bool() const { return true; }
+
+    int available() override {
+        std::lock_guard<std::mutex> lock(mutex);
+        return (int)rx.size();
+    }
+    int read() override {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (rx.empty()) return -1;
+        uint8_t c = rx.front();
+        rx.pop_front();
+        return c;
+    }
+    int peek() override {
+        std::lock_guard<std::mutex> lock(mutex);
+        return rx.empty() ? -1 : rx.front();
+    }
+    size_t write(uint8_t byte) override { return write(&byte, 1); }
+    size_t write(const uint8_t* data, size_t length) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        tx.append((const char*)data, length);
+        if (tx.size() > HOST_SERIAL_KEEP) tx.erase(0, tx.size() - HOST_SERIAL_KEEP);
+        if (getenv("HOST_SERIAL_ECHO")) fwrite(data, 1, length, stdout);
+        return length;
+    }
+    int availableForWrite() override { return 4096; }
+    using Print::write;
+
+    // Test side
+    void inject(const uint8_t* data, size_t length) {
+        std::lock_guard<std::mutex> lock(mutex);
+        rx.insert(rx.end(), data, data + length);
+    }
+    void inject(const char* text) { inject((const uint8_t*)text, strlen(text)); }
+    std::string output() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return tx;
+    }
+    void clearOutput() {
+        std::lock_guard<std::mutex> lock(mutex);
+        tx.clear();
+    }
+
+private:
+    static const size_t HOST_SERIAL_KEEP = 64 * 1024;
+    std::mutex mutex;
+    std::deque<uint8_t> rx;
+    std::string tx;
+};
+
+inline HardwareSerial Serial;
+
+// The ESP32 core pulls in the kernel for every sketch
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,217 @@
+#ifndef HOST_BLE_DEVICE_H
+#define HOST_BLE_DEVICE_H
+
+// Host stand-in for the Arduino-ESP32 BLE server. Callbacks are invoked
+// the way the BLE task does, but synchronously on the calling thread.
+// Tests play the part of the clients through `hostBle`: connect and
+// disconnect them, write characteristics as they would, and read back
+// the notifications each connection was sent.
+
+#include <Arduino.h>
+#include <map>
+#include <set>
+#include <vector>
+#include "esp_gatts_api.h"
+
+class BLEServer;
+class BLECharacteristic;
+
+class BLEServerCallbacks {
+public:
+    virtual ~BLEServerCallbacks() {}
+    virtual void onConnect(BLEServer*) {}
+    virtual void onConnect(BLEServer* server, esp_ble_gatts_cb_param_t*) { onConnect(server); }
+    virtual void onDisconnect(BLEServer*) {}
+    virtual void onDisconnect(BLEServer* server, esp_ble_gatts_cb_param_t*) { onDisconnect(server); }
+};
+
+class BLECharacteristicCallbacks {
+public:
+    virtual ~BLECharacteristicCallbacks() {}
+    virtual void onWrite(BLECharacteristic*) {}
+    virtual void onWrite(BLECharacteristic* characteristic, esp_ble_gatts_cb_param_t*) { onWrite(characteristic); }
+    virtual void onRead(BLECharacteristic*) {}
+    virtual void onRead(BLECharacteristic* characteristic, esp_ble_gatts_cb_param_t*) { onRead(characteristic); }
+};
+
+// A notification as a client received it
+struct HostNotification {
+    uint16_t connId;
+    uint16_t handle;
+    std::vector<uint8_t> value;
+};
+
+struct HostBle {
+    BLEServer* server = nullptr;
+    std::map<std::string, BLECharacteristic*> characteristics;   // By UUID
+    std::set<uint16_t> connected;
+    std::set<uint16_t> congested;        // Notifications to these fail, as with a full TX buffer
+    std::vector<HostNotification> notifications;
+    bool advertising = false;
+    uint32_t advertisingStarts = 0;
+
+    BLECharacteristic* characteristic(const char* uuid) { return characteristics[uuid]; }
+
+    // Test side, as the stack reports clients
+    void connect(uint16_t connId, const uint8_t* address,
+                 esp_ble_addr_type_t type = BLE_ADDR_TYPE_PUBLIC);
+    void disconnect(uint16_t connId);
+    void write(const char* uuid, uint16_t connId, const uint8_t* data, size_t length);
+
+    // Notifications on `handle` sent to a connection since the last call
+    std::vector<std::vector<uint8_t>> take(uint16_t connId, uint16_t handle) {
+        std::vector<std::vector<uint8_t>> out;
+        for (auto it = notifications.begin(); it != notifications.end();) {
+            if (it->connId == connId && it->handle == handle) {
+                out.push_back(it->value);
+                it = notifications.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        return out;
+    }
+    void reset() {
+        connected.clear();
+        congested.clear();
+        notifications.clear();
+    }
+};
+inline HostBle hostBle;
+
+class BLEDescriptor {};
+
+class BLECharacteristic {
+public:
+    static const uint32_t PROPERTY_READ = 1 << 0;
+    static const uint32_t PROPERTY_WRITE = 1 << 1;
+    static const uint32_t PROPERTY_NOTIFY = 1 << 2;
+    static const uint32_t PROPERTY_INDICATE = 1 << 3;
+    static const uint32_t PROPERTY_WRITE_NR = 1 << 4;
+
+    BLECharacteristic(const char* uuid, uint32_t properties, uint16_t handle)
+        : uuid(uuid), properties(properties), handle(handle) {}
+
+    uint16_t getHandle() { return handle; }
+    void setCallbacks(BLECharacteristicCallbacks* callbacks) { this->callbacks = callbacks; }
+    void setValue(uint8_t* data, size_t length) { value.assign((const char*)data, length); }
+    void setValue(const String& text) { value.assign(text.c_str(), text.length()); }
+    void setValue(uint16_t& number) { setValue((uint8_t*)&number, sizeof(number)); }
+    void setValue(uint32_t& number) { setValue((uint8_t*)&number, sizeof(number)); }
+    String getValue() { return String(value.data(), value.size()); }
+    uint8_t* getData() { return (uint8_t*)value.data(); }
+    size_t getLength() { return value.size(); }
+    void notify(bool = true) { notifyCount++; }
+
+    // Test side: a client writes the characteristic
+    void hostWrite(uint16_t connId, const uint8_t* data, size_t length) {
+        value.assign((const char*)data, length);
+        esp_ble_gatts_cb_param_t param = {};
+        param.write.conn_id = connId;
+        param.write.handle = handle;
+        param.write.len = length;
+        param.write.value = (uint8_t*)value.data();
+        if (callbacks) {
+            callbacks->onWrite(this, &param);
+        }
+    }
+
+    std::string uuid;
+    uint32_t properties;
+    uint32_t notifyCount = 0;
+
+private:
+    uint16_t handle;
+    std::string value;
+    BLECharacteristicCallbacks* callbacks = nullptr;
+};
+
+class BLEService {
+public:
+    BLECharacteristic* createCharacteristic(const char* uuid, uint32_t properties) {
+        static uint16_t nextHandle = 0x2a;
+        BLECharacteristic* characteristic = new BLECharacteristic(uuid, properties, nextHandle);
+        nextHandle += 3;   // Declaration, value and CCC descriptor
+        hostBle.characteristics[uuid] = characteristic;
+        return characteristic;
+    }
+    void start() {}
+};
+
+class BLEAdvertising {
+public:
+    void addServiceUUID(const char*) {}
+    void setScanResponse(bool) {}
+    void setMinPreferred(uint16_t) {}
+    void setMaxPreferred(uint16_t) {}
+    void start() {
+        hostBle.advertising = true;
+        hostBle.advertisingStarts++;
+    }
+    void stop() { hostBle.advertising = false; }
+};
+
+class BLEServer {
+public:
+    BLEService* createService(const char*) { return new BLEService(); }
+    void setCallbacks(BLEServerCallbacks* callbacks) { this->callbacks = callbacks; }
+    BLEAdvertising* getAdvertising() { return &advertising; }
+    void startAdvertising() { advertising.start(); }
+    esp_gatt_if_t getGattsIf() { return 3; }
+    uint32_t getConnectedCount() { return hostBle.connected.size(); }
+    void disconnect(uint16_t connId) { hostBle.disconnect(connId); }
+
+    BLEServerCallbacks* callbacks = nullptr;
+
+private:
+    BLEAdvertising advertising;
+};
+
+class BLEDevice {
+public:
+    static void init(const char*) {}
+    static void setMTU(uint16_t) {}
+    static BLEServer* createServer() {
+        hostBle.server = new BLEServer();
+        return hostBle.server;
+    }
+};
+
+inline void HostBle::connect(uint16_t connId, const uint8_t* address, esp_ble_addr_type_t type) {
+    connected.insert(connId);
+    advertising = false;   // The stack stops advertising on connect
+    esp_ble_gatts_cb_param_t param = {};
+    param.connect.conn_id = connId;
+    memcpy(param.connect.remote_bda, address, 6);
+    param.connect.ble_addr_type = type;
+    if (server && server->callbacks) {
+        server->callbacks->onConnect(server, &param);
+    }
+}
+
+inline void HostBle::disconnect(uint16_t connId) {
+    if (connected.erase(connId) == 0) {
+        return;
+    }
+    esp_ble_gatts_cb_param_t param = {};
+    param.disconnect.conn_id = connId;
+    param.disconnect.reason = 0x13;   // Remote user terminated
+    if (server && server->callbacks) {
+        server->callbacks->onDisconnect(server, &param);
+    }
+}
+
+inline void HostBle::write(const char* uuid, uint16_t connId, const uint8_t* data, size_t length) {
+    characteristic(uuid)->hostWrite(connId, data, length);
+}
+
+inline esp_err_t esp_ble_gatts_send_indicate(esp_gatt_if_t, uint16_t conn_id, uint16_t attr_handle,
+                                             uint16_t value_len, uint8_t* value, bool) {
+    if (hostBle.connected.count(conn_id) == 0 || hostBle.congested.count(conn_id) > 0) {
+        return ESP_FAIL;
+    }
+    hostBle.notifications.push_back({conn_id, attr_handle, std::vector<uint8_t>(value, value + value_len)});
+    return ESP_OK;
+}
+
+#endif // HOST_BLE_DEVICE_H
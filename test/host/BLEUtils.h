@@ -0,0 +1,6 @@
+#ifndef HOST_BLEUTILS_H
+#define HOST_BLEUTILS_H
+
+#include "BLEDevice.h"
+
+#endif // HOST_BLEUTILS_H
@@ -0,0 +1,70 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+// NVS stand-in: namespaces live in memory for the whole test run, so a
+// test can close and reopen them as a reboot would
+inline std::map<std::string, std::map<std::string, std::vector<uint8_t>>> hostNvs;
+
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false) {
+        space = &hostNvs[name];
+        this->readOnly = readOnly;
+        return true;
+    }
+    void end() { space = nullptr; }
+    bool clear() {
+        if (space == nullptr || readOnly) return false;
+        space->clear();
+        return true;
+    }
+    bool isKey(const char* key) { return space != nullptr && space->count(key) > 0; }
+    bool remove(const char* key) { return space != nullptr && !readOnly && space->erase(key) > 0; }
+
+    size_t putBytes(const char* key, const void* value, size_t length) {
+        if (space == nullptr || readOnly) return 0;
+        const uint8_t* bytes = (const uint8_t*)value;
+        (*space)[key].assign(bytes, bytes + length);
+        return length;
+    }
+    size_t getBytesLength(const char* key) {
+        return isKey(key) ? (*space)[key].size() : 0;
+    }
+    size_t getBytes(const char* key, void* buf, size_t maxLength) {
+        size_t length = getBytesLength(key);
+        if (length == 0 || length > maxLength) return 0;
+        memcpy(buf, (*space)[key].data(), length);
+        return length;
+    }
+
+    size_t putString(const char* key, const String& value) {
+        return putBytes(key, value.c_str(), value.length() + 1) > 0 ? value.length() : 0;
+    }
+    String getString(const char* key, const String& defaultValue = String()) {
+        return isKey(key) ? String((const char*)(*space)[key].data()) : defaultValue;
+    }
+
+    size_t putUChar(const char* key, uint8_t value) { return putBytes(key, &value, sizeof(value)); }
+    uint8_t getUChar(const char* key, uint8_t defaultValue = 0) { return get(key, defaultValue); }
+    size_t putUShort(const char* key, uint16_t value) { return putBytes(key, &value, sizeof(value)); }
+    uint16_t getUShort(const char* key, uint16_t defaultValue = 0) { return get(key, defaultValue); }
+    size_t putUInt(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+    size_t putBool(const char* key, bool value) { return putUChar(key, value); }
+    bool getBool(const char* key, bool defaultValue = false) { return getUChar(key, defaultValue); }
+
+private:
+    std::map<std::string, std::vector<uint8_t>>* space = nullptr;
+    bool readOnly = false;
+
+    template<class T> T get(const char* key, T defaultValue) {
+        T value;
+        return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+    }
+};
+
+#endif // HOST_PREFERENCES_H
@@ -0,0 +1,276 @@
+#ifndef HOST_U8G2LIB_H
+#define HOST_U8G2LIB_H
+
+// Host stand-in for U8g2 driving an SSD1306 over I2C. Drawing goes into
+// the same page-ordered frame buffer as the real library (8 pages of 128
+// column bytes, LSB on top); every font draws the classic 5x7 glyphs in
+// its own advance width. Tiles sent to the panel land in `hostPanel`,
+// which counts the bytes they would take on the bus and, when given a bus
+// speed, takes as long as they would to send.
+
+#include <Arduino.h>
+
+#define HOST_PANEL_WIDTH   128
+#define HOST_PANEL_HEIGHT  64
+#define HOST_PANEL_BYTES   (HOST_PANEL_WIDTH * HOST_PANEL_HEIGHT / 8)
+
+// I2C cost model of the SSD1306 HW I2C driver: a 5-byte position command
+// (address, control, 3 commands) per tile row, then the data in Wire
+// transfers of up to 31 bytes, each with an address and a control byte
+#define HOST_I2C_POSITION_BYTES  5
+#define HOST_I2C_CHUNK           31
+#define HOST_I2C_CHUNK_OVERHEAD  2
+#define HOST_I2C_COMMAND_BYTES   3
+
+// The OLED at the end of the bus
+struct HostPanel {
+    std::mutex mutex;
+    uint8_t ram[HOST_PANEL_BYTES] = {};
+    uint32_t i2cBytes = 0;
+    uint32_t tileRows = 0;       // u8x8_DrawTile calls
+    uint8_t powerSave = 0;
+    uint8_t contrast = 0xCF;
+    uint32_t busHz = 0;          // 0 = transfers take no time
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        memset(ram, 0, sizeof(ram));
+        i2cBytes = 0;
+        tileRows = 0;
+        powerSave = 0;
+        contrast = 0xCF;
+        busHz = 0;
+    }
+    void copy(uint8_t* out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        memcpy(out, ram, sizeof(ram));
+    }
+};
+inline HostPanel hostPanel;
+
+typedef struct u8x8_struct { HostPanel* panel; } u8x8_t;
+typedef struct u8g2_struct { const uint8_t* font; } u8g2_t;
+typedef uint8_t u8g2_uint_t;
+struct u8g2_cb_t {};
+inline const u8g2_cb_t u8g2_cb_r0 = {};
+#define U8G2_R0 (&u8g2_cb_r0)
+
+// Fonts: advance width, line height, ascent
+inline const uint8_t u8g2_font_5x7_tf[] = {5, 7, 6};
+inline const uint8_t u8g2_font_6x10_tf[] = {6, 10, 7};
+inline const uint8_t u8g2_font_ncenB10_tr[] = {8, 11, 8};
+
+// Columns of the 5x7 ASCII glyphs from 0x20, LSB on top
+inline const uint8_t hostGlyphs[95][5] = {
+    {0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00}, {0x00,0x07,0x00,0x07,0x00}, {0x14,0x7F,0x14,0x7F,0x14},
+    {0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62}, {0x36,0x49,0x56,0x20,0x50}, {0x00,0x08,0x07,0x03,0x00},
+    {0x00,0x1C,0x22,0x41,0x00}, {0x00,0x41,0x22,0x1C,0x00}, {0x2A,0x1C,0x7F,0x1C,0x2A}, {0x08,0x08,0x3E,0x08,0x08},
+    {0x00,0x80,0x70,0x30,0x00}, {0x08,0x08,0x08,0x08,0x08}, {0x00,0x00,0x60,0x60,0x00}, {0x20,0x10,0x08,0x04,0x02},
+    {0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00}, {0x72,0x49,0x49,0x49,0x46}, {0x21,0x41,0x49,0x4D,0x33},
+    {0x18,0x14,0x12,0x7F,0x10}, {0x27,0x45,0x45,0x45,0x39}, {0x3C,0x4A,0x49,0x49,0x31}, {0x41,0x21,0x11,0x09,0x07},
+    {0x36,0x49,0x49,0x49,0x36}, {0x46,0x49,0x49,0x29,0x1E}, {0x00,0x00,0x14,0x00,0x00}, {0x00,0x40,0x34,0x00,0x00},
+    {0x00,0x08,0x14,0x22,0x41}, {0x14,0x14,0x14,0x14,0x14}, {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x59,0x09,0x06},
+    {0x3E,0x41,0x5D,0x59,0x4E}, {0x7C,0x12,0x11,0x12,0x7C}, {0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22},
+    {0x7F,0x41,0x41,0x41,0x3E}, {0x7F,0x49,0x49,0x49,0x41}, {0x7F,0x09,0x09,0x09,0x01}, {0x3E,0x41,0x41,0x51,0x73},
+    {0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00}, {0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41},
+    {0x7F,0x40,0x40,0x40,0x40}, {0x7F,0x02,0x1C,0x02,0x7F}, {0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E},
+    {0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E}, {0x7F,0x09,0x19,0x29,0x46}, {0x26,0x49,0x49,0x49,0x32},
+    {0x03,0x01,0x7F,0x01,0x03}, {0x3F,0x40,0x40,0x40,0x3F}, {0x1F,0x20,0x40,0x20,0x1F}, {0x3F,0x40,0x38,0x40,0x3F},
+    {0x63,0x14,0x08,0x14,0x63}, {0x03,0x04,0x78,0x04,0x03}, {0x61,0x59,0x49,0x4D,0x43}, {0x00,0x7F,0x41,0x41,0x41},
+    {0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x41,0x7F}, {0x04,0x02,0x01,0x02,0x04}, {0x40,0x40,0x40,0x40,0x40},
+    {0x00,0x03,0x07,0x08,0x00}, {0x20,0x54,0x54,0x78,0x40}, {0x7F,0x28,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x28},
+    {0x38,0x44,0x44,0x28,0x7F}, {0x38,0x54,0x54,0x54,0x18}, {0x00,0x08,0x7E,0x09,0x02}, {0x18,0xA4,0xA4,0x9C,0x78},
+    {0x7F,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7D,0x40,0x00}, {0x20,0x40,0x40,0x3D,0x00}, {0x7F,0x10,0x28,0x44,0x00},
+    {0x00,0x41,0x7F,0x40,0x00}, {0x7C,0x04,0x78,0x04,0x78}, {0x7C,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38},
+    {0xFC,0x18,0x24,0x24,0x18}, {0x18,0x24,0x24,0x18,0xFC}, {0x7C,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x24},
+    {0x04,0x04,0x3F,0x44,0x24}, {0x3C,0x40,0x40,0x20,0x7C}, {0x1C,0x20,0x40,0x20,0x1C}, {0x3C,0x40,0x30,0x40,0x3C},
+    {0x44,0x28,0x10,0x28,0x44}, {0x4C,0x90,0x90,0x90,0x7C}, {0x44,0x64,0x54,0x4C,0x44}, {0x00,0x08,0x36,0x41,0x00},
+    {0x00,0x00,0x77,0x00,0x00}, {0x00,0x41,0x36,0x08,0x00}, {0x02,0x01,0x02,0x04,0x02},
+};
+
+inline uint32_t hostI2cDataBytes(size_t length) {
+    return length + (length + HOST_I2C_CHUNK - 1) / HOST_I2C_CHUNK * HOST_I2C_CHUNK_OVERHEAD;
+}
+
+// Hold the caller for the time `bytes` take on the bus (9 clocks each, with ACK)
+inline void hostI2cWait(const HostPanel& panel, uint32_t bytes) {
+    if (panel.busHz > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds((uint64_t)bytes * 9 * 1000000 / panel.busHz));
+    }
+}
+
+// Send `cnt` tiles (8 columns each) to page `y` from tile column `x`
+inline uint8_t u8x8_DrawTile(u8x8_t* u8x8, uint8_t x, uint8_t y, uint8_t cnt, uint8_t* tiles) {
+    HostPanel& panel = *u8x8->panel;
+    uint32_t bytes;
+    {
+        std::lock_guard<std::mutex> lock(panel.mutex);
+        size_t length = min((size_t)cnt * 8, (size_t)HOST_PANEL_WIDTH - x * 8);
+        memcpy(panel.ram + y * HOST_PANEL_WIDTH + x * 8, tiles, length);
+        bytes = HOST_I2C_POSITION_BYTES + hostI2cDataBytes(length);
+        panel.i2cBytes += bytes;
+        panel.tileRows++;
+    }
+    hostI2cWait(panel, bytes);
+    return 1;
+}
+
+inline void u8x8_SetPowerSave(u8x8_t* u8x8, uint8_t is_enable) {
+    std::lock_guard<std::mutex> lock(u8x8->panel->mutex);
+    u8x8->panel->powerSave = is_enable;
+    u8x8->panel->i2cBytes += HOST_I2C_COMMAND_BYTES;
+}
+
+inline void u8x8_SetContrast(u8x8_t* u8x8, uint8_t value) {
+    std::lock_guard<std::mutex> lock(u8x8->panel->mutex);
+    u8x8->panel->contrast = value;
+    u8x8->panel->i2cBytes += HOST_I2C_COMMAND_BYTES + 1;
+}
+
+class U8G2 {
+public:
+    U8G2() {
+        u8x8.panel = &hostPanel;
+        u8g2.font = u8g2_font_6x10_tf;
+    }
+
+    bool begin() { clearBuffer(); sendBuffer(); return true; }
+    void clearBuffer() { memset(buffer, 0, sizeof(buffer)); }
+    void sendBuffer() {
+        for (uint8_t page = 0; page < HOST_PANEL_HEIGHT / 8; page++) {
+            u8x8_DrawTile(&u8x8, 0, page, HOST_PANEL_WIDTH / 8, buffer + page * HOST_PANEL_WIDTH);
+        }
+    }
+    uint8_t* getBufferPtr() { return buffer; }
+    uint8_t getBufferTileWidth() { return HOST_PANEL_WIDTH / 8; }
+    uint8_t getBufferTileHeight() { return HOST_PANEL_HEIGHT / 8; }
+    u8g2_t* getU8g2() { return &u8g2; }
+    u8x8_t* getU8x8() { return &u8x8; }
+    void setPowerSave(uint8_t is_enable) { u8x8_SetPowerSave(&u8x8, is_enable); }
+    void setContrast(uint8_t value) { u8x8_SetContrast(&u8x8, value); }
+
+    void setFont(const uint8_t* font) { u8g2.font = font; }
+    void setFontPosTop() { fontPosTop = true; }
+    void setFontPosBaseline() { fontPosTop = false; }
+    void setFontRefHeightExtendedText() {}
+    void setFontDirection(uint8_t) {}
+    void setDrawColor(uint8_t color) { drawColor = color; }
+    int8_t getAscent() { return u8g2.font[2]; }
+    int8_t getDescent() { return u8g2.font[2] - u8g2.font[1]; }
+    int getMaxCharWidth() { return u8g2.font[0]; }
+    int getStrWidth(const char* text) { return strlen(text) * u8g2.font[0]; }
+
+    int drawStr(int x, int y, const char* text) {
+        int top = fontPosTop ? y : y - u8g2.font[2];
+        int start = x;
+        for (const unsigned char* c = (const unsigned char*)text; *c; c++) {
+            drawGlyph(x, top, *c);
+            x += u8g2.font[0];
+        }
+        return x - start;
+    }
+
+    void drawPixel(int x, int y) {
+        if (x < 0 || x >= HOST_PANEL_WIDTH || y < 0 || y >= HOST_PANEL_HEIGHT) {
+            return;
+        }
+        uint8_t& column = buffer[(y / 8) * HOST_PANEL_WIDTH + x];
+        uint8_t bit = 1 << (y % 8);
+        column = drawColor == 0 ? column & ~bit : drawColor == 2 ? column ^ bit : column | bit;
+    }
+    void drawHLine(int x, int y, int w) { for (int i = 0; i < w; i++) drawPixel(x + i, y); }
+    void drawVLine(int x, int y, int h) { for (int i = 0; i < h; i++) drawPixel(x, y + i); }
+    void drawBox(int x, int y, int w, int h) { for (int i = 0; i < h; i++) drawHLine(x, y + i, w); }
+    void drawFrame(int x, int y, int w, int h) {
+        drawHLine(x, y, w);
+        drawHLine(x, y + h - 1, w);
+        drawVLine(x, y, h);
+        drawVLine(x + w - 1, y, h);
+    }
+    void drawLine(int x0, int y0, int x1, int y1) {
+        int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+        int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+        int err = dx + dy;
+        while (true) {
+            drawPixel(x0, y0);
+            if (x0 == x1 && y0 == y1) break;
+            int e2 = 2 * err;
+            if (e2 >= dy) { err += dy; x0 += sx; }
+            if (e2 <= dx) { err += dx; y0 += sy; }
+        }
+    }
+
+private:
+    u8g2_t u8g2;
+    u8x8_t u8x8;
+    uint8_t buffer[HOST_PANEL_BYTES] = {};
+    uint8_t drawColor = 1;
+    bool fontPosTop = false;
+
+    // ASCII from the table; anything else (Latin-1) as a hollow box
+    void drawGlyph(int x, int top, unsigned char c) {
+        if (c < 0x20 || c > 0x7e) {
+            drawFrame(x, top, 5, 7);
+            return;
+        }
+        for (int col = 0; col < 5; col++) {
+            for (int row = 0; row < 8; row++) {
+                if (hostGlyphs[c - 0x20][col] & (1 << row)) {
+                    drawPixel(x + col, top + row);
+                }
+            }
+        }
+    }
+};
+
+class U8G2_SSD1306_128X64_NONAME_F_HW_I2C : public U8G2 {
+public:
+    U8G2_SSD1306_128X64_NONAME_F_HW_I2C(const u8g2_cb_t*, uint8_t = 255, uint8_t = 255, uint8_t = 255) {}
+};
+
+inline uint16_t u8g2_GetGlyphWidth(u8g2_t* u8g2, uint16_t) {
+    return u8g2->font[0];
+}
+
+// Plain PBM (P1), for the golden screens of test_display
+inline bool hostWritePbm(const uint8_t* frame, const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+    fprintf(file, "P1\n%d %d\n", HOST_PANEL_WIDTH, HOST_PANEL_HEIGHT);
+    for (int y = 0; y < HOST_PANEL_HEIGHT; y++) {
+        for (int x = 0; x < HOST_PANEL_WIDTH; x++) {
+            fputc((frame[(y / 8) * HOST_PANEL_WIDTH + x] >> (y % 8)) & 1 ? '1' : '0', file);
+        }
+        fputc('\n', file);
+    }
+    return fclose(file) == 0;
+}
+
+inline bool hostReadPbm(const char* path, uint8_t* frame) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+    int width = 0, height = 0;
+    bool ok = fscanf(file, "P1 %d %d", &width, &height) == 2 &&
+              width == HOST_PANEL_WIDTH && height == HOST_PANEL_HEIGHT;
+    memset(frame, 0, HOST_PANEL_BYTES);
+    for (int i = 0; ok && i < HOST_PANEL_WIDTH * HOST_PANEL_HEIGHT;) {
+        int c = fgetc(file);
+        if (c == EOF) {
+            ok = false;
+        } else if (c == '0' || c == '1') {
+            int x = i % HOST_PANEL_WIDTH, y = i / HOST_PANEL_WIDTH;
+            if (c == '1') {
+                frame[(y / 8) * HOST_PANEL_WIDTH + x] |= 1 << (y % 8);
+            }
+            i++;
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+#endif // HOST_U8G2LIB_H
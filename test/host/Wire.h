@@ -0,0 +1,15 @@
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include <Arduino.h>
+
+// The panel's bus traffic is counted in U8g2lib.h; the bus itself is inert
+class TwoWire {
+public:
+    bool begin(int, int, uint32_t = 0) { return true; }
+    void setClock(uint32_t) {}
+};
+
+inline TwoWire Wire;
+
+#endif // HOST_WIRE_H
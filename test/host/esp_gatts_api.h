@@ -0,0 +1,47 @@
+#ifndef HOST_ESP_GATTS_API_H
+#define HOST_ESP_GATTS_API_H
+
+#include <stdint.h>
+
+typedef uint8_t esp_gatt_if_t;
+typedef int esp_err_t;
+#ifndef ESP_OK
+#define ESP_OK    0
+#define ESP_FAIL  -1
+#endif
+
+typedef enum {
+    BLE_ADDR_TYPE_PUBLIC = 0x00,
+    BLE_ADDR_TYPE_RANDOM = 0x01,
+    BLE_ADDR_TYPE_RPA_PUBLIC = 0x02,
+    BLE_ADDR_TYPE_RPA_RANDOM = 0x03
+} esp_ble_addr_type_t;
+
+// The GATT server events MeshtasticBLE reads
+typedef union {
+    struct gatts_connect_evt_param {
+        uint16_t conn_id;
+        uint8_t remote_bda[6];
+        esp_ble_addr_type_t ble_addr_type;
+    } connect;
+    struct gatts_disconnect_evt_param {
+        uint16_t conn_id;
+        uint8_t remote_bda[6];
+        int reason;
+    } disconnect;
+    struct gatts_write_evt_param {
+        uint16_t conn_id;
+        uint16_t handle;
+        uint16_t len;
+        uint8_t* value;
+    } write;
+    struct gatts_read_evt_param {
+        uint16_t conn_id;
+        uint16_t handle;
+    } read;
+} esp_ble_gatts_cb_param_t;
+
+// esp_ble_gatts_send_indicate() delivers to the simulated clients
+#include "BLEDevice.h"
+
+#endif // HOST_ESP_GATTS_API_H
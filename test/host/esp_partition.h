@@ -0,0 +1,113 @@
+#ifndef HOST_ESP_PARTITION_H
+#define HOST_ESP_PARTITION_H
+
+// One data partition in RAM with NOR flash rules: erase sets 4 KB sectors
+// to 0xFF, and a write can only clear bits
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+typedef int esp_err_t;
+#ifndef ESP_OK
+#define ESP_OK                 0
+#define ESP_FAIL               -1
+#endif
+#define ESP_ERR_INVALID_ARG    0x102
+#define ESP_ERR_INVALID_SIZE   0x104
+
+#define HOST_FLASH_SECTOR      4096
+#define HOST_PARTITION_SIZE    0x160000   // spiffs in the default 4 MB layout
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_DATA_NVS = 0x02,
+    ESP_PARTITION_SUBTYPE_DATA_FAT = 0x81,
+    ESP_PARTITION_SUBTYPE_DATA_SPIFFS = 0x82,
+    ESP_PARTITION_SUBTYPE_ANY = 0xff
+} esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    uint32_t erase_size;
+    char label[17];
+    bool encrypted;
+} esp_partition_t;
+
+inline const esp_partition_t hostPartition = {
+    ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, 0x290000, HOST_PARTITION_SIZE,
+    HOST_FLASH_SECTOR, "spiffs", false
+};
+
+// Partition contents and wear, for tests to inspect or wipe
+struct HostFlash {
+    std::vector<uint8_t> data = std::vector<uint8_t>(HOST_PARTITION_SIZE, 0xFF);
+    uint32_t sectorErases = 0;
+    uint32_t bytesWritten = 0;
+
+    void wipe() {
+        std::fill(data.begin(), data.end(), 0xFF);
+        sectorErases = 0;
+        bytesWritten = 0;
+    }
+};
+inline HostFlash hostFlash;
+
+inline const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                       const char* label) {
+    if (type != hostPartition.type ||
+        (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != hostPartition.subtype) ||
+        (label != nullptr && strcmp(label, hostPartition.label) != 0)) {
+        return nullptr;
+    }
+    return &hostPartition;
+}
+
+inline esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* dst, size_t size) {
+    if (partition != &hostPartition || dst == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset > partition->size || size > partition->size - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, hostFlash.data.data() + offset, size);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* src, size_t size) {
+    if (partition != &hostPartition || src == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset > partition->size || size > partition->size - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    const uint8_t* bytes = (const uint8_t*)src;
+    for (size_t i = 0; i < size; i++) {
+        hostFlash.data[offset + i] &= bytes[i];
+    }
+    hostFlash.bytesWritten += size;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    if (partition != &hostPartition) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset % HOST_FLASH_SECTOR != 0 || size % HOST_FLASH_SECTOR != 0 ||
+        offset > partition->size || size > partition->size - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memset(hostFlash.data.data() + offset, 0xFF, size);
+    hostFlash.sectorErases += size / HOST_FLASH_SECTOR;
+    return ESP_OK;
+}
+
+#endif // HOST_ESP_PARTITION_H
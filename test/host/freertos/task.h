@@ -0,0 +1,60 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+#include <thread>
+
+// A task's notification value; the handle points at it
+struct HostTask {
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t notifications = 0;
+};
+typedef HostTask* TaskHandle_t;
+
+inline thread_local HostTask* hostCurrentTask = nullptr;
+
+// Tasks run detached until the process exits, as they never return on the device
+inline BaseType_t xTaskCreatePinnedToCore(void (*function)(void*), const char*, uint32_t, void* param,
+                                          UBaseType_t, TaskHandle_t* handle, BaseType_t) {
+    HostTask* task = new HostTask();
+    if (handle) {
+        *handle = task;
+    }
+    std::thread([function, param, task]() {
+        hostCurrentTask = task;
+        function(param);
+    }).detach();
+    return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(void (*function)(void*), const char* name, uint32_t stack, void* param,
+                              UBaseType_t priority, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(function, name, stack, param, priority, handle, 0);
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        task->notifications++;
+    }
+    task->cv.notify_one();
+    return pdPASS;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    HostTask* task = hostCurrentTask;
+    std::unique_lock<std::mutex> lock(task->mutex);
+    hostWaitTicks(task->cv, lock, ticks, [task]() { return task->notifications > 0; });
+    uint32_t value = task->notifications;
+    if (value > 0) {
+        task->notifications = clearOnExit ? 0 : value - 1;
+    }
+    return value;
+}
+
+#endif // HOST_FREERTOS_TASK_H
@@ -0,0 +1,149 @@
+#include <unity.h>
+#include <pb_encode.h>
+#include "AdminModule.h"
+
+#define NODE 0x11223344
+
+static ConfigStore* store;
+static AdminModule* admin;
+static int channelReloads;
+
+static void boot() {
+    delete admin;
+    delete store;
+    store = new ConfigStore();
+    admin = new AdminModule();
+    store->begin();   // False on first boot: no image yet
+    TEST_ASSERT_TRUE(admin->begin(NODE, store));
+    admin->onChannelChanged([](int index) {
+        if (index < 0) {
+            channelReloads++;
+        }
+    });
+}
+
+void setUp() {
+    hostNvs.clear();
+    channelReloads = 0;
+    store = nullptr;
+    admin = nullptr;
+    boot();
+}
+
+void tearDown() {
+    delete admin;
+    delete store;
+}
+
+static void send(const meshtastic_AdminMessage& message) {
+    meshtastic_MeshPacket packet = meshtastic_MeshPacket_init_zero;
+    packet.to = NODE;
+    packet.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    packet.decoded.portnum = meshtastic_PortNum_ADMIN_APP;
+    pb_ostream_t stream = pb_ostream_from_buffer(packet.decoded.payload.bytes, sizeof(packet.decoded.payload.bytes));
+    TEST_ASSERT_TRUE(pb_encode(&stream, meshtastic_AdminMessage_fields, &message));
+    packet.decoded.payload.size = stream.bytes_written;
+    TEST_ASSERT_TRUE(admin->handlePacket(packet));
+}
+
+static void beginEdit() {
+    meshtastic_AdminMessage message = meshtastic_AdminMessage_init_zero;
+    message.which_payload_variant = meshtastic_AdminMessage_begin_edit_settings_tag;
+    message.begin_edit_settings = true;
+    send(message);
+}
+
+static void commitEdit() {
+    meshtastic_AdminMessage message = meshtastic_AdminMessage_init_zero;
+    message.which_payload_variant = meshtastic_AdminMessage_commit_edit_settings_tag;
+    message.commit_edit_settings = true;
+    send(message);
+}
+
+static void setOwner(const char* longName) {
+    meshtastic_AdminMessage message = meshtastic_AdminMessage_init_zero;
+    message.which_payload_variant = meshtastic_AdminMessage_set_owner_tag;
+    strncpy(message.set_owner.long_name, longName, sizeof(message.set_owner.long_name) - 1);
+    strncpy(message.set_owner.short_name, "TST", sizeof(message.set_owner.short_name) - 1);
+    send(message);
+}
+
+static void setLoRaPreset(meshtastic_Config_LoRaConfig_ModemPreset preset) {
+    meshtastic_AdminMessage message = meshtastic_AdminMessage_init_zero;
+    message.which_payload_variant = meshtastic_AdminMessage_set_config_tag;
+    message.set_config.which_payload_variant = meshtastic_Config_lora_tag;
+    message.set_config.payload_variant.lora.use_preset = true;
+    message.set_config.payload_variant.lora.modem_preset = preset;
+    send(message);
+}
+
+static meshtastic_Config_LoRaConfig storedLoRa() {
+    meshtastic_Config_LoRaConfig lora = meshtastic_Config_LoRaConfig_init_default;
+    TEST_ASSERT_TRUE(store->read(CONFIG_LOCAL, meshtastic_LocalConfig_lora_tag, 0, meshtastic_Config_LoRaConfig_fields, &lora));
+    return lora;
+}
+
+static void test_set_outside_edit_is_saved() {
+    setOwner("Gateway");
+    TEST_ASSERT_FALSE(store->isDirty());
+
+    boot();
+    meshtastic_User owner;
+    TEST_ASSERT_TRUE(admin->getOwner(&owner));
+    TEST_ASSERT_EQUAL_STRING("Gateway", owner.long_name);
+}
+
+static void test_committed_edit_is_saved() {
+    beginEdit();
+    setOwner("Batched");
+    setLoRaPreset(meshtastic_Config_LoRaConfig_ModemPreset_SHORT_FAST);
+    TEST_ASSERT_TRUE(store->isDirty());
+    commitEdit();
+    TEST_ASSERT_FALSE(store->isDirty());
+
+    boot();
+    meshtastic_User owner;
+    TEST_ASSERT_TRUE(admin->getOwner(&owner));
+    TEST_ASSERT_EQUAL_STRING("Batched", owner.long_name);
+    TEST_ASSERT_EQUAL(meshtastic_Config_LoRaConfig_ModemPreset_SHORT_FAST, storedLoRa().modem_preset);
+}
+
+static void test_abandoned_edit_is_discarded() {
+    beginEdit();
+    setOwner("Half sent");
+    setLoRaPreset(meshtastic_Config_LoRaConfig_ModemPreset_SHORT_FAST);
+    TEST_ASSERT_EQUAL(1, channelReloads);
+
+    // Staged sets are visible until the edit times out
+    meshtastic_User owner;
+    TEST_ASSERT_TRUE(admin->getOwner(&owner));
+    TEST_ASSERT_EQUAL_STRING("Half sent", owner.long_name);
+
+    hostAdvanceMillis(ADMIN_EDIT_TIMEOUT_MS - 1);
+    admin->update();
+    TEST_ASSERT_TRUE(store->isDirty());
+
+    hostAdvanceMillis(1);
+    admin->update();
+    TEST_ASSERT_FALSE(store->isDirty());
+    TEST_ASSERT_EQUAL(2, channelReloads);   // Saved channels applied again
+    TEST_ASSERT_TRUE(admin->getOwner(&owner));
+    TEST_ASSERT_NOT_EQUAL(0, strcmp("Half sent", owner.long_name));
+    TEST_ASSERT_EQUAL(meshtastic_Config_LoRaConfig_ModemPreset_LONG_FAST, storedLoRa().modem_preset);
+
+    // Nothing of the batch reached flash
+    boot();
+    TEST_ASSERT_EQUAL(meshtastic_Config_LoRaConfig_ModemPreset_LONG_FAST, storedLoRa().modem_preset);
+
+    // Sets after the timeout are saved one by one again
+    setOwner("Later");
+    TEST_ASSERT_FALSE(store->isDirty());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_set_outside_edit_is_saved);
+    RUN_TEST(test_committed_edit_is_saved);
+    RUN_TEST(test_abandoned_edit_is_discarded);
+    return UNITY_END();
+}
@@ -0,0 +1,304 @@
+#include <unity.h>
+#include <vector>
+#include "MeshtasticBLE.h"
+
+#define FRAME_BYTES   400     // One frame per DRR quantum
+#define LOOP_MS       10      // delay() at the end of loop()
+#define TOKEN         0x5EC0417E
+#define AWAY_MS       5000    // Phone out of range, or the app backgrounded
+#define NEXT_FRAME_MS 10000   // Until the mesh sends the next message after the reconnect
+
+static MeshtasticBLE* ble;
+static uint16_t fromRadioHandle;
+
+static const uint8_t PHONE[6] = { 0x4A, 0x11, 0x22, 0x33, 0x44, 0x55 };     // Resolvable private
+static const uint8_t PHONE_ROTATED[6] = { 0x5B, 0x66, 0x77, 0x88, 0x99, 0xAA };
+static const uint8_t LAPTOP[6] = { 0x00, 0x1A, 0x7D, 0x01, 0x02, 0x03 };    // Public
+static const uint8_t TABLET[6] = { 0x00, 0x1A, 0x7D, 0x04, 0x05, 0x06 };
+
+void setUp() {
+    hostBle.reset();
+    ble = new MeshtasticBLE();
+    ble->begin("Meshtastic_test");
+    fromRadioHandle = hostBle.characteristic(FROMRADIO_UUID)->getHandle();
+}
+
+void tearDown() {
+    delete ble;
+    // Let anything the previous test queued age out of every window
+    hostAdvanceMillis(FROMRADIO_KEEP_MS + 1);
+}
+
+// A FromRadio frame that carries its sequence number
+static void send(uint32_t number) {
+    uint8_t frame[FRAME_BYTES];
+    memset(frame, 0xA5, sizeof(frame));
+    memcpy(frame, &number, sizeof(number));
+    TEST_ASSERT_TRUE(ble->sendFromRadio(frame, sizeof(frame)));
+}
+
+// Sequence numbers of the frames a connection was notified since the last call
+static std::vector<uint32_t> received(uint16_t connId) {
+    std::vector<uint32_t> numbers;
+    for (const std::vector<uint8_t>& value : hostBle.take(connId, fromRadioHandle)) {
+        uint32_t number;
+        memcpy(&number, value.data(), sizeof(number));
+        numbers.push_back(number);
+    }
+    return numbers;
+}
+
+static void pump(int passes = 1) {
+    for (int i = 0; i < passes; i++) {
+        ble->update();
+        hostAdvanceMillis(LOOP_MS);
+    }
+}
+
+// The 8-byte FromNum write: last id seen, then the client's session token
+static void writeResume(uint16_t connId, uint32_t lastId, uint32_t token) {
+    uint8_t value[8];
+    memcpy(value, &lastId, 4);
+    memcpy(value + 4, &token, 4);
+    hostBle.write(FROMNUM_UUID, connId, value, sizeof(value));
+}
+
+static void assertSequence(uint32_t first, uint32_t last, const std::vector<uint32_t>& numbers) {
+    TEST_ASSERT_EQUAL(last - first + 1, numbers.size());
+    for (size_t i = 0; i < numbers.size(); i++) {
+        TEST_ASSERT_EQUAL(first + i, numbers[i]);
+    }
+}
+
+static void test_three_clients_at_different_speeds() {
+    hostBle.connect(1, PHONE, BLE_ADDR_TYPE_RANDOM);
+    hostBle.connect(2, LAPTOP);
+    hostBle.connect(3, TABLET);
+    pump();
+    TEST_ASSERT_EQUAL(3, ble->getConnectedCount());
+
+    // One frame per pass. The phone takes notifications every pass, the
+    // laptop every second one and the tablet every eighth: it falls more
+    // than the ring behind and skips frames, without holding up the others
+    const uint32_t frames = 60;
+    std::vector<uint32_t> phone, laptop, tablet;
+    for (uint32_t pass = 0; pass < frames; pass++) {
+        hostBle.congested.clear();
+        if (pass % 2 != 0) {
+            hostBle.congested.insert(2);
+        }
+        if (pass % 8 != 0) {
+            hostBle.congested.insert(3);
+        }
+        send(pass + 1);
+        pump();
+
+        std::vector<uint32_t> now = received(1);
+        TEST_ASSERT_EQUAL_MESSAGE(1, now.size(), "fast client delayed by a slow one");
+        TEST_ASSERT_EQUAL(pass + 1, now[0]);
+        phone.push_back(now[0]);
+        now = received(2);
+        laptop.insert(laptop.end(), now.begin(), now.end());
+        now = received(3);
+        tablet.insert(tablet.end(), now.begin(), now.end());
+    }
+    hostBle.congested.clear();
+    pump(FROMRADIO_QUEUE_DEPTH);
+    std::vector<uint32_t> now = received(2);
+    laptop.insert(laptop.end(), now.begin(), now.end());
+    now = received(3);
+    tablet.insert(tablet.end(), now.begin(), now.end());
+
+    assertSequence(1, frames, phone);
+    assertSequence(1, frames, laptop);
+    // In order, never twice, and caught up at the end
+    for (size_t i = 1; i < tablet.size(); i++) {
+        TEST_ASSERT_GREATER_THAN(tablet[i - 1], tablet[i]);
+    }
+    TEST_ASSERT_EQUAL(frames, tablet.back());
+    TEST_ASSERT_LESS_THAN(frames, tablet.size());
+
+    char message[96];
+    snprintf(message, sizeof(message), "frames delivered: phone %u, laptop %u, tablet %u of %u",
+             (unsigned)phone.size(), (unsigned)laptop.size(), (unsigned)tablet.size(), frames);
+    TEST_MESSAGE(message);
+}
+
+static void test_resume_by_token_from_rotated_address() {
+    hostBle.connect(1, PHONE, BLE_ADDR_TYPE_RANDOM);
+    pump();
+    writeResume(1, 0, TOKEN);
+    for (uint32_t i = 1; i <= 3; i++) {
+        send(i);
+    }
+    pump(10);
+    assertSequence(1, 3, received(1));
+
+    hostBle.disconnect(1);
+    pump();
+    for (uint32_t i = 4; i <= 8; i++) {
+        send(i);
+    }
+    pump(1000);   // 10 s away
+
+    // Back from a new private address: nothing matches it until the token
+    hostBle.connect(2, PHONE_ROTATED, BLE_ADDR_TYPE_RANDOM);
+    pump();
+    TEST_ASSERT_EQUAL(0, received(2).size());
+    writeResume(2, 3, TOKEN);
+    pump(10);
+    assertSequence(4, 8, received(2));
+    TEST_ASSERT_EQUAL(1, ble->getConnectedCount());
+}
+
+static void test_private_address_alone_does_not_resume() {
+    hostBle.connect(1, PHONE, BLE_ADDR_TYPE_RANDOM);
+    pump();
+    send(1);
+    pump();
+    assertSequence(1, 1, received(1));
+    hostBle.disconnect(1);
+    pump();
+    send(2);
+
+    // Another phone that happens to get the same private address later
+    hostBle.connect(2, PHONE, BLE_ADDR_TYPE_RANDOM);
+    pump(10);
+    TEST_ASSERT_EQUAL(0, received(2).size());
+}
+
+static void test_public_address_resumes_without_write() {
+    hostBle.connect(1, LAPTOP);
+    pump();
+    send(1);
+    pump();
+    hostBle.disconnect(1);
+    pump();
+    send(2);
+    send(3);
+
+    hostBle.connect(2, LAPTOP);
+    pump(10);
+    assertSequence(2, 3, received(2));
+}
+
+static void test_frames_kept_with_no_session() {
+    hostBle.connect(1, PHONE, BLE_ADDR_TYPE_RANDOM);
+    pump();
+    writeResume(1, 0, TOKEN);
+    send(1);
+    pump();
+    assertSequence(1, 1, received(1));
+    hostBle.disconnect(1);
+
+    // The session expires; frames queued afterwards have no session to hold them
+    hostAdvanceMillis(SESSION_RESUME_WINDOW_MS + 1);
+    pump();
+    send(2);
+    send(3);
+    pump(500);
+
+    hostBle.connect(2, PHONE_ROTATED, BLE_ADDR_TYPE_RANDOM);
+    pump();
+    writeResume(2, 1, TOKEN);
+    pump(10);
+    assertSequence(2, 3, received(2));
+
+    // Past the keep window they are gone
+    hostBle.disconnect(2);
+    send(4);
+    hostAdvanceMillis(FROMRADIO_KEEP_MS + 1);
+    pump();
+    hostBle.connect(3, PHONE, BLE_ADDR_TYPE_RANDOM);
+    pump();
+    writeResume(3, 3, TOKEN);
+    pump();
+    TEST_ASSERT_EQUAL(0, received(3).size());
+}
+
+// Reconnect to first FromRadio for a client that misses three frames
+// while away. A stock app never writes FromNum, so it resumes nothing and
+// waits for the next new frame; a client that writes its last id and
+// token gets the missed frames on the next passes of loop().
+static uint32_t reconnectToFirstFrame(bool writesResume, uint32_t* missedDelivered) {
+    static uint32_t number = 1000;
+    static uint16_t connId = 10;
+    hostBle.connect(connId, PHONE, BLE_ADDR_TYPE_RANDOM);
+    pump();
+    if (writesResume) {
+        writeResume(connId, 0, TOKEN);
+    }
+    send(++number);
+    pump(10);
+    TEST_ASSERT_EQUAL(1, received(connId).size());
+    // The FromRadio id the client saw last, from its FromNum notifications
+    uint16_t fromNumHandle = hostBle.characteristic(FROMNUM_UUID)->getHandle();
+    std::vector<std::vector<uint8_t>> fromNum = hostBle.take(connId, fromNumHandle);
+    uint32_t lastId;
+    memcpy(&lastId, fromNum.back().data(), sizeof(lastId));
+    hostBle.disconnect(connId);
+    pump();
+
+    uint32_t lastSeen = number;
+    for (int i = 0; i < 3; i++) {
+        send(++number);
+    }
+    pump(AWAY_MS / LOOP_MS);
+
+    connId++;
+    hostBle.connect(connId, PHONE_ROTATED, BLE_ADDR_TYPE_RANDOM);
+    unsigned long start = millis();
+    if (writesResume) {
+        // The client's first write after it subscribes, one pass later
+        pump();
+        writeResume(connId, lastId, TOKEN);
+    }
+    std::vector<uint32_t> frames;
+    while (frames.empty()) {
+        if (millis() - start == NEXT_FRAME_MS) {
+            send(++number);
+        }
+        pump();
+        frames = received(connId);
+        TEST_ASSERT_TRUE(millis() - start <= NEXT_FRAME_MS + 100);
+    }
+    uint32_t elapsed = millis() - start;
+    pump(10);
+    std::vector<uint32_t> rest = received(connId);
+    frames.insert(frames.end(), rest.begin(), rest.end());
+
+    *missedDelivered = 0;
+    for (uint32_t frame : frames) {
+        *missedDelivered += frame > lastSeen && frame <= lastSeen + 3;
+    }
+    hostBle.disconnect(connId);
+    connId++;
+    return elapsed;
+}
+
+static void test_reconnect_latency() {
+    uint32_t stockMissed;
+    uint32_t resumeMissed;
+    uint32_t stockMillis = reconnectToFirstFrame(false, &stockMissed);
+    uint32_t resumeMillis = reconnectToFirstFrame(true, &resumeMissed);
+
+    char message[160];
+    snprintf(message, sizeof(message),
+             "reconnect -> first FromRadio: no resume write %u ms (%u/3 missed frames), resume write %u ms (%u/3)",
+             stockMillis, stockMissed, resumeMillis, resumeMissed);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL(0, stockMissed);
+    TEST_ASSERT_EQUAL(3, resumeMissed);
+    TEST_ASSERT_LESS_THAN(100, resumeMillis);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_three_clients_at_different_speeds);
+    RUN_TEST(test_resume_by_token_from_rotated_address);
+    RUN_TEST(test_private_address_alone_does_not_resume);
+    RUN_TEST(test_public_address_resumes_without_write);
+    RUN_TEST(test_frames_kept_with_no_session);
+    RUN_TEST(test_reconnect_latency);
+    return UNITY_END();
+}
@@ -0,0 +1,169 @@
+#include <unity.h>
+#include <pb_encode.h>
+#include "ChannelCrypto.h"
+
+// The host build always takes the portable AES path
+#ifndef CHANNEL_CRYPTO_SOFTWARE
+#error "native tests expect CHANNEL_CRYPTO_SOFTWARE"
+#endif
+
+// NIST SP 800-38A F.5.1 (AES-128-CTR) and F.5.5 (AES-256-CTR)
+static const uint8_t key128[16] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+static const uint8_t key256[32] = {
+    0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+    0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4
+};
+static const uint8_t counter[16] = {
+    0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+};
+static const uint8_t plaintext[64] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+};
+static const uint8_t cipher128[64] = {
+    0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+    0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+    0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+    0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee
+};
+static const uint8_t cipher256[64] = {
+    0x60, 0x1e, 0xc3, 0x13, 0x77, 0x57, 0x89, 0xa5, 0xb7, 0xa7, 0xf5, 0x04, 0xbb, 0xf3, 0xd2, 0x28,
+    0xf4, 0x43, 0xe3, 0xca, 0x4d, 0x62, 0xb5, 0x9a, 0xca, 0x84, 0xe9, 0x90, 0xca, 0xca, 0xf5, 0xc5,
+    0x2b, 0x09, 0x30, 0xda, 0xa2, 0x3d, 0xe9, 0x4c, 0xe8, 0x70, 0x17, 0xba, 0x2d, 0x84, 0x98, 0x8d,
+    0xdf, 0xc9, 0xc5, 0x8d, 0xb6, 0x7a, 0xad, 0xa6, 0x13, 0xc2, 0xdd, 0x08, 0x45, 0x79, 0x41, 0xa6
+};
+
+static ChannelCrypto* crypto;
+
+void setUp() {
+    crypto = new ChannelCrypto();
+}
+
+void tearDown() {
+    delete crypto;
+}
+
+static meshtastic_Channel channelWithPsk(const uint8_t* psk, size_t length, const char* name = "") {
+    meshtastic_Channel channel = meshtastic_Channel_init_default;
+    channel.role = meshtastic_Channel_Role_SECONDARY;
+    channel.has_settings = true;
+    channel.settings.psk.size = length;
+    memcpy(channel.settings.psk.bytes, psk, length);
+    strncpy(channel.settings.name, name, sizeof(channel.settings.name) - 1);
+    return channel;
+}
+
+// An encrypted packet as it arrives from the radio, sealed with channel `index`
+static meshtastic_MeshPacket sealedText(uint8_t index, uint8_t hash, const char* text) {
+    meshtastic_Data data = meshtastic_Data_init_zero;
+    data.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+    data.payload.size = strlen(text);
+    memcpy(data.payload.bytes, text, data.payload.size);
+
+    meshtastic_MeshPacket packet = meshtastic_MeshPacket_init_zero;
+    packet.id = 0x1A2B3C4D;
+    packet.from = 0xDEADBEEF;
+    packet.channel = hash;
+    packet.which_payload_variant = meshtastic_MeshPacket_encrypted_tag;
+    pb_ostream_t stream = pb_ostream_from_buffer(packet.encrypted.bytes, sizeof(packet.encrypted.bytes));
+    TEST_ASSERT_TRUE(pb_encode(&stream, meshtastic_Data_fields, &data));
+    packet.encrypted.size = stream.bytes_written;
+    TEST_ASSERT_TRUE(crypto->crypt(index, packet.id, packet.from, packet.encrypted.bytes, packet.encrypted.size));
+    return packet;
+}
+
+static void test_nist_ctr_vectors() {
+    ChannelKey slot;
+    uint8_t buffer[64];
+
+    // Odd length exercises the partial final block
+    ChannelCrypto::setKey(slot, key128, sizeof(key128));
+    memcpy(buffer, plaintext, sizeof(buffer));
+    ChannelCrypto::ctr(slot, counter, buffer, 61);
+    TEST_ASSERT_EQUAL_MEMORY(cipher128, buffer, 61);
+    TEST_ASSERT_EQUAL_MEMORY(plaintext + 61, buffer + 61, 3);
+
+    ChannelCrypto::setKey(slot, key256, sizeof(key256));
+    memcpy(buffer, plaintext, sizeof(buffer));
+    ChannelCrypto::ctr(slot, counter, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_MEMORY(cipher256, buffer, sizeof(buffer));
+}
+
+static void test_default_channel_hash() {
+    // LongFast with the default key hashes to 8 on every Meshtastic node
+    const uint8_t defaultPsk = 1;
+    crypto->setChannel(0, channelWithPsk(&defaultPsk, 1), "LongFast");
+    meshtastic_MeshPacket packet = sealedText(0, 8, "hello mesh");
+    TEST_ASSERT_TRUE(crypto->decrypt(packet));
+    TEST_ASSERT_EQUAL(meshtastic_MeshPacket_decoded_tag, packet.which_payload_variant);
+    TEST_ASSERT_EQUAL(0, packet.channel);
+    TEST_ASSERT_EQUAL(10, packet.decoded.payload.size);
+    TEST_ASSERT_EQUAL_MEMORY("hello mesh", packet.decoded.payload.bytes, 10);
+}
+
+static void test_hash_collision_tries_each_key() {
+    // 'a' ^ 1 == 'c' ^ 3, so both channels carry the same hash
+    uint8_t keyA[16] = { 1 };
+    uint8_t keyB[16] = { 3 };
+    crypto->setChannel(1, channelWithPsk(keyA, sizeof(keyA), "a"), "LongFast");
+    crypto->setChannel(2, channelWithPsk(keyB, sizeof(keyB), "c"), "LongFast");
+    uint8_t hash = ChannelCrypto::channelHash("a", keyA, sizeof(keyA));
+    TEST_ASSERT_EQUAL(hash, ChannelCrypto::channelHash("c", keyB, sizeof(keyB)));
+
+    meshtastic_MeshPacket packet = sealedText(2, hash, "second key");
+    TEST_ASSERT_TRUE(crypto->decrypt(packet));
+    TEST_ASSERT_EQUAL(2, packet.channel);
+    TEST_ASSERT_EQUAL_MEMORY("second key", packet.decoded.payload.bytes, 10);
+}
+
+static void test_unknown_hash_and_disabled_channel() {
+    uint8_t key[32] = { 7, 7, 7 };
+    crypto->setChannel(3, channelWithPsk(key, sizeof(key), "Private"), "LongFast");
+    uint8_t hash = ChannelCrypto::channelHash("Private", key, sizeof(key));
+    meshtastic_MeshPacket packet = sealedText(3, hash, "secret");
+
+    meshtastic_MeshPacket wrongHash = packet;
+    wrongHash.channel = hash ^ 1;
+    TEST_ASSERT_FALSE(crypto->decrypt(wrongHash));
+    TEST_ASSERT_EQUAL(meshtastic_MeshPacket_encrypted_tag, wrongHash.which_payload_variant);
+
+    meshtastic_Channel disabled = meshtastic_Channel_init_default;
+    crypto->setChannel(3, disabled, "LongFast");
+    TEST_ASSERT_FALSE(crypto->decrypt(packet));
+    TEST_ASSERT_FALSE(crypto->crypt(3, 1, 1, key, 1));
+}
+
+static void test_decrypt_throughput() {
+    static uint8_t buffer[sizeof(meshtastic_MeshPacket_encrypted_t::bytes)];
+    ChannelKey slot;
+    ChannelCrypto::setKey(slot, key128, sizeof(key128));
+
+    const size_t total = 1024 * 1024;
+    size_t done = 0;
+    unsigned long start = micros();
+    while (done < total) {
+        ChannelCrypto::ctr(slot, counter, buffer, sizeof(buffer));
+        done += sizeof(buffer);
+    }
+    unsigned long elapsed = max(1UL, micros() - start);
+
+    char message[96];
+    snprintf(message, sizeof(message), "AES-128-CTR: %lu KB/s, %.2f us per %u byte packet",
+             (unsigned long)((uint64_t)done * 1000000 / elapsed / 1024),
+             (double)elapsed * sizeof(buffer) / done, (unsigned)sizeof(buffer));
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_nist_ctr_vectors);
+    RUN_TEST(test_default_channel_hash);
+    RUN_TEST(test_hash_collision_tries_each_key);
+    RUN_TEST(test_unknown_hash_and_disabled_channel);
+    RUN_TEST(test_decrypt_throughput);
+    return UNITY_END();
+}
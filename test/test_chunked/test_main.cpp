@@ -0,0 +1,197 @@
+#include <unity.h>
+#include <deque>
+#include <random>
+#include "ChunkedTransfer.h"
+#include "XModemTransfer.h"
+
+#define NODE_A 0xa1a1a1a1
+#define NODE_B 0xb2b2b2b2
+#define LINK_LATENCY_MS 400   // One LongFast packet on air, roughly
+
+// Two nodes joined by a link that drops packets at a fixed rate
+struct LossyLink {
+    struct InFlight {
+        unsigned long deliverAt;
+        meshtastic_MeshPacket packet;
+    };
+    std::deque<InFlight> inFlight;
+    std::mt19937 rng;
+    double loss;
+    uint32_t packetsSent;
+    uint32_t bytesSent;
+    uint32_t dropped;
+
+    void reset(double lossRate, uint32_t seed) {
+        inFlight.clear();
+        rng.seed(seed);
+        loss = lossRate;
+        packetsSent = 0;
+        bytesSent = 0;
+        dropped = 0;
+    }
+
+    void send(uint32_t from, uint32_t to, const meshtastic_Data& data) {
+        packetsSent++;
+        bytesSent += data.payload.size;
+        if (std::uniform_real_distribution<double>(0, 1)(rng) < loss) {
+            dropped++;
+            return;
+        }
+        InFlight entry;
+        entry.deliverAt = millis() + LINK_LATENCY_MS;
+        entry.packet = meshtastic_MeshPacket_init_zero;
+        entry.packet.from = from;
+        entry.packet.to = to;
+        entry.packet.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+        entry.packet.decoded = data;
+        inFlight.push_back(entry);
+    }
+};
+
+static LossyLink link;
+static ChunkedTransfer sender;
+static ChunkedTransfer receiver;
+static std::vector<uint8_t> delivered;
+static uint32_t deliveredCount;
+
+static void route(ChunkedTransfer& node, const meshtastic_MeshPacket& packet) {
+    if (packet.decoded.portnum == CHUNKED_PAYLOAD_PORT) {
+        node.handleChunkPacket(packet);
+    } else if (packet.decoded.portnum == CHUNKED_RESPONSE_PORT) {
+        node.handleResponsePacket(packet);
+    }
+}
+
+static void step() {
+    hostAdvanceMillis(10);
+    while (!link.inFlight.empty() && (long)(millis() - link.inFlight.front().deliverAt) >= 0) {
+        meshtastic_MeshPacket packet = link.inFlight.front().packet;
+        link.inFlight.pop_front();
+        route(packet.to == NODE_B ? receiver : sender, packet);
+    }
+    sender.update();
+    receiver.update();
+}
+
+void setUp() {
+    sender = ChunkedTransfer();
+    receiver = ChunkedTransfer();
+    sender.onSend([](uint32_t to, const meshtastic_Data& data) { link.send(NODE_A, to, data); });
+    receiver.onSend([](uint32_t to, const meshtastic_Data& data) { link.send(NODE_B, to, data); });
+    receiver.onPayloadComplete([](uint32_t from, uint32_t payloadId, const uint8_t* data, size_t length) {
+        delivered.assign(data, data + length);
+        deliveredCount++;
+    });
+    delivered.clear();
+    deliveredCount = 0;
+}
+
+void tearDown() {}
+
+static void fillPattern(uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        data[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+}
+
+// Upload a file the way a client does: ToRadio.xmodemPacket blocks
+static void xmodemUpload(XModemTransfer& xmodem, const char* name, const uint8_t* data, size_t length) {
+    uint8_t frame[FROMRADIO_MAX_FRAME];
+    auto push = [&](meshtastic_XModem_Control control, uint16_t seq, const uint8_t* bytes, size_t size) {
+        meshtastic_ToRadio toRadio = meshtastic_ToRadio_init_zero;
+        toRadio.which_payload_variant = meshtastic_ToRadio_xmodemPacket_tag;
+        toRadio.xmodemPacket.control = control;
+        toRadio.xmodemPacket.seq = seq;
+        memcpy(toRadio.xmodemPacket.buffer.bytes, bytes, size);
+        toRadio.xmodemPacket.buffer.size = size;
+        toRadio.xmodemPacket.crc16 = xmodem_crc16(bytes, size);
+        size_t frameLen = 0;
+        TEST_ASSERT_TRUE(encode_to_radio(frame, sizeof(frame), &toRadio, &frameLen));
+        meshtastic_ToRadio decoded = meshtastic_ToRadio_init_zero;
+        TEST_ASSERT_TRUE(decode_to_radio(frame, frameLen, &decoded));
+        xmodem.handlePacket(decoded.xmodemPacket);
+    };
+    push(meshtastic_XModem_Control_SOH, 0, (const uint8_t*)name, strlen(name));
+    uint16_t seq = 1;
+    for (size_t offset = 0; offset < length; offset += XMODEM_BLOCK_SIZE) {
+        push(meshtastic_XModem_Control_SOH, seq++, data + offset, min((size_t)XMODEM_BLOCK_SIZE, length - offset));
+    }
+    push(meshtastic_XModem_Control_EOT, 0, nullptr, 0);
+}
+
+// Run one transfer to completion; returns the simulated milliseconds taken
+static unsigned long runTransfer(const uint8_t* data, size_t length) {
+    unsigned long start = millis();
+    TEST_ASSERT_NOT_EQUAL(0, sender.send(NODE_B, data, length));
+    while (sender.isSending() && millis() - start < 10 * CHUNK_TRANSFER_TIMEOUT_MS) {
+        step();
+    }
+    return millis() - start;
+}
+
+// The SEND: path: a file staged over XModem goes out as a chunked payload
+static void test_send_xmodem_file() {
+    static uint8_t file[CHUNK_MAX_PAYLOAD];
+    static uint8_t loaded[CHUNK_MAX_PAYLOAD];
+    fillPattern(file, sizeof(file));
+
+    XModemTransfer xmodem;
+    TEST_ASSERT_TRUE(xmodem.begin());
+    xmodemUpload(xmodem, "map.cfg", file, 3000);
+    TEST_ASSERT_FALSE(xmodem.isActive());
+
+    TEST_ASSERT_EQUAL(0, xmodem.readFile("other.cfg", loaded, sizeof(loaded)));
+    TEST_ASSERT_EQUAL(0, xmodem.readFile("map.cfg", loaded, 2000));
+    size_t length = xmodem.readFile("map.cfg", loaded, sizeof(loaded));
+    TEST_ASSERT_EQUAL(3000, length);
+
+    link.reset(0, 1);
+    runTransfer(loaded, length);
+    TEST_ASSERT_EQUAL(1, deliveredCount);
+    TEST_ASSERT_EQUAL(3000, delivered.size());
+    TEST_ASSERT_EQUAL_MEMORY(file, delivered.data(), 3000);
+}
+
+// Goodput (payload bytes / bytes put on air, both directions) and time
+// to deliver a full-size payload as the link gets worse
+static void test_goodput_lossy_link() {
+    static uint8_t payload[CHUNK_MAX_PAYLOAD];
+    fillPattern(payload, sizeof(payload));
+    const double LOSS[] = { 0.0, 0.1, 0.2, 0.3 };
+    const int RUNS = 20;
+
+    for (double loss : LOSS) {
+        uint32_t bytes = 0;
+        uint32_t delivered = 0;
+        unsigned long totalMs = 0;
+        for (int run = 0; run < RUNS; run++) {
+            setUp();
+            link.reset(loss, 1000 + run);
+            unsigned long elapsed = runTransfer(payload, sizeof(payload));
+            // Ended on the receiver's accept, not on the sender's timeout
+            TEST_ASSERT_LESS_THAN(CHUNK_TRANSFER_TIMEOUT_MS, elapsed);
+            totalMs += elapsed;
+            // Let a late resend request or accept settle
+            for (int i = 0; i < 1000; i++) {
+                step();
+            }
+            bytes += link.bytesSent;
+            delivered += deliveredCount > 0 ? 1 : 0;
+        }
+        double goodput = (double)delivered * sizeof(payload) / bytes;
+        char line[128];
+        snprintf(line, sizeof(line), "loss %2.0f%%: %d/%d delivered, goodput %.0f%%, %lu ms per transfer",
+                 loss * 100, delivered, RUNS, goodput * 100, totalMs / RUNS);
+        TEST_MESSAGE(line);
+        TEST_ASSERT_EQUAL(RUNS, delivered);
+        // Only missing chunks are resent, so goodput tracks the loss rate
+        TEST_ASSERT_GREATER_THAN((int)((1 - loss) * 85 - 10), (int)(goodput * 100));
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_send_xmodem_file);
+    RUN_TEST(test_goodput_lossy_link);
+    return UNITY_END();
+}
@@ -0,0 +1,334 @@
+#include <unity.h>
+#include "ConfigStore.h"
+
+#define LOAD_ROUNDS 200
+
+static ConfigStore* store;
+
+// A fresh store over whatever NVS holds, as after a reboot
+static bool reboot() {
+    delete store;
+    store = new ConfigStore();
+    return store->begin();
+}
+
+void setUp() {
+    hostNvs.clear();
+    store = nullptr;
+    reboot();
+}
+
+void tearDown() {
+    delete store;
+}
+
+static std::vector<uint8_t>& slotImage(const char* key) {
+    return hostNvs[CONFIG_NVS_NAMESPACE][key];
+}
+
+// Plain CRC-32, independent of the store's
+static uint32_t crc32(const uint8_t* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+// Rewrite a slot's sequence number and re-seal it with a valid CRC
+static void setSequence(const char* key, uint32_t sequence) {
+    std::vector<uint8_t>& image = slotImage(key);
+    ConfigImageHeader* header = (ConfigImageHeader*)image.data();
+    header->sequence = sequence;
+    header->crc32 = 0;
+    header->crc32 = crc32(image.data(), image.size());
+}
+
+static void writeLora(uint32_t hopLimit, int8_t txPower) {
+    meshtastic_Config_LoRaConfig lora = meshtastic_Config_LoRaConfig_init_zero;
+    lora.hop_limit = hopLimit;
+    lora.tx_power = txPower;
+    TEST_ASSERT_TRUE(store->write(CONFIG_LOCAL, meshtastic_LocalConfig_lora_tag, 0, meshtastic_Config_LoRaConfig_fields, &lora));
+}
+
+static meshtastic_Config_LoRaConfig readLora() {
+    meshtastic_Config_LoRaConfig lora = meshtastic_Config_LoRaConfig_init_zero;
+    TEST_ASSERT_TRUE(store->read(CONFIG_LOCAL, meshtastic_LocalConfig_lora_tag, 0, meshtastic_Config_LoRaConfig_fields, &lora));
+    return lora;
+}
+
+static void writeDevice(meshtastic_Config_DeviceConfig_Role role) {
+    meshtastic_Config_DeviceConfig device = meshtastic_Config_DeviceConfig_init_zero;
+    device.role = role;
+    TEST_ASSERT_TRUE(store->write(CONFIG_LOCAL, meshtastic_LocalConfig_device_tag, 0, meshtastic_Config_DeviceConfig_fields, &device));
+}
+
+static meshtastic_Config_DeviceConfig_Role readRole() {
+    meshtastic_Config_DeviceConfig device = meshtastic_Config_DeviceConfig_init_zero;
+    TEST_ASSERT_TRUE(store->read(CONFIG_LOCAL, meshtastic_LocalConfig_device_tag, 0, meshtastic_Config_DeviceConfig_fields, &device));
+    return device.role;
+}
+
+static void writeChannel(uint8_t index, const char* name) {
+    meshtastic_Channel channel = meshtastic_Channel_init_zero;
+    channel.index = index;
+    channel.has_settings = true;
+    strncpy(channel.settings.name, name, sizeof(channel.settings.name) - 1);
+    channel.settings.psk.size = 16;
+    memset(channel.settings.psk.bytes, 0xA0 + index, 16);
+    channel.role = index == 0 ? meshtastic_Channel_Role_PRIMARY : meshtastic_Channel_Role_SECONDARY;
+    TEST_ASSERT_TRUE(store->write(CONFIG_CHANNELS, meshtastic_ChannelFile_channels_tag, index, meshtastic_Channel_fields, &channel));
+}
+
+// Decoded into a static, so fields can be asserted on straight from the call
+static const meshtastic_Channel& readChannel(uint8_t index) {
+    static meshtastic_Channel channel;
+    channel = meshtastic_Channel_init_zero;
+    TEST_ASSERT_TRUE(store->read(CONFIG_CHANNELS, meshtastic_ChannelFile_channels_tag, index, meshtastic_Channel_fields, &channel));
+    return channel;
+}
+
+static void writeOwner(const char* longName) {
+    meshtastic_User owner = meshtastic_User_init_zero;
+    strncpy(owner.long_name, longName, sizeof(owner.long_name) - 1);
+    strncpy(owner.short_name, "TST", sizeof(owner.short_name) - 1);
+    TEST_ASSERT_TRUE(store->write(CONFIG_OWNER, 0, 0, meshtastic_User_fields, &owner));
+}
+
+static const meshtastic_User& readOwner() {
+    static meshtastic_User owner;
+    owner = meshtastic_User_init_zero;
+    TEST_ASSERT_TRUE(store->read(CONFIG_OWNER, 0, 0, meshtastic_User_fields, &owner));
+    return owner;
+}
+
+static const ConfigSectionEntry* sectionEntry(const std::vector<uint8_t>& image, ConfigMessage message, uint8_t field) {
+    const ConfigImageHeader* header = (const ConfigImageHeader*)image.data();
+    const ConfigSectionEntry* table = (const ConfigSectionEntry*)(image.data() + sizeof(ConfigImageHeader));
+    for (uint16_t i = 0; i < header->sectionCount; i++) {
+        if (table[i].message == message && table[i].field == field) {
+            return &table[i];
+        }
+    }
+    return nullptr;
+}
+
+static void test_first_boot_reads_defaults() {
+    TEST_ASSERT_FALSE(store->hasImage());
+    TEST_ASSERT_EQUAL(0, readLora().hop_limit);
+    TEST_ASSERT_EQUAL(0, store->commit());
+}
+
+static void test_sections_round_trip() {
+    writeLora(3, 20);
+    writeDevice(meshtastic_Config_DeviceConfig_Role_ROUTER);
+    for (uint8_t i = 0; i < 3; i++) {
+        char name[12];
+        snprintf(name, sizeof(name), "chan%u", i);
+        writeChannel(i, name);
+    }
+    writeOwner("Test Node");
+
+    // Visible before the commit
+    TEST_ASSERT_TRUE(store->isDirty());
+    TEST_ASSERT_EQUAL(3, readLora().hop_limit);
+    TEST_ASSERT_GREATER_THAN(0, store->commit());
+    TEST_ASSERT_FALSE(store->isDirty());
+
+    TEST_ASSERT_TRUE(reboot());
+    TEST_ASSERT_EQUAL(3, readLora().hop_limit);
+    TEST_ASSERT_EQUAL(20, readLora().tx_power);
+    TEST_ASSERT_EQUAL(meshtastic_Config_DeviceConfig_Role_ROUTER, readRole());
+    for (uint8_t i = 0; i < 3; i++) {
+        const meshtastic_Channel& channel = readChannel(i);
+        char name[12];
+        snprintf(name, sizeof(name), "chan%u", i);
+        TEST_ASSERT_EQUAL_STRING(name, channel.settings.name);
+        TEST_ASSERT_EQUAL(0xA0 + i, channel.settings.psk.bytes[15]);
+    }
+    TEST_ASSERT_EQUAL_STRING("Test Node", readOwner().long_name);
+
+    // Growing an early section shifts the later ones without touching them
+    writeLora(7, -5);
+    writeOwner("A much longer owner name here");
+    TEST_ASSERT_EQUAL(7, readLora().hop_limit);
+    TEST_ASSERT_EQUAL(meshtastic_Config_DeviceConfig_Role_ROUTER, readRole());
+    TEST_ASSERT_EQUAL_STRING("chan2", readChannel(2).settings.name);
+    store->commit();
+    TEST_ASSERT_TRUE(reboot());
+    TEST_ASSERT_EQUAL(-5, readLora().tx_power);
+    TEST_ASSERT_EQUAL_STRING("chan1", readChannel(1).settings.name);
+    TEST_ASSERT_EQUAL_STRING("A much longer owner name here", readOwner().long_name);
+
+    // A discarded edit leaves the committed image as it was
+    writeLora(1, 1);
+    store->discard();
+    TEST_ASSERT_EQUAL(7, readLora().hop_limit);
+}
+
+// An all-default section encodes to nothing and sits at the same offset as
+// the section after it; resizing either must keep both readable
+static void test_empty_sections_share_offset() {
+    writeLora(0, 0);
+    writeDevice(meshtastic_Config_DeviceConfig_Role_CLIENT_MUTE);
+    writeOwner("Owner");
+    store->commit();
+
+    const std::vector<uint8_t>& image = slotImage("imageA");
+    const ConfigSectionEntry* lora = sectionEntry(image, CONFIG_LOCAL, meshtastic_LocalConfig_lora_tag);
+    const ConfigSectionEntry* device = sectionEntry(image, CONFIG_LOCAL, meshtastic_LocalConfig_device_tag);
+    TEST_ASSERT_NOT_NULL(lora);
+    TEST_ASSERT_NOT_NULL(device);
+    TEST_ASSERT_EQUAL(0, lora->length);
+    TEST_ASSERT_EQUAL(lora->offset, device->offset);
+
+    // Empty section grows: the one it shared an offset with must move
+    writeLora(5, 10);
+    TEST_ASSERT_EQUAL(5, readLora().hop_limit);
+    TEST_ASSERT_EQUAL(meshtastic_Config_DeviceConfig_Role_CLIENT_MUTE, readRole());
+    TEST_ASSERT_EQUAL_STRING("Owner", readOwner().long_name);
+
+    // And back to empty, then the neighbour changes size
+    writeLora(0, 0);
+    writeDevice(meshtastic_Config_DeviceConfig_Role_ROUTER_LATE);
+    TEST_ASSERT_EQUAL(0, readLora().hop_limit);
+    TEST_ASSERT_EQUAL(meshtastic_Config_DeviceConfig_Role_ROUTER_LATE, readRole());
+    TEST_ASSERT_EQUAL_STRING("Owner", readOwner().long_name);
+
+    store->commit();
+    TEST_ASSERT_TRUE(reboot());
+    TEST_ASSERT_EQUAL(0, readLora().hop_limit);
+    TEST_ASSERT_EQUAL(meshtastic_Config_DeviceConfig_Role_ROUTER_LATE, readRole());
+    TEST_ASSERT_EQUAL_STRING("Owner", readOwner().long_name);
+}
+
+static void test_falls_back_on_bad_crc() {
+    writeLora(3, 0);
+    store->commit();   // Slot A, #1
+    writeLora(5, 0);
+    store->commit();   // Slot B, #2
+    TEST_ASSERT_EQUAL(2, ((ConfigImageHeader*)slotImage("imageB").data())->sequence);
+
+    // A torn write of the newer slot
+    slotImage("imageB").back() ^= 0x55;
+    TEST_ASSERT_TRUE(reboot());
+    TEST_ASSERT_EQUAL(3, readLora().hop_limit);
+
+    // The next commit replaces the bad slot, never the good one
+    std::vector<uint8_t> good = slotImage("imageA");
+    writeLora(6, 0);
+    store->commit();
+    TEST_ASSERT_EQUAL_MEMORY(good.data(), slotImage("imageA").data(), good.size());
+    TEST_ASSERT_TRUE(reboot());
+    TEST_ASSERT_EQUAL(6, readLora().hop_limit);
+
+    // Both bad: nothing to load, reads fall back to defaults
+    slotImage("imageA")[sizeof(ConfigImageHeader)] ^= 0x01;
+    slotImage("imageB")[sizeof(ConfigImageHeader)] ^= 0x01;
+    TEST_ASSERT_FALSE(reboot());
+    TEST_ASSERT_EQUAL(0, readLora().hop_limit);
+}
+
+static void test_newer_sequence_wins() {
+    writeLora(1, 0);
+    store->commit();   // A #1
+    writeLora(2, 0);
+    store->commit();   // B #2
+    writeLora(3, 0);
+    store->commit();   // A #3
+    TEST_ASSERT_TRUE(reboot());
+    TEST_ASSERT_EQUAL(3, readLora().hop_limit);
+
+    // Commits alternate, so the older slot is the one overwritten
+    writeLora(4, 0);
+    store->commit();   // B #4
+    TEST_ASSERT_EQUAL(4, ((ConfigImageHeader*)slotImage("imageB").data())->sequence);
+    TEST_ASSERT_TRUE(reboot());
+    TEST_ASSERT_EQUAL(4, readLora().hop_limit);
+
+    // Sequence numbers compare across the 32-bit wrap
+    setSequence("imageA", 0xFFFFFFFF);
+    setSequence("imageB", 0);
+    TEST_ASSERT_TRUE(reboot());
+    TEST_ASSERT_EQUAL(4, readLora().hop_limit);
+    setSequence("imageA", 0);
+    setSequence("imageB", 0xFFFFFFFF);
+    TEST_ASSERT_TRUE(reboot());
+    TEST_ASSERT_EQUAL(3, readLora().hop_limit);
+
+    // The commit after that continues from the loaded image
+    writeLora(9, 0);
+    store->commit();
+    TEST_ASSERT_EQUAL(1, ((ConfigImageHeader*)slotImage("imageB").data())->sequence);
+    TEST_ASSERT_TRUE(reboot());
+    TEST_ASSERT_EQUAL(9, readLora().hop_limit);
+}
+
+// A typical configured node: load cost and heap against keeping the decoded structs
+static void test_load_time_and_footprint() {
+    writeLora(3, 27);
+    writeDevice(meshtastic_Config_DeviceConfig_Role_CLIENT);
+    meshtastic_Config_PositionConfig position = meshtastic_Config_PositionConfig_init_zero;
+    position.position_broadcast_secs = 900;
+    TEST_ASSERT_TRUE(store->write(CONFIG_LOCAL, meshtastic_LocalConfig_position_tag, 0, meshtastic_Config_PositionConfig_fields, &position));
+    meshtastic_Config_DisplayConfig display = meshtastic_Config_DisplayConfig_init_zero;
+    display.screen_on_secs = 60;
+    TEST_ASSERT_TRUE(store->write(CONFIG_LOCAL, meshtastic_LocalConfig_display_tag, 0, meshtastic_Config_DisplayConfig_fields, &display));
+    meshtastic_Config_BluetoothConfig bluetooth = meshtastic_Config_BluetoothConfig_init_zero;
+    bluetooth.enabled = true;
+    bluetooth.fixed_pin = 123456;
+    TEST_ASSERT_TRUE(store->write(CONFIG_LOCAL, meshtastic_LocalConfig_bluetooth_tag, 0, meshtastic_Config_BluetoothConfig_fields, &bluetooth));
+    meshtastic_ModuleConfig_MQTTConfig mqtt = meshtastic_ModuleConfig_MQTTConfig_init_zero;
+    mqtt.enabled = true;
+    strcpy(mqtt.address, "mqtt.meshtastic.org");
+    strcpy(mqtt.username, "meshdev");
+    strcpy(mqtt.password, "large4cats");
+    TEST_ASSERT_TRUE(store->write(CONFIG_MODULES, meshtastic_LocalModuleConfig_mqtt_tag, 0, meshtastic_ModuleConfig_MQTTConfig_fields, &mqtt));
+    for (uint8_t i = 0; i < 8; i++) {
+        char name[12];
+        snprintf(name, sizeof(name), "chan%u", i);
+        writeChannel(i, name);
+    }
+    writeOwner("Trailhead Relay");
+    size_t imageBytes = store->commit();
+    TEST_ASSERT_GREATER_THAN(0, imageBytes);
+
+    unsigned long start = micros();
+    for (int i = 0; i < LOAD_ROUNDS; i++) {
+        TEST_ASSERT_TRUE(reboot());
+    }
+    unsigned long loadMicros = micros() - start;
+
+    start = micros();
+    for (int i = 0; i < LOAD_ROUNDS; i++) {
+        readChannel(i % 8);
+    }
+    unsigned long readMicros = max(micros() - start, 1UL);
+
+    size_t decoded = sizeof(meshtastic_LocalConfig) + sizeof(meshtastic_LocalModuleConfig) +
+                     sizeof(meshtastic_ChannelFile) + sizeof(meshtastic_User);
+    size_t resident = store->residentBytes();
+    char message[160];
+    snprintf(message, sizeof(message), "%u byte image: load %.1f us, section read %.2f us; %u bytes resident vs %u decoded",
+             (unsigned)imageBytes, (double)loadMicros / LOAD_ROUNDS, (double)readMicros / LOAD_ROUNDS,
+             (unsigned)resident, (unsigned)decoded);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_FALSE(store->isDirty());
+    TEST_ASSERT_EQUAL(imageBytes, resident);
+    TEST_ASSERT_LESS_THAN(decoded / 4, resident);
+    TEST_ASSERT_LESS_THAN(1000, loadMicros / LOAD_ROUNDS);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_boot_reads_defaults);
+    RUN_TEST(test_sections_round_trip);
+    RUN_TEST(test_empty_sections_share_offset);
+    RUN_TEST(test_falls_back_on_bad_crc);
+    RUN_TEST(test_newer_sequence_wins);
+    RUN_TEST(test_load_time_and_footprint);
+    return UNITY_END();
+}
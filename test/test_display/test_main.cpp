@@ -0,0 +1,277 @@
+#include <unity.h>
+#include <stdlib.h>
+#include <string>
+#include <pb_encode.h>
+#include "DisplayController.h"
+
+// Golden screens sit next to this file. Set UPDATE_GOLDEN=1 to rewrite
+// them after an intended change; a mismatch leaves <name>.actual.pbm.
+#define SCREEN_BUDGET_US  5000     // Build and handoff, well under a frame's bus time
+#define BUS_HZ            400000
+
+// The flush task keeps a pointer to the display and never exits, so both live for the whole run
+static DisplayController display;
+static MessageHandler messageHandler;
+static TelemetryStore telemetry;
+static PositionStore positions;
+
+void setUp() {}
+
+void tearDown() {}
+
+static uint32_t panelRows() {
+    std::lock_guard<std::mutex> lock(hostPanel.mutex);
+    return hostPanel.tileRows;
+}
+
+static uint32_t panelBytes() {
+    std::lock_guard<std::mutex> lock(hostPanel.mutex);
+    return hostPanel.i2cBytes;
+}
+
+// Wait until the flush task has sent nothing for a few page times
+static void waitIdle() {
+    uint32_t rows = panelRows();
+    for (int quiet = 0; quiet < 10;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        uint32_t now = panelRows();
+        quiet = now == rows ? quiet + 1 : 0;
+        rows = now;
+    }
+}
+
+static std::string goldenPath(const char* name, const char* suffix = ".pbm") {
+    std::string file = __FILE__;
+    return file.substr(0, file.find_last_of("/\\") + 1) + "golden/" + name + suffix;
+}
+
+// The panel, once the frame has been flushed, against test/test_display/golden/<name>.pbm
+static void checkGolden(const char* name) {
+    waitIdle();
+    static uint8_t shown[HOST_PANEL_BYTES];
+    static uint8_t golden[HOST_PANEL_BYTES];
+    hostPanel.copy(shown);
+
+    std::string path = goldenPath(name);
+    const char* update = getenv("UPDATE_GOLDEN");
+    if (update != nullptr && strcmp(update, "1") == 0) {
+        TEST_ASSERT_TRUE_MESSAGE(hostWritePbm(shown, path.c_str()), path.c_str());
+        return;
+    }
+    TEST_ASSERT_TRUE_MESSAGE(hostReadPbm(path.c_str(), golden), path.c_str());
+    if (memcmp(shown, golden, HOST_PANEL_BYTES) != 0) {
+        std::string actual = goldenPath(name, ".actual.pbm");
+        hostWritePbm(shown, actual.c_str());
+        TEST_FAIL_MESSAGE(("screen differs from golden, see " + actual).c_str());
+    }
+}
+
+static void addMessages(int count) {
+    for (int i = 0; i < count; i++) {
+        char text[96];
+        snprintf(text, sizeof(text), "Message %d: long enough to wrap onto a second line of the screen", i + 1);
+        messageHandler.addSentMessage(text, strlen(text));
+    }
+}
+
+static void test_status_screens() {
+    display.showStartup();
+    checkGolden("startup");
+    display.showScanning();
+    checkGolden("scanning");
+    display.showConnecting("Meshtastic_1234");
+    checkGolden("connecting");
+    display.showConnected("Meshtastic_1234");
+    checkGolden("connected");
+    display.showDisconnected();
+    checkGolden("disconnected");
+    display.showKeyStatus(true);
+    checkGolden("keys");
+    display.showKeyStatus(false);
+    checkGolden("no_keys");
+}
+
+static void test_header_battery_and_charging() {
+    display.updateBatteryLevel(42);
+    display.updateChargingStatus(true);
+    TEST_ASSERT_TRUE(display.needsRedraw());
+    display.showDisconnected();
+    checkGolden("charging");
+    display.updateBatteryLevel(100);
+    display.updateChargingStatus(false);
+}
+
+static void test_message_screens() {
+    display.showMessages(messageHandler);
+    checkGolden("messages_empty");
+
+    addMessages(6);
+    Message sample = messageHandler.conversationMessage(0, 5);
+    display.showMessage(sample);
+    checkGolden("message");
+    display.showMessages(messageHandler);
+    checkGolden("messages");
+    display.scrollMessages(messageHandler);
+    checkGolden("messages_scrolled");
+    display.toggleDetail(messageHandler);
+    checkGolden("detail");
+    display.toggleDetail(messageHandler);
+    display.scrollMessages(messageHandler);
+    display.scrollMessages(messageHandler);
+    display.scrollMessages(messageHandler);
+    display.scrollMessages(messageHandler);
+    checkGolden("messages_oldest");
+}
+
+static void test_telemetry_screen() {
+    display.showTelemetry(telemetry, 0x1234ABCD, 3600);
+    checkGolden("telemetry_empty");
+
+    // Two device reports and one environment report, a minute apart
+    for (int i = 0; i < 2; i++) {
+        meshtastic_Telemetry report = meshtastic_Telemetry_init_zero;
+        report.which_variant = meshtastic_Telemetry_device_metrics_tag;
+        meshtastic_DeviceMetrics& m = report.variant.device_metrics;
+        m.has_battery_level = m.has_voltage = m.has_channel_utilization = m.has_air_util_tx = true;
+        m.battery_level = 90 - i * 10;
+        m.voltage = 4.05f - i * 0.1f;
+        m.channel_utilization = 12.5f + i;
+        m.air_util_tx = 1.5f;
+        telemetry.record(0x1234ABCD, report);
+        hostAdvanceMillis(60000);
+    }
+    meshtastic_Telemetry report = meshtastic_Telemetry_init_zero;
+    report.which_variant = meshtastic_Telemetry_environment_metrics_tag;
+    report.variant.environment_metrics.has_temperature = true;
+    report.variant.environment_metrics.temperature = -3.5f;
+    report.variant.environment_metrics.has_barometric_pressure = true;
+    report.variant.environment_metrics.barometric_pressure = 1013.2f;
+    telemetry.record(0x1234ABCD, report);
+    telemetry.update();
+
+    display.showTelemetry(telemetry, 0x1234ABCD, 3600);
+    checkGolden("telemetry");
+    display.showTelemetry(telemetry, 0x1234ABCD, 900);
+    checkGolden("telemetry_15m");
+}
+
+static void addPosition(uint32_t from, uint32_t node, int32_t latitude_i, int32_t longitude_i) {
+    meshtastic_Position position = meshtastic_Position_init_zero;
+    position.has_latitude_i = position.has_longitude_i = true;
+    position.latitude_i = latitude_i;
+    position.longitude_i = longitude_i;
+    meshtastic_MeshPacket packet = meshtastic_MeshPacket_init_zero;
+    packet.from = from;
+    pb_ostream_t stream = pb_ostream_from_buffer(packet.decoded.payload.bytes, sizeof(packet.decoded.payload.bytes));
+    pb_encode(&stream, meshtastic_Position_fields, &position);
+    packet.decoded.payload.size = stream.bytes_written;
+    positions.handlePacket(packet, node);
+    positions.update();
+}
+
+static void test_nearby_screen() {
+    display.showNearby(positions, 0x1234ABCD);
+    checkGolden("nearby_none");
+
+    // Seven nodes heard a minute apart, then this device's position from the phone
+    for (uint32_t i = 0; i < 7; i++) {
+        addPosition(0x0A000000 + i, 0x0A000000 + i, 515000000 + i * i * 20000, -1200000 + i * 30000);
+        hostAdvanceMillis(60000);
+    }
+    addPosition(0, 0x1234ABCD, 515000000, -1200000);
+    display.showNearby(positions, 0x1234ABCD);
+    checkGolden("nearby");
+}
+
+static void test_unchanged_screen_sends_nothing() {
+    display.showScanning();
+    waitIdle();
+    uint32_t bytes = panelBytes();
+    display.showScanning();
+    waitIdle();
+    TEST_ASSERT_EQUAL(bytes, panelBytes());
+
+    // Only the pages that differ: the status line stays, the body changes
+    display.showConnecting("Meshtastic_1234");
+    waitIdle();
+    uint32_t changed = panelBytes() - bytes;
+    TEST_ASSERT_GREATER_THAN(0, changed);
+    TEST_ASSERT_LESS_THAN(DISPLAY_PAGES * (DISPLAY_FRAME_SIZE / DISPLAY_PAGES + I2C_PAGE_OVERHEAD), changed);
+}
+
+// Stored ids are not contiguous: a message that outlived 32 newer ones in
+// other conversations shares id % LAYOUT_CACHE_SIZE with one of them
+static void test_layout_cache_by_slot() {
+    TextLayout layout;
+    const char* older = "Kept in a quiet conversation";
+    const char* newer = "Arrived 32 messages later";
+    for (int round = 0; round < 10; round++) {
+        const LayoutLines& first = layout.lines(3, 1, older, strlen(older), 126, 0);
+        TEST_ASSERT_EQUAL(1, first.messageId);
+        const LayoutLines& second = layout.lines(7, 1 + LAYOUT_CACHE_SIZE, newer, strlen(newer), 126, 0);
+        TEST_ASSERT_EQUAL(1 + LAYOUT_CACHE_SIZE, second.messageId);
+    }
+
+    // A slot reused by a new message is laid out again
+    layout.lines(3, 2 + LAYOUT_CACHE_SIZE, newer, strlen(newer), 126, 0);
+
+    Serial.clearOutput();
+    layout.printStats();
+    TEST_ASSERT_TRUE(Serial.output().find("18 hits, 3 misses") != std::string::npos);
+}
+
+// Each screen on loop(), with the bus at its real speed: a screen that
+// waited for the panel would take the whole frame's bus time
+static void test_screen_times() {
+    struct Screen {
+        const char* name;
+        std::function<void()> show;
+    };
+    Message sample = messageHandler.conversationMessage(0, 0);
+    Screen screens[] = {
+        {"startup",      []() { display.showStartup(); }},
+        {"scanning",     []() { display.showScanning(); }},
+        {"connecting",   []() { display.showConnecting("Meshtastic_1234"); }},
+        {"connected",    []() { display.showConnected("Meshtastic_1234"); }},
+        {"disconnected", []() { display.showDisconnected(); }},
+        {"keys",         []() { display.showKeyStatus(true); }},
+        {"message",      [&]() { display.showMessage(sample); }},
+        {"messages",     []() { display.showMessages(messageHandler); }},
+        {"scroll",       []() { display.scrollMessages(messageHandler); }},
+        {"detail",       []() { display.toggleDetail(messageHandler); }},
+        {"telemetry",    []() { display.showTelemetry(telemetry, 0x1234ABCD, 3600); }},
+        {"nearby",       []() { display.showNearby(positions, 0x1234ABCD); }},
+    };
+
+    hostPanel.busHz = BUS_HZ;
+    for (Screen& screen : screens) {
+        uint32_t bytes = panelBytes();
+        unsigned long start = micros();
+        screen.show();
+        uint32_t elapsed = micros() - start;
+        waitIdle();
+
+        char message[96];
+        snprintf(message, sizeof(message), "%-12s %5u us, %4u I2C bytes", screen.name, elapsed, panelBytes() - bytes);
+        TEST_MESSAGE(message);
+        TEST_ASSERT_LESS_THAN_MESSAGE(SCREEN_BUDGET_US, elapsed, screen.name);
+    }
+    hostPanel.busHz = 0;
+}
+
+int main(int argc, char** argv) {
+    hostPanel.reset();
+    messageHandler.begin();
+    display.begin();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_status_screens);
+    RUN_TEST(test_header_battery_and_charging);
+    RUN_TEST(test_message_screens);
+    RUN_TEST(test_telemetry_screen);
+    RUN_TEST(test_nearby_screen);
+    RUN_TEST(test_unchanged_screen_sends_nothing);
+    RUN_TEST(test_layout_cache_by_slot);
+    RUN_TEST(test_screen_times);
+    return UNITY_END();
+}
@@ -0,0 +1,132 @@
+#include <unity.h>
+#include "DisplayController.h"
+
+#define BUS_HZ 400000   // Wire.setClock() in DisplayController::begin()
+
+// The flush task keeps a pointer to the display and never exits, so both live for the whole run
+static DisplayController display;
+static MessageHandler messageHandler;
+
+void setUp() {}
+
+void tearDown() {}
+
+static uint32_t panelRows() {
+    std::lock_guard<std::mutex> lock(hostPanel.mutex);
+    return hostPanel.tileRows;
+}
+
+static uint32_t panelBytes() {
+    std::lock_guard<std::mutex> lock(hostPanel.mutex);
+    return hostPanel.i2cBytes;
+}
+
+// Wait until the flush task has sent nothing for a few page times
+static void waitIdle() {
+    uint32_t rows = panelRows();
+    for (int quiet = 0; quiet < 10;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        uint32_t now = panelRows();
+        quiet = now == rows ? quiet + 1 : 0;
+        rows = now;
+    }
+}
+
+// Alternate two full screens so every frame differs from the last
+static void showAlternating(int frame) {
+    if (frame % 2 == 0) {
+        display.showMessages(messageHandler);
+    } else {
+        display.showScanning();
+    }
+}
+
+static void test_last_frame_reaches_panel() {
+    static uint8_t expected[HOST_PANEL_BYTES];
+    static uint8_t shown[HOST_PANEL_BYTES];
+    display.showStartup();
+    waitIdle();
+    hostPanel.copy(expected);
+
+    // Far faster than the bus: most frames are replaced before the task takes them
+    const int frames = 31;
+    uint32_t rowsBefore = panelRows();
+    for (int i = 0; i < frames - 1; i++) {
+        showAlternating(i);
+    }
+    display.showStartup();
+    waitIdle();
+
+    hostPanel.copy(shown);
+    TEST_ASSERT_EQUAL_MEMORY(expected, shown, HOST_PANEL_BYTES);
+    TEST_ASSERT_LESS_THAN(frames * DISPLAY_PAGES / 2, panelRows() - rowsBefore);
+}
+
+static void test_loop_stall_against_bus_time() {
+    // Bus time of a screen change, which a synchronous sendBuffer() would stall loop() for
+    display.showScanning();
+    waitIdle();
+    uint32_t bytesBefore = panelBytes();
+    unsigned long start = micros();
+    display.showMessages(messageHandler);
+    waitIdle();
+    uint32_t frameBytes = panelBytes() - bytesBefore;
+    uint32_t busMicros = (uint64_t)frameBytes * 9 * 1000000 / BUS_HZ;
+    TEST_ASSERT_GREATER_OR_EQUAL(busMicros, micros() - start);
+
+    // One frame per simulated loop() pass, the flush task sending in parallel
+    const int frames = 200;
+    uint64_t stallTotal = 0;
+    uint32_t stallMax = 0;
+    for (int i = 0; i < frames; i++) {
+        start = micros();
+        showAlternating(i);
+        uint32_t elapsed = micros() - start;
+        stallTotal += elapsed;
+        stallMax = max(stallMax, elapsed);
+        std::this_thread::sleep_for(std::chrono::microseconds(busMicros / 4));
+    }
+    waitIdle();
+
+    char message[128];
+    snprintf(message, sizeof(message), "loop() stall %u us avg, %u us max per frame; %u I2C bytes take %u us at %u Hz",
+             (unsigned)(stallTotal / frames), stallMax, frameBytes, busMicros, BUS_HZ);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_THAN(busMicros / 10, stallTotal / frames);
+}
+
+static void test_sleep_blanks_before_power_save() {
+    display.showMessages(messageHandler);
+    display.sleep();
+    waitIdle();
+    static uint8_t shown[HOST_PANEL_BYTES];
+    static const uint8_t blank[HOST_PANEL_BYTES] = {};
+    hostPanel.copy(shown);
+    TEST_ASSERT_EQUAL_MEMORY(blank, shown, HOST_PANEL_BYTES);
+    TEST_ASSERT_EQUAL(1, hostPanel.powerSave);
+
+    display.wake();
+    display.showMessages(messageHandler);
+    waitIdle();
+    TEST_ASSERT_EQUAL(0, hostPanel.powerSave);
+    hostPanel.copy(shown);
+    TEST_ASSERT_NOT_EQUAL(0, memcmp(blank, shown, HOST_PANEL_BYTES));
+}
+
+int main(int argc, char** argv) {
+    hostPanel.reset();
+    messageHandler.begin();
+    for (int i = 0; i < 12; i++) {
+        char text[64];
+        snprintf(text, sizeof(text), "Message %d, long enough to wrap onto a second line", i);
+        messageHandler.addSentMessage(text, strlen(text));
+    }
+    display.begin();
+    hostPanel.busHz = BUS_HZ;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_last_frame_reaches_panel);
+    RUN_TEST(test_loop_stall_against_bus_time);
+    RUN_TEST(test_sleep_blanks_before_power_save);
+    return UNITY_END();
+}
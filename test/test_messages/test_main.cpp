@@ -0,0 +1,290 @@
+#include <unity.h>
+#include <vector>
+#include <algorithm>
+#include "MessageHandler.h"
+
+#define PEER        0x1234abcd
+#define CHURN       2000
+
+static MessageHandler* handler;
+static uint32_t seed;
+
+void setUp() {
+    handler = new MessageHandler();
+    handler->begin();
+    seed = 1;
+}
+
+void tearDown() {
+    delete handler;
+}
+
+static uint32_t nextRandom() {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+// Same home slot as MessageHandler uses for its packet id index
+static uint32_t homeOf(uint32_t packetId) {
+    return ((packetId * 2654435769u) >> 16) & (MESSAGE_INDEX_SIZE - 1);
+}
+
+// The next id after `after` whose home slot is `home`
+static uint32_t idWithHome(uint32_t home, uint32_t after) {
+    uint32_t id = after + 1;
+    while (homeOf(id) != home) {
+        id++;
+    }
+    return id;
+}
+
+static bool receive(uint32_t from, uint32_t to, uint32_t channel, uint32_t id, const char* text,
+                    uint32_t replyId = 0, bool reaction = false) {
+    meshtastic_FromRadio fromRadio = meshtastic_FromRadio_init_zero;
+    fromRadio.which_payload_variant = meshtastic_FromRadio_packet_tag;
+    meshtastic_MeshPacket& packet = fromRadio.packet;
+    packet.from = from;
+    packet.to = to;
+    packet.channel = channel;
+    packet.id = id;
+    packet.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    packet.decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+    packet.decoded.reply_id = replyId;
+    packet.decoded.emoji = reaction ? 1 : 0;
+    packet.decoded.payload.size = strlen(text);
+    memcpy(packet.decoded.payload.bytes, text, packet.decoded.payload.size);
+
+    uint8_t frame[512];
+    size_t length = 0;
+    TEST_ASSERT_TRUE(encode_from_radio(frame, sizeof(frame), &fromRadio, &length));
+    return handler->processReceivedData(frame, length);
+}
+
+static bool receiveChannel(uint32_t channel, uint32_t id, const char* text) {
+    return receive(PEER, BROADCAST_ADDR, channel, id, text);
+}
+
+static bool receiveDirect(uint32_t from, uint32_t id, const char* text) {
+    return receive(from, handler->getNodeNum(), 0, id, text);
+}
+
+static int conversationLabelled(const char* label) {
+    int conversation = handler->findConversation(label);
+    TEST_ASSERT_TRUE(conversation >= 0);
+    return conversation;
+}
+
+static bool statsContain(const char* text) {
+    Serial.clearOutput();
+    handler->printStats();
+    return Serial.output().find(text) != std::string::npos;
+}
+
+static void test_reactions_attach_by_packet_id() {
+    TEST_ASSERT_TRUE(receiveChannel(0, 100, "summit at noon?"));
+    TEST_ASSERT_TRUE(receiveChannel(0, 101, "on my way"));
+
+    TEST_ASSERT_TRUE(receive(0x1111, BROADCAST_ADDR, 0, 200, "\xf0\x9f\x91\x8d", 100, true));
+    TEST_ASSERT_TRUE(receive(0x2222, BROADCAST_ADDR, 0, 201, "\xf0\x9f\x91\x8d", 100, true));
+    TEST_ASSERT_TRUE(receive(0x3333, BROADCAST_ADDR, 0, 202, "\xe2\x9d\xa4", 100, true));
+    TEST_ASSERT_TRUE(receive(0x3333, BROADCAST_ADDR, 0, 203, "\xf0\x9f\x98\x82", 101, true));
+
+    // Reactions are counted, never stored as messages
+    TEST_ASSERT_EQUAL(2, handler->getMessageCount());
+    const Message* parent = handler->findPacket(100);
+    TEST_ASSERT_NOT_NULL(parent);
+    TEST_ASSERT_EQUAL(2, parent->reactionCount);
+    TEST_ASSERT_EQUAL_STRING("\xf0\x9f\x91\x8d", parent->reactions[0].emoji);
+    TEST_ASSERT_EQUAL(2, parent->reactions[0].count);
+    TEST_ASSERT_EQUAL(1, parent->reactions[1].count);
+    TEST_ASSERT_EQUAL(1, handler->findPacket(101)->reactionCount);
+
+    // Room for MAX_REACTIONS distinct emoji, then new ones are dropped
+    TEST_ASSERT_TRUE(receive(0x4444, BROADCAST_ADDR, 0, 204, "a", 100, true));
+    TEST_ASSERT_FALSE(receive(0x5555, BROADCAST_ADDR, 0, 205, "b", 100, true));
+    TEST_ASSERT_EQUAL(MAX_REACTIONS, parent->reactionCount);
+
+    // A parent we never stored
+    TEST_ASSERT_FALSE(receive(0x4444, BROADCAST_ADDR, 0, 206, "\xf0\x9f\x91\x8d", 999, true));
+    TEST_ASSERT_TRUE(statsContain("Reactions: 5 counted, 2 dropped"));
+
+    // A reply (no emoji flag) is a message of its own that names its parent
+    TEST_ASSERT_TRUE(receive(0x4444, BROADCAST_ADDR, 0, 207, "noon works", 100));
+    TEST_ASSERT_EQUAL(3, handler->getMessageCount());
+    TEST_ASSERT_EQUAL(100, handler->findPacket(207)->replyId);
+}
+
+static void test_duplicates_dropped() {
+    TEST_ASSERT_TRUE(receiveChannel(0, 300, "hello"));
+    TEST_ASSERT_FALSE(receiveChannel(0, 300, "hello"));
+    // Same id through another route (DM, other channel) is still the same packet
+    TEST_ASSERT_FALSE(receiveChannel(1, 300, "hello"));
+    TEST_ASSERT_FALSE(receiveDirect(PEER, 300, "hello"));
+    TEST_ASSERT_EQUAL(1, handler->getMessageCount());
+    TEST_ASSERT_EQUAL(1, handler->getConversationCount());
+    TEST_ASSERT_TRUE(statsContain("3 duplicate packets"));
+}
+
+// Evicting the head of a probe run must shift the rest back, or later
+// entries of the run become unreachable
+static void test_index_backward_shift_on_evict() {
+    const uint32_t home = 10;
+    uint32_t first = idWithHome(home, 1000);
+    uint32_t second = idWithHome(home, first);
+    uint32_t third = idWithHome(home, second);
+    uint32_t neighbour = idWithHome(home + 1, third);   // Probes past the run
+
+    TEST_ASSERT_TRUE(receiveChannel(0, first, "first"));
+    TEST_ASSERT_TRUE(receiveChannel(0, second, "second"));
+    TEST_ASSERT_TRUE(receiveChannel(0, third, "third"));
+    TEST_ASSERT_TRUE(receiveChannel(0, neighbour, "neighbour"));
+    // Filler whose homes stay clear of the run
+    uint32_t filler = 5000;
+    for (int i = 4; i < CONVERSATION_QUOTA; i++) {
+        filler = idWithHome(40 + i, filler);
+        TEST_ASSERT_TRUE(receiveChannel(0, filler, "filler"));
+    }
+
+    // At the quota: each new message evicts the oldest, head of the run first
+    filler = idWithHome(60, filler);
+    TEST_ASSERT_TRUE(receiveChannel(0, filler, "filler"));
+    TEST_ASSERT_NULL(handler->findPacket(first));
+    TEST_ASSERT_NOT_NULL(handler->findPacket(second));
+    TEST_ASSERT_NOT_NULL(handler->findPacket(third));
+    TEST_ASSERT_EQUAL_STRING("neighbour", handler->findPacket(neighbour)->text.c_str());
+
+    filler = idWithHome(61, filler);
+    TEST_ASSERT_TRUE(receiveChannel(0, filler, "filler"));
+    TEST_ASSERT_NULL(handler->findPacket(second));
+    TEST_ASSERT_EQUAL_STRING("third", handler->findPacket(third)->text.c_str());
+    TEST_ASSERT_EQUAL_STRING("neighbour", handler->findPacket(neighbour)->text.c_str());
+
+    // An evicted id is new again
+    TEST_ASSERT_TRUE(receiveChannel(0, first, "first again"));
+}
+
+// Random traffic with ids crowded onto a few home slots: every stored
+// message stays findable by packet id, every evicted one is gone
+static void test_index_matches_store_under_churn() {
+    std::vector<uint32_t> seen;
+    uint32_t nextId = 1;
+    for (int i = 0; i < CHURN; i++) {
+        uint32_t id = idWithHome(nextRandom() % 8, nextId);
+        nextId = id;
+        seen.push_back(id);
+        if (nextRandom() % 3 == 0) {
+            TEST_ASSERT_TRUE(receiveDirect(0x1000 + nextRandom() % 3, id, "dm"));
+        } else {
+            TEST_ASSERT_TRUE(receiveChannel(nextRandom() % 4, id, "chan"));
+        }
+
+        std::vector<uint32_t> stored;
+        for (int rank = 0; rank < handler->getConversationCount(); rank++) {
+            int conversation = handler->conversationAt(rank);
+            for (int m = 0; m < handler->getConversation(conversation).count; m++) {
+                const Message& message = handler->conversationMessage(conversation, m);
+                TEST_ASSERT_TRUE(handler->findPacket(message.packetId) == &message);
+                stored.push_back(message.packetId);
+            }
+        }
+        TEST_ASSERT_EQUAL(handler->getMessageCount(), stored.size());
+        // Spot-check a few evicted ids
+        for (int probe = 0; probe < 4; probe++) {
+            uint32_t old = seen[nextRandom() % seen.size()];
+            if (std::find(stored.begin(), stored.end(), old) == stored.end()) {
+                TEST_ASSERT_NULL(handler->findPacket(old));
+            }
+        }
+    }
+}
+
+static void test_conversation_quota() {
+    for (uint32_t i = 1; i <= CONVERSATION_QUOTA + 4; i++) {
+        char text[16];
+        snprintf(text, sizeof(text), "msg %u", i);
+        TEST_ASSERT_TRUE(receiveChannel(0, 400 + i, text));
+    }
+    int channel = conversationLabelled("C0");
+    const Conversation& conv = handler->getConversation(channel);
+    TEST_ASSERT_EQUAL(CONVERSATION_QUOTA, conv.count);
+    TEST_ASSERT_EQUAL(CONVERSATION_QUOTA, conv.unread);
+    // Oldest four recycled; sequence numbers keep counting
+    TEST_ASSERT_EQUAL(5, handler->conversationMessage(channel, 0).seq);
+    TEST_ASSERT_EQUAL_STRING("msg 5", handler->conversationMessage(channel, 0).text.c_str());
+    TEST_ASSERT_EQUAL_STRING("msg 20", handler->conversationMessage(channel, CONVERSATION_QUOTA - 1).text.c_str());
+    TEST_ASSERT_EQUAL(CONVERSATION_QUOTA, handler->getMessageCount());
+    TEST_ASSERT_TRUE(statsContain("Evicted: 4 at quota, 0 least recent"));
+}
+
+static void test_busy_channel_keeps_direct_messages() {
+    TEST_ASSERT_TRUE(receiveDirect(PEER, 500, "meet at the hut"));
+    TEST_ASSERT_TRUE(receiveDirect(PEER, 501, "bring the spare radio"));
+    TEST_ASSERT_TRUE(receiveDirect(PEER, 502, "ok?"));
+    for (uint32_t i = 0; i < 10 * MAX_MESSAGES; i++) {
+        TEST_ASSERT_TRUE(receiveChannel(0, 1000 + i, "channel chatter"));
+    }
+
+    int direct = conversationLabelled("D1234abcd");
+    TEST_ASSERT_EQUAL(3, handler->getConversation(direct).count);
+    TEST_ASSERT_EQUAL_STRING("meet at the hut", handler->conversationMessage(direct, 0).text.c_str());
+    TEST_ASSERT_NOT_NULL(handler->findPacket(500));
+    TEST_ASSERT_EQUAL(CONVERSATION_QUOTA, handler->getConversation(conversationLabelled("C0")).count);
+}
+
+// With the slab full, the least recently active conversation gives up its oldest message
+static void test_slab_eviction_takes_least_recent() {
+    for (uint32_t i = 0; i < CONVERSATION_QUOTA; i++) {
+        TEST_ASSERT_TRUE(receiveChannel(0, 600 + i, "zero"));
+    }
+    for (uint32_t i = 0; i < CONVERSATION_QUOTA; i++) {
+        TEST_ASSERT_TRUE(receiveChannel(1, 700 + i, "one"));
+    }
+    TEST_ASSERT_EQUAL(MAX_MESSAGES, handler->getMessageCount());
+
+    TEST_ASSERT_TRUE(receiveDirect(PEER, 800, "dm"));
+    TEST_ASSERT_EQUAL(MAX_MESSAGES, handler->getMessageCount());
+    TEST_ASSERT_EQUAL(CONVERSATION_QUOTA - 1, handler->getConversation(conversationLabelled("C0")).count);
+    TEST_ASSERT_EQUAL(CONVERSATION_QUOTA, handler->getConversation(conversationLabelled("C1")).count);
+    TEST_ASSERT_NULL(handler->findPacket(600));
+
+    // C0 speaks up, so C1 is now the least recent and pays for it
+    TEST_ASSERT_TRUE(receiveChannel(0, 616, "zero again"));
+    TEST_ASSERT_EQUAL(CONVERSATION_QUOTA, handler->getConversation(conversationLabelled("C0")).count);
+    TEST_ASSERT_EQUAL(CONVERSATION_QUOTA - 1, handler->getConversation(conversationLabelled("C1")).count);
+    TEST_ASSERT_NULL(handler->findPacket(700));
+
+    // Still C1 after the DM: the DM is now the most recent
+    TEST_ASSERT_TRUE(receiveDirect(PEER, 801, "dm"));
+    TEST_ASSERT_EQUAL(CONVERSATION_QUOTA - 2, handler->getConversation(conversationLabelled("C1")).count);
+    TEST_ASSERT_EQUAL(2, handler->getConversation(conversationLabelled("D1234abcd")).count);
+    TEST_ASSERT_TRUE(statsContain("Evicted: 0 at quota, 3 least recent"));
+}
+
+// Past MAX_CONVERSATIONS, the least recently active conversation is closed
+static void test_conversation_lru() {
+    for (uint32_t c = 0; c < MAX_CONVERSATIONS; c++) {
+        TEST_ASSERT_TRUE(receiveDirect(0x2000 + c, 900 + c, "hi"));
+    }
+    // Touch the oldest so the second becomes least recent
+    TEST_ASSERT_TRUE(receiveDirect(0x2000, 950, "still here"));
+
+    TEST_ASSERT_TRUE(receiveChannel(3, 960, "new channel"));
+    TEST_ASSERT_EQUAL(MAX_CONVERSATIONS, handler->getConversationCount());
+    TEST_ASSERT_EQUAL(-1, handler->findConversation("D00002001"));
+    TEST_ASSERT_NULL(handler->findPacket(901));
+    TEST_ASSERT_EQUAL(2, handler->getConversation(conversationLabelled("D00002000")).count);
+    TEST_ASSERT_EQUAL(handler->findConversation("C3"), handler->conversationAt(0));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_reactions_attach_by_packet_id);
+    RUN_TEST(test_duplicates_dropped);
+    RUN_TEST(test_index_backward_shift_on_evict);
+    RUN_TEST(test_index_matches_store_under_churn);
+    RUN_TEST(test_conversation_quota);
+    RUN_TEST(test_busy_channel_keeps_direct_messages);
+    RUN_TEST(test_slab_eviction_takes_least_recent);
+    RUN_TEST(test_conversation_lru);
+    return UNITY_END();
+}
@@ -0,0 +1,203 @@
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "OutboundQueue.h"
+
+#define LINE_BYTES   200
+#define STEP_MS      100
+
+static OutboundQueue* queue;
+static std::vector<std::string> sent;
+static std::vector<unsigned long> sentAt;
+
+static void configure(meshtastic_Config_LoRaConfig_RegionCode region) {
+    meshtastic_Config_LoRaConfig lora = meshtastic_Config_LoRaConfig_init_zero;
+    lora.use_preset = true;
+    lora.modem_preset = meshtastic_Config_LoRaConfig_ModemPreset_LONG_FAST;
+    lora.region = region;
+    queue->configure(lora);
+}
+
+void setUp() {
+    queue = new OutboundQueue();
+    sent.clear();
+    sentAt.clear();
+    configure(meshtastic_Config_LoRaConfig_RegionCode_US);
+    queue->onSend([](const char* text, size_t length) -> size_t {
+        sent.push_back(std::string(text, length));
+        sentAt.push_back(millis());
+        return length + OUTBOUND_PACKET_OVERHEAD;
+    });
+    Serial.clearOutput();
+}
+
+void tearDown() {
+    delete queue;
+}
+
+// Lines far enough apart that each gets its own packet
+static void pushSeparate(int lines, size_t bytes) {
+    std::string line(bytes, 'x');
+    for (int i = 0; i < lines; i++) {
+        line[0] = 'a' + i;
+        TEST_ASSERT_TRUE(queue->push(line.c_str(), line.length()));
+        hostAdvanceMillis(OUTBOUND_COALESCE_MS);
+    }
+}
+
+static void run(unsigned long ms) {
+    for (unsigned long elapsed = 0; elapsed < ms; elapsed += STEP_MS) {
+        queue->update();
+        hostAdvanceMillis(STEP_MS);
+    }
+}
+
+static bool statsContain(const char* text) {
+    Serial.clearOutput();
+    queue->printStats();
+    return Serial.output().find(text) != std::string::npos;
+}
+
+// Steady-state gap between packets, once the burst allowance is spent
+static unsigned long pacedGap() {
+    TEST_ASSERT_GREATER_THAN(OUTBOUND_BURST_PACKETS + 1, sentAt.size());
+    return sentAt.back() - sentAt[sentAt.size() - 2];
+}
+
+// Reference values from the Semtech LoRa calculator: LongFast (SF11,
+// 250 kHz, CR 4/5), 16-symbol preamble, explicit header, CRC on, no low
+// data rate optimization
+static void test_airtime_matches_calculator() {
+    TEST_ASSERT_UINT32_WITHIN(2, 395264, queue->airtimeMicros(20));
+    TEST_ASSERT_UINT32_WITHIN(2, 641024, queue->airtimeMicros(50));
+    TEST_ASSERT_UINT32_WITHIN(2, 2156544, queue->airtimeMicros(255));
+
+    // SF7/125 kHz, 10 bytes: the calculator's 41.216 ms at 8 symbols of
+    // preamble, plus 8 more at 1.024 ms
+    meshtastic_Config_LoRaConfig lora = meshtastic_Config_LoRaConfig_init_zero;
+    lora.bandwidth = 125;
+    lora.spread_factor = 7;
+    lora.coding_rate = 5;
+    queue->configure(lora);
+    TEST_ASSERT_UINT32_WITHIN(2, 49408, queue->airtimeMicros(10));
+
+    // LongSlow (SF12, 125 kHz, CR 4/8) turns on low data rate optimization
+    lora.use_preset = true;
+    lora.modem_preset = meshtastic_Config_LoRaConfig_ModemPreset_LONG_SLOW;
+    queue->configure(lora);
+    TEST_ASSERT_UINT32_WITHIN(2, 3547136, queue->airtimeMicros(50));
+}
+
+// The bucket refills at half the region's duty cycle: 5% in EU_868, 50% in the US
+static void test_region_pacing() {
+    uint32_t airtime = queue->airtimeMicros(LINE_BYTES + OUTBOUND_PACKET_OVERHEAD);
+
+    pushSeparate(OUTBOUND_QUEUE_DEPTH, LINE_BYTES);
+    run(60000);
+    TEST_ASSERT_EQUAL(OUTBOUND_QUEUE_DEPTH, sent.size());
+    unsigned long usGap = pacedGap();
+    // A full bucket lets the first packets go back to back
+    TEST_ASSERT_LESS_THAN(2 * STEP_MS, sentAt[1] - sentAt[0]);
+    TEST_ASSERT_UINT32_WITHIN(airtime * 2 / 1000 / 20 + STEP_MS, airtime * 2 / 1000, usGap);
+
+    sent.clear();
+    sentAt.clear();
+    configure(meshtastic_Config_LoRaConfig_RegionCode_EU_868);
+    pushSeparate(OUTBOUND_QUEUE_DEPTH, LINE_BYTES);
+    run(OUTBOUND_MAX_WAIT_MS);
+    TEST_ASSERT_EQUAL(OUTBOUND_QUEUE_DEPTH, sent.size());
+    unsigned long euGap = pacedGap();
+    TEST_ASSERT_UINT32_WITHIN(airtime * 20 / 1000 / 20 + STEP_MS, airtime * 20 / 1000, euGap);
+
+    char message[128];
+    snprintf(message, sizeof(message), "%u ms per packet on air: one every %lu ms in the US, %lu ms in EU_868",
+             airtime / 1000, usGap, euGap);
+    TEST_MESSAGE(message);
+}
+
+static void test_coalescing_window() {
+    // Lines within 200 ms of the last one join, however long the paste runs
+    queue->push("one", 3);
+    hostAdvanceMillis(150);
+    queue->push("two", 3);
+    hostAdvanceMillis(150);
+    queue->push("three", 5);
+    TEST_ASSERT_EQUAL(1, queue->size());
+
+    // Still inside the window: held for the rest of the paste
+    queue->update();
+    TEST_ASSERT_EQUAL(0, sent.size());
+
+    hostAdvanceMillis(OUTBOUND_COALESCE_MS);
+    queue->push("four", 4);
+    TEST_ASSERT_EQUAL(2, queue->size());
+    run(2000);
+    TEST_ASSERT_EQUAL(2, sent.size());
+    TEST_ASSERT_EQUAL_STRING("one\ntwo\nthree", sent[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("four", sent[1].c_str());
+    TEST_ASSERT_TRUE(statsContain("Lines: 4 queued, 2 coalesced"));
+}
+
+// Joined text stops at one packet's payload, 233 bytes
+static void test_coalescing_stops_at_packet_size() {
+    std::string half(116, 'h');
+    queue->push(half.c_str(), half.length());
+    queue->push(half.c_str(), half.length());   // 116 + '\n' + 116 = 233
+    TEST_ASSERT_EQUAL(1, queue->size());
+    queue->push("x", 1);                         // Would make 235
+    TEST_ASSERT_EQUAL(2, queue->size());
+
+    std::string line(60, 'l');
+    for (int i = 0; i < 5; i++) {
+        queue->push(line.c_str(), line.length());
+    }
+    run(5000);
+    TEST_ASSERT_EQUAL(3, sent.size());
+    TEST_ASSERT_EQUAL(OUTBOUND_PACKET_TEXT, sent[0].length());
+    for (const std::string& packet : sent) {
+        TEST_ASSERT_TRUE(packet.length() <= OUTBOUND_PACKET_TEXT);
+    }
+    // "x" took three 60-byte lines (1 + 3 * 61), the last two share the third packet
+    TEST_ASSERT_EQUAL(1 + 3 * 61, sent[1].length());
+    TEST_ASSERT_EQUAL(60 + 61, sent[2].length());
+}
+
+static void test_drops_when_full() {
+    pushSeparate(OUTBOUND_QUEUE_DEPTH, 20);
+    std::string line(20, 'z');
+    TEST_ASSERT_FALSE(queue->push(line.c_str(), line.length()));
+    TEST_ASSERT_EQUAL(OUTBOUND_QUEUE_DEPTH, queue->size());
+    TEST_ASSERT_TRUE(statsContain("Dropped: 1 queue full, 0 waited too long"));
+
+    // Draining makes room again
+    run(5000);
+    TEST_ASSERT_EQUAL(OUTBOUND_QUEUE_DEPTH, sent.size());
+    TEST_ASSERT_TRUE(queue->push(line.c_str(), line.length()));
+}
+
+static void test_drops_stale_lines() {
+    // At UA_868's 0.5% a packet earns its airtime back in over six minutes,
+    // so once the burst is spent the rest of the queue outlives its wait
+    configure(meshtastic_Config_LoRaConfig_RegionCode_UA_868);
+    pushSeparate(OUTBOUND_QUEUE_DEPTH, LINE_BYTES);
+    run(OUTBOUND_MAX_WAIT_MS + 60000);
+    TEST_ASSERT_EQUAL(0, queue->size());
+    TEST_ASSERT_GREATER_THAN(0, sent.size());
+    TEST_ASSERT_LESS_THAN(OUTBOUND_QUEUE_DEPTH, sent.size());
+
+    char expected[64];
+    snprintf(expected, sizeof(expected), "Dropped: 0 queue full, %u waited too long",
+             (unsigned)(OUTBOUND_QUEUE_DEPTH - sent.size()));
+    TEST_ASSERT_TRUE(statsContain(expected));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_airtime_matches_calculator);
+    RUN_TEST(test_region_pacing);
+    RUN_TEST(test_coalescing_window);
+    RUN_TEST(test_coalescing_stops_at_packet_size);
+    RUN_TEST(test_drops_when_full);
+    RUN_TEST(test_drops_stale_lines);
+    return UNITY_END();
+}
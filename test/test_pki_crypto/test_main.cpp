@@ -0,0 +1,225 @@
+#include <unity.h>
+#include <pb_encode.h>
+#include "PkiCrypto.h"
+
+// The host build always takes the portable X25519 and SHA-256
+#ifndef PKI_CRYPTO_SOFTWARE
+#error "native tests expect PKI_CRYPTO_SOFTWARE"
+#endif
+
+#define ALICE 0xA11CE000
+#define BOB   0x00000B0B
+
+// RFC 7748 section 6.1
+static const uint8_t alicePrivate[32] = {
+    0x77, 0x07, 0x6d, 0x0a, 0x73, 0x18, 0xa5, 0x7d, 0x3c, 0x16, 0xc1, 0x72, 0x51, 0xb2, 0x66, 0x45,
+    0xdf, 0x4c, 0x2f, 0x87, 0xeb, 0xc0, 0x99, 0x2a, 0xb1, 0x77, 0xfb, 0xa5, 0x1d, 0xb9, 0x2c, 0x2a
+};
+static const uint8_t alicePublic[32] = {
+    0x85, 0x20, 0xf0, 0x09, 0x89, 0x30, 0xa7, 0x54, 0x74, 0x8b, 0x7d, 0xdc, 0xb4, 0x3e, 0xf7, 0x5a,
+    0x0d, 0xbf, 0x3a, 0x0d, 0x26, 0x38, 0x1a, 0xf4, 0xeb, 0xa4, 0xa9, 0x8e, 0xaa, 0x9b, 0x4e, 0x6a
+};
+static const uint8_t bobPrivate[32] = {
+    0x5d, 0xab, 0x08, 0x7e, 0x62, 0x4a, 0x8a, 0x4b, 0x79, 0xe1, 0x7f, 0x8b, 0x83, 0x80, 0x0e, 0xe6,
+    0x6f, 0x3b, 0xb1, 0x29, 0x26, 0x18, 0xb6, 0xfd, 0x1c, 0x2f, 0x8b, 0x27, 0xff, 0x88, 0xe0, 0xeb
+};
+static const uint8_t bobPublic[32] = {
+    0xde, 0x9e, 0xdb, 0x7d, 0x7b, 0x7d, 0xc1, 0xb4, 0xd3, 0x5b, 0x61, 0xc2, 0xec, 0xe4, 0x35, 0x37,
+    0x3f, 0x83, 0x43, 0xc8, 0x5b, 0x78, 0x67, 0x4d, 0xad, 0xfc, 0x7e, 0x14, 0x6f, 0x88, 0x2b, 0x4f
+};
+static const uint8_t sharedSecret[32] = {
+    0x4a, 0x5d, 0x9d, 0x5b, 0xa4, 0xce, 0x2d, 0xe1, 0x72, 0x8e, 0x3b, 0xf4, 0x80, 0x35, 0x0f, 0x25,
+    0xe0, 0x7e, 0x21, 0xc9, 0x47, 0xd1, 0x9e, 0x33, 0x76, 0xf0, 0x9b, 0x3c, 0x1e, 0x16, 0x17, 0x42
+};
+
+static const uint8_t BASE_POINT[32] = { 9 };
+
+static PkiCrypto* alice;
+static PkiCrypto* bob;
+
+void setUp() {
+    alice = new PkiCrypto();
+    bob = new PkiCrypto();
+    TEST_ASSERT_TRUE(alice->begin(ALICE));
+    TEST_ASSERT_TRUE(bob->begin(BOB));
+    TEST_ASSERT_TRUE(alice->setKeys(alicePrivate, alicePublic));
+    TEST_ASSERT_TRUE(bob->setKeys(bobPrivate, nullptr));
+}
+
+void tearDown() {
+    delete alice;
+    delete bob;
+}
+
+// Tell `to` about `from`'s public key, as a NODEINFO_APP packet would
+static void introduce(PkiCrypto* to, uint32_t from, const uint8_t* publicKey) {
+    meshtastic_User user = meshtastic_User_init_zero;
+    user.public_key.size = 32;
+    memcpy(user.public_key.bytes, publicKey, 32);
+
+    meshtastic_MeshPacket packet = meshtastic_MeshPacket_init_zero;
+    packet.from = from;
+    packet.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    packet.decoded.portnum = meshtastic_PortNum_NODEINFO_APP;
+    pb_ostream_t stream = pb_ostream_from_buffer(packet.decoded.payload.bytes, sizeof(packet.decoded.payload.bytes));
+    TEST_ASSERT_TRUE(pb_encode(&stream, meshtastic_User_fields, &user));
+    packet.decoded.payload.size = stream.bytes_written;
+    TEST_ASSERT_TRUE(to->handleNodeInfo(packet));
+}
+
+static meshtastic_MeshPacket directText(uint32_t to, const char* text) {
+    meshtastic_MeshPacket packet = meshtastic_MeshPacket_init_zero;
+    packet.to = to;
+    packet.id = 0x12345678;
+    packet.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    packet.decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+    packet.decoded.payload.size = strlen(text);
+    memcpy(packet.decoded.payload.bytes, text, packet.decoded.payload.size);
+    return packet;
+}
+
+static void test_rfc7748_vectors() {
+    uint8_t out[32];
+    TEST_ASSERT_TRUE(PkiCrypto::x25519(out, alicePrivate, BASE_POINT));
+    TEST_ASSERT_EQUAL_MEMORY(alicePublic, out, 32);
+    TEST_ASSERT_TRUE(PkiCrypto::x25519(out, bobPrivate, BASE_POINT));
+    TEST_ASSERT_EQUAL_MEMORY(bobPublic, out, 32);
+    TEST_ASSERT_TRUE(PkiCrypto::x25519(out, alicePrivate, bobPublic));
+    TEST_ASSERT_EQUAL_MEMORY(sharedSecret, out, 32);
+    TEST_ASSERT_TRUE(PkiCrypto::x25519(out, bobPrivate, alicePublic));
+    TEST_ASSERT_EQUAL_MEMORY(sharedSecret, out, 32);
+
+    // Section 5.2, first test vector
+    static const uint8_t scalar[32] = {
+        0xa5, 0x46, 0xe3, 0x6b, 0xf0, 0x52, 0x7c, 0x9d, 0x3b, 0x16, 0x15, 0x4b, 0x82, 0x46, 0x5e, 0xdd,
+        0x62, 0x14, 0x4c, 0x0a, 0xc1, 0xfc, 0x5a, 0x18, 0x50, 0x6a, 0x22, 0x44, 0xba, 0x44, 0x9a, 0xc4
+    };
+    static const uint8_t u[32] = {
+        0xe6, 0xdb, 0x68, 0x67, 0x58, 0x30, 0x30, 0xdb, 0x35, 0x94, 0xc1, 0xa4, 0x24, 0xb1, 0x5f, 0x7c,
+        0x72, 0x66, 0x24, 0xec, 0x26, 0xb3, 0x35, 0x3b, 0x10, 0xa9, 0x03, 0xa6, 0xd0, 0xab, 0x1c, 0x4c
+    };
+    static const uint8_t expected[32] = {
+        0xc3, 0xda, 0x55, 0x37, 0x9d, 0xe9, 0xc6, 0x90, 0x8e, 0x94, 0xea, 0x4d, 0xf2, 0x8d, 0x08, 0x4f,
+        0x32, 0xec, 0xcf, 0x03, 0x49, 0x1c, 0x71, 0xf7, 0x54, 0xb4, 0x07, 0x55, 0x77, 0xa2, 0x85, 0x52
+    };
+    TEST_ASSERT_TRUE(PkiCrypto::x25519(out, scalar, u));
+    TEST_ASSERT_EQUAL_MEMORY(expected, out, 32);
+}
+
+static void test_sha256_of_secret() {
+    // SHA-256 of 32 zero bytes
+    static const uint8_t zeros[32] = {};
+    static const uint8_t expected[32] = {
+        0x66, 0x68, 0x7a, 0xad, 0xf8, 0x62, 0xbd, 0x77, 0x6c, 0x8f, 0xc1, 0x8b, 0x8e, 0x9f, 0x8e, 0x20,
+        0x08, 0x97, 0x14, 0x85, 0x6e, 0xe2, 0x33, 0xb3, 0x90, 0x2a, 0x59, 0x1d, 0x0d, 0x5f, 0x29, 0x25
+    };
+    uint8_t out[32];
+    PkiCrypto::sha256Key(zeros, out);
+    TEST_ASSERT_EQUAL_MEMORY(expected, out, 32);
+}
+
+static void test_ccm_vector() {
+    // AES-256-CCM, key 40..5f, nonce 10..1c, plaintext 20..34, 8-byte tag
+    static const uint8_t cipher[21] = {
+        0x40, 0x52, 0x7d, 0xbf, 0x45, 0x71, 0x97, 0xdc, 0xf6, 0xb4, 0x7b, 0x20, 0xe9, 0x74, 0xd1, 0x74,
+        0x1c, 0x6a, 0xd6, 0x94, 0x8f
+    };
+    static const uint8_t expectedTag[PKI_TAG_SIZE] = { 0x5d, 0xb5, 0x5f, 0xe4, 0x34, 0x92, 0x67, 0x41 };
+
+    uint8_t key[32], nonce[13], data[21], tag[PKI_TAG_SIZE];
+    for (int i = 0; i < 32; i++) key[i] = 0x40 + i;
+    for (int i = 0; i < 13; i++) nonce[i] = 0x10 + i;
+    for (int i = 0; i < 21; i++) data[i] = 0x20 + i;
+    ChannelKey aes;
+    ChannelCrypto::setKey(aes, key, sizeof(key));
+
+    PkiCrypto::ccmEncrypt(aes, nonce, data, sizeof(data), tag);
+    TEST_ASSERT_EQUAL_MEMORY(cipher, data, sizeof(data));
+    TEST_ASSERT_EQUAL_MEMORY(expectedTag, tag, sizeof(tag));
+
+    // A corrupted tag is rejected and the ciphertext is left as it was
+    tag[0] ^= 1;
+    TEST_ASSERT_FALSE(PkiCrypto::ccmDecrypt(aes, nonce, data, sizeof(data), tag));
+    TEST_ASSERT_EQUAL_MEMORY(cipher, data, sizeof(data));
+
+    tag[0] ^= 1;
+    TEST_ASSERT_TRUE(PkiCrypto::ccmDecrypt(aes, nonce, data, sizeof(data), tag));
+    for (int i = 0; i < 21; i++) {
+        TEST_ASSERT_EQUAL_HEX8(0x20 + i, data[i]);
+    }
+}
+
+static void test_direct_message_round_trip() {
+    introduce(alice, BOB, bobPublic);
+    introduce(bob, ALICE, alicePublic);
+
+    meshtastic_MeshPacket packet = directText(BOB, "just for bob");
+    TEST_ASSERT_TRUE(alice->encrypt(packet));
+    TEST_ASSERT_EQUAL(meshtastic_MeshPacket_encrypted_tag, packet.which_payload_variant);
+    TEST_ASSERT_EQUAL(ALICE, packet.from);
+    TEST_ASSERT_EQUAL(0, packet.channel);
+
+    meshtastic_MeshPacket tampered = packet;
+    tampered.encrypted.bytes[0] ^= 0x80;
+    TEST_ASSERT_FALSE(bob->decrypt(tampered));
+    TEST_ASSERT_EQUAL(meshtastic_MeshPacket_encrypted_tag, tampered.which_payload_variant);
+    tampered.encrypted.bytes[0] ^= 0x80;   // The ciphertext was put back
+    TEST_ASSERT_EQUAL_MEMORY(packet.encrypted.bytes, tampered.encrypted.bytes, packet.encrypted.size);
+
+    TEST_ASSERT_TRUE(bob->decrypt(packet));
+    TEST_ASSERT_EQUAL(meshtastic_MeshPacket_decoded_tag, packet.which_payload_variant);
+    TEST_ASSERT_TRUE(packet.pki_encrypted);
+    TEST_ASSERT_EQUAL_MEMORY(alicePublic, packet.public_key.bytes, 32);
+    TEST_ASSERT_EQUAL(12, packet.decoded.payload.size);
+    TEST_ASSERT_EQUAL_MEMORY("just for bob", packet.decoded.payload.bytes, 12);
+}
+
+static void test_unknown_peer_and_relay_ports() {
+    // No key for Bob yet: the message goes out on a channel
+    meshtastic_MeshPacket packet = directText(BOB, "hello");
+    TEST_ASSERT_FALSE(alice->encrypt(packet));
+    TEST_ASSERT_EQUAL(meshtastic_MeshPacket_decoded_tag, packet.which_payload_variant);
+
+    // Positions stay readable by relays even to a known peer
+    introduce(alice, BOB, bobPublic);
+    packet.decoded.portnum = meshtastic_PortNum_POSITION_APP;
+    TEST_ASSERT_FALSE(alice->encrypt(packet));
+
+    // A low-order public key is refused
+    static const uint8_t lowOrder[32] = {};
+    introduce(alice, 0x0BAD, lowOrder);
+    packet = directText(0x0BAD, "hello");
+    TEST_ASSERT_FALSE(alice->encrypt(packet));
+}
+
+static void test_derive_and_message_cost() {
+    ChannelKey key;
+    unsigned long start = micros();
+    TEST_ASSERT_TRUE(PkiCrypto::derive(alicePrivate, bobPublic, key));
+    unsigned long deriveMicros = micros() - start;
+
+    static uint8_t buffer[sizeof(meshtastic_MeshPacket_encrypted_t::bytes) - PKI_OVERHEAD];
+    uint8_t nonce[13] = {}, tag[PKI_TAG_SIZE];
+    const int messages = 1000;
+    start = micros();
+    for (int i = 0; i < messages; i++) {
+        PkiCrypto::ccmEncrypt(key, nonce, buffer, sizeof(buffer), tag);
+    }
+    double messageMicros = (double)(micros() - start) / messages;
+
+    char message[96];
+    snprintf(message, sizeof(message), "key derivation %lu us, %u byte message %.2f us with a cached key",
+             deriveMicros, (unsigned)sizeof(buffer), messageMicros);
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_rfc7748_vectors);
+    RUN_TEST(test_sha256_of_secret);
+    RUN_TEST(test_ccm_vector);
+    RUN_TEST(test_direct_message_round_trip);
+    RUN_TEST(test_unknown_peer_and_relay_ports);
+    RUN_TEST(test_derive_and_message_cost);
+    return UNITY_END();
+}
@@ -0,0 +1,237 @@
+#include <unity.h>
+#include <math.h>
+#include <pb_encode.h>
+#include <vector>
+#include <algorithm>
+#include "PositionStore.h"
+
+#define SYNTHETIC_NODES  2000
+#define QUERIES          1000
+#define NEAREST_COUNT    8
+#define WITHIN_KM        10.0f
+
+static PositionStore* store;
+static uint32_t seed;
+
+struct Node {
+    uint32_t node;
+    int32_t latitude_i;
+    int32_t longitude_i;
+};
+static std::vector<Node> nodes;
+
+void setUp() {
+    store = new PositionStore();
+    nodes.clear();
+    seed = 1;
+}
+
+void tearDown() {
+    delete store;
+}
+
+static uint32_t nextRandom() {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+// Uniform in [-1, 1)
+static float spread() {
+    return (nextRandom() % 20001) / 10000.0f - 1.0f;
+}
+
+static meshtastic_MeshPacket positionPacket(uint32_t from, int32_t latitude_i, int32_t longitude_i) {
+    meshtastic_Position position = meshtastic_Position_init_zero;
+    position.has_latitude_i = position.has_longitude_i = true;
+    position.latitude_i = latitude_i;
+    position.longitude_i = longitude_i;
+    position.has_altitude = true;
+    position.altitude = 420;
+
+    meshtastic_MeshPacket packet = meshtastic_MeshPacket_init_zero;
+    packet.from = from;
+    packet.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    packet.decoded.portnum = meshtastic_PortNum_POSITION_APP;
+    pb_ostream_t stream = pb_ostream_from_buffer(packet.decoded.payload.bytes, sizeof(packet.decoded.payload.bytes));
+    pb_encode(&stream, meshtastic_Position_fields, &position);
+    packet.decoded.payload.size = stream.bytes_written;
+    return packet;
+}
+
+static void addNode(uint32_t node, int32_t latitude_i, int32_t longitude_i) {
+    TEST_ASSERT_TRUE(store->handlePacket(positionPacket(node, latitude_i, longitude_i)));
+    store->update();
+    nodes.push_back({ node, latitude_i, longitude_i });
+}
+
+// Towns of a few dozen nodes each, around the meridian and the equator
+// so cells on both sides of zero are used, plus a few far away
+static void addSyntheticNodes(size_t count) {
+    const float centers[][2] = { { 51.50f, -0.12f }, { 51.75f, -1.25f }, { 52.20f, 0.12f },
+                                 { 0.05f, 32.58f }, { -33.87f, 151.21f }, { 47.37f, 8.54f } };
+    for (uint32_t i = 0; i < count; i++) {
+        float latitude;
+        float longitude;
+        if (i % 50 == 49) {
+            latitude = spread() * 80;
+            longitude = spread() * 179;
+        } else {
+            const float* center = centers[nextRandom() % 6];
+            // Most within a town, some out in the countryside
+            float radius = nextRandom() % 4 == 0 ? 1.0f : 0.1f;
+            latitude = center[0] + spread() * radius;
+            longitude = center[1] + spread() * radius;
+        }
+        addNode(0x10000 + i, lroundf(latitude * 1e7f), lroundf(longitude * 1e7f));
+    }
+}
+
+// Same approximation as the store, over every node
+static float distanceKm(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2) {
+    const float toRadians = PI / 180.0f / 1e7f;
+    float meanLat = ((float)lat1 + (float)lat2) / 2 * toRadians;
+    float x = ((float)lon2 - (float)lon1) * toRadians * cosf(meanLat);
+    float y = ((float)lat2 - (float)lat1) * toRadians;
+    return 6371.0f * sqrtf(x * x + y * y);
+}
+
+static std::vector<float> bruteForce(int32_t latitude_i, int32_t longitude_i, float limitKm) {
+    std::vector<float> distances;
+    for (const Node& node : nodes) {
+        float distance = distanceKm(latitude_i, longitude_i, node.latitude_i, node.longitude_i);
+        if (distance <= limitKm) {
+            distances.push_back(distance);
+        }
+    }
+    std::sort(distances.begin(), distances.end());
+    return distances;
+}
+
+// A query point next to a random node, so most queries land in a town
+static void queryPoint(int32_t* latitude_i, int32_t* longitude_i) {
+    const Node& node = nodes[nextRandom() % nodes.size()];
+    *latitude_i = node.latitude_i + spread() * 200000;
+    *longitude_i = node.longitude_i + spread() * 200000;
+}
+
+static void test_stores_latest_position() {
+    addNode(0x1234, 515000000, -1200000);
+    addNode(0x1234, 515100000, -1300000);
+    TEST_ASSERT_EQUAL(1, store->size());
+    const PositionRecord* record = store->getPosition(0x1234);
+    TEST_ASSERT_NOT_NULL(record);
+    TEST_ASSERT_EQUAL(515100000, record->latitude_i);
+    TEST_ASSERT_EQUAL(-1300000, record->longitude_i);
+    TEST_ASSERT_EQUAL(420, record->altitude);
+
+    // No fix
+    TEST_ASSERT_FALSE(store->handlePacket(positionPacket(0x5678, 0, 0)));
+    TEST_ASSERT_NULL(store->getPosition(0x5678));
+}
+
+static void test_phone_position_stored_for_device() {
+    // The app's packet comes from the phone, not from a mesh node
+    TEST_ASSERT_TRUE(store->handlePacket(positionPacket(0, 473700000, 85400000), 0xDEADBEEF));
+    store->update();
+    TEST_ASSERT_NULL(store->getPosition(0));
+    TEST_ASSERT_NOT_NULL(store->getPosition(0xDEADBEEF));
+}
+
+static void test_least_recent_node_evicted() {
+    for (uint32_t node = 1; node <= POSITION_MAX_NODES + 1; node++) {
+        addNode(node, 100000 * node, 200000);
+        hostAdvanceMillis(1000);
+    }
+    TEST_ASSERT_EQUAL(POSITION_MAX_NODES, store->size());
+    TEST_ASSERT_NULL(store->getPosition(1));
+    TEST_ASSERT_NOT_NULL(store->getPosition(POSITION_MAX_NODES + 1));
+
+    PositionResult result;
+    TEST_ASSERT_EQUAL(1, store->nearest(100000 * (POSITION_MAX_NODES + 1), 200000, &result, 1));
+    TEST_ASSERT_EQUAL(POSITION_MAX_NODES + 1, result.node);
+}
+
+static void test_queries_match_brute_force() {
+    addSyntheticNodes(SYNTHETIC_NODES);
+    TEST_ASSERT_EQUAL(SYNTHETIC_NODES, store->size());
+
+    static PositionResult results[SYNTHETIC_NODES];
+    for (int i = 0; i < 200; i++) {
+        int32_t latitude_i;
+        int32_t longitude_i;
+        queryPoint(&latitude_i, &longitude_i);
+
+        std::vector<float> expected = bruteForce(latitude_i, longitude_i, INFINITY);
+        size_t found = store->nearest(latitude_i, longitude_i, results, NEAREST_COUNT);
+        TEST_ASSERT_EQUAL(NEAREST_COUNT, found);
+        for (size_t r = 0; r < found; r++) {
+            TEST_ASSERT_EQUAL_FLOAT(expected[r], results[r].distanceKm);
+        }
+
+        float radius = (i % 4 + 1) * WITHIN_KM / 2;
+        expected = bruteForce(latitude_i, longitude_i, radius);
+        found = store->within(latitude_i, longitude_i, radius, results, SYNTHETIC_NODES);
+        TEST_ASSERT_EQUAL(expected.size(), found);
+        for (size_t r = 0; r < found; r++) {
+            TEST_ASSERT_EQUAL_FLOAT(expected[r], results[r].distanceKm);
+        }
+    }
+
+    // Far from every node: the rings give up and a full scan answers
+    std::vector<float> expected = bruteForce(-850000000, 0, INFINITY);
+    TEST_ASSERT_EQUAL(NEAREST_COUNT, store->nearest(-850000000, 0, results, NEAREST_COUNT));
+    TEST_ASSERT_EQUAL_FLOAT(expected[0], results[0].distanceKm);
+}
+
+static void test_query_time_against_full_scan() {
+    addSyntheticNodes(SYNTHETIC_NODES);
+    static int32_t points[QUERIES][2];
+    for (int i = 0; i < QUERIES; i++) {
+        queryPoint(&points[i][0], &points[i][1]);
+    }
+
+    PositionResult results[NEAREST_COUNT];
+    size_t found = 0;
+    unsigned long start = micros();
+    for (int i = 0; i < QUERIES; i++) {
+        found += store->nearest(points[i][0], points[i][1], results, NEAREST_COUNT);
+    }
+    unsigned long nearestMicros = micros() - start;
+
+    start = micros();
+    for (int i = 0; i < QUERIES; i++) {
+        found += store->within(points[i][0], points[i][1], WITHIN_KM, results, NEAREST_COUNT);
+    }
+    unsigned long withinMicros = micros() - start;
+
+    // The least an unindexed store would do: a distance to every node
+    start = micros();
+    for (int i = 0; i < QUERIES; i++) {
+        float closest = INFINITY;
+        for (const Node& node : nodes) {
+            closest = min(closest, distanceKm(points[i][0], points[i][1], node.latitude_i, node.longitude_i));
+        }
+        found += closest < INFINITY;
+    }
+    unsigned long scanMicros = max(micros() - start, 1UL);
+    TEST_ASSERT_GREATER_THAN(0, found);
+
+    char message[160];
+    snprintf(message, sizeof(message),
+             "%d nodes: nearest %d %.1f us, within %.0f km %.1f us, full scan %.1f us per query (%u bytes)",
+             SYNTHETIC_NODES, NEAREST_COUNT, (double)nearestMicros / QUERIES, WITHIN_KM,
+             (double)withinMicros / QUERIES, (double)scanMicros / QUERIES, (unsigned)(SYNTHETIC_NODES * sizeof(PositionRecord)));
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_THAN(scanMicros, nearestMicros);
+    TEST_ASSERT_LESS_THAN(scanMicros, withinMicros);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_stores_latest_position);
+    RUN_TEST(test_phone_position_stored_for_device);
+    RUN_TEST(test_least_recent_node_evicted);
+    RUN_TEST(test_queries_match_brute_force);
+    RUN_TEST(test_query_time_against_full_scan);
+    return UNITY_END();
+}
@@ -0,0 +1,170 @@
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "SerialStream.h"
+
+static HardwareSerial* port;
+static SerialStream* stream;
+static std::vector<std::string> frames;
+static std::vector<std::string> lines;
+
+void setUp() {
+    port = new HardwareSerial();
+    stream = new SerialStream(*port);
+    frames.clear();
+    lines.clear();
+    stream->onFrame([](const uint8_t* data, size_t length) { frames.push_back(std::string((const char*)data, length)); });
+    stream->onLine([](const String& line) { lines.push_back(line.c_str()); });
+}
+
+void tearDown() {
+    delete stream;
+    delete port;
+}
+
+static std::string framed(const std::string& payload) {
+    std::string out;
+    out += (char)STREAM_START1;
+    out += (char)STREAM_START2;
+    out += (char)(payload.size() >> 8);
+    out += (char)(payload.size() & 0xFF);
+    return out + payload;
+}
+
+static void arrive(const std::string& bytes) {
+    port->inject((const uint8_t*)bytes.data(), bytes.size());
+    stream->update();
+}
+
+static void test_frames_and_console_lines() {
+    TEST_ASSERT_FALSE(stream->isActive());
+    arrive("hello\n" + framed("first") + "/stats\r\n" + framed(std::string(300, 'x')));
+
+    TEST_ASSERT_EQUAL(2, frames.size());
+    TEST_ASSERT_EQUAL_STRING("first", frames[0].c_str());
+    TEST_ASSERT_EQUAL(300, frames[1].size());
+    TEST_ASSERT_EQUAL(2, lines.size());
+    TEST_ASSERT_EQUAL_STRING("hello", lines[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("/stats", lines[1].c_str());
+    TEST_ASSERT_TRUE(stream->isActive());
+}
+
+static void test_frame_split_across_reads() {
+    std::string bytes = framed(std::string(200, 'y'));
+    for (char c : bytes) {
+        arrive(std::string(1, c));
+    }
+    TEST_ASSERT_EQUAL(1, frames.size());
+    TEST_ASSERT_EQUAL(200, frames[0].size());
+    TEST_ASSERT_EQUAL(0, lines.size());
+}
+
+static void test_resync_after_noise() {
+    // A header with an impossible length, then START1 without START2
+    std::string noise = "\x94\xc3\xff\xff";
+    noise += "\x94x\n";
+    arrive(noise + framed("after noise"));
+
+    TEST_ASSERT_EQUAL(1, frames.size());
+    TEST_ASSERT_EQUAL_STRING("after noise", frames[0].c_str());
+    // The lone START1 and what followed it were console text
+    TEST_ASSERT_EQUAL(1, lines.size());
+    TEST_ASSERT_EQUAL_STRING("\x94x", lines[0].c_str());
+
+    // Zero length is noise too
+    arrive(std::string("\x94\xc3\x00\x00", 4) + framed("again"));
+    TEST_ASSERT_EQUAL(2, frames.size());
+    TEST_ASSERT_EQUAL_STRING("again", frames[1].c_str());
+}
+
+static void test_cut_off_frame_times_out() {
+    std::string partial = framed(std::string(100, 'z')).substr(0, 40);
+    arrive(partial);
+    TEST_ASSERT_EQUAL(0, frames.size());
+
+    // Within the timeout the rest still completes the frame
+    hostAdvanceMillis(STREAM_FRAME_TIMEOUT_MS - 10);
+    arrive(framed(std::string(100, 'z')).substr(40));
+    TEST_ASSERT_EQUAL(1, frames.size());
+
+    // Past it, the next frame is not swallowed as payload of the old one
+    arrive(partial);
+    hostAdvanceMillis(STREAM_FRAME_TIMEOUT_MS + 1);
+    arrive(framed("fresh") + "ok\n");
+    TEST_ASSERT_EQUAL(2, frames.size());
+    TEST_ASSERT_EQUAL_STRING("fresh", frames[1].c_str());
+    TEST_ASSERT_EQUAL(1, lines.size());
+    TEST_ASSERT_EQUAL_STRING("ok", lines[0].c_str());
+}
+
+static void test_long_line_truncated() {
+    arrive(std::string(STREAM_LINE_MAX + 50, 'a') + "\nnext\n");
+    TEST_ASSERT_EQUAL(2, lines.size());
+    TEST_ASSERT_EQUAL(STREAM_LINE_MAX, lines[0].size());
+    TEST_ASSERT_EQUAL_STRING("next", lines[1].c_str());
+}
+
+static void test_send_writes_one_frame() {
+    const uint8_t payload[] = { 1, 2, 3 };
+    TEST_ASSERT_TRUE(stream->send(payload, sizeof(payload)));
+    std::string expected = framed(std::string((const char*)payload, sizeof(payload)));
+    TEST_ASSERT_EQUAL(expected.size(), port->output().size());
+    TEST_ASSERT_EQUAL_MEMORY(expected.data(), port->output().data(), expected.size());
+
+    static uint8_t tooLong[STREAM_MAX_FRAME + 1];
+    TEST_ASSERT_FALSE(stream->send(tooLong, sizeof(tooLong)));
+    TEST_ASSERT_FALSE(stream->send(payload, 0));
+}
+
+static void test_parser_throughput() {
+    // Frames of typical ToRadio sizes, with a console line every eighth
+    std::string sample;
+    size_t sampleFrames = 0;
+    size_t sampleLines = 0;
+    uint32_t seed = 1;
+    while (sample.size() < 4096) {
+        seed = seed * 1103515245 + 12345;
+        uint16_t payload = 20 + (seed >> 16) % 220;
+        std::string bytes(payload, 0);
+        for (uint16_t i = 0; i < payload; i++) {
+            bytes[i] = (seed >> (i % 24)) & 0xFF;
+        }
+        sample += framed(bytes);
+        if (++sampleFrames % 8 == 0) {
+            sample += "/stats\n";
+            sampleLines++;
+        }
+    }
+
+    size_t frameCount = 0;
+    size_t lineCount = 0;
+    stream->onFrame([&](const uint8_t*, size_t) { frameCount++; });
+    stream->onLine([&](const String&) { lineCount++; });
+
+    const size_t rounds = 1024 * 1024 / sample.size();
+    unsigned long start = micros();
+    for (size_t r = 0; r < rounds; r++) {
+        stream->feed((const uint8_t*)sample.data(), sample.size());
+    }
+    unsigned long elapsed = max(micros() - start, 1UL);
+    TEST_ASSERT_EQUAL(rounds * sampleFrames, frameCount);
+    TEST_ASSERT_EQUAL(rounds * sampleLines, lineCount);
+
+    double bytesPerSecond = (double)rounds * sample.size() * 1e6 / elapsed;
+    char message[96];
+    snprintf(message, sizeof(message), "%.2f MB/s, %.0fx the %d baud link",
+             bytesPerSecond / 1e6, bytesPerSecond / (STREAM_BAUD / 10.0), STREAM_BAUD);
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_frames_and_console_lines);
+    RUN_TEST(test_frame_split_across_reads);
+    RUN_TEST(test_resync_after_noise);
+    RUN_TEST(test_cut_off_frame_times_out);
+    RUN_TEST(test_long_line_truncated);
+    RUN_TEST(test_send_writes_one_frame);
+    RUN_TEST(test_parser_throughput);
+    return UNITY_END();
+}
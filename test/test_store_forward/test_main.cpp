@@ -0,0 +1,251 @@
+#include <unity.h>
+#include <algorithm>
+#include <deque>
+#include "StoreForward.h"
+#include "MessageHandler.h"
+
+#define CLIENT 0x1234ABCD
+#define SENDER 0x00C0FFEE
+#define EPOCH  1700000000
+
+struct Sent {
+    uint32_t to;
+    meshtastic_Data data;
+};
+
+static std::deque<Sent> sent;
+static StoreForward* sf;
+static uint32_t packetId;
+
+static void boot() {
+    delete sf;
+    sf = new StoreForward();
+    sf->onSend([](uint32_t to, const meshtastic_Data& data) { sent.push_back({ to, data }); });
+    TEST_ASSERT_TRUE(sf->begin());
+}
+
+void setUp() {
+    hostFlash.wipe();
+    sent.clear();
+    packetId = 1;
+    sf = nullptr;
+    boot();
+}
+
+void tearDown() {
+    delete sf;
+    sf = nullptr;
+}
+
+static void record(meshtastic_PortNum port, uint32_t to, const char* text, uint32_t rxTime = EPOCH) {
+    meshtastic_MeshPacket packet = meshtastic_MeshPacket_init_zero;
+    packet.from = SENDER;
+    packet.to = to;
+    packet.id = packetId++;
+    packet.rx_time = rxTime;
+    packet.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    packet.decoded.portnum = port;
+    packet.decoded.payload.size = strlen(text);
+    memcpy(packet.decoded.payload.bytes, text, packet.decoded.payload.size);
+    sf->recordPacket(packet);
+}
+
+// Record `count` broadcasts, one second apart, flushing the pending queue as loop() would
+static void fill(uint32_t count, const char* text) {
+    for (uint32_t i = 0; i < count; i++) {
+        record(meshtastic_PortNum_TEXT_MESSAGE_APP, BROADCAST_ADDR, text, EPOCH + i);
+        if (i % (SF_PENDING_DEPTH / 2) == 0) {
+            sf->update();
+        }
+    }
+    sf->update();
+}
+
+static void request(meshtastic_StoreAndForward_RequestResponse rr, uint32_t lastRequest = 0) {
+    meshtastic_StoreAndForward message = meshtastic_StoreAndForward_init_zero;
+    message.rr = rr;
+    if (rr == meshtastic_StoreAndForward_RequestResponse_CLIENT_HISTORY) {
+        message.which_variant = meshtastic_StoreAndForward_history_tag;
+        message.variant.history.last_request = lastRequest;
+    }
+
+    meshtastic_MeshPacket packet = meshtastic_MeshPacket_init_zero;
+    packet.from = CLIENT;
+    packet.to = 0x11111111;
+    packet.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    packet.decoded.portnum = meshtastic_PortNum_STORE_FORWARD_APP;
+    pb_ostream_t stream = pb_ostream_from_buffer(packet.decoded.payload.bytes, sizeof(packet.decoded.payload.bytes));
+    TEST_ASSERT_TRUE(pb_encode(&stream, meshtastic_StoreAndForward_fields, &message));
+    packet.decoded.payload.size = stream.bytes_written;
+    TEST_ASSERT_TRUE(sf->handlePacket(packet));
+    sent.clear();
+    sf->update();
+    // Only answers to the client; a first update() after boot also sends a heartbeat
+    sent.erase(std::remove_if(sent.begin(), sent.end(), [](const Sent& reply) { return reply.to == BROADCAST_ADDR; }),
+               sent.end());
+}
+
+static meshtastic_StoreAndForward decodeResponse(const Sent& reply) {
+    TEST_ASSERT_EQUAL(meshtastic_PortNum_STORE_FORWARD_APP, reply.data.portnum);
+    meshtastic_StoreAndForward message = meshtastic_StoreAndForward_init_zero;
+    pb_istream_t stream = pb_istream_from_buffer(reply.data.payload.bytes, reply.data.payload.size);
+    TEST_ASSERT_TRUE(pb_decode(&stream, meshtastic_StoreAndForward_fields, &message));
+    return message;
+}
+
+// The ROUTER_HISTORY answer to the request just made
+static meshtastic_StoreAndForward_History historyResponse() {
+    TEST_ASSERT_FALSE(sent.empty());
+    meshtastic_StoreAndForward message = decodeResponse(sent.front());
+    sent.pop_front();
+    TEST_ASSERT_EQUAL(meshtastic_StoreAndForward_RequestResponse_ROUTER_HISTORY, message.rr);
+    return message.variant.history;
+}
+
+static uint32_t savedMessages() {
+    request(meshtastic_StoreAndForward_RequestResponse_CLIENT_STATS);
+    TEST_ASSERT_EQUAL(1, sent.size());
+    meshtastic_StoreAndForward message = decodeResponse(sent.front());
+    sent.clear();
+    TEST_ASSERT_EQUAL(meshtastic_StoreAndForward_RequestResponse_ROUTER_STATS, message.rr);
+    return message.variant.stats.messages_saved;
+}
+
+// Let the paced replay run to the end; returns the packets it sent the client
+static uint32_t drainReplay() {
+    sent.clear();
+    uint32_t packets = 0;
+    for (int i = 0; i < SF_RETURN_MAX + 1; i++) {
+        hostAdvanceMillis(SF_REPLAY_INTERVAL_MS);
+        sf->update();
+        for (const Sent& reply : sent) {
+            packets += reply.to == CLIENT;   // Not heartbeats
+        }
+        sent.clear();
+    }
+    return packets;
+}
+
+static void test_last_request_zero_gets_whole_window() {
+    fill(5, "hello");
+    request(meshtastic_StoreAndForward_RequestResponse_CLIENT_HISTORY, 0);
+    meshtastic_StoreAndForward_History history = historyResponse();
+    TEST_ASSERT_EQUAL(5, history.history_messages);
+    TEST_ASSERT_EQUAL(5, history.last_request);
+    TEST_ASSERT_EQUAL(5, drainReplay());
+}
+
+static void test_continues_after_last_request() {
+    fill(SF_RETURN_MAX + 50, "hello");
+    request(meshtastic_StoreAndForward_RequestResponse_CLIENT_HISTORY, 0);
+    meshtastic_StoreAndForward_History history = historyResponse();
+    TEST_ASSERT_EQUAL(SF_RETURN_MAX, history.history_messages);
+    TEST_ASSERT_EQUAL(SF_RETURN_MAX, history.last_request);
+    TEST_ASSERT_EQUAL(SF_RETURN_MAX, drainReplay());
+
+    request(meshtastic_StoreAndForward_RequestResponse_CLIENT_HISTORY, history.last_request);
+    history = historyResponse();
+    TEST_ASSERT_EQUAL(50, history.history_messages);
+    TEST_ASSERT_EQUAL(SF_RETURN_MAX + 50, history.last_request);
+    TEST_ASSERT_EQUAL(50, drainReplay());
+
+    // Nothing new: nothing replayed
+    request(meshtastic_StoreAndForward_RequestResponse_CLIENT_HISTORY, history.last_request);
+    TEST_ASSERT_EQUAL(0, historyResponse().history_messages);
+}
+
+static void test_compressed_text_replayed_on_its_port() {
+    record(meshtastic_PortNum_TEXT_MESSAGE_APP, BROADCAST_ADDR, "plain");
+    record(meshtastic_PortNum_TEXT_MESSAGE_COMPRESSED_APP, BROADCAST_ADDR, "\x8a\x01unishox");
+    record(TEXT_COMPRESSED_PORT, CLIENT, "\x02\xffpacked");
+    record(meshtastic_PortNum_POSITION_APP, BROADCAST_ADDR, "not text");
+    sf->update();
+
+    request(meshtastic_StoreAndForward_RequestResponse_CLIENT_HISTORY, 0);
+    TEST_ASSERT_EQUAL(3, historyResponse().history_messages);
+
+    hostAdvanceMillis(SF_REPLAY_INTERVAL_MS);
+    sf->update();
+    TEST_ASSERT_EQUAL(1, sent.size());
+    meshtastic_StoreAndForward text = decodeResponse(sent.front());
+    TEST_ASSERT_EQUAL(meshtastic_StoreAndForward_RequestResponse_ROUTER_TEXT_BROADCAST, text.rr);
+    TEST_ASSERT_EQUAL(5, text.variant.text.size);
+    TEST_ASSERT_EQUAL_MEMORY("plain", text.variant.text.bytes, 5);
+    sent.clear();
+
+    hostAdvanceMillis(SF_REPLAY_INTERVAL_MS);
+    sf->update();
+    TEST_ASSERT_EQUAL(1, sent.size());
+    TEST_ASSERT_EQUAL(meshtastic_PortNum_TEXT_MESSAGE_COMPRESSED_APP, sent.front().data.portnum);
+    TEST_ASSERT_EQUAL(9, sent.front().data.payload.size);
+    TEST_ASSERT_EQUAL_MEMORY("\x8a\x01unishox", sent.front().data.payload.bytes, 9);
+    sent.clear();
+
+    hostAdvanceMillis(SF_REPLAY_INTERVAL_MS);
+    sf->update();
+    TEST_ASSERT_EQUAL(1, sent.size());
+    TEST_ASSERT_EQUAL(CLIENT, sent.front().to);
+    TEST_ASSERT_EQUAL(TEXT_COMPRESSED_PORT, sent.front().data.portnum);
+    TEST_ASSERT_EQUAL_MEMORY("\x02\xffpacked", sent.front().data.payload.bytes, 8);
+}
+
+static void test_index_rebuilt_after_reboot() {
+    fill(300, "hello");
+    TEST_ASSERT_EQUAL(300, savedMessages());
+
+    boot();
+    TEST_ASSERT_EQUAL(300, savedMessages());
+    request(meshtastic_StoreAndForward_RequestResponse_CLIENT_HISTORY, 250);
+    TEST_ASSERT_EQUAL(50, historyResponse().history_messages);
+}
+
+static void test_ring_wraps() {
+    // 60-byte texts fill the ring before the index
+    const char* text = "sixty bytes of text sixty bytes of text sixty bytes of text.";
+    fill(6000, text);
+    TEST_ASSERT_GREATER_THAN(SF_FLASH_SECTORS, hostFlash.sectorErases);
+
+    uint32_t saved = savedMessages();
+    TEST_ASSERT_LESS_THAN(6000, saved);
+    TEST_ASSERT_GREATER_THAN(4500, saved);
+
+    // The oldest messages are gone; a stale last_request gets the window from the start
+    request(meshtastic_StoreAndForward_RequestResponse_CLIENT_HISTORY, 10);
+    meshtastic_StoreAndForward_History history = historyResponse();
+    TEST_ASSERT_EQUAL(SF_RETURN_MAX, history.history_messages);
+    TEST_ASSERT_EQUAL(6000 - saved + SF_RETURN_MAX, history.last_request);
+
+    boot();
+    TEST_ASSERT_EQUAL(saved, savedMessages());
+}
+
+static void test_history_query_time() {
+    // Short texts so the index, not the ring, is the limit
+    fill(SF_MAX_MESSAGES + 100, "hi");
+    TEST_ASSERT_EQUAL(SF_MAX_MESSAGES, savedMessages());
+
+    const int iterations = 1000;
+    unsigned long start = micros();
+    for (int i = 0; i < iterations; i++) {
+        request(meshtastic_StoreAndForward_RequestResponse_CLIENT_HISTORY, (i * 37) % (SF_MAX_MESSAGES + 100));
+    }
+    unsigned long elapsed = micros() - start;
+    TEST_ASSERT_EQUAL(1, sent.size());
+
+    char message[96];
+    snprintf(message, sizeof(message), "%d history requests over %d messages: %.2f us each",
+             iterations, SF_MAX_MESSAGES, (double)elapsed / iterations);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_THAN(1000, elapsed / iterations);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_last_request_zero_gets_whole_window);
+    RUN_TEST(test_continues_after_last_request);
+    RUN_TEST(test_compressed_text_replayed_on_its_port);
+    RUN_TEST(test_index_rebuilt_after_reboot);
+    RUN_TEST(test_ring_wraps);
+    RUN_TEST(test_history_query_time);
+    return UNITY_END();
+}
@@ -0,0 +1,165 @@
+#include <unity.h>
+#include <math.h>
+#include "TelemetryStore.h"
+
+#define NODE 0x0A0B0C0D
+
+static TelemetryStore* store;
+
+void setUp() {
+    store = new TelemetryStore();
+}
+
+void tearDown() {
+    delete store;
+}
+
+static void recordBattery(uint32_t node, uint32_t level) {
+    meshtastic_Telemetry telemetry = meshtastic_Telemetry_init_zero;
+    telemetry.which_variant = meshtastic_Telemetry_device_metrics_tag;
+    telemetry.variant.device_metrics.has_battery_level = true;
+    telemetry.variant.device_metrics.battery_level = level;
+    store->record(node, telemetry);
+    store->update();
+}
+
+static void recordTemperature(uint32_t node, float celsius) {
+    meshtastic_Telemetry telemetry = meshtastic_Telemetry_init_zero;
+    telemetry.which_variant = meshtastic_Telemetry_environment_metrics_tag;
+    telemetry.variant.environment_metrics.has_temperature = true;
+    telemetry.variant.environment_metrics.temperature = celsius;
+    store->record(node, telemetry);
+    store->update();
+}
+
+static void test_raw_window() {
+    recordBattery(NODE, 80);
+    hostAdvanceMillis(10000);
+    recordBattery(NODE, 100);
+    hostAdvanceMillis(10000);
+    recordBattery(NODE, 90);
+
+    TelemetrySummary summary;
+    TEST_ASSERT_TRUE(store->query(NODE, METRIC_BATTERY_LEVEL, 60, &summary));
+    TEST_ASSERT_EQUAL(3, summary.count);
+    TEST_ASSERT_EQUAL_FLOAT(80, summary.min);
+    TEST_ASSERT_EQUAL_FLOAT(100, summary.max);
+    TEST_ASSERT_EQUAL_FLOAT(90, summary.avg);
+
+    // Only the newest sample is within the last 5 s
+    TEST_ASSERT_TRUE(store->query(NODE, METRIC_BATTERY_LEVEL, 5, &summary));
+    TEST_ASSERT_EQUAL(1, summary.count);
+    TEST_ASSERT_FALSE(store->query(NODE, METRIC_VOLTAGE, 60, &summary));
+    TEST_ASSERT_FALSE(store->query(NODE + 1, METRIC_BATTERY_LEVEL, 60, &summary));
+}
+
+static void test_window_past_raw_ring_uses_buckets() {
+    // A rising temperature every 30 s for 100 minutes: the raw ring holds
+    // the last 16 minutes, the rest of an hour comes from the buckets
+    const int samples = 200;
+    for (int i = 0; i < samples; i++) {
+        recordTemperature(NODE, i * 0.5f);
+        hostAdvanceMillis(30000);
+    }
+    const uint32_t window = 3600;
+    const int exact = window / 30;    // Samples within the window
+    const int bucket = TELEMETRY_QUARTER_SECONDS / 30;
+
+    TelemetrySummary summary;
+    TEST_ASSERT_TRUE(store->query(NODE, METRIC_TEMPERATURE, window, &summary));
+    // Whole buckets: the one the window starts in may add older samples, none is counted twice
+    TEST_ASSERT_GREATER_OR_EQUAL(exact, summary.count);
+    TEST_ASSERT_LESS_OR_EQUAL(exact + bucket, summary.count);
+    TEST_ASSERT_EQUAL_FLOAT((samples - 1) * 0.5f, summary.max);
+    TEST_ASSERT_TRUE(summary.min <= (samples - exact) * 0.5f);
+    TEST_ASSERT_TRUE(summary.min >= (samples - exact - bucket) * 0.5f);
+    // The mean of the samples counted, newest first
+    float expectedAvg = ((samples - 1) - (summary.count - 1) / 2.0f) * 0.5f;
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, expectedAvg, summary.avg);
+
+    // Everything stored
+    TEST_ASSERT_TRUE(store->query(NODE, METRIC_TEMPERATURE, 86400, &summary));
+    TEST_ASSERT_EQUAL(samples, summary.count);
+    TEST_ASSERT_EQUAL_FLOAT(0, summary.min);
+}
+
+static void test_least_recent_series_recycled() {
+    for (uint32_t node = 1; node <= TELEMETRY_SERIES_SLOTS; node++) {
+        recordBattery(node, 50);
+        hostAdvanceMillis(1000);
+    }
+    recordBattery(1, 60);          // Node 1 is fresh again; node 2 is now the oldest
+    hostAdvanceMillis(1000);
+    recordBattery(TELEMETRY_SERIES_SLOTS + 1, 70);
+
+    TelemetrySummary summary;
+    TEST_ASSERT_TRUE(store->query(1, METRIC_BATTERY_LEVEL, 3600, &summary));
+    TEST_ASSERT_FALSE(store->query(2, METRIC_BATTERY_LEVEL, 3600, &summary));
+    TEST_ASSERT_TRUE(store->query(TELEMETRY_SERIES_SLOTS + 1, METRIC_BATTERY_LEVEL, 3600, &summary));
+}
+
+static void test_metric_names_and_values() {
+    TelemetryMetric metric;
+    for (uint8_t i = 0; i < METRIC_COUNT; i++) {
+        TEST_ASSERT_TRUE(TelemetryStore::metricFromName(TelemetryStore::metricName((TelemetryMetric)i), &metric));
+        TEST_ASSERT_EQUAL(i, metric);
+    }
+    TEST_ASSERT_FALSE(TelemetryStore::metricFromName("rssi", &metric));
+
+    char text[16];
+    TelemetryStore::formatValue(METRIC_BATTERY_LEVEL, 87.4f, text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("87%", text);
+    TelemetryStore::formatValue(METRIC_VOLTAGE, 3.7123f, text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("3.71V", text);
+    TelemetryStore::formatValue(METRIC_TEMPERATURE, -4.25f, text, sizeof(text), false);
+    TEST_ASSERT_EQUAL_STRING("-4.2", text);
+}
+
+static void test_memory_and_query_time() {
+    // Every slot full: a device metrics report every 60 s for 12 hours from four nodes
+    const uint32_t nodes = TELEMETRY_SERIES_SLOTS / 4;
+    const uint32_t hours = TELEMETRY_QUARTER_BUCKETS * TELEMETRY_QUARTER_SECONDS / 3600;
+    for (uint32_t minute = 0; minute < hours * 60; minute++) {
+        for (uint32_t node = 1; node <= nodes; node++) {
+            meshtastic_Telemetry telemetry = meshtastic_Telemetry_init_zero;
+            telemetry.which_variant = meshtastic_Telemetry_device_metrics_tag;
+            meshtastic_DeviceMetrics& m = telemetry.variant.device_metrics;
+            m.has_battery_level = m.has_voltage = m.has_channel_utilization = m.has_air_util_tx = true;
+            m.battery_level = 100 - minute % 50;
+            m.voltage = 3.6f + (minute % 7) * 0.01f;
+            m.channel_utilization = (minute * node) % 40;
+            m.air_util_tx = (minute % 10) * 0.1f;
+            store->record(node, telemetry);
+        }
+        store->update();
+        hostAdvanceMillis(60000);
+    }
+
+    const uint32_t windows[] = { 120, 600, 1800, 3600, 6 * 3600, hours * 3600 };
+    const int iterations = 10000;
+    uint32_t found = 0;
+    unsigned long start = micros();
+    for (int i = 0; i < iterations; i++) {
+        TelemetrySummary summary;
+        found += store->query(1 + i % nodes, (TelemetryMetric)(i % 4), windows[i % 6], &summary);
+    }
+    unsigned long elapsed = micros() - start;
+    TEST_ASSERT_EQUAL(iterations, found);
+
+    char message[128];
+    snprintf(message, sizeof(message), "%u bytes per series, %u bytes per node-hour (4 metrics, %u h kept); query %.2f us",
+             (unsigned)sizeof(TelemetrySeries), (unsigned)(4 * sizeof(TelemetrySeries) / hours), hours,
+             (double)elapsed / iterations);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_THAN(100, elapsed / iterations);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_raw_window);
+    RUN_TEST(test_window_past_raw_ring_uses_buckets);
+    RUN_TEST(test_least_recent_series_recycled);
+    RUN_TEST(test_metric_names_and_values);
+    RUN_TEST(test_memory_and_query_time);
+    return UNITY_END();
+}
@@ -0,0 +1,178 @@
+#include <unity.h>
+#include <math.h>
+#include <pb_decode.h>
+#include <vector>
+#include "TelemetryProducer.h"
+
+#define NODE          0x5eed1234
+#define SEND_ROUNDS   2000
+
+static TelemetryProducer* producer;
+static std::vector<std::vector<uint8_t>> frames;
+
+void setUp() {
+    producer = new TelemetryProducer();
+    producer->begin(NODE);
+    producer->onSend([](uint8_t* data, size_t length) {
+        frames.push_back(std::vector<uint8_t>(data, data + length));
+    });
+    frames.clear();
+}
+
+void tearDown() {
+    delete producer;
+}
+
+static void advanceTo(unsigned long ms) {
+    TEST_ASSERT_TRUE(millis() <= ms);
+    hostAdvanceMillis(ms - millis());
+}
+
+// Call update() once a second for `seconds`
+static void run(unsigned long seconds) {
+    for (unsigned long i = 0; i < seconds; i++) {
+        producer->update();
+        hostAdvanceMillis(1000);
+    }
+}
+
+static void runUntilSent(size_t count, unsigned long limitSeconds) {
+    for (unsigned long i = 0; i < limitSeconds && frames.size() < count; i++) {
+        producer->update();
+        hostAdvanceMillis(1000);
+    }
+    TEST_ASSERT_EQUAL(count, frames.size());
+}
+
+// Decode the last frame sent and check it against what snapshot() reports now
+static meshtastic_MeshPacket checkLastFrame() {
+    meshtastic_FromRadio fromRadio = meshtastic_FromRadio_init_zero;
+    TEST_ASSERT_TRUE(decode_from_radio(frames.back().data(), frames.back().size(), &fromRadio));
+    TEST_ASSERT_EQUAL(meshtastic_FromRadio_packet_tag, fromRadio.which_payload_variant);
+    const meshtastic_MeshPacket& packet = fromRadio.packet;
+    TEST_ASSERT_EQUAL_HEX32(NODE, packet.from);
+    TEST_ASSERT_EQUAL_HEX32(0xFFFFFFFF, packet.to);
+    TEST_ASSERT_EQUAL(meshtastic_PortNum_TELEMETRY_APP, packet.decoded.portnum);
+
+    meshtastic_Telemetry telemetry = meshtastic_Telemetry_init_zero;
+    pb_istream_t stream = pb_istream_from_buffer(packet.decoded.payload.bytes, packet.decoded.payload.size);
+    TEST_ASSERT_TRUE(pb_decode(&stream, meshtastic_Telemetry_fields, &telemetry));
+    TEST_ASSERT_EQUAL(meshtastic_Telemetry_device_metrics_tag, telemetry.which_variant);
+
+    meshtastic_Telemetry expected = producer->snapshot();
+    const meshtastic_DeviceMetrics& sent = telemetry.variant.device_metrics;
+    const meshtastic_DeviceMetrics& now = expected.variant.device_metrics;
+    TEST_ASSERT_EQUAL(now.battery_level, sent.battery_level);
+    TEST_ASSERT_EQUAL_FLOAT(now.voltage, sent.voltage);
+    TEST_ASSERT_EQUAL_FLOAT(now.channel_utilization, sent.channel_utilization);
+    TEST_ASSERT_EQUAL_FLOAT(now.air_util_tx, sent.air_util_tx);
+    // snapshot() reads the clock a moment later
+    TEST_ASSERT_UINT32_WITHIN(1, now.uptime_seconds, sent.uptime_seconds);
+    return packet;
+}
+
+static bool statsContain(const char* text) {
+    Serial.clearOutput();
+    producer->printStats();
+    return Serial.output().find(text) != std::string::npos;
+}
+
+// Runs first: the uptime varint grows from one byte to two at 128 s of
+// process time, and the clock only moves forward
+static void test_patched_frames_decode() {
+    TEST_ASSERT_LESS_THAN(15000, millis());
+    producer->recordAirtime(true, 40);
+    producer->recordAirtime(false, 120);
+    producer->updateBattery(80, 3.95f, false);
+    runUntilSent(1, TELEMETRY_FIRST_SEND_MS * 2 / 1000);
+    uint32_t firstId = checkLastFrame().id;
+
+    // Last one-byte uptime
+    advanceTo(120000);
+    producer->recordAirtime(true, 200);
+    producer->updateBattery(70, 3.81f, false);
+    producer->update();
+    TEST_ASSERT_EQUAL(2, frames.size());
+    meshtastic_MeshPacket packet = checkLastFrame();
+    TEST_ASSERT_LESS_THAN(128, millis() / 1000);
+    TEST_ASSERT_NOT_EQUAL(firstId, packet.id);
+    TEST_ASSERT_EQUAL(frames[0].size(), frames[1].size());
+
+    // Past 127 s the frame is one byte longer and must be re-encoded
+    advanceTo(190000);
+    producer->updateBattery(60, 3.70f, false);
+    producer->update();
+    TEST_ASSERT_EQUAL(3, frames.size());
+    checkLastFrame();
+    TEST_ASSERT_EQUAL(frames[1].size() + 1, frames[2].size());
+
+    // Scheduled send on the cached two-byte frame
+    runUntilSent(4, (TELEMETRY_SEND_INTERVAL_MS + TELEMETRY_SEND_JITTER_MS) / 1000 + 1);
+    checkLastFrame();
+    TEST_ASSERT_EQUAL(frames[2].size(), frames[3].size());
+    TEST_ASSERT_TRUE(statsContain("Sent: 2 scheduled, 2 on change, 2 encodes"));
+}
+
+static void test_change_hysteresis_and_spacing() {
+    producer->updateBattery(80, 3.95f, false);
+    runUntilSent(1, TELEMETRY_FIRST_SEND_MS * 2 / 1000);
+
+    // Below both thresholds: nothing until the schedule
+    producer->updateBattery(76, 3.90f, false);
+    run(120);
+    TEST_ASSERT_EQUAL(1, frames.size());
+
+    // 5% since the last *sent* frame triggers a send at once
+    producer->updateBattery(75, 3.90f, false);
+    producer->update();
+    TEST_ASSERT_EQUAL(2, frames.size());
+    checkLastFrame();
+
+    // The next change waits out the 60 s spacing, then goes once
+    hostAdvanceMillis(10000);
+    producer->updateBattery(75, 3.75f, false);
+    run(TELEMETRY_MIN_SPACING_MS / 1000 - 12);
+    TEST_ASSERT_EQUAL(2, frames.size());
+    runUntilSent(3, 5);
+    checkLastFrame();
+    run(120);
+    TEST_ASSERT_EQUAL(3, frames.size());
+
+    // Plugging in is a change on its own; level reads 101 while charging
+    producer->updateBattery(75, 3.75f, true);
+    producer->update();
+    TEST_ASSERT_EQUAL(4, frames.size());
+    checkLastFrame();
+    TEST_ASSERT_EQUAL(101, producer->snapshot().variant.device_metrics.battery_level);
+}
+
+static void test_send_time() {
+    producer->updateBattery(50, 3.80f, false);
+    runUntilSent(1, TELEMETRY_FIRST_SEND_MS * 2 / 1000);
+
+    // Toggle charging past the spacing each round, so every update() sends
+    unsigned long total = 0;
+    for (int i = 0; i < SEND_ROUNDS; i++) {
+        hostAdvanceMillis(TELEMETRY_MIN_SPACING_MS);
+        producer->updateBattery(50, 3.80f + (i % 10) * 0.01f, i % 2 == 0);
+        unsigned long start = micros();
+        producer->update();
+        total += micros() - start;
+    }
+    TEST_ASSERT_EQUAL(SEND_ROUNDS + 1, frames.size());
+    checkLastFrame();
+
+    char message[96];
+    snprintf(message, sizeof(message), "%d sends: %.2f us per send (patched), %u byte frame",
+             SEND_ROUNDS, (double)total / SEND_ROUNDS, (unsigned)frames.back().size());
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_THAN(50, total / SEND_ROUNDS);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_patched_frames_decode);
+    RUN_TEST(test_change_hysteresis_and_spacing);
+    RUN_TEST(test_send_time);
+    return UNITY_END();
+}
@@ -0,0 +1,256 @@
+#include <unity.h>
+#include "TextCompressor.h"
+#include "MessageHandler.h"
+#include "FromRadioQueue.h"
+
+static TextCompressor compressor;
+
+static const char* const SAMPLES[] = {
+    "hi",
+    "ok see you there",
+    "Where are you? I'm at the trailhead, going up the ridge now",
+    "Battery at 40%, heading back home before it gets dark",
+    "node 3 has no GPS fix yet, should be there in 10 min",
+    "{\"lat\":52.37,\"lon\":4.89}",
+    "~~~|||```^^^",
+};
+
+void setUp() {}
+void tearDown() {}
+
+static void test_round_trip() {
+    for (const char* text : SAMPLES) {
+        uint8_t packed[256];
+        uint8_t unpacked[256];
+        size_t length = strlen(text);
+        size_t packedLen = compressor.compress((const uint8_t*)text, length, packed, sizeof(packed));
+        TEST_ASSERT_GREATER_THAN_MESSAGE(0, packedLen, text);
+        size_t unpackedLen = compressor.decompress(packed, packedLen, unpacked, sizeof(unpacked));
+        TEST_ASSERT_EQUAL_MESSAGE(length, unpackedLen, text);
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(text, unpacked, length, text);
+    }
+}
+
+// Chat text should come out smaller; bytes outside the codebook cost at
+// most the literal-run escape
+static void test_ratio() {
+    const char* chat = SAMPLES[2];
+    uint8_t packed[256];
+    size_t packedLen = compressor.compress((const uint8_t*)chat, strlen(chat), packed, sizeof(packed));
+    TEST_ASSERT_LESS_THAN(strlen(chat) * 3 / 4, packedLen);
+
+    const uint8_t binary[] = { 0x80, 0x81, 0x82, 0x83, 0x84, 0x85 };
+    packedLen = compressor.compress(binary, sizeof(binary), packed, sizeof(packed));
+    TEST_ASSERT_EQUAL(sizeof(binary) + 2, packedLen);
+}
+
+// Typical mesh chat, for the aggregate ratio and speed
+static const char* const CORPUS[] = {
+    "hi",
+    "ok",
+    "yes",
+    "lol",
+    "on my way",
+    "ok see you there",
+    "Good morning everyone!",
+    "anyone on the mesh today?",
+    "Where are you? I'm at the trailhead, going up the ridge now",
+    "Battery at 40%, heading back home before it gets dark",
+    "node 3 has no GPS fix yet, should be there in 10 min",
+    "Thanks, got it. Signal is good from the hill",
+    "Can you hear me? Testing the new antenna on the roof",
+    "We will meet at the parking lot at 9:30, bring water",
+    "The relay on the water tower is back up after the storm",
+    "I have 2 bars here, moving to the north side of the lake",
+    "Does anyone know how to set the region to EU_868?",
+    "Just checking in from the cabin, all good here",
+    "What time is the net tonight? 20:00 or 21:00?",
+    "Traffic on the bridge, I will be 15 minutes late",
+    "Copy that. Heading out now, back in about an hour",
+    "Is the mesh node at the school still running on solar?",
+    "{\"lat\":52.37,\"lon\":4.89}",
+    "Rain starting here, packing up the camp",
+};
+#define CORPUS_COUNT (sizeof(CORPUS) / sizeof(CORPUS[0]))
+
+static void test_corpus() {
+    const int rounds = 5000;
+    uint8_t packed[CORPUS_COUNT][256];
+    size_t packedLen[CORPUS_COUNT];
+    uint32_t rawBytes = 0;
+    uint32_t packedBytes = 0;
+    for (size_t i = 0; i < CORPUS_COUNT; i++) {
+        packedLen[i] = compressor.compress((const uint8_t*)CORPUS[i], strlen(CORPUS[i]), packed[i], sizeof(packed[i]));
+        TEST_ASSERT_GREATER_THAN_MESSAGE(0, packedLen[i], CORPUS[i]);
+        rawBytes += strlen(CORPUS[i]);
+        packedBytes += packedLen[i];
+    }
+
+    uint8_t out[256];
+    uint32_t bytes = 0;
+    unsigned long start = micros();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < CORPUS_COUNT; i++) {
+            bytes += strlen(CORPUS[i]);
+            compressor.compress((const uint8_t*)CORPUS[i], strlen(CORPUS[i]), out, sizeof(out));
+        }
+    }
+    unsigned long compressMicros = micros() - start;
+
+    uint32_t unpacked = 0;
+    start = micros();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < CORPUS_COUNT; i++) {
+            unpacked += compressor.decompress(packed[i], packedLen[i], out, sizeof(out));
+        }
+    }
+    unsigned long decompressMicros = micros() - start;
+    TEST_ASSERT_EQUAL(bytes, unpacked);
+
+    char line[160];
+    snprintf(line, sizeof(line), "%u messages, %u -> %u bytes (%.1f%%); compress %.1f ns/byte, decompress %.1f ns/byte",
+             (unsigned)CORPUS_COUNT, rawBytes, packedBytes, 100.0 * packedBytes / rawBytes,
+             1000.0 * compressMicros / bytes, 1000.0 * decompressMicros / bytes);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_LESS_THAN(rawBytes * 3 / 4, packedBytes);
+    // Loose bound: a regression to per-byte codebook scans would blow it
+    TEST_ASSERT_LESS_THAN(200, 1000 * compressMicros / bytes);
+    TEST_ASSERT_LESS_THAN(200, 1000 * decompressMicros / bytes);
+}
+
+static void test_rejects_overflow() {
+    const char* text = SAMPLES[2];
+    uint8_t packed[8];
+    TEST_ASSERT_EQUAL(0, compressor.compress((const uint8_t*)text, strlen(text), packed, sizeof(packed)));
+
+    uint8_t full[256];
+    size_t packedLen = compressor.compress((const uint8_t*)text, strlen(text), full, sizeof(full));
+    uint8_t unpacked[16];
+    TEST_ASSERT_EQUAL(0, compressor.decompress(full, packedLen, unpacked, sizeof(unpacked)));
+}
+
+static void test_rejects_malformed() {
+    uint8_t out[64];
+    const uint8_t danglingLiteral[] = { 0x01, TEXT_CODE_LITERAL };
+    TEST_ASSERT_EQUAL(0, compressor.decompress(danglingLiteral, sizeof(danglingLiteral), out, sizeof(out)));
+
+    const uint8_t shortRun[] = { TEXT_CODE_LITERAL_RUN, 4, 'a', 'b' };
+    TEST_ASSERT_EQUAL(0, compressor.decompress(shortRun, sizeof(shortRun), out, sizeof(out)));
+
+    const uint8_t missingLength[] = { TEXT_CODE_LITERAL_RUN };
+    TEST_ASSERT_EQUAL(0, compressor.decompress(missingLength, sizeof(missingLength), out, sizeof(out)));
+}
+
+// Hand a packet sent by createTextMessage back in as if it came off the mesh
+static bool loopBack(MessageHandler& handler, const uint8_t* toRadioBytes, size_t length, meshtastic_Data* sent) {
+    meshtastic_ToRadio toRadio = meshtastic_ToRadio_init_zero;
+    TEST_ASSERT_TRUE(decode_to_radio(toRadioBytes, length, &toRadio));
+    *sent = toRadio.packet.decoded;
+    meshtastic_FromRadio fromRadio = meshtastic_FromRadio_init_zero;
+    fromRadio.which_payload_variant = meshtastic_FromRadio_packet_tag;
+    fromRadio.packet = toRadio.packet;
+    fromRadio.packet.from = 0x1234abcd;
+    uint8_t frame[512];
+    size_t frameLen = 0;
+    TEST_ASSERT_TRUE(encode_from_radio(frame, sizeof(frame), &fromRadio, &frameLen));
+    return handler.processReceivedData(frame, frameLen);
+}
+
+// Stock nodes drop port 302, so plain text is the default
+static void test_plain_by_default() {
+    MessageHandler handler;
+    handler.begin();
+    TEST_ASSERT_FALSE(handler.getTextCompression());
+    uint8_t buffer[FROMRADIO_MAX_FRAME];
+    size_t length = 0;
+    meshtastic_Data sent;
+
+    TEST_ASSERT_TRUE(handler.createTextMessage(SAMPLES[2], strlen(SAMPLES[2]), buffer, &length, sizeof(buffer)));
+    TEST_ASSERT_TRUE(loopBack(handler, buffer, length, &sent));
+    TEST_ASSERT_EQUAL(meshtastic_PortNum_TEXT_MESSAGE_APP, sent.portnum);
+    TEST_ASSERT_EQUAL(strlen(SAMPLES[2]), sent.payload.size);
+    TEST_ASSERT_EQUAL_STRING(SAMPLES[2], handler.conversationMessage(handler.conversationAt(0), 0).text.c_str());
+}
+
+static void test_private_port_and_fallback() {
+    MessageHandler handler;
+    handler.begin();
+    handler.setTextCompression(true);
+    uint8_t buffer[FROMRADIO_MAX_FRAME];
+    size_t length = 0;
+    meshtastic_Data sent;
+
+    TEST_ASSERT_TRUE(handler.createTextMessage(SAMPLES[2], strlen(SAMPLES[2]), buffer, &length, sizeof(buffer)));
+    TEST_ASSERT_TRUE(loopBack(handler, buffer, length, &sent));
+    TEST_ASSERT_EQUAL(TEXT_COMPRESSED_PORT, sent.portnum);
+    TEST_ASSERT_NOT_EQUAL(meshtastic_PortNum_TEXT_MESSAGE_COMPRESSED_APP, sent.portnum);
+
+    // Text the codec cannot shrink goes out readable by stock clients
+    const char* accents = "\xc3\xb1\xc3\xa9\xc3\xbc";
+    TEST_ASSERT_TRUE(handler.createTextMessage(accents, strlen(accents), buffer, &length, sizeof(buffer)));
+    TEST_ASSERT_TRUE(loopBack(handler, buffer, length, &sent));
+    TEST_ASSERT_EQUAL(meshtastic_PortNum_TEXT_MESSAGE_APP, sent.portnum);
+
+    TEST_ASSERT_EQUAL(2, handler.getMessageCount());
+    int conversation = handler.conversationAt(0);
+    TEST_ASSERT_EQUAL_STRING(SAMPLES[2], handler.conversationMessage(conversation, 0).text.c_str());
+    TEST_ASSERT_EQUAL_STRING(accents, handler.conversationMessage(conversation, 1).text.c_str());
+}
+
+// A full raw payload, as the outbound queue can coalesce, encodes past
+// 256 bytes once the MeshPacket and ToRadio framing are added
+static void test_full_payload_fits_frame() {
+    MessageHandler handler;
+    handler.begin();
+    char text[234];
+    for (size_t i = 0; i < sizeof(text); i += 2) {
+        text[i] = 0xc3;
+        text[i + 1] = 0xa9 + (i / 2) % 4;
+    }
+    uint8_t buffer[FROMRADIO_MAX_FRAME];
+    size_t length = 0;
+    meshtastic_Data sent;
+    TEST_ASSERT_TRUE(handler.createTextMessage(text, sizeof(text), buffer, &length, sizeof(buffer)));
+    TEST_ASSERT_GREATER_THAN(256, length);
+    TEST_ASSERT_TRUE(loopBack(handler, buffer, length, &sent));
+    TEST_ASSERT_EQUAL(meshtastic_PortNum_TEXT_MESSAGE_APP, sent.portnum);
+    // 233 bytes would split the last two-byte code point
+    TEST_ASSERT_EQUAL(232, sent.payload.size);
+    TEST_ASSERT_EQUAL_MEMORY(text, sent.payload.bytes, sent.payload.size);
+}
+
+// Port 7 carries Unishox2 from stock firmware; it must not be fed to our codec
+static void test_ignores_unishox_port() {
+    MessageHandler handler;
+    handler.begin();
+    meshtastic_FromRadio fromRadio = meshtastic_FromRadio_init_zero;
+    fromRadio.which_payload_variant = meshtastic_FromRadio_packet_tag;
+    fromRadio.packet.from = 0x1234abcd;
+    fromRadio.packet.to = BROADCAST_ADDR;
+    fromRadio.packet.id = 42;
+    fromRadio.packet.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    fromRadio.packet.decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_COMPRESSED_APP;
+    size_t packedLen = compressor.compress((const uint8_t*)SAMPLES[1], strlen(SAMPLES[1]),
+                                           fromRadio.packet.decoded.payload.bytes,
+                                           sizeof(fromRadio.packet.decoded.payload.bytes));
+    fromRadio.packet.decoded.payload.size = packedLen;
+    uint8_t frame[512];
+    size_t frameLen = 0;
+    TEST_ASSERT_TRUE(encode_from_radio(frame, sizeof(frame), &fromRadio, &frameLen));
+    TEST_ASSERT_FALSE(handler.processReceivedData(frame, frameLen));
+    TEST_ASSERT_EQUAL(0, handler.getMessageCount());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_ratio);
+    RUN_TEST(test_corpus);
+    RUN_TEST(test_rejects_overflow);
+    RUN_TEST(test_rejects_malformed);
+    RUN_TEST(test_plain_by_default);
+    RUN_TEST(test_private_port_and_fallback);
+    RUN_TEST(test_ignores_unishox_port);
+    RUN_TEST(test_full_payload_fits_frame);
+    return UNITY_END();
+}
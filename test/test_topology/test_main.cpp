@@ -0,0 +1,314 @@
+#include <unity.h>
+#include <vector>
+#include "TopologyGraph.h"
+
+#define NODE_BASE        0x1000
+#define MODEL_NODES      80
+#define EPOCHS           40
+#define REACH            3
+#define BENCH_NODES      500
+#define BENCH_UPDATES    20000
+#define BENCH_QUERIES    20000
+#define PATH_BUFFER      (MODEL_NODES + 1)
+
+static TopologyGraph* graph;
+static uint32_t seed;
+
+void setUp() {
+    graph = new TopologyGraph();
+    seed = 1;
+}
+
+void tearDown() {
+    delete graph;
+}
+
+static uint32_t nextRandom() {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+// Same costs as TopologyGraph::edgeCost(), spelled out independently
+static uint16_t referenceCost(int8_t snr) {
+    int value = snr == TOPOLOGY_SNR_UNKNOWN ? 0 : snr;
+    int penalty = TOPOLOGY_GOOD_SNR - value;
+    if (penalty < 0) {
+        penalty = 0;
+    }
+    if (penalty > TOPOLOGY_MAX_PENALTY) {
+        penalty = TOPOLOGY_MAX_PENALTY;
+    }
+    return TOPOLOGY_HOP_COST + penalty;
+}
+
+// What the graph should hold: one slot per ordered pair, plus when it was last heard
+struct ModelEdge {
+    bool present;
+    bool measured;
+    int8_t snr;
+    int seenMinute;
+};
+
+static ModelEdge model[MODEL_NODES][MODEL_NODES];
+static bool modelAdded[MODEL_NODES];
+static int modelMinute;
+static int modelExpired;
+
+static void modelReset() {
+    memset(model, 0, sizeof(model));
+    memset(modelAdded, 0, sizeof(modelAdded));
+    modelMinute = 0;
+    modelExpired = 0;
+}
+
+static void modelSet(int from, int to, int8_t snr, bool measured) {
+    ModelEdge& edge = model[from][to];
+    if (edge.present && edge.measured && !measured) {
+        return;
+    }
+    edge.present = true;
+    edge.measured = measured;
+    edge.snr = snr;
+    edge.seenMinute = modelMinute;
+}
+
+static void report(int from, int to, int8_t snr) {
+    graph->queueEdge(NODE_BASE + from, NODE_BASE + to, snr);
+    modelAdded[from] = modelAdded[to] = true;
+    modelSet(from, to, snr, true);
+    modelSet(to, from, snr, false);
+}
+
+static void modelExpire() {
+    for (int from = 0; from < MODEL_NODES; from++) {
+        for (int to = 0; to < MODEL_NODES; to++) {
+            if (model[from][to].present && modelMinute - model[from][to].seenMinute > TOPOLOGY_EDGE_TTL_MIN) {
+                model[from][to].present = false;
+                modelExpired++;
+            }
+        }
+    }
+}
+
+// Bellman-Ford over the model, from scratch
+static void referenceDistances(int source, uint32_t* dist) {
+    for (int i = 0; i < MODEL_NODES; i++) {
+        dist[i] = UINT32_MAX;
+    }
+    dist[source] = 0;
+    for (int round = 0; round < MODEL_NODES - 1; round++) {
+        bool relaxed = false;
+        for (int from = 0; from < MODEL_NODES; from++) {
+            if (dist[from] == UINT32_MAX) {
+                continue;
+            }
+            for (int to = 0; to < MODEL_NODES; to++) {
+                if (model[from][to].present && dist[from] + referenceCost(model[from][to].snr) < dist[to]) {
+                    dist[to] = dist[from] + referenceCost(model[from][to].snr);
+                    relaxed = true;
+                }
+            }
+        }
+        if (!relaxed) {
+            break;
+        }
+    }
+}
+
+static int referenceHops(int source, int target) {
+    int hops[MODEL_NODES];
+    for (int i = 0; i < MODEL_NODES; i++) {
+        hops[i] = -1;
+    }
+    hops[source] = 0;
+    for (int round = 0; round < MODEL_NODES && hops[target] < 0; round++) {
+        for (int from = 0; from < MODEL_NODES; from++) {
+            if (hops[from] != round) {
+                continue;
+            }
+            for (int to = 0; to < MODEL_NODES; to++) {
+                if (model[from][to].present && hops[to] < 0) {
+                    hops[to] = round + 1;
+                }
+            }
+        }
+    }
+    return hops[target];
+}
+
+static void checkQuery(int source, int target) {
+    uint32_t dist[MODEL_NODES];
+    referenceDistances(source, dist);
+
+    uint32_t path[PATH_BUFFER];
+    uint16_t cost = 0;
+    size_t length = graph->bestPath(NODE_BASE + source, NODE_BASE + target, path, PATH_BUFFER, &cost);
+    if (dist[target] == UINT32_MAX) {
+        TEST_ASSERT_EQUAL(0, length);
+    } else {
+        // Ties may pick a different route; the cost and the walk itself must hold up
+        TEST_ASSERT_NOT_EQUAL(0, length);
+        TEST_ASSERT_EQUAL(dist[target], cost);
+        TEST_ASSERT_EQUAL_HEX32(NODE_BASE + source, path[0]);
+        TEST_ASSERT_EQUAL_HEX32(NODE_BASE + target, path[length - 1]);
+        uint32_t walked = 0;
+        for (size_t i = 1; i < length; i++) {
+            const ModelEdge& edge = model[path[i - 1] - NODE_BASE][path[i] - NODE_BASE];
+            TEST_ASSERT_TRUE(edge.present);
+            walked += referenceCost(edge.snr);
+        }
+        TEST_ASSERT_EQUAL(cost, walked);
+    }
+
+    TEST_ASSERT_EQUAL(referenceHops(source, target), graph->hopCount(NODE_BASE + source, NODE_BASE + target));
+}
+
+static void test_node_added_after_tree_is_unreachable() {
+    graph->queueEdge(1, 2, 20);
+    graph->update();
+    TEST_ASSERT_EQUAL(1, graph->hopCount(1, 2));
+    uint16_t cost = 0;
+    uint32_t path[8];
+    TEST_ASSERT_EQUAL(2, graph->bestPath(1, 2, path, 8, &cost));
+
+    // 3 and 4 join after both trees from 1 were cached, with no link to 1 or 2
+    graph->queueEdge(3, 4, 20);
+    graph->update();
+    TEST_ASSERT_EQUAL(-1, graph->hopCount(1, 4));
+    TEST_ASSERT_EQUAL(-1, graph->hopCount(1, 3));
+    TEST_ASSERT_EQUAL(0, graph->bestPath(1, 4, path, 8, &cost));
+    TEST_ASSERT_EQUAL(0, graph->bestPath(1, 3, path, 8, &cost));
+
+    // Once linked, the trees must notice
+    graph->queueEdge(2, 3, 20);
+    graph->update();
+    TEST_ASSERT_EQUAL(3, graph->hopCount(1, 4));
+    TEST_ASSERT_EQUAL(4, graph->bestPath(1, 4, path, 8, &cost));
+    TEST_ASSERT_EQUAL(3 * referenceCost(20), cost);
+}
+
+static void test_cached_answers_match_recompute() {
+    modelReset();
+    // Let the expiry timer line up with the first epoch
+    hostAdvanceMillis(60000);
+    graph->update();
+
+    int active = 20;
+    int checked = 0;
+    for (int epoch = 0; epoch < EPOCHS; epoch++) {
+        // Mostly short gaps; a long one now and then so edges reported before it age out.
+        // Ages stay well clear of the TTL so millis() drift cannot flip an edge
+        int gap = nextRandom() % 8 == 0 ? 500 : 7;
+        hostAdvanceMillis((unsigned long)gap * 60000);
+        modelMinute += gap;
+        graph->update();
+        modelExpire();
+
+        if (active + 2 <= MODEL_NODES) {
+            // Two newcomers that only hear each other yet, asked about straight away
+            report(active, active + 1, 10);
+            graph->update();
+            checkQuery(0, active + 1);
+            active += 2;
+        }
+        for (int step = 0; step < 40; step++) {
+            // New links, SNR changes on existing ones, and (via `active`) new nodes
+            int batch = 1 + nextRandom() % 4;
+            for (int i = 0; i < batch; i++) {
+                int from = nextRandom() % active;
+                int to = from + 1 + nextRandom() % REACH;
+                if (nextRandom() % 2 == 0) {
+                    to = from - 1 - nextRandom() % REACH;
+                }
+                if (to < 0 || to >= active) {
+                    continue;
+                }
+                int8_t snr = nextRandom() % 10 == 0 ? TOPOLOGY_SNR_UNKNOWN : (int8_t)((int)(nextRandom() % 161) - 80);
+                report(from, to, snr);
+            }
+            graph->update();
+
+            // A few queries from a small set of sources so cached trees get reused
+            for (int i = 0; i < 3; i++) {
+                int source = nextRandom() % 4;
+                int target = nextRandom() % active;
+                if (modelAdded[source] && modelAdded[target]) {
+                    checkQuery(source, target);
+                    checked++;
+                }
+            }
+        }
+    }
+
+    char message[96];
+    snprintf(message, sizeof(message), "%d queries checked against Bellman-Ford/BFS, %u nodes, %u edges, %d expired",
+             checked, (unsigned)graph->nodeCount(), (unsigned)graph->edgeCount(), modelExpired);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_GREATER_THAN(1000, checked);
+    TEST_ASSERT_GREATER_THAN(0, modelExpired);
+}
+
+static void test_throughput() {
+    // Each node linked to its neighbours up to REACH away, in both directions
+    for (int from = 0; from < BENCH_NODES; from++) {
+        for (int d = 1; d <= REACH && from + d < BENCH_NODES; d++) {
+            graph->queueEdge(NODE_BASE + from, NODE_BASE + from + d, (int8_t)((int)(nextRandom() % 81) - 40));
+            graph->queueEdge(NODE_BASE + from + d, NODE_BASE + from, (int8_t)((int)(nextRandom() % 81) - 40));
+            graph->update();
+        }
+    }
+    TEST_ASSERT_EQUAL(BENCH_NODES, graph->nodeCount());
+
+    // Updates in traceroute-sized batches
+    unsigned long start = micros();
+    for (int i = 0; i < BENCH_UPDATES; i++) {
+        int from = nextRandom() % (BENCH_NODES - REACH);
+        graph->queueEdge(NODE_BASE + from, NODE_BASE + from + 1 + nextRandom() % REACH, (int8_t)((int)(nextRandom() % 81) - 40));
+        if (i % 8 == 7) {
+            graph->update();
+        }
+    }
+    graph->update();
+    unsigned long updateMicros = max(micros() - start, 1UL);
+
+    // Queries from a handful of sources, as the phone and the screen would ask
+    uint32_t path[BENCH_NODES];
+    start = micros();
+    for (int i = 0; i < BENCH_QUERIES; i++) {
+        uint32_t source = NODE_BASE + nextRandom() % TOPOLOGY_CACHE_SLOTS;
+        uint32_t target = NODE_BASE + nextRandom() % BENCH_NODES;
+        if (i % 2 == 0) {
+            graph->bestPath(source, target, path, BENCH_NODES);
+        } else {
+            graph->hopCount(source, target);
+        }
+    }
+    unsigned long queryMicros = max(micros() - start, 1UL);
+
+    // The same, with an SNR change between every ten queries
+    start = micros();
+    for (int i = 0; i < BENCH_QUERIES; i++) {
+        if (i % 10 == 0) {
+            int from = nextRandom() % (BENCH_NODES - REACH);
+            graph->queueEdge(NODE_BASE + from, NODE_BASE + from + 1, (int8_t)((int)(nextRandom() % 81) - 40));
+            graph->update();
+        }
+        graph->bestPath(NODE_BASE + nextRandom() % TOPOLOGY_CACHE_SLOTS, NODE_BASE + nextRandom() % BENCH_NODES, path, BENCH_NODES);
+    }
+    unsigned long mixedMicros = max(micros() - start, 1UL);
+
+    char message[160];
+    snprintf(message, sizeof(message), "%d nodes: %.0f updates/s, %.0f queries/s cached, %.0f queries/s with 1 update per 10",
+             BENCH_NODES, BENCH_UPDATES * 1e6 / updateMicros, BENCH_QUERIES * 1e6 / queryMicros,
+             BENCH_QUERIES * 1e6 / mixedMicros);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_THAN(20, queryMicros / BENCH_QUERIES);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_node_added_after_tree_is_unreachable);
+    RUN_TEST(test_cached_answers_match_recompute);
+    RUN_TEST(test_throughput);
+    return UNITY_END();
+}
@@ -0,0 +1,145 @@
+#include <unity.h>
+#include "Utf8Text.h"
+
+// Chat traffic as it shows up on public channels, plus damaged bytes
+static const char* const SAMPLES[] = {
+    "Anyone on the mountain repeater tonight? Signal is good from here",
+    "Caf\xc3\xa9" " at 18:00, bring the spare antenna \xe2\x80\x94 see you there \xe2\x80\x9c" "folks\xe2\x80\x9d",
+    "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82, \xd0\xba\xd0\xb0\xd0\xba \xd1\x81\xd0\xb2\xd1\x8f\xd0\xb7\xd1\x8c? 73",
+    "\xe4\xbd\xa0\xe5\xa5\xbd\xef\xbc\x8c\xe4\xbf\xa1\xe5\x8f\xb7\xe5\xbe\x88\xe5\xa5\xbd mesh test",
+    "Battery \xe2\x9a\xa1 charged \xf0\x9f\x91\x8d\xf0\x9f\x8f\xbd ok \xe2\x9c\x94\xef\xb8\x8f",
+    "Gr\xc3\xbc\xc3\x9f" "e aus M\xc3\xbcnchen \xe2\x86\x92 Z\xc3\xbc" "rich, \xc3\xa7" "a va?",
+    "Truncated sequence \xe2\x82 and stray \x80\xbf bytes \xc0\xaf overlong",
+};
+static const int SAMPLE_COUNT = sizeof(SAMPLES) / sizeof(SAMPLES[0]);
+
+void setUp() {}
+void tearDown() {}
+
+static void test_decode() {
+    size_t pos = 0;
+    const char* text = "a\xc3\xa9\xe2\x80\x94\xf0\x9f\x91\x8d";
+    size_t length = strlen(text);
+    TEST_ASSERT_EQUAL_HEX32('a', Utf8Text::decode(text, length, &pos));
+    TEST_ASSERT_EQUAL_HEX32(0xE9, Utf8Text::decode(text, length, &pos));
+    TEST_ASSERT_EQUAL_HEX32(0x2014, Utf8Text::decode(text, length, &pos));
+    TEST_ASSERT_EQUAL_HEX32(0x1F44D, Utf8Text::decode(text, length, &pos));
+    TEST_ASSERT_EQUAL(length, pos);
+}
+
+// Each malformed form yields one replacement and moves on by one byte
+static void test_decode_malformed() {
+    const char* const BAD[] = {
+        "\x80",               // Stray continuation
+        "\xc0\xaf",           // Overlong '/'
+        "\xed\xa0\x80",       // Surrogate
+        "\xf4\x90\x80\x80",   // Past U+10FFFF
+        "\xe2\x82",           // Cut short
+        "\xff",
+    };
+    for (const char* bad : BAD) {
+        size_t pos = 0;
+        TEST_ASSERT_EQUAL_HEX32(UTF8_REPLACEMENT, Utf8Text::decode(bad, strlen(bad), &pos));
+        TEST_ASSERT_EQUAL(1, pos);
+    }
+}
+
+static void test_sanitize() {
+    char out[64];
+    const uint8_t in[] = { 'o', 'k', '\t', 0xe2, 0x82, '!', '\n', 0xc3, 0xa9 };
+    size_t length = Utf8Text::sanitize(in, sizeof(in), out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("ok ??!\n\xc3\xa9", out);
+    TEST_ASSERT_EQUAL(strlen(out), length);
+
+    // Cut on a code point boundary, never mid-sequence
+    length = Utf8Text::sanitize(in, sizeof(in), out, 8);
+    TEST_ASSERT_EQUAL_STRING("ok ??!\n", out);
+
+    // Stops at an embedded NUL
+    const uint8_t nul[] = { 'a', 0, 'b' };
+    TEST_ASSERT_EQUAL(1, Utf8Text::sanitize(nul, sizeof(nul), out, sizeof(out)));
+
+    // In place
+    char text[] = "x\x80y";
+    Utf8Text::sanitize((const uint8_t*)text, 3, text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("x?y", text);
+}
+
+static void test_truncate() {
+    const char* text = "ab\xe2\x80\x94";
+    TEST_ASSERT_EQUAL(5, Utf8Text::truncate(text, 5, 10));
+    TEST_ASSERT_EQUAL(2, Utf8Text::truncate(text, 5, 4));
+    TEST_ASSERT_EQUAL(2, Utf8Text::truncate(text, 5, 3));
+    TEST_ASSERT_EQUAL(2, Utf8Text::truncate(text, 5, 2));
+}
+
+static void test_glyphs() {
+    char out[64];
+    Utf8Text::toGlyphs(SAMPLES[4], strlen(SAMPLES[4]), out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("Battery + charged + ok v", out);
+
+    Utf8Text::toGlyphs(SAMPLES[1], strlen(SAMPLES[1]), out, sizeof(out));
+    TEST_ASSERT_EQUAL_HEX8(0xE9, (uint8_t)out[3]);
+    TEST_ASSERT_NOT_NULL(strstr(out, "antenna - see you there \"folks\""));
+
+    TEST_ASSERT_EQUAL('?', Utf8Text::toGlyph(0x4F60));
+    TEST_ASSERT_EQUAL(UTF8_NO_GLYPH, Utf8Text::toGlyph(0xFE0F));
+}
+
+// Every sample comes out valid: decoding the sanitized text finds no
+// replacement characters
+static void test_sanitize_output_is_valid() {
+    char out[256];
+    for (int i = 0; i < SAMPLE_COUNT; i++) {
+        size_t length = Utf8Text::sanitize((const uint8_t*)SAMPLES[i], strlen(SAMPLES[i]), out, sizeof(out));
+        size_t pos = 0;
+        while (pos < length) {
+            TEST_ASSERT_NOT_EQUAL(UTF8_REPLACEMENT, Utf8Text::decode(out, length, &pos));
+        }
+    }
+}
+
+// Sanitize and glyph mapping cost per byte over the samples
+static void test_throughput() {
+    const int rounds = 20000;
+    char buffer[256];
+    uint32_t bytes = 0;
+    uint32_t glyphs = 0;
+
+    unsigned long start = micros();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < SAMPLE_COUNT; i++) {
+            bytes += Utf8Text::sanitize((const uint8_t*)SAMPLES[i], strlen(SAMPLES[i]), buffer, sizeof(buffer));
+        }
+    }
+    unsigned long sanitizeMicros = micros() - start;
+
+    start = micros();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < SAMPLE_COUNT; i++) {
+            glyphs += Utf8Text::toGlyphs(SAMPLES[i], strlen(SAMPLES[i]), buffer, sizeof(buffer));
+        }
+    }
+    unsigned long glyphMicros = micros() - start;
+
+    char line[128];
+    snprintf(line, sizeof(line), "%d messages, %u bytes -> %u glyphs; sanitize %.1f ns/byte, glyph map %.1f ns/byte",
+             rounds * SAMPLE_COUNT, bytes, glyphs,
+             1000.0 * sanitizeMicros / bytes, 1000.0 * glyphMicros / bytes);
+    TEST_MESSAGE(line);
+    // Loose bound: a regression to per-byte allocation or rescanning would blow it
+    TEST_ASSERT_LESS_THAN(100, 1000 * sanitizeMicros / bytes);
+    TEST_ASSERT_LESS_THAN(100, 1000 * glyphMicros / bytes);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_decode);
+    RUN_TEST(test_decode_malformed);
+    RUN_TEST(test_sanitize);
+    RUN_TEST(test_truncate);
+    RUN_TEST(test_glyphs);
+    RUN_TEST(test_sanitize_output_is_valid);
+    RUN_TEST(test_throughput);
+    return UNITY_END();
+}
@@ -0,0 +1,221 @@
+#include <unity.h>
+#include <deque>
+#include "XModemTransfer.h"
+#include "StoreForward.h"
+
+// Frames the device sent back, decoded
+static std::deque<meshtastic_XModem> replies;
+static XModemTransfer xmodem;
+
+// What the client sends goes through the same path as onToRadio: one
+// ToRadio decode, then dispatch on the payload variant
+static void clientSend(meshtastic_XModem_Control control, uint16_t seq, const uint8_t* bytes, size_t size,
+                       bool corrupt = false) {
+    meshtastic_ToRadio toRadio = meshtastic_ToRadio_init_zero;
+    toRadio.which_payload_variant = meshtastic_ToRadio_xmodemPacket_tag;
+    toRadio.xmodemPacket.control = control;
+    toRadio.xmodemPacket.seq = seq;
+    if (size > 0) {
+        memcpy(toRadio.xmodemPacket.buffer.bytes, bytes, size);
+    }
+    toRadio.xmodemPacket.buffer.size = size;
+    toRadio.xmodemPacket.crc16 = xmodem_crc16(bytes, size) ^ (corrupt ? 1 : 0);
+
+    uint8_t frame[FROMRADIO_MAX_FRAME];
+    size_t length = 0;
+    TEST_ASSERT_TRUE(encode_to_radio(frame, sizeof(frame), &toRadio, &length));
+
+    static meshtastic_ToRadio decoded;
+    memset(&decoded, 0, sizeof(decoded));
+    TEST_ASSERT_TRUE(decode_to_radio(frame, length, &decoded));
+    TEST_ASSERT_EQUAL(meshtastic_ToRadio_xmodemPacket_tag, decoded.which_payload_variant);
+    xmodem.handlePacket(decoded.xmodemPacket);
+}
+
+static meshtastic_XModem nextReply() {
+    TEST_ASSERT_FALSE(replies.empty());
+    meshtastic_XModem reply = replies.front();
+    replies.pop_front();
+    return reply;
+}
+
+static void expectReply(meshtastic_XModem_Control control, uint16_t seq) {
+    meshtastic_XModem reply = nextReply();
+    TEST_ASSERT_EQUAL(control, reply.control);
+    TEST_ASSERT_EQUAL(seq, reply.seq);
+}
+
+static void fillPattern(uint8_t* data, size_t length, uint8_t seed) {
+    for (size_t i = 0; i < length; i++) {
+        data[i] = (uint8_t)(i * 31 + seed + (i >> 7));
+    }
+}
+
+static void upload(const char* name, const uint8_t* data, size_t length) {
+    clientSend(meshtastic_XModem_Control_SOH, 0, (const uint8_t*)name, strlen(name));
+    expectReply(meshtastic_XModem_Control_ACK, 0);
+    uint16_t seq = 1;
+    for (size_t offset = 0; offset < length; offset += XMODEM_BLOCK_SIZE, seq++) {
+        clientSend(meshtastic_XModem_Control_SOH, seq, data + offset, min((size_t)XMODEM_BLOCK_SIZE, length - offset));
+        expectReply(meshtastic_XModem_Control_ACK, seq);
+    }
+    clientSend(meshtastic_XModem_Control_EOT, 0, nullptr, 0);
+    expectReply(meshtastic_XModem_Control_ACK, seq);
+    TEST_ASSERT_FALSE(xmodem.isActive());
+}
+
+// Download `name`, ACKing every block; returns the bytes received
+static size_t download(const char* name, uint8_t* out, size_t maxLen) {
+    clientSend(meshtastic_XModem_Control_STX, 0, (const uint8_t*)name, strlen(name));
+    size_t length = 0;
+    while (!replies.empty()) {
+        meshtastic_XModem block = nextReply();
+        if (block.control == meshtastic_XModem_Control_EOT) {
+            clientSend(meshtastic_XModem_Control_ACK, 0, nullptr, 0);
+            break;
+        }
+        TEST_ASSERT_EQUAL(meshtastic_XModem_Control_SOH, block.control);
+        TEST_ASSERT_EQUAL_HEX16(xmodem_crc16(block.buffer.bytes, block.buffer.size), block.crc16);
+        size_t offset = (size_t)(block.seq - 1) * XMODEM_BLOCK_SIZE;
+        TEST_ASSERT_LESS_OR_EQUAL(maxLen, offset + block.buffer.size);
+        memcpy(out + offset, block.buffer.bytes, block.buffer.size);
+        length = max(length, offset + block.buffer.size);
+        clientSend(meshtastic_XModem_Control_ACK, block.seq, nullptr, 0);
+    }
+    TEST_ASSERT_FALSE(xmodem.isActive());
+    return length;
+}
+
+void setUp() {
+    hostFlash.wipe();
+    replies.clear();
+    xmodem = XModemTransfer();
+    TEST_ASSERT_TRUE(xmodem.begin());
+    xmodem.onSend([](uint8_t* data, size_t length) {
+        meshtastic_FromRadio fromRadio = meshtastic_FromRadio_init_zero;
+        TEST_ASSERT_TRUE(decode_from_radio(data, length, &fromRadio));
+        TEST_ASSERT_EQUAL(meshtastic_FromRadio_xmodemPacket_tag, fromRadio.which_payload_variant);
+        replies.push_back(fromRadio.xmodemPacket);
+    });
+}
+
+void tearDown() {}
+
+// Upload then download a file that ends mid-block and spans sectors
+static void test_round_trip() {
+    static uint8_t file[10000];
+    static uint8_t back[10000];
+    fillPattern(file, sizeof(file), 3);
+
+    upload("notes.txt", file, sizeof(file));
+    // Header sector plus three data sectors, each erased once
+    TEST_ASSERT_EQUAL(4, hostFlash.sectorErases);
+
+    memset(back, 0, sizeof(back));
+    TEST_ASSERT_EQUAL(sizeof(file), download("notes.txt", back, sizeof(back)));
+    TEST_ASSERT_EQUAL_MEMORY(file, back, sizeof(file));
+}
+
+// A corrupt block is NAKed with the block wanted; a repeated one is re-ACKed
+static void test_upload_recovers() {
+    uint8_t file[3 * XMODEM_BLOCK_SIZE];
+    uint8_t back[sizeof(file)];
+    fillPattern(file, sizeof(file), 9);
+
+    clientSend(meshtastic_XModem_Control_SOH, 0, (const uint8_t*)"a.bin", 5);
+    expectReply(meshtastic_XModem_Control_ACK, 0);
+    clientSend(meshtastic_XModem_Control_SOH, 1, file, XMODEM_BLOCK_SIZE);
+    expectReply(meshtastic_XModem_Control_ACK, 1);
+    clientSend(meshtastic_XModem_Control_SOH, 2, file + XMODEM_BLOCK_SIZE, XMODEM_BLOCK_SIZE, true);
+    expectReply(meshtastic_XModem_Control_NAK, 2);
+    clientSend(meshtastic_XModem_Control_SOH, 3, file + 2 * XMODEM_BLOCK_SIZE, XMODEM_BLOCK_SIZE);
+    expectReply(meshtastic_XModem_Control_NAK, 2);
+    clientSend(meshtastic_XModem_Control_SOH, 1, file, XMODEM_BLOCK_SIZE);
+    expectReply(meshtastic_XModem_Control_ACK, 1);
+    clientSend(meshtastic_XModem_Control_SOH, 2, file + XMODEM_BLOCK_SIZE, XMODEM_BLOCK_SIZE);
+    expectReply(meshtastic_XModem_Control_ACK, 2);
+    clientSend(meshtastic_XModem_Control_SOH, 3, file + 2 * XMODEM_BLOCK_SIZE, XMODEM_BLOCK_SIZE);
+    expectReply(meshtastic_XModem_Control_ACK, 3);
+    clientSend(meshtastic_XModem_Control_EOT, 0, nullptr, 0);
+    expectReply(meshtastic_XModem_Control_ACK, 4);
+
+    TEST_ASSERT_EQUAL(sizeof(file), download("a.bin", back, sizeof(back)));
+    TEST_ASSERT_EQUAL_MEMORY(file, back, sizeof(file));
+}
+
+// The sender keeps XMODEM_SEND_WINDOW blocks in flight, goes back on a
+// NAK and resends the window after a silent timeout
+static void test_download_window_and_resend() {
+    uint8_t file[8 * XMODEM_BLOCK_SIZE];
+    fillPattern(file, sizeof(file), 5);
+    upload("w.bin", file, sizeof(file));
+
+    clientSend(meshtastic_XModem_Control_STX, 0, (const uint8_t*)"w.bin", 5);
+    TEST_ASSERT_EQUAL(XMODEM_SEND_WINDOW, replies.size());
+    for (uint16_t seq = 1; seq <= XMODEM_SEND_WINDOW; seq++) {
+        TEST_ASSERT_EQUAL(seq, nextReply().seq);
+    }
+
+    // Block 2 was lost: ACK 1, NAK 2
+    clientSend(meshtastic_XModem_Control_ACK, 1, nullptr, 0);
+    TEST_ASSERT_EQUAL(5, nextReply().seq);
+    replies.clear();
+    clientSend(meshtastic_XModem_Control_NAK, 2, nullptr, 0);
+    TEST_ASSERT_EQUAL(XMODEM_SEND_WINDOW, replies.size());
+    TEST_ASSERT_EQUAL(2, nextReply().seq);
+    replies.clear();
+
+    // Nothing heard: the window from the oldest unacknowledged block again
+    hostAdvanceMillis(XMODEM_TIMEOUT_MS + 1);
+    xmodem.update();
+    TEST_ASSERT_EQUAL(XMODEM_SEND_WINDOW, replies.size());
+    TEST_ASSERT_EQUAL(2, nextReply().seq);
+    replies.clear();
+
+    clientSend(meshtastic_XModem_Control_ACK, 8, nullptr, 0);
+    expectReply(meshtastic_XModem_Control_EOT, 0);
+    clientSend(meshtastic_XModem_Control_ACK, 0, nullptr, 0);
+    TEST_ASSERT_FALSE(xmodem.isActive());
+}
+
+static void test_missing_file_and_cancel() {
+    clientSend(meshtastic_XModem_Control_STX, 0, (const uint8_t*)"none", 4);
+    expectReply(meshtastic_XModem_Control_NAK, 0);
+    TEST_ASSERT_FALSE(xmodem.isActive());
+
+    clientSend(meshtastic_XModem_Control_SOH, 0, (const uint8_t*)"c.bin", 5);
+    expectReply(meshtastic_XModem_Control_ACK, 0);
+    TEST_ASSERT_TRUE(xmodem.isActive());
+    clientSend(meshtastic_XModem_Control_CAN, 0, nullptr, 0);
+    TEST_ASSERT_FALSE(xmodem.isActive());
+
+    // The cancelled upload invalidated the old file
+    uint8_t out[16];
+    TEST_ASSERT_EQUAL(0, xmodem.readFile("c.bin", out, sizeof(out)));
+}
+
+// Uploads stop short of the Store & Forward ring at the partition's end
+static void test_rejects_file_past_history_ring() {
+    static uint8_t block[XMODEM_BLOCK_SIZE];
+    size_t room = HOST_PARTITION_SIZE - SF_FLASH_BYTES - XMODEM_SECTOR_SIZE;
+    clientSend(meshtastic_XModem_Control_SOH, 0, (const uint8_t*)"big", 3);
+    expectReply(meshtastic_XModem_Control_ACK, 0);
+    uint16_t seq = 1;
+    for (size_t sent = 0; sent < room; sent += XMODEM_BLOCK_SIZE, seq++) {
+        clientSend(meshtastic_XModem_Control_SOH, seq, block, sizeof(block));
+        expectReply(meshtastic_XModem_Control_ACK, seq);
+    }
+    clientSend(meshtastic_XModem_Control_SOH, seq, block, sizeof(block));
+    expectReply(meshtastic_XModem_Control_CAN, 0);
+    TEST_ASSERT_FALSE(xmodem.isActive());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_upload_recovers);
+    RUN_TEST(test_download_window_and_resend);
+    RUN_TEST(test_missing_file_and_cancel);
+    RUN_TEST(test_rejects_file_past_history_ring);
+    return UNITY_END();
+}